@@ -0,0 +1,1240 @@
+// File: benchmark.cpp - Compressor performance benchmarks.
+// See Copyright Notice and license at the end of inc/crnlib.h
+//
+// Example command line (see crunch_benchmark.cpp):
+// crunch_benchmark -test threads -in c:\temp\test.tga [-maxThreads 32] [-iterations 3] [-quality 128] [-DXT5] [-fileformat dds]
+// crunch_benchmark -test dxt -in c:\temp\test.tga [-size 4096] [-maxThreads 32] [-iterations 3] [-compressor ryg] [-dxtquality normal] [-DXT5|-ETC1]
+// crunch_benchmark -test sort -in c:\temp\test.tga [-iterations 3]
+// crunch_benchmark -test vq -in c:\temp\test.tga [-size 4096] [-maxThreads 32] [-iterations 1]
+// crunch_benchmark -test chunks -in c:\temp\test.tga [-size 4096] [-iterations 3]
+// crunch_benchmark -test decode -in c:\temp\test.tga [-in c:\temp\test2.crn ...] [-iterations 10] [-quality 128]
+#include "crn_core.h"
+#include "benchmark.h"
+#include "crn_console.h"
+#include "crn_image_utils.h"
+#include "crn_threading.h"
+#include "crn_dxt_image.h"
+#include "crn_comp.h"
+#include "crn_rand.h"
+#include "crn_cfile_stream.h"
+#include "crn_tree_clusterizer.h"
+#include "crn_dxt_hc.h"
+#include <malloc.h>
+
+#if !CRNLIB_USE_WIN32_API
+#define _msize malloc_usable_size
+#endif
+
+#define CRND_HEADER_FILE_ONLY
+#include "crn_decomp.h"
+
+namespace crnlib
+{
+   benchmark::benchmark()
+   {
+   }
+
+   bool benchmark::load_image(uint in_index)
+   {
+      dynamic_string filename;
+      if (!m_params.get_value_as_string("in", in_index, filename))
+      {
+         console::error("Must specify an input image with -in!");
+         return false;
+      }
+
+      if (!image_utils::read_from_file(m_img, filename.get_ptr(), 0))
+      {
+         console::error("Failed loading image file: %s", filename.get_ptr());
+         return false;
+      }
+
+      console::printf("Loaded image \"%s\", %ux%u", filename.get_ptr(), m_img.get_width(), m_img.get_height());
+
+      return true;
+   }
+
+   bool benchmark::init_comp_params(crn_comp_params& comp_params)
+   {
+      comp_params.clear();
+
+      comp_params.m_width = m_img.get_width();
+      comp_params.m_height = m_img.get_height();
+      comp_params.m_pImages[0][0] = reinterpret_cast<const crn_uint32*>(m_img.get_ptr());
+      comp_params.m_format = m_params.has_key("DXT5") ? cCRNFmtDXT5 : cCRNFmtDXT1;
+      comp_params.m_quality_level = m_params.get_value_as_int("quality", 0, 128, cCRNMinQualityLevel, cCRNMaxQualityLevel);
+
+      dynamic_string file_format;
+      if ((m_params.get_value_as_string("fileformat", 0, file_format)) && (file_format == "dds"))
+         comp_params.m_file_type = cCRNFileTypeDDS;
+
+      return comp_params.check();
+   }
+
+   bool benchmark::compress(const crn_comp_params& comp_params, double& time, uint& compressed_size)
+   {
+      timer t;
+      t.start();
+
+      crn_uint32 comp_size = 0;
+      void* pData = crn_compress(comp_params, comp_size);
+
+      time = t.get_elapsed_secs();
+      compressed_size = comp_size;
+
+      if (!pData)
+      {
+         console::error("crn_compress() failed!");
+         return false;
+      }
+
+      crn_free_block(pData);
+      return true;
+   }
+
+   // Compresses the same image with 1, 2, 4 ... N total threads (the calling thread plus N-1 helpers) and reports the best time of each.
+   bool benchmark::test_threads()
+   {
+      if (!load_image())
+         return false;
+
+      crn_comp_params comp_params;
+      if (!init_comp_params(comp_params))
+         return false;
+
+      const uint max_threads = m_params.get_value_as_int("maxThreads", 0, g_number_of_processors, 1, cCRNMaxHelperThreads + 1);
+      const uint num_iterations = m_params.get_value_as_int("iterations", 0, 1, 1, 100);
+
+      console::printf("Threads      Time  Speedup  Size");
+
+      double base_time = 0.0f;
+
+      for (uint num_threads = 1; ; num_threads = math::minimum(num_threads * 2, max_threads))
+      {
+         comp_params.m_num_helper_threads = num_threads - 1;
+
+         double best_time = 1e+10f;
+         uint compressed_size = 0;
+
+         for (uint i = 0; i < num_iterations; i++)
+         {
+            double time;
+            if (!compress(comp_params, time, compressed_size))
+               return false;
+
+            best_time = math::minimum(best_time, time);
+         }
+
+         if (num_threads == 1)
+            base_time = best_time;
+
+         console::printf("%7u %8.3fs %7.2fx  %u", num_threads, best_time, base_time / best_time, compressed_size);
+
+         if (num_threads == max_threads)
+            break;
+      }
+
+      return true;
+   }
+
+   // Packs a size x size texture (the input image tiled to fill it) with dxt_image::init(), comparing the old round-robin
+   // block schedule against contiguous chunks at 1, 2, 4 ... N total threads. Endpoint caching makes the CRN compressor's output
+   // depend on which blocks each thread saw before, so the two schedules are only required to match when that can't happen.
+   bool benchmark::test_dxt_schedule()
+   {
+      if (!load_image())
+         return false;
+
+      const uint size = m_params.get_value_as_int("size", 0, 4096, 4, 16384);
+
+      image_u8 img(size, size);
+      for (uint y = 0; y < size; y++)
+         for (uint x = 0; x < size; x++)
+            img(x, y) = m_img(x % m_img.get_width(), y % m_img.get_height());
+
+      dxt_format fmt = cDXT1;
+      if (m_params.has_key("DXT5"))
+         fmt = cDXT5;
+      else if (m_params.has_key("ETC1"))
+         fmt = cETC1;
+
+      dxt_image::pack_params pack_params;
+      pack_params.m_quality = cCRNDXTQualityNormal;
+
+      dynamic_string comp_name;
+      if (m_params.get_value_as_string("compressor", 0, comp_name))
+      {
+         uint i;
+         for (i = 0; i < cCRNTotalDXTCompressors; i++)
+         {
+            if (comp_name == get_dxt_compressor_name(static_cast<crn_dxt_compressor_type>(i)))
+            {
+               pack_params.m_compressor = static_cast<crn_dxt_compressor_type>(i);
+               break;
+            }
+         }
+         if (i == cCRNTotalDXTCompressors)
+         {
+            console::error("Invalid compressor: \"%s\"", comp_name.get_ptr());
+            return false;
+         }
+      }
+
+      dynamic_string dxt_quality_str;
+      if (m_params.get_value_as_string("dxtquality", 0, dxt_quality_str))
+      {
+         uint i;
+         for (i = 0; i < cCRNDXTQualityTotal; i++)
+         {
+            if (dxt_quality_str == crn_get_dxt_quality_string(static_cast<crn_dxt_quality>(i)))
+            {
+               pack_params.m_quality = static_cast<crn_dxt_quality>(i);
+               break;
+            }
+         }
+         if (i == cCRNDXTQualityTotal)
+         {
+            console::error("Invalid DXT quality: \"%s\"", dxt_quality_str.get_ptr());
+            return false;
+         }
+      }
+
+      const uint max_threads = m_params.get_value_as_int("maxThreads", 0, g_number_of_processors, 1, cCRNMaxHelperThreads + 1);
+      const uint num_iterations = m_params.get_value_as_int("iterations", 0, 1, 1, 100);
+
+      console::printf("Packing %ux%u %s, compressor: %s, quality: %s", size, size, get_dxt_format_string(fmt),
+         get_dxt_compressor_name(pack_params.m_compressor), crn_get_dxt_quality_string(pack_params.m_quality));
+      console::printf("Threads  Round-robin    Chunked  Speedup");
+
+      for (uint num_threads = 1; ; num_threads = math::minimum(num_threads * 2, max_threads))
+      {
+         task_pool pool;
+         if (!pool.init(num_threads - 1))
+            return false;
+         pack_params.m_pTask_pool = &pool;
+
+         double best_time[2] = { 1e+10f, 1e+10f };
+         dxt_image dxt_img[2];
+
+         for (uint i = 0; i < num_iterations; i++)
+         {
+            for (uint schedule = 0; schedule < 2; schedule++)
+            {
+               pack_params.m_interleaved_blocks = (schedule == 0);
+
+               timer t;
+               t.start();
+
+               if (!dxt_img[schedule].init(fmt, img, pack_params))
+               {
+                  console::error("dxt_image::init() failed!");
+                  return false;
+               }
+
+               best_time[schedule] = math::minimum(best_time[schedule], t.get_elapsed_secs());
+            }
+         }
+
+         const bool must_match = (num_threads == 1) || (pack_params.m_compressor != cCRNDXTCompressorCRN) || (!pack_params.m_endpoint_caching);
+         if ((must_match) && (memcmp(dxt_img[0].get_element_ptr(), dxt_img[1].get_element_ptr(), dxt_img[0].get_size_in_bytes()) != 0))
+         {
+            console::error("Round-robin and chunked schedules produced different blocks!");
+            return false;
+         }
+
+         console::printf("%7u %11.3fs %9.3fs %7.2fx", num_threads, best_time[0], best_time[1], best_time[0] / best_time[1]);
+
+         if (num_threads == max_threads)
+            break;
+      }
+
+      return true;
+   }
+
+   // The exhaustive O(n^2) nearest neighbor chain crn_comp::sort_color_endpoint_codebook() used to build.
+   static void sort_color_endpoint_codebook_reference(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints)
+   {
+      remapping.resize(endpoints.size());
+
+      uint lowest_energy = UINT_MAX;
+      uint lowest_energy_index = 0;
+
+      for (uint i = 0; i < endpoints.size(); i++)
+      {
+         color_quad_u8 a(dxt1_block::unpack_endpoint(endpoints[i], 0, true));
+         color_quad_u8 b(dxt1_block::unpack_endpoint(endpoints[i], 1, true));
+
+         uint total = a.r + a.g + a.b + b.r + b.g + b.b;
+
+         if (total < lowest_energy)
+         {
+            lowest_energy = total;
+            lowest_energy_index = i;
+         }
+      }
+
+      uint cur_index = lowest_energy_index;
+
+      crnlib::vector<bool> chosen_flags(endpoints.size());
+
+      uint n = 0;
+      for ( ; ; )
+      {
+         chosen_flags[cur_index] = true;
+
+         remapping[cur_index] = n;
+         n++;
+         if (n == endpoints.size())
+            break;
+
+         uint lowest_error = UINT_MAX;
+         uint lowest_error_index = 0;
+
+         color_quad_u8 a(dxt1_block::unpack_endpoint(endpoints[cur_index], 0, true));
+         color_quad_u8 b(dxt1_block::unpack_endpoint(endpoints[cur_index], 1, true));
+
+         for (uint i = 0; i < endpoints.size(); i++)
+         {
+            if (chosen_flags[i])
+               continue;
+
+            color_quad_u8 c(dxt1_block::unpack_endpoint(endpoints[i], 0, true));
+            color_quad_u8 d(dxt1_block::unpack_endpoint(endpoints[i], 1, true));
+
+            uint total = color::elucidian_distance(a, c, false) + color::elucidian_distance(b, d, false);
+
+            if (total < lowest_error)
+            {
+               lowest_error = total;
+               lowest_error_index = i;
+            }
+         }
+
+         cur_index = lowest_error_index;
+      }
+   }
+
+   // Times crn_comp::sort_color_endpoint_codebook() against the exhaustive reference on 1K-8K entry palettes, made
+   // from the color extents of random 4x4 blocks of the input image. Both must produce the same ordering.
+   bool benchmark::test_endpoint_sort()
+   {
+      if (!load_image())
+         return false;
+
+      const uint num_iterations = m_params.get_value_as_int("iterations", 0, 1, 1, 100);
+
+      console::printf("Palette  Reference   Indexed  Speedup");
+
+      for (uint palette_size = 1024; palette_size <= cCRNMaxPaletteSize; palette_size *= 2)
+      {
+         random rm;
+         rm.seed(palette_size);
+
+         crnlib::vector<uint> endpoints(palette_size);
+         for (uint i = 0; i < palette_size; i++)
+         {
+            const uint x = rm.irand(0, math::maximum<int>(1, m_img.get_width() - 3));
+            const uint y = rm.irand(0, math::maximum<int>(1, m_img.get_height() - 3));
+
+            color_quad_u8 lo(255, 255, 255, 255), hi(0, 0, 0, 255);
+            for (uint by = 0; by < 4; by++)
+            {
+               for (uint bx = 0; bx < 4; bx++)
+               {
+                  const color_quad_u8& c = m_img.get_clamped(x + bx, y + by);
+                  for (uint k = 0; k < 3; k++)
+                  {
+                     lo[k] = math::minimum(lo[k], c[k]);
+                     hi[k] = math::maximum(hi[k], c[k]);
+                  }
+               }
+            }
+
+            endpoints[i] = dxt1_block::pack_endpoints(dxt1_block::pack_color(lo, true), dxt1_block::pack_color(hi, true));
+         }
+
+         double best_time[2] = { 1e+10f, 1e+10f };
+         crnlib::vector<uint> remapping[2];
+
+         for (uint i = 0; i < num_iterations; i++)
+         {
+            for (uint method = 0; method < 2; method++)
+            {
+               timer t;
+               t.start();
+
+               if (method)
+                  crn_comp::sort_color_endpoint_codebook(remapping[method], endpoints);
+               else
+                  sort_color_endpoint_codebook_reference(remapping[method], endpoints);
+
+               best_time[method] = math::minimum(best_time[method], t.get_elapsed_secs());
+            }
+         }
+
+         if (!(remapping[0] == remapping[1]))
+         {
+            console::error("Endpoint orderings differ!");
+            return false;
+         }
+
+         console::printf("%7u %9.3fs %8.3fs %7.2fx", palette_size, best_time[0], best_time[1], best_time[0] / best_time[1]);
+      }
+
+      return true;
+   }
+
+   // The tree_clusterizer::generate_codebook() the heap driven one replaced: every split scanned all the nodes for the leaf
+   // with the highest variance, and each node owned a copy of its training vectors.
+   template<typename VectorType>
+   class tree_clusterizer_reference
+   {
+   public:
+      void add_training_vec(const VectorType& v, uint weight)
+      {
+         m_hist[v] += weight;
+      }
+
+      void generate_codebook(uint max_size)
+      {
+         double ttsum = 0.0f;
+
+         vq_node root;
+         root.m_vectors.reserve(static_cast<uint>(m_hist.size()));
+
+         for (typename std::map<VectorType, uint>::const_iterator it = m_hist.begin(); it != m_hist.end(); ++it)
+         {
+            root.m_centroid += (it->first * (float)it->second);
+            root.m_total_weight += it->second;
+            root.m_vectors.push_back(*it);
+
+            ttsum += it->first.dot(it->first) * it->second;
+         }
+
+         root.m_variance = (float)(ttsum - (root.m_centroid.dot(root.m_centroid) / root.m_total_weight));
+         root.m_centroid *= (1.0f / root.m_total_weight);
+
+         m_nodes.clear();
+         m_nodes.reserve(max_size * 2 + 1);
+         m_nodes.push_back(root);
+
+         for (uint total_leaves = 1; total_leaves < max_size; total_leaves++)
+         {
+            int worst_node_index = -1;
+            float worst_variance = -1.0f;
+
+            for (uint i = 0; i < m_nodes.size(); i++)
+            {
+               const vq_node& node = m_nodes[i];
+               if ((node.m_left == -1) && (!node.m_unsplittable) && (node.m_variance > worst_variance))
+               {
+                  worst_variance = node.m_variance;
+                  worst_node_index = i;
+               }
+            }
+
+            if (worst_variance <= 0.0f)
+               break;
+
+            split_node(worst_node_index);
+         }
+      }
+
+      float get_overall_variance() const
+      {
+         float variance = 0.0f;
+         for (uint i = 0; i < m_nodes.size(); i++)
+            if (m_nodes[i].m_left == -1)
+               variance += m_nodes[i].m_variance;
+         return variance;
+      }
+
+   private:
+      std::map<VectorType, uint> m_hist;
+
+      struct vq_node
+      {
+         vq_node() : m_centroid(cClear), m_total_weight(0), m_left(-1), m_right(-1), m_unsplittable(false) { }
+
+         VectorType m_centroid;
+         uint64 m_total_weight;
+         float m_variance;
+         crnlib::vector< std::pair<VectorType, uint> > m_vectors;
+         int m_left;
+         int m_right;
+         bool m_unsplittable;
+      };
+
+      crnlib::vector<vq_node> m_nodes;
+
+      void split_node(uint index)
+      {
+         vq_node& parent_node = m_nodes[index];
+
+         if (parent_node.m_vectors.size() == 1)
+            return;
+
+         VectorType furthest(0);
+         double furthest_dist = -1.0f;
+
+         for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+         {
+            double dist = parent_node.m_vectors[i].first.squared_distance(parent_node.m_centroid);
+            if (dist > furthest_dist)
+            {
+               furthest_dist = dist;
+               furthest = parent_node.m_vectors[i].first;
+            }
+         }
+
+         VectorType opposite;
+         double opposite_dist = -1.0f;
+
+         for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+         {
+            double dist = parent_node.m_vectors[i].first.squared_distance(furthest);
+            if (dist > opposite_dist)
+            {
+               opposite_dist = dist;
+               opposite = parent_node.m_vectors[i].first;
+            }
+         }
+
+         VectorType left_child((furthest + parent_node.m_centroid) * .5f);
+         VectorType right_child((opposite + parent_node.m_centroid) * .5f);
+
+         if (parent_node.m_vectors.size() > 2)
+         {
+            const uint N = VectorType::num_elements;
+
+            matrix<N, N, float> covar;
+            covar.clear();
+
+            for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+            {
+               const VectorType v(parent_node.m_vectors[i].first - parent_node.m_centroid);
+               const VectorType w(v * (float)parent_node.m_vectors[i].second);
+
+               for (uint x = 0; x < N; x++)
+                  for (uint y = x; y < N; y++)
+                     covar[x][y] = covar[x][y] + v[x] * w[y];
+            }
+
+            for (uint x = 0; x != (N - 1); x++)
+               for (uint y = x + 1; y < N; y++)
+                  covar[y][x] = covar[x][y];
+
+            covar /= float(parent_node.m_total_weight);
+
+            VectorType axis(1.0f);
+
+            for (uint iter = 0; iter < 10; iter++)
+            {
+               VectorType x;
+               double max_sum = 0;
+
+               for (uint i = 0; i < N; i++)
+               {
+                  double sum = 0;
+                  for (uint j = 0; j < N; j++)
+                     sum += axis[j] * covar[i][j];
+
+                  x[i] = (float)sum;
+                  max_sum = i ? math::maximum(max_sum, sum) : sum;
+               }
+
+               if (max_sum != 0.0f)
+                  x *= (float)(1.0f / max_sum);
+
+               axis = x;
+            }
+
+            axis.normalize();
+
+            VectorType new_left_child(0.0f);
+            VectorType new_right_child(0.0f);
+
+            double left_weight = 0.0f;
+            double right_weight = 0.0f;
+
+            for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+            {
+               const float weight = (float)parent_node.m_vectors[i].second;
+               const VectorType& v = parent_node.m_vectors[i].first;
+
+               double t = (v - parent_node.m_centroid) * axis;
+               if (t < 0.0f)
+               {
+                  new_left_child += v * weight;
+                  left_weight += weight;
+               }
+               else
+               {
+                  new_right_child += v * weight;
+                  right_weight += weight;
+               }
+            }
+
+            if ((left_weight > 0.0f) && (right_weight > 0.0f))
+            {
+               left_child = new_left_child * (float)(1.0f/left_weight);
+               right_child = new_right_child * (float)(1.0f/right_weight);
+            }
+         }
+
+         uint64 left_weight = 0;
+         uint64 right_weight = 0;
+
+         crnlib::vector< std::pair<VectorType, uint> > left_children;
+         crnlib::vector< std::pair<VectorType, uint> > right_children;
+
+         left_children.reserve(parent_node.m_vectors.size() / 2);
+         right_children.reserve(parent_node.m_vectors.size() / 2);
+
+         float prev_total_variance = 1e+10f;
+
+         float left_variance = 0.0f;
+         float right_variance = 0.0f;
+
+         for (uint total_loops = 0; total_loops < 1024; total_loops++)
+         {
+            left_children.resize(0);
+            right_children.resize(0);
+
+            VectorType new_left_child(cClear);
+            VectorType new_right_child(cClear);
+
+            double left_ttsum = 0.0f;
+            double right_ttsum = 0.0f;
+
+            left_weight = 0;
+            right_weight = 0;
+
+            for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+            {
+               const VectorType& v = parent_node.m_vectors[i].first;
+               const uint weight = parent_node.m_vectors[i].second;
+
+               if (left_child.squared_distance(v) < right_child.squared_distance(v))
+               {
+                  left_children.push_back(parent_node.m_vectors[i]);
+                  new_left_child += (v * (float)weight);
+                  left_weight += weight;
+                  left_ttsum += v.dot(v) * weight;
+               }
+               else
+               {
+                  right_children.push_back(parent_node.m_vectors[i]);
+                  new_right_child += (v * (float)weight);
+                  right_weight += weight;
+                  right_ttsum += v.dot(v) * weight;
+               }
+            }
+
+            if ((!left_weight) || (!right_weight))
+            {
+               parent_node.m_unsplittable = true;
+               return;
+            }
+
+            left_variance = (float)(left_ttsum - (new_left_child.dot(new_left_child) / left_weight));
+            right_variance = (float)(right_ttsum - (new_right_child.dot(new_right_child) / right_weight));
+
+            left_child = new_left_child * (1.0f / left_weight);
+            right_child = new_right_child * (1.0f / right_weight);
+
+            float total_variance = left_variance + right_variance;
+            if (total_variance < .00001f)
+               break;
+
+            if (((prev_total_variance - total_variance) / total_variance) < .00001f)
+               break;
+
+            prev_total_variance = total_variance;
+         }
+
+         const uint left_child_index = m_nodes.size();
+
+         parent_node.m_left = left_child_index;
+         parent_node.m_right = left_child_index + 1;
+
+         m_nodes.resize(m_nodes.size() + 2);
+
+         vq_node& left_child_node = m_nodes[left_child_index];
+         vq_node& right_child_node = m_nodes[left_child_index + 1];
+
+         left_child_node.m_centroid = left_child;
+         left_child_node.m_total_weight = left_weight;
+         left_child_node.m_vectors.swap(left_children);
+         left_child_node.m_variance = left_variance;
+
+         right_child_node.m_centroid = right_child;
+         right_child_node.m_total_weight = right_weight;
+         right_child_node.m_vectors.swap(right_children);
+         right_child_node.m_variance = right_variance;
+      }
+   };
+
+   typedef vec<6, float> vec6F;
+   typedef vec<16, float> vec16F;
+
+   // Counts the bytes held in crnlib's heap, to report the peak memory use of each codebook build.
+   struct heap_usage
+   {
+      heap_usage() : m_cur(0), m_peak(0) { }
+
+      void reset() { m_cur = 0; m_peak = 0; }
+
+      void add(int64 size)
+      {
+         scoped_mutex lock(m_mutex);
+         m_cur += size;
+         m_peak = math::maximum(m_peak, m_cur);
+      }
+
+      mutex m_mutex;
+      int64 m_cur;
+      int64 m_peak;
+   };
+
+   static size_t heap_usage_msize(void* p, void* pUser_data)
+   {
+      pUser_data;
+      return p ? _msize(p) : 0;
+   }
+
+   // Same as crnlib's default allocator (which can't resize in place outside of Windows), so blocks may be freed by either.
+   static void* heap_usage_realloc(void* p, size_t size, size_t* pActual_size, bool movable, void* pUser_data)
+   {
+      heap_usage& usage = *static_cast<heap_usage*>(pUser_data);
+
+      const int64 cur_size = p ? static_cast<int64>(_msize(p)) : 0;
+
+      void* p_new = NULL;
+      if (!size)
+         ::free(p);
+      else if ((!p) || (movable))
+         p_new = ::realloc(p, size);
+
+      if ((p_new) || (!size))
+         usage.add((p_new ? static_cast<int64>(_msize(p_new)) : 0) - cur_size);
+
+      if (pActual_size)
+         *pActual_size = p_new ? _msize(p_new) : (size ? cur_size : 0);
+
+      return p_new;
+   }
+
+   // Builds a codebook with the reference and the heap driven tree clusterizers (the latter on 1 thread, and on the given task
+   // pool), printing the time and peak heap use of each. Both thread counts must build the same codebook.
+   template<typename VectorType>
+   static bool test_tree_clusterizer_codebook(const char* pName, const crnlib::vector<VectorType>& vecs, uint codebook_size, task_pool& tp, uint num_iterations)
+   {
+      heap_usage usage;
+
+      double best_time[3] = { 1e+10f, 1e+10f, 1e+10f };
+      int64 peak_heap[3] = { 0, 0, 0 };
+      float variance[3] = { 0, 0, 0 };
+      crnlib::vector<VectorType> codebook[2];
+
+      for (uint i = 0; i < num_iterations; i++)
+      {
+         for (uint method = 0; method < 3; method++)
+         {
+            tree_clusterizer_reference<VectorType> reference;
+            tree_clusterizer<VectorType> clusterizer;
+
+            for (uint j = 0; j < vecs.size(); j++)
+            {
+               if (method)
+                  clusterizer.add_training_vec(vecs[j], 1);
+               else
+                  reference.add_training_vec(vecs[j], 1);
+            }
+
+            usage.reset();
+            crn_set_memory_callbacks(heap_usage_realloc, heap_usage_msize, &usage);
+
+            timer t;
+            t.start();
+
+            if (method)
+               clusterizer.generate_codebook(codebook_size, (method == 2) ? &tp : NULL);
+            else
+               reference.generate_codebook(codebook_size);
+
+            best_time[method] = math::minimum(best_time[method], t.get_elapsed_secs());
+
+            crn_set_memory_callbacks(NULL, NULL, NULL);
+
+            peak_heap[method] = usage.m_peak;
+            variance[method] = method ? clusterizer.get_overall_variance() : reference.get_overall_variance();
+
+            if (method)
+               codebook[method - 1] = clusterizer.get_codebook();
+         }
+      }
+
+      if (!(codebook[0] == codebook[1]))
+      {
+         console::error("Codebooks built with and without helper threads differ!");
+         return false;
+      }
+
+      const double MB = 1024.0f * 1024.0f;
+      console::printf("%-9s %8u %8u %9.3fs %8.3fs %8.3fs %7.2fx %7.1fMB %7.1fMB %10.3f %10.3f", pName, vecs.size(), codebook[0].size(),
+         best_time[0], best_time[1], best_time[2], best_time[0] / best_time[2], peak_heap[0] / MB, peak_heap[2] / MB, variance[0], variance[2]);
+
+      return true;
+   }
+
+   // Packs a size x size texture (the input image tiled to fill it) to DXT5, and builds 3072 and 8192 entry codebooks from its color
+   // endpoints and its color and alpha selectors, the training vectors dxt_hc clusterizes, with the old node scanning tree clusterizer
+   // and with tree_clusterizer, at 1 and N total threads. Reports the build times, the peak heap use, and the total variance of the
+   // resulting clusters.
+   bool benchmark::test_tree_clusterizer()
+   {
+      if (!load_image())
+         return false;
+
+      const uint size = m_params.get_value_as_int("size", 0, 4096, 4, 16384);
+      const uint max_threads = m_params.get_value_as_int("maxThreads", 0, g_number_of_processors, 1, cCRNMaxHelperThreads + 1);
+      const uint num_iterations = m_params.get_value_as_int("iterations", 0, 1, 1, 100);
+
+      image_u8 img(size, size);
+      for (uint y = 0; y < size; y++)
+         for (uint x = 0; x < size; x++)
+            img(x, y) = m_img(x % m_img.get_width(), y % m_img.get_height());
+
+      task_pool tp;
+      if (!tp.init(max_threads - 1))
+         return false;
+
+      dxt_image::pack_params pack_params;
+      pack_params.m_pTask_pool = &tp;
+
+      dxt_image dxt_img;
+      if (!dxt_img.init(cDXT5, img, pack_params))
+      {
+         console::error("Failed packing the image to DXT5!");
+         return false;
+      }
+
+      const uint color_element = (dxt_img.get_element_type(0) == dxt_image::cColorDXT1) ? 0 : 1;
+      const uint alpha_element = color_element ^ 1;
+
+      crnlib::vector<vec6F> endpoints(dxt_img.get_total_blocks());
+      crnlib::vector<vec16F> color_selectors(dxt_img.get_total_blocks());
+      crnlib::vector<vec16F> alpha_selectors(dxt_img.get_total_blocks());
+
+      for (uint by = 0; by < dxt_img.get_blocks_y(); by++)
+      {
+         for (uint bx = 0; bx < dxt_img.get_blocks_x(); bx++)
+         {
+            const uint block_index = bx + by * dxt_img.get_blocks_x();
+
+            color_quad_u8 lo, hi;
+            dxt_img.get_block_endpoints(bx, by, color_element, lo, hi);
+
+            vec6F& e = endpoints[block_index];
+            for (uint c = 0; c < 3; c++)
+            {
+               e[c] = lo[c] * (1.0f / 255.0f);
+               e[3 + c] = hi[c] * (1.0f / 255.0f);
+            }
+
+            for (uint i = 0; i < 16; i++)
+            {
+               color_selectors[block_index][i] = dxt_img.get_selector(bx * 4 + (i & 3), by * 4 + (i >> 2), color_element) * (1.0f / 3.0f);
+               alpha_selectors[block_index][i] = dxt_img.get_selector(bx * 4 + (i & 3), by * 4 + (i >> 2), alpha_element) * (1.0f / 7.0f);
+            }
+         }
+      }
+
+      console::printf("Using %u total threads", max_threads);
+      console::printf("Vectors      Count Codebook  Reference  1 thread N threads  Speedup  Ref heap Tree heap    Ref var   Variance");
+
+      static const uint s_codebook_sizes[] = { 3072, 8192 };
+
+      for (uint i = 0; i < CRNLIB_ARRAY_SIZE(s_codebook_sizes); i++)
+      {
+         const uint codebook_size = s_codebook_sizes[i];
+
+         if (!test_tree_clusterizer_codebook("endpoint", endpoints, codebook_size, tp, num_iterations))
+            return false;
+         if (!test_tree_clusterizer_codebook("color sel", color_selectors, codebook_size, tp, num_iterations))
+            return false;
+         if (!test_tree_clusterizer_codebook("alpha sel", alpha_selectors, codebook_size, tp, num_iterations))
+            return false;
+      }
+
+      return true;
+   }
+
+   // dxt_hc's chunk layout before pixel_chunk was made planar: 2x2 interleaved RGBA blocks, 4 cache lines of pixels per chunk.
+   struct pixel_chunk_interleaved
+   {
+      dxt_pixel_block m_blocks[cChunkBlockHeight][cChunkBlockWidth];
+      float m_weight;
+
+      const color_quad_u8& operator() (uint cx, uint cy) const
+      {
+         return m_blocks[cy >> cBlockPixelHeightShift][cx >> cBlockPixelWidthShift].m_pixels[cy & (cBlockPixelHeight - 1)][cx & (cBlockPixelWidth - 1)];
+      }
+
+      color_quad_u8& operator() (uint cx, uint cy)
+      {
+         return m_blocks[cy >> cBlockPixelHeightShift][cx >> cBlockPixelWidthShift].m_pixels[cy & (cBlockPixelHeight - 1)][cx & (cBlockPixelWidth - 1)];
+      }
+   };
+
+   CRNLIB_DEFINE_BITWISE_COPYABLE(pixel_chunk_interleaved);
+
+   // Splits a size x size texture (the input image tiled to fill it) into 8x8 chunks with the old interleaved layout and with
+   // dxt_hc::pixel_chunk, then runs an alpha pass (sum and sum of squares of A, like the alpha tile statistics) and a luma pass
+   // (Y from R, G and B) over every chunk of each. Reports the best time of each step and the pixel throughput of the passes,
+   // along with the cache lines of chunk data each pass streams through, as there are no portable cache miss counters.
+   bool benchmark::test_chunk_layout()
+   {
+      if (!load_image())
+         return false;
+
+      const uint size = m_params.get_value_as_int("size", 0, 4096, 8, 16384) & ~(cChunkPixelWidth - 1);
+      const uint num_iterations = m_params.get_value_as_int("iterations", 0, 3, 1, 100);
+
+      image_u8 img(size, size);
+      for (uint y = 0; y < size; y++)
+         for (uint x = 0; x < size; x++)
+            img(x, y) = m_img(x % m_img.get_width(), y % m_img.get_height());
+
+      const uint num_chunks_x = size / cChunkPixelWidth;
+      const uint num_chunks = num_chunks_x * num_chunks_x;
+      const uint cChunkPixels = cChunkPixelWidth * cChunkPixelHeight;
+
+      crnlib::vector<pixel_chunk_interleaved> interleaved(num_chunks);
+      dxt_hc::pixel_chunk_vec planar(num_chunks);
+
+      double best_time[2][3] = { { 1e+10f, 1e+10f, 1e+10f }, { 1e+10f, 1e+10f, 1e+10f } };
+      uint64 alpha_sums[2][2] = { { 0, 0 }, { 0, 0 } };
+      uint64 luma_sums[2] = { 0, 0 };
+
+      for (uint i = 0; i < num_iterations; i++)
+      {
+         for (uint layout = 0; layout < 2; layout++)
+         {
+            timer t;
+            t.start();
+
+            for (uint chunk_index = 0; chunk_index < num_chunks; chunk_index++)
+            {
+               const uint x_ofs = (chunk_index % num_chunks_x) * cChunkPixelWidth;
+               const uint y_ofs = (chunk_index / num_chunks_x) * cChunkPixelHeight;
+
+               for (uint cy = 0; cy < cChunkPixelHeight; cy++)
+               {
+                  for (uint cx = 0; cx < cChunkPixelWidth; cx++)
+                  {
+                     if (layout)
+                        planar[chunk_index].set_pixel(cx, cy, img(x_ofs + cx, y_ofs + cy));
+                     else
+                        interleaved[chunk_index](cx, cy) = img(x_ofs + cx, y_ofs + cy);
+                  }
+               }
+            }
+
+            best_time[layout][0] = math::minimum(best_time[layout][0], t.get_elapsed_secs());
+
+            t.start();
+
+            uint64 alpha_sum = 0, alpha_sum2 = 0;
+            for (uint chunk_index = 0; chunk_index < num_chunks; chunk_index++)
+            {
+               uint s = 0, s2 = 0;
+
+               if (layout)
+               {
+                  const uint8* pA = planar[chunk_index].get_plane(3);
+                  for (uint j = 0; j < cChunkPixels; j++)
+                  {
+                     s += pA[j];
+                     s2 += pA[j] * pA[j];
+                  }
+               }
+               else
+               {
+                  const pixel_chunk_interleaved& chunk = interleaved[chunk_index];
+                  for (uint cy = 0; cy < cChunkPixelHeight; cy++)
+                  {
+                     for (uint cx = 0; cx < cChunkPixelWidth; cx++)
+                     {
+                        const uint a = chunk(cx, cy).a;
+                        s += a;
+                        s2 += a * a;
+                     }
+                  }
+               }
+
+               alpha_sum += s;
+               alpha_sum2 += s2;
+            }
+
+            best_time[layout][1] = math::minimum(best_time[layout][1], t.get_elapsed_secs());
+
+            t.start();
+
+            uint64 luma_sum = 0;
+            for (uint chunk_index = 0; chunk_index < num_chunks; chunk_index++)
+            {
+               uint s = 0;
+
+               if (layout)
+               {
+                  const uint8* pR = planar[chunk_index].get_plane(0);
+                  const uint8* pG = planar[chunk_index].get_plane(1);
+                  const uint8* pB = planar[chunk_index].get_plane(2);
+                  for (uint j = 0; j < cChunkPixels; j++)
+                     s += (pR[j] * 77 + pG[j] * 150 + pB[j] * 29) >> 8;
+               }
+               else
+               {
+                  const pixel_chunk_interleaved& chunk = interleaved[chunk_index];
+                  for (uint cy = 0; cy < cChunkPixelHeight; cy++)
+                  {
+                     for (uint cx = 0; cx < cChunkPixelWidth; cx++)
+                     {
+                        const color_quad_u8& c = chunk(cx, cy);
+                        s += (c.r * 77 + c.g * 150 + c.b * 29) >> 8;
+                     }
+                  }
+               }
+
+               luma_sum += s;
+            }
+
+            best_time[layout][2] = math::minimum(best_time[layout][2], t.get_elapsed_secs());
+
+            alpha_sums[layout][0] = alpha_sum;
+            alpha_sums[layout][1] = alpha_sum2;
+            luma_sums[layout] = luma_sum;
+         }
+      }
+
+      if ((alpha_sums[0][0] != alpha_sums[1][0]) || (alpha_sums[0][1] != alpha_sums[1][1]) || (luma_sums[0] != luma_sums[1]))
+      {
+         console::error("The interleaved and planar chunks hold different pixels!");
+         return false;
+      }
+
+      const double total_mpixels = static_cast<double>(num_chunks) * cChunkPixels / 1000000.0f;
+
+      console::printf("%u chunks, %u bytes per interleaved chunk, %u per planar chunk", num_chunks, (uint)sizeof(pixel_chunk_interleaved), (uint)sizeof(dxt_hc::pixel_chunk));
+      console::printf("Layout          Gather   Alpha pass   MPix/s  Lines/chunk   Luma pass   MPix/s  Lines/chunk");
+
+      static const char* s_layout_names[] = { "interleaved", "planar" };
+      static const uint s_alpha_lines[] = { 4, 1 };
+      static const uint s_luma_lines[] = { 4, 3 };
+
+      for (uint layout = 0; layout < 2; layout++)
+      {
+         console::printf("%-12s %8.3fs %11.3fs %8.1f %12u %10.3fs %8.1f %12u", s_layout_names[layout], best_time[layout][0],
+            best_time[layout][1], total_mpixels / best_time[layout][1], s_alpha_lines[layout],
+            best_time[layout][2], total_mpixels / best_time[layout][2], s_luma_lines[layout]);
+      }
+
+      return true;
+   }
+
+   // Transcodes every level of a corpus of CRN files with crnd_unpack_level_reference(), the original one symbol per lookup
+   // decoder, and crnd_unpack_level(). -in may be given more than once: .CRN files are used as is, images are first compressed
+   // to mipmapped DXT1 and DXT5 .CRN files. Both decoders must produce identical blocks.
+   bool benchmark::test_decode()
+   {
+      const uint num_inputs = m_params.get_count("in");
+      if (!num_inputs)
+      {
+         console::error("Must specify an input image or .CRN file with -in!");
+         return false;
+      }
+
+      const uint num_iterations = m_params.get_value_as_int("iterations", 0, 10, 1, 1000);
+
+      crnlib::vector< crnlib::vector<uint8> > corpus;
+
+      for (uint i = 0; i < num_inputs; i++)
+      {
+         dynamic_string filename;
+         m_params.get_value_as_string("in", i, filename);
+
+         crnlib::vector<uint8> file_data;
+         if (!cfile_stream::read_file_into_array(filename.get_ptr(), file_data))
+         {
+            console::error("Failed reading file: %s", filename.get_ptr());
+            return false;
+         }
+
+         crnd::crn_texture_info tex_info;
+         if (crnd::crnd_get_texture_info(file_data.get_ptr(), file_data.size(), &tex_info))
+         {
+            corpus.push_back(file_data);
+            continue;
+         }
+
+         if (!load_image(i))
+            return false;
+
+         crn_comp_params comp_params;
+         if (!init_comp_params(comp_params))
+            return false;
+
+         comp_params.m_file_type = cCRNFileTypeCRN;
+
+         for (uint format = 0; format < 2; format++)
+         {
+            comp_params.m_format = format ? cCRNFmtDXT5 : cCRNFmtDXT1;
+
+            crn_uint32 comp_size = 0;
+            void* pData = crn_compress(comp_params, crn_mipmap_params(), comp_size);
+            if (!pData)
+            {
+               console::error("crn_compress() failed!");
+               return false;
+            }
+
+            corpus.enlarge(1)->append(static_cast<const uint8*>(pData), comp_size);
+            crn_free_block(pData);
+         }
+      }
+
+      console::printf("Format     Size  Levels   Reference       Fast  Speedup");
+
+      double total_time[2] = { 0.0f, 0.0f };
+
+      for (uint i = 0; i < corpus.size(); i++)
+      {
+         const crnlib::vector<uint8>& crn_data = corpus[i];
+
+         crnd::crn_texture_info tex_info;
+         if (!crnd::crnd_get_texture_info(crn_data.get_ptr(), crn_data.size(), &tex_info))
+            return false;
+
+         crnd::crnd_unpack_context pContext = crnd::crnd_unpack_begin(crn_data.get_ptr(), crn_data.size());
+         if (!pContext)
+         {
+            console::error("crnd_unpack_begin() failed!");
+            return false;
+         }
+
+         crnlib::vector<uint8> blocks[2][cCRNMaxLevels];
+         uint level_sizes[cCRNMaxLevels];
+         for (uint level_index = 0; level_index < tex_info.m_levels; level_index++)
+         {
+            const uint blocks_x = math::maximum(1U, ((tex_info.m_width >> level_index) + 3) >> 2);
+            const uint blocks_y = math::maximum(1U, ((tex_info.m_height >> level_index) + 3) >> 2);
+            level_sizes[level_index] = blocks_x * blocks_y * tex_info.m_bytes_per_block;
+
+            for (uint method = 0; method < 2; method++)
+               blocks[method][level_index].resize(level_sizes[level_index] * tex_info.m_faces);
+         }
+
+         double best_time[2] = { 1e+10f, 1e+10f };
+
+         for (uint iter = 0; iter < num_iterations; iter++)
+         {
+            for (uint method = 0; method < 2; method++)
+            {
+               timer t;
+               t.start();
+
+               for (uint level_index = 0; level_index < tex_info.m_levels; level_index++)
+               {
+                  void* pFaces[cCRNMaxFaces];
+                  for (uint f = 0; f < tex_info.m_faces; f++)
+                     pFaces[f] = &blocks[method][level_index][level_sizes[level_index] * f];
+
+                  const bool success = method ?
+                     crnd::crnd_unpack_level(pContext, pFaces, level_sizes[level_index], 0, level_index) :
+                     crnd::crnd_unpack_level_reference(pContext, pFaces, level_sizes[level_index], 0, level_index);
+
+                  if (!success)
+                  {
+                     console::error("Failed unpacking level %u!", level_index);
+                     crnd::crnd_unpack_end(pContext);
+                     return false;
+                  }
+               }
+
+               best_time[method] = math::minimum(best_time[method], t.get_elapsed_secs());
+            }
+         }
+
+         crnd::crnd_unpack_end(pContext);
+
+         for (uint level_index = 0; level_index < tex_info.m_levels; level_index++)
+         {
+            if (!(blocks[0][level_index] == blocks[1][level_index]))
+            {
+               console::error("Decoded blocks differ, level %u!", level_index);
+               return false;
+            }
+         }
+
+         console::printf("%-6s %8u %7u %9.3fms %8.3fms %7.2fx", crn_get_format_string(static_cast<crn_format>(tex_info.m_format)),
+            crn_data.size(), tex_info.m_levels, best_time[0] * 1000.0f, best_time[1] * 1000.0f, best_time[0] / best_time[1]);
+
+         total_time[0] += best_time[0];
+         total_time[1] += best_time[1];
+      }
+
+      console::printf("Total                   %9.3fms %8.3fms %7.2fx", total_time[0] * 1000.0f, total_time[1] * 1000.0f, total_time[0] / total_time[1]);
+
+      return true;
+   }
+
+   bool benchmark::run(const char* pCmd_line)
+   {
+      console::printf("Command line:\n\"%s\"", pCmd_line);
+
+      static const command_line_params::param_desc param_desc_array[] =
+      {
+         { "test", 1, false },
+         { "in", 1, false },
+         { "maxThreads", 1, false },
+         { "iterations", 1, false },
+         { "quality", 1, false },
+         { "DXT5", 0, false },
+         { "fileformat", 1, false },
+         { "quiet", 0, false },
+         { "size", 1, false },
+         { "compressor", 1, false },
+         { "dxtquality", 1, false },
+         { "ETC1", 0, false },
+      };
+
+      if (!m_params.parse(pCmd_line, CRNLIB_ARRAY_SIZE(param_desc_array), param_desc_array, true))
+         return false;
+
+      dynamic_string test_name;
+      if (!m_params.get_value_as_string("test", 0, test_name))
+      {
+         console::error("Must specify a benchmark with -test!");
+         return false;
+      }
+
+      if (test_name == "threads")
+         return test_threads();
+      else if (test_name == "dxt")
+         return test_dxt_schedule();
+      else if (test_name == "sort")
+         return test_endpoint_sort();
+      else if (test_name == "vq")
+         return test_tree_clusterizer();
+      else if (test_name == "chunks")
+         return test_chunk_layout();
+      else if (test_name == "decode")
+         return test_decode();
+
+      console::error("Unknown benchmark: %s", test_name.get_ptr());
+      return false;
+   }
+
+} // namespace crnlib
@@ -0,0 +1,32 @@
+// File: benchmark.h
+// See Copyright Notice and license at the end of inc/crnlib.h
+#pragma once
+#include "crn_command_line_params.h"
+#include "crn_image.h"
+
+namespace crnlib
+{
+   class benchmark
+   {
+   public:
+      benchmark();
+
+      bool run(const char* pCmd_line);
+
+   private:
+      command_line_params m_params;
+      image_u8 m_img;
+
+      bool load_image(uint in_index = 0);
+      bool init_comp_params(crn_comp_params& comp_params);
+      bool compress(const crn_comp_params& comp_params, double& time, uint& compressed_size);
+
+      bool test_threads();
+      bool test_dxt_schedule();
+      bool test_endpoint_sort();
+      bool test_tree_clusterizer();
+      bool test_chunk_layout();
+      bool test_decode();
+   };
+
+} // namespace crnlib
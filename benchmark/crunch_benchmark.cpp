@@ -0,0 +1,51 @@
+// File: crunch_benchmark.cpp - Command line tool running the compressor performance benchmarks in benchmark.cpp.
+// It's built separately from crunch, so the reference implementations the benchmarks compare against never ship with the tool.
+// See Copyright Notice and license at the end of inc/crnlib.h
+//
+// Important: If compiling with gcc, be sure strict aliasing is disabled: -fno-strict-aliasing
+#include "crn_core.h"
+#include "crn_console.h"
+#include "crn_colorized_console.h"
+#include "crn_command_line_params.h"
+
+#include "benchmark.h"
+
+using namespace crnlib;
+
+static bool check_for_option(int argc, char *argv[], const char *pOption)
+{
+   for (int i = 1; i < argc; i++)
+   {
+      if ((argv[i][0] == '/') || (argv[i][0] == '-'))
+      {
+         if (crn_stricmp(&argv[i][1], pOption) == 0)
+            return true;
+      }
+   }
+   return false;
+}
+
+int main(int argc, char *argv[])
+{
+   colorized_console::init();
+
+   if (check_for_option(argc, argv, "quiet"))
+      console::disable_output();
+
+   console::printf("crunch_benchmark: crnlib version v%u.%02u %s Built %s, %s", CRNLIB_VERSION / 100U, CRNLIB_VERSION % 100U, crnlib_is_x64() ? "x64" : "x86", __DATE__, __TIME__);
+   console::printf("");
+
+   dynamic_string cmd_line;
+   get_command_line_as_single_string(cmd_line, argc, argv);
+
+   benchmark bench;
+   const bool status = bench.run(cmd_line.get_ptr());
+
+   colorized_console::deinit();
+
+   crnlib_print_mem_stats();
+
+   console::printf("\nExit status: %i", status ? EXIT_SUCCESS : EXIT_FAILURE);
+
+   return status ? EXIT_SUCCESS : EXIT_FAILURE;
+}
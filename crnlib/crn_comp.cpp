@@ -14,7 +14,11 @@ namespace crnlib
    static const uint cEncodingMapNumChunksPerCode = 3;
 
    crn_comp::crn_comp() :
-      m_pParams(NULL)
+      m_pTask_pool(NULL),
+      m_pParams(NULL),
+      m_chunk_conv_type(image_utils::cConversion_Invalid),
+      m_max_sample_chunks(0),
+      m_max_batch_chunks(0)
    {
    }
 
@@ -22,20 +26,51 @@ namespace crnlib
    {
    }
 
-   float crn_comp::color_endpoint_similarity_func(uint index_a, uint index_b, void* pContext)
+   // Unpacks a color endpoint to the two colors the codebook is sorted and delta coded by. DXT1 endpoints hold two 565 colors.
+   // ETC1 endpoints hold a 555 base color and an intensity table: unscaled they unpack to the base color and (table, 0, 0),
+   // scaled to their darkest and brightest block colors.
+   static void unpack_color_endpoint(color_quad_u8* pColors, uint endpoint, crn_format fmt, bool scaled)
    {
-      dxt_hc& hvq = *static_cast<dxt_hc*>(pContext);
+      if (fmt == cCRNFmtETC1)
+      {
+         const uint16 packed_color5 = static_cast<uint16>(endpoint & 0xFFFF);
+         const uint inten_table = (endpoint >> 16) & (cETC1IntenModifierValues - 1);
+
+         if (scaled)
+         {
+            color_quad_u8 block_colors[cETC1SelectorValues];
+            etc1_block::get_diff_subblock_colors(block_colors, packed_color5, inten_table);
+            pColors[0] = block_colors[0];
+            pColors[1] = block_colors[cETC1SelectorValues - 1];
+         }
+         else
+         {
+            pColors[0] = etc1_block::unpack_color5(packed_color5, false);
+            pColors[1].set(inten_table, 0, 0, 0);
+         }
+      }
+      else
+      {
+         pColors[0] = dxt1_block::unpack_color((uint16)(endpoint & 0xFFFF), scaled);
+         pColors[1] = dxt1_block::unpack_color((uint16)((endpoint >> 16) & 0xFFFF), scaled);
+      }
+   }
+
+   static const uint8* get_color_selector_to_linear(crn_format fmt)
+   {
+      return (fmt == cCRNFmtETC1) ? g_etc1_to_selector_index : g_dxt1_to_linear;
+   }
 
-      uint endpoint_a = hvq.get_color_endpoint(index_a);
-      uint endpoint_b = hvq.get_color_endpoint(index_b);
+   float crn_comp::color_endpoint_similarity_func(uint index_a, uint index_b, void* pContext)
+   {
+      const crn_comp& comp = *static_cast<const crn_comp*>(pContext);
+      const crn_format fmt = comp.m_pParams->m_format;
 
       color_quad_u8 a[2];
-      a[0] = dxt1_block::unpack_color((uint16)(endpoint_a & 0xFFFF), true);
-      a[1] = dxt1_block::unpack_color((uint16)((endpoint_a >> 16) & 0xFFFF), true);
+      unpack_color_endpoint(a, comp.m_hvq.get_color_endpoint(index_a), fmt, true);
 
       color_quad_u8 b[2];
-      b[0] = dxt1_block::unpack_color((uint16)(endpoint_b & 0xFFFF), true);
-      b[1] = dxt1_block::unpack_color((uint16)((endpoint_b >> 16) & 0xFFFF), true);
+      unpack_color_endpoint(b, comp.m_hvq.get_color_endpoint(index_b), fmt, true);
 
       uint total_error = color::elucidian_distance(a[0], b[0], false) + color::elucidian_distance(a[1], b[1], false);
 
@@ -61,128 +96,137 @@ namespace crnlib
       return weight;
    }
 
-   void crn_comp::sort_color_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints)
+   // Orders a codebook by greedily chaining each entry to its nearest unchosen neighbor (lowest index wins ties), starting
+   // from the entry with the smallest component sum. comps holds N unpacked components per entry.
+   // The unchosen entries are kept in a list sorted by component sum. Two entries whose sums differ by d are at least
+   // d*d/N apart, so each search walks outward from the current entry and stops as soon as that bound exceeds the best
+   // match found so far, instead of scanning the whole codebook.
+   template<uint N>
+   static void sort_codebook_nearest_neighbor(crnlib::vector<uint>& remapping, const crnlib::vector<uint8>& comps)
    {
-      remapping.resize(endpoints.size());
+      const uint n = comps.size() / N;
+      remapping.resize(n);
+      if (!n)
+         return;
 
-      uint lowest_energy = UINT_MAX;
-      uint lowest_energy_index = 0;
+      const uint cMaxSum = 255 * N;
 
-      for (uint i = 0; i < endpoints.size(); i++)
+      // Counting sort by component sum, which keeps entries with equal sums in index order.
+      crnlib::vector<uint> sums(n);
+      crnlib::vector<uint> sum_offsets(cMaxSum + 2);
+      for (uint i = 0; i < n; i++)
       {
-         color_quad_u8 a(dxt1_block::unpack_color(static_cast<uint16>(endpoints[i] & 0xFFFF), true));
-         color_quad_u8 b(dxt1_block::unpack_color(static_cast<uint16>((endpoints[i] >> 16) & 0xFFFF), true));
-
-         uint total = a.r + a.g + a.b + b.r + b.g + b.b;
+         uint sum = 0;
+         for (uint k = 0; k < N; k++)
+            sum += comps[i * N + k];
+         sums[i] = sum;
+         sum_offsets[sum + 1]++;
+      }
+      for (uint s = 0; s <= cMaxSum; s++)
+         sum_offsets[s + 1] += sum_offsets[s];
 
-         if (total < lowest_energy)
-         {
-            lowest_energy = total;
-            lowest_energy_index = i;
-         }
+      crnlib::vector<uint> sorted_index(n);
+      crnlib::vector<int> sorted_sum(n);
+      crnlib::vector<uint8> sorted_comps(n * N);
+      for (uint i = 0; i < n; i++)
+      {
+         const uint pos = sum_offsets[sums[i]]++;
+         sorted_index[pos] = i;
+         sorted_sum[pos] = sums[i];
+         memcpy(&sorted_comps[pos * N], &comps[i * N], N);
       }
 
-      uint cur_index = lowest_energy_index;
+      // Doubly linked list of unchosen entries. Node pos + 1 refers to sorted position pos, nodes 0 and n + 1 are sentinels.
+      crnlib::vector<uint> prev(n + 2);
+      crnlib::vector<uint> next(n + 2);
+      for (uint node = 1; node <= n; node++)
+      {
+         prev[node] = node - 1;
+         next[node] = node + 1;
+      }
 
-      crnlib::vector<bool> chosen_flags(endpoints.size());
+      uint cur_node = 1;
 
-      uint n = 0;
-      for ( ; ; )
+      for (uint chain_index = 0; ; )
       {
-         chosen_flags[cur_index] = true;
+         const uint cur_pos = cur_node - 1;
 
-         remapping[cur_index] = n;
-         n++;
-         if (n == endpoints.size())
+         remapping[sorted_index[cur_pos]] = chain_index;
+         if (++chain_index == n)
             break;
 
-         uint lowest_error = UINT_MAX;
-         uint lowest_error_index = 0;
+         next[prev[cur_node]] = next[cur_node];
+         prev[next[cur_node]] = prev[cur_node];
+
+         const uint8* pCur = &sorted_comps[cur_pos * N];
+         const int cur_sum = sorted_sum[cur_pos];
 
-         color_quad_u8 a(dxt1_block::unpack_endpoint(endpoints[cur_index], 0, true));
-         color_quad_u8 b(dxt1_block::unpack_endpoint(endpoints[cur_index], 1, true));
+         uint lowest_error = UINT_MAX;
+         uint lowest_error_index = UINT_MAX;
+         uint lowest_error_node = 0;
 
-         for (uint i = 0; i < endpoints.size(); i++)
+         for (uint dir = 0; dir < 2; dir++)
          {
-            if (chosen_flags[i])
-               continue;
+            for (uint node = dir ? prev[cur_node] : next[cur_node]; (node >= 1) && (node <= n); node = dir ? prev[node] : next[node])
+            {
+               const uint pos = node - 1;
 
-            color_quad_u8 c(dxt1_block::unpack_endpoint(endpoints[i], 0, true));
-            color_quad_u8 d(dxt1_block::unpack_endpoint(endpoints[i], 1, true));
+               const int sum_delta = sorted_sum[pos] - cur_sum;
+               if (static_cast<uint64>(sum_delta * sum_delta) > static_cast<uint64>(lowest_error) * N)
+                  break;
 
-            uint total = color::elucidian_distance(a, c, false) + color::elucidian_distance(b, d, false);
+               const uint8* pComps = &sorted_comps[pos * N];
 
-            if (total < lowest_error)
-            {
-               lowest_error = total;
-               lowest_error_index = i;
+               uint total = 0;
+               for (uint k = 0; k < N; k++)
+                  total += math::square(pComps[k] - pCur[k]);
+
+               const uint index = sorted_index[pos];
+               if ((total < lowest_error) || ((total == lowest_error) && (index < lowest_error_index)))
+               {
+                  lowest_error = total;
+                  lowest_error_index = index;
+                  lowest_error_node = node;
+               }
             }
          }
 
-         cur_index = lowest_error_index;
+         cur_node = lowest_error_node;
       }
    }
 
-   void crn_comp::sort_alpha_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints)
+   void crn_comp::sort_color_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints, crn_format fmt)
    {
-      remapping.resize(endpoints.size());
-
-      uint lowest_energy = UINT_MAX;
-      uint lowest_energy_index = 0;
+      crnlib::vector<uint8> comps(endpoints.size() * 6);
 
       for (uint i = 0; i < endpoints.size(); i++)
       {
-         uint a = dxt5_block::unpack_endpoint(endpoints[i], 0);
-         uint b = dxt5_block::unpack_endpoint(endpoints[i], 1);
+         color_quad_u8 c[2];
+         unpack_color_endpoint(c, endpoints[i], fmt, true);
 
-         uint total = a + b;
-
-         if (total < lowest_energy)
-         {
-            lowest_energy = total;
-            lowest_energy_index = i;
-         }
+         uint8* pComps = &comps[i * 6];
+         pComps[0] = c[0].r;
+         pComps[1] = c[0].g;
+         pComps[2] = c[0].b;
+         pComps[3] = c[1].r;
+         pComps[4] = c[1].g;
+         pComps[5] = c[1].b;
       }
 
-      uint cur_index = lowest_energy_index;
+      sort_codebook_nearest_neighbor<6>(remapping, comps);
+   }
 
-      crnlib::vector<bool> chosen_flags(endpoints.size());
+   void crn_comp::sort_alpha_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints)
+   {
+      crnlib::vector<uint8> comps(endpoints.size() * 2);
 
-      uint n = 0;
-      for ( ; ; )
+      for (uint i = 0; i < endpoints.size(); i++)
       {
-         chosen_flags[cur_index] = true;
-
-         remapping[cur_index] = n;
-         n++;
-         if (n == endpoints.size())
-            break;
-
-         uint lowest_error = UINT_MAX;
-         uint lowest_error_index = 0;
-
-         const int a = dxt5_block::unpack_endpoint(endpoints[cur_index], 0);
-         const int b = dxt5_block::unpack_endpoint(endpoints[cur_index], 1);
-
-         for (uint i = 0; i < endpoints.size(); i++)
-         {
-            if (chosen_flags[i])
-               continue;
-
-            const int c = dxt5_block::unpack_endpoint(endpoints[i], 0);
-            const int d = dxt5_block::unpack_endpoint(endpoints[i], 1);
-
-            uint total = math::square(a - c) + math::square(b - d);
-
-            if (total < lowest_error)
-            {
-               lowest_error = total;
-               lowest_error_index = i;
-            }
-         }
-
-         cur_index = lowest_error_index;
+         comps[i * 2 + 0] = static_cast<uint8>(dxt5_block::unpack_endpoint(endpoints[i], 0));
+         comps[i * 2 + 1] = static_cast<uint8>(dxt5_block::unpack_endpoint(endpoints[i], 1));
       }
+
+      sort_codebook_nearest_neighbor<2>(remapping, comps);
    }
 
    // The indices are only used for statistical purposes.
@@ -229,12 +273,13 @@ namespace crnlib
          const uint endpoint = remapped_endpoints[endpoint_index];
 
          color_quad_u8 cur[2];
-         cur[0] = dxt1_block::unpack_color((uint16)(endpoint & 0xFFFF), false);
-         cur[1] = dxt1_block::unpack_color((uint16)((endpoint >> 16) & 0xFFFF), false);
+         unpack_color_endpoint(cur, endpoint, m_pParams->m_format, false);
 
 #if CRNLIB_CREATE_DEBUG_IMAGES
-         endpoint_image(0, endpoint_index) = dxt1_block::unpack_color((uint16)(endpoint & 0xFFFF), true);
-         endpoint_image(1, endpoint_index) = dxt1_block::unpack_color((uint16)((endpoint >> 16) & 0xFFFF), true);
+         color_quad_u8 scaled[2];
+         unpack_color_endpoint(scaled, endpoint, m_pParams->m_format, true);
+         endpoint_image(0, endpoint_index) = scaled[0];
+         endpoint_image(1, endpoint_index) = scaled[1];
 #endif
 
          for (uint j = 0; j < 2; j++)
@@ -292,7 +337,7 @@ namespace crnlib
       static_huffman_data_model residual_dm[2];
 
       symbol_codec codec;
-      codec.start_encoding(1024*1024);
+      codec.start_encoding(4096 + remapped_endpoints.size() * 4);
 
       // Transmit residuals
       for (uint i = 0; i < 2; i++)
@@ -439,7 +484,7 @@ namespace crnlib
       static_huffman_data_model residual_dm;
 
       symbol_codec codec;
-      codec.start_encoding(1024*1024);
+      codec.start_encoding(4096 + remapped_endpoints.size() * 2);
 
       // Transmit residuals
       if (!residual_dm.init(true, hist, 15))
@@ -485,7 +530,9 @@ namespace crnlib
 
    float crn_comp::color_selector_similarity_func(uint index_a, uint index_b, void* pContext)
    {
-      const crnlib::vector<dxt_hc::selectors>& selectors = *static_cast< const crnlib::vector<dxt_hc::selectors>* >(pContext);
+      const crn_comp& comp = *static_cast<const crn_comp*>(pContext);
+      const crnlib::vector<dxt_hc::selectors>& selectors = comp.m_hvq.get_color_selectors_vec();
+      const uint8* pTo_linear = get_color_selector_to_linear(comp.m_pParams->m_format);
 
       const dxt_hc::selectors& selectors_a = selectors[index_a];
       const dxt_hc::selectors& selectors_b = selectors[index_b];
@@ -493,8 +540,8 @@ namespace crnlib
       int total = 0;
       for (uint i = 0; i < 16; i++)
       {
-         int a = g_dxt1_to_linear[selectors_a.get_by_index(i)];
-         int b = g_dxt1_to_linear[selectors_b.get_by_index(i)];
+         int a = pTo_linear[selectors_a.get_by_index(i)];
+         int b = pTo_linear[selectors_b.get_by_index(i)];
 
          int delta = a - b;
          total += delta*delta;
@@ -625,8 +672,14 @@ namespace crnlib
       const uint num_baised_selector_values = (max_selector_value * 2 + 1);
       symbol_histogram hist(num_baised_selector_values * num_baised_selector_values);
 
+      // The decoder starts out with all linear selectors at 0, which isn't raw selector 0 for ETC1.
+      uint first_selector = 0;
+      while (pTo_linear[first_selector])
+         first_selector++;
+
       dxt_hc::selectors prev_selectors;
-      utils::zero_object(prev_selectors);
+      for (uint i = 0; i < 16; i++)
+         prev_selectors.set_by_index(i, first_selector);
       int total_residuals = 0;
       for (uint selector_index = 0; selector_index < selectors.size(); selector_index++)
       {
@@ -693,7 +746,7 @@ namespace crnlib
       static_huffman_data_model residual_dm;
 
       symbol_codec codec;
-      codec.start_encoding(1024*1024);
+      codec.start_encoding(4096 + remapped_selectors.size() * 4);
 
       // Transmit residuals
       if (!residual_dm.init(true, hist, 15))
@@ -737,51 +790,67 @@ namespace crnlib
       return true;
    }
 
+   void crn_comp::chunk_models::clear()
+   {
+      m_chunk_encoding_hist.clear();
+      m_chunk_encoding_dm.clear();
+      for (uint i = 0; i < 2; i++)
+      {
+         m_endpoint_index_hist[i].clear();
+         m_endpoint_index_dm[i].clear();
+         m_selector_index_hist[i].clear();
+         m_selector_index_dm[i].clear();
+      }
+   }
+
    bool crn_comp::pack_chunks(
       uint first_chunk, uint num_chunks,
       bool clear_histograms,
+      bool continue_stream,
       symbol_codec* pCodec,
+      chunk_models& models,
       const crnlib::vector<uint>* pColor_endpoint_remap,
       const crnlib::vector<uint>* pColor_selector_remap,
       const crnlib::vector<uint>* pAlpha_endpoint_remap,
-      const crnlib::vector<uint>* pAlpha_selector_remap)
+      const crnlib::vector<uint>* pAlpha_selector_remap,
+      crnlib::vector<crnd::crn_slice>* pSlices)
    {
       if (!pCodec)
       {
-         m_chunk_encoding_hist.resize(1 << (3 * cEncodingMapNumChunksPerCode));
+         models.m_chunk_encoding_hist.resize(1 << (3 * cEncodingMapNumChunksPerCode));
          if (clear_histograms)
-            m_chunk_encoding_hist.set_all(0);
+            models.m_chunk_encoding_hist.set_all(0);
 
          if (pColor_endpoint_remap)
          {
             CRNLIB_ASSERT(pColor_endpoint_remap->size() == m_hvq.get_color_endpoint_codebook_size());
-            m_endpoint_index_hist[0].resize(pColor_endpoint_remap->size());
+            models.m_endpoint_index_hist[0].resize(pColor_endpoint_remap->size());
             if (clear_histograms)
-               m_endpoint_index_hist[0].set_all(0);
+               models.m_endpoint_index_hist[0].set_all(0);
          }
 
          if (pColor_selector_remap)
          {
             CRNLIB_ASSERT(pColor_selector_remap->size() == m_hvq.get_color_selector_codebook_size());
-            m_selector_index_hist[0].resize(pColor_selector_remap->size());
+            models.m_selector_index_hist[0].resize(pColor_selector_remap->size());
             if (clear_histograms)
-               m_selector_index_hist[0].set_all(0);
+               models.m_selector_index_hist[0].set_all(0);
          }
 
          if (pAlpha_endpoint_remap)
          {
             CRNLIB_ASSERT(pAlpha_endpoint_remap->size() == m_hvq.get_alpha_endpoint_codebook_size());
-            m_endpoint_index_hist[1].resize(pAlpha_endpoint_remap->size());
+            models.m_endpoint_index_hist[1].resize(pAlpha_endpoint_remap->size());
             if (clear_histograms)
-               m_endpoint_index_hist[1].set_all(0);
+               models.m_endpoint_index_hist[1].set_all(0);
          }
 
          if (pAlpha_selector_remap)
          {
             CRNLIB_ASSERT(pAlpha_selector_remap->size() == m_hvq.get_alpha_selector_codebook_size());
-            m_selector_index_hist[1].resize(pAlpha_selector_remap->size());
+            models.m_selector_index_hist[1].resize(pAlpha_selector_remap->size());
             if (clear_histograms)
-               m_selector_index_hist[1].set_all(0);
+               models.m_selector_index_hist[1].set_all(0);
          }
       }
 
@@ -791,27 +860,75 @@ namespace crnlib
       uint prev_selector_index[cNumComps];
       utils::zero_object(prev_selector_index);
 
+      // Pick up the deltas where the previous chunk left off, so a long run of chunks can be split into pieces.
+      if ((continue_stream) && (first_chunk))
+      {
+         const chunk_detail& details = m_chunk_details[first_chunk];
+
+         for (uint comp_index = 0; comp_index < cNumComps; comp_index++)
+         {
+            if (!m_has_comp[comp_index])
+               continue;
+
+            const crnlib::vector<uint>* pEndpoint_remap = (comp_index == cColor) ? pColor_endpoint_remap : pAlpha_endpoint_remap;
+            const crnlib::vector<uint>* pSelector_remap = (comp_index == cColor) ? pColor_selector_remap : pAlpha_selector_remap;
+
+            if (pEndpoint_remap)
+               prev_endpoint_index[comp_index] = (*pEndpoint_remap)[m_endpoint_indices[comp_index][details.m_first_endpoint_index - 1]];
+
+            if (pSelector_remap)
+               prev_selector_index[comp_index] = (*pSelector_remap)[m_selector_indices[comp_index][details.m_first_selector_index - 1]];
+         }
+      }
+
       uint num_encodings_left = 0;
+      uint index = 0;
+
+      uint level_index = 0;
 
       for (uint chunk_index = first_chunk; chunk_index < (first_chunk + num_chunks); chunk_index++)
       {
+         // Record the decoder's state at the start of each slice of the level's faces.
+         if ((pCodec) && (pSlices))
+         {
+            while (chunk_index >= (m_levels[level_index].m_first_chunk + m_levels[level_index].m_num_chunks))
+               level_index++;
+
+            const level_tag& level = m_levels[level_index];
+            const uint face_chunk_index = (chunk_index - level.m_first_chunk) % (level.m_chunk_width * level.m_chunk_height);
+
+            if ((!(face_chunk_index % level.m_chunk_width)) && (!((face_chunk_index / level.m_chunk_width) % m_pParams->m_crn_slice_chunk_rows)))
+            {
+               crnd::crn_slice& slice = *pSlices->enlarge(1);
+               slice.m_bit_ofs = pCodec->encode_get_total_bits_written();
+
+               const uint num_encodings_used = cEncodingMapNumChunksPerCode - num_encodings_left;
+               slice.m_chunk_encoding_bits = num_encodings_left ? ((index >> (num_encodings_used * 3)) | (1 << (num_encodings_left * 3))) : 1;
+
+               for (uint comp_index = 0; comp_index < cNumComps; comp_index++)
+               {
+                  slice.m_endpoint_index[comp_index] = prev_endpoint_index[comp_index];
+                  slice.m_selector_index[comp_index] = prev_selector_index[comp_index];
+               }
+            }
+         }
+
          if (!num_encodings_left)
          {
-            uint index = 0;
+            index = 0;
             for (uint i = 0; i < cEncodingMapNumChunksPerCode; i++)
                if ((chunk_index + i) < (first_chunk + num_chunks))
-                  index |= (m_hvq.get_chunk_encoding(chunk_index + i).m_encoding_index << (i * 3));
+                  index |= (m_chunk_details[chunk_index + i].m_encoding_index << (i * 3));
 
             if (pCodec)
-               pCodec->encode(index, m_chunk_encoding_dm);
+               pCodec->encode(index, models.m_chunk_encoding_dm);
             else
-               m_chunk_encoding_hist.inc_freq(index);
+               models.m_chunk_encoding_hist.inc_freq(index);
 
             num_encodings_left = cEncodingMapNumChunksPerCode;
          }
          num_encodings_left--;
 
-         const dxt_hc::chunk_encoding& encoding = m_hvq.get_chunk_encoding(chunk_index);
          const chunk_detail& details = m_chunk_details[chunk_index];
 
          const uint comp_order[3] = { cAlpha0, cAlpha1, cColor };
@@ -826,7 +943,7 @@ namespace crnlib
             {
                if (pColor_endpoint_remap)
                {
-                  for (uint i = 0; i < encoding.m_num_tiles; i++)
+                  for (uint i = 0; i < details.m_num_tiles; i++)
                   {
                      uint cur_endpoint_index = (*pColor_endpoint_remap)[ m_endpoint_indices[cColor][details.m_first_endpoint_index + i] ];
                      int endpoint_delta = cur_endpoint_index - prev_endpoint_index[cColor];
@@ -838,9 +955,9 @@ namespace crnlib
                      CRNLIB_ASSERT(sym >= 0 && sym < (int)pColor_endpoint_remap->size());
 
                      if (!pCodec)
-                        m_endpoint_index_hist[cColor].inc_freq(sym);
+                        models.m_endpoint_index_hist[cColor].inc_freq(sym);
                      else
-                        pCodec->encode(sym, m_endpoint_index_dm[0]);
+                        pCodec->encode(sym, models.m_endpoint_index_dm[0]);
 
                      prev_endpoint_index[cColor] = cur_endpoint_index;
                   }
@@ -850,7 +967,7 @@ namespace crnlib
             {
                if (pAlpha_endpoint_remap)
                {
-                  for (uint i = 0; i < encoding.m_num_tiles; i++)
+                  for (uint i = 0; i < details.m_num_tiles; i++)
                   {
                      uint cur_endpoint_index = (*pAlpha_endpoint_remap)[m_endpoint_indices[comp_index][details.m_first_endpoint_index + i]];
                      int endpoint_delta = cur_endpoint_index - prev_endpoint_index[comp_index];
@@ -862,9 +979,9 @@ namespace crnlib
                      CRNLIB_ASSERT(sym >= 0 && sym < (int)pAlpha_endpoint_remap->size());
 
                      if (!pCodec)
-                        m_endpoint_index_hist[1].inc_freq(sym);
+                        models.m_endpoint_index_hist[1].inc_freq(sym);
                      else
-                        pCodec->encode(sym, m_endpoint_index_dm[1]);
+                        pCodec->encode(sym, models.m_endpoint_index_dm[1]);
 
                      prev_endpoint_index[comp_index] = cur_endpoint_index;
                   }
@@ -897,9 +1014,9 @@ namespace crnlib
                         CRNLIB_ASSERT(sym >= 0 && sym < (int)pColor_selector_remap->size());
 
                         if (!pCodec)
-                           m_selector_index_hist[cColor].inc_freq(sym);
+                           models.m_selector_index_hist[cColor].inc_freq(sym);
                         else
-                           pCodec->encode(sym, m_selector_index_dm[cColor]);
+                           pCodec->encode(sym, models.m_selector_index_dm[cColor]);
 
                         prev_selector_index[cColor] = cur_selector_index;
                      }
@@ -916,9 +1033,9 @@ namespace crnlib
                      CRNLIB_ASSERT(sym >= 0 && sym < (int)pAlpha_selector_remap->size());
 
                      if (!pCodec)
-                        m_selector_index_hist[1].inc_freq(sym);
+                        models.m_selector_index_hist[1].inc_freq(sym);
                      else
-                        pCodec->encode(sym, m_selector_index_dm[1]);
+                        pCodec->encode(sym, models.m_selector_index_dm[1]);
 
                      prev_selector_index[comp_index] = cur_selector_index;
                   }
@@ -933,46 +1050,42 @@ namespace crnlib
       return true;
    }
 
-   bool crn_comp::pack_chunks_simulation(
-      uint first_chunk, uint num_chunks,
-      uint& total_bits,
-      const crnlib::vector<uint>* pColor_endpoint_remap,
-      const crnlib::vector<uint>* pColor_selector_remap,
-      const crnlib::vector<uint>* pAlpha_endpoint_remap,
-      const crnlib::vector<uint>* pAlpha_selector_remap)
+   // Returns how many bits pack_chunks() would write for the chunks whose histograms were gathered into models, including
+   // the index Huffman tables, without actually coding the chunks again.
+   bool crn_comp::pack_chunks_simulation(chunk_models& models, uint& total_bits)
    {
-      if (!pack_chunks(first_chunk, num_chunks, true, NULL, pColor_endpoint_remap, pColor_selector_remap, pAlpha_endpoint_remap, pAlpha_selector_remap))
-         return false;
-
       symbol_codec codec;
-      codec.start_encoding(2*1024*1024);
+      codec.start_encoding(64*1024);
       codec.encode_enable_simulation(true);
 
-      m_chunk_encoding_dm.init(true, m_chunk_encoding_hist, 16);
+      models.m_chunk_encoding_dm.init(true, models.m_chunk_encoding_hist, 16);
+
+      uint64 total_symbol_bits = models.m_chunk_encoding_dm.get_total_cost(models.m_chunk_encoding_hist);
 
       for (uint i = 0; i < 2; i++)
       {
-         if (m_endpoint_index_hist[i].size())
+         if (models.m_endpoint_index_hist[i].size())
          {
-            m_endpoint_index_dm[i].init(true, m_endpoint_index_hist[i], 16);
+            models.m_endpoint_index_dm[i].init(true, models.m_endpoint_index_hist[i], 16);
+
+            codec.encode_transmit_static_huffman_data_model(models.m_endpoint_index_dm[i], false);
 
-            codec.encode_transmit_static_huffman_data_model(m_endpoint_index_dm[i], false);
+            total_symbol_bits += models.m_endpoint_index_dm[i].get_total_cost(models.m_endpoint_index_hist[i]);
          }
 
-         if (m_selector_index_hist[i].size())
+         if (models.m_selector_index_hist[i].size())
          {
-            m_selector_index_dm[i].init(true, m_selector_index_hist[i], 16);
+            models.m_selector_index_dm[i].init(true, models.m_selector_index_hist[i], 16);
 
-            codec.encode_transmit_static_huffman_data_model(m_selector_index_dm[i], false);
+            codec.encode_transmit_static_huffman_data_model(models.m_selector_index_dm[i], false);
+
+            total_symbol_bits += models.m_selector_index_dm[i].get_total_cost(models.m_selector_index_hist[i]);
          }
       }
 
-      if (!pack_chunks(first_chunk, num_chunks, false, &codec, pColor_endpoint_remap, pColor_selector_remap, pAlpha_endpoint_remap, pAlpha_selector_remap))
-         return false;
-
       codec.stop_encoding(false);
 
-      total_bits = codec.encode_get_total_bits_written();
+      total_bits = static_cast<uint>(codec.encode_get_total_bits_written() + total_symbol_bits);
 
       return true;
    }
@@ -1019,7 +1132,7 @@ namespace crnlib
          hist.inc_freq(index);
       }
 
-      if (!m_chunk_encoding_dm.init(true, hist, 16))
+      if (!m_chunk_models.m_chunk_encoding_dm.init(true, hist, 16))
          return false;
 
       return true;
@@ -1043,7 +1156,13 @@ namespace crnlib
       }
 
       image_utils::conversion_type conv_type = image_utils::get_image_conversion_type_from_crn_format((crn_format)m_pParams->m_format);
-      if (conv_type != image_utils::cConversion_Invalid)
+
+      // Converted copies would take as much memory as the images themselves, so with a memory limit each chunk is converted
+      // as it's created instead.
+      m_chunk_conv_type = image_utils::cConversion_Invalid;
+      if ((conv_type != image_utils::cConversion_Invalid) && (m_pParams->m_crn_memory_limit_mb))
+         m_chunk_conv_type = conv_type;
+      else if (conv_type != image_utils::cConversion_Invalid)
       {
          for (uint face_index = 0; face_index < m_pParams->m_faces; face_index++)
          {
@@ -1098,6 +1217,37 @@ namespace crnlib
       return true;
    }
 
+   void crn_comp::create_chunk(const image_u8& img, uint x, uint y, float weight, dxt_hc::pixel_chunk& chunk) const
+   {
+      color_quad_u8 pixels[cChunkPixelHeight][cChunkPixelWidth];
+
+      for (uint cy = 0; cy < cChunkPixelHeight; cy++)
+      {
+         uint py = y * cChunkPixelHeight + cy;
+         py = math::minimum(py, img.get_height() - 1);
+
+         for (uint cx = 0; cx < cChunkPixelWidth; cx++)
+         {
+            uint px = x * cChunkPixelWidth + cx;
+            px = math::minimum(px, img.get_width() - 1);
+
+            pixels[cy][cx] = img(px, py);
+         }
+      }
+
+      if (m_chunk_conv_type != image_utils::cConversion_Invalid)
+      {
+         image_u8 chunk_img(&pixels[0][0], cChunkPixelWidth, cChunkPixelHeight);
+         image_utils::convert_image(chunk_img, m_chunk_conv_type);
+      }
+
+      chunk.m_weight = weight;
+
+      for (uint cy = 0; cy < cChunkPixelHeight; cy++)
+         for (uint cx = 0; cx < cChunkPixelWidth; cx++)
+            chunk.set_pixel(cx, cy, pixels[cy][cx]);
+   }
+
    void crn_comp::append_chunks(const image_u8& img, uint num_chunks_x, uint num_chunks_y, dxt_hc::pixel_chunk_vec& chunks, float weight)
    {
       for (uint y = 0; y < num_chunks_y; y++)
@@ -1116,26 +1266,38 @@ namespace crnlib
          {
             chunks.resize(chunks.size() + 1);
 
-            dxt_hc::pixel_chunk& chunk = chunks.back();
-            chunk.m_weight = weight;
+            create_chunk(img, x, y, weight, chunks.back());
+         }
+      }
+   }
+
+   void crn_comp::append_level_chunks(uint level, uint first_chunk, uint num_chunks, dxt_hc::pixel_chunk_vec& chunks)
+   {
+      const level_tag& l = m_levels[level];
+      const uint chunks_per_face = l.m_chunk_width * l.m_chunk_height;
 
-            for (uint cy = 0; cy < cChunkPixelHeight; cy++)
-            {
-               uint py = y * cChunkPixelHeight + cy;
-               py = math::minimum(py, img.get_height() - 1);
+      for (uint chunk_index = first_chunk; chunk_index < first_chunk + num_chunks; chunk_index++)
+      {
+         const uint face = chunk_index / chunks_per_face;
+         const uint y = (chunk_index % chunks_per_face) / l.m_chunk_width;
 
-               for (uint cx = 0; cx < cChunkPixelWidth; cx++)
-               {
-                  uint px = x * cChunkPixelWidth + cx;
-                  px = math::minimum(px, img.get_width() - 1);
+         // Odd rows run right to left, like append_chunks() lays them out.
+         uint x = (chunk_index % chunks_per_face) % l.m_chunk_width;
+         if (y & 1)
+            x = l.m_chunk_width - 1 - x;
 
-                  chunk(cx, cy) = img(px, py);
-               }
-            }
-         }
+         chunks.resize(chunks.size() + 1);
+
+         create_chunk(m_images[face][level], x, y, get_mip_weight(level), chunks.back());
       }
    }
 
+   float crn_comp::get_mip_weight(uint level)
+   {
+      return math::minimum(12.0f, powf( 1.3f, static_cast<float>(level) ) );
+      //return 1.0f;
+   }
+
    void crn_comp::create_chunks()
    {
       m_chunks.reserve(m_total_chunks);
@@ -1150,20 +1312,122 @@ namespace crnlib
                CRNLIB_ASSERT(m_levels[level].m_first_chunk == m_chunks.size());
             }
 
-            float mip_weight = math::minimum(12.0f, powf( 1.3f, static_cast<float>(level) ) );
-            //float mip_weight = 1.0f;
-
-            append_chunks(m_images[face][level], m_levels[level].m_chunk_width, m_levels[level].m_chunk_height, m_chunks, mip_weight);
+            append_chunks(m_images[face][level], m_levels[level].m_chunk_width, m_levels[level].m_chunk_height, m_chunks, get_mip_weight(level));
          }
       }
 
       CRNLIB_ASSERT(m_chunks.size() == m_total_chunks);
    }
 
-   void crn_comp::clear()
+   // The memory a compression with a memory limit needs however many chunks it samples: the source images, the indices of
+   // every chunk, the symbols of the largest mip group while it's packed, and the packed chunks and the file they're copied
+   // into, neither of which is larger than the DXT data.
+   uint64 crn_comp::get_fixed_memory_size() const
    {
-      m_pParams = NULL;
+      uint64 total_pixels = 0;
+      uint64 total_blocks = 0;
+      for (uint level = 0; level < m_pParams->m_levels; level++)
+      {
+         total_pixels += static_cast<uint64>(m_levels[level].m_width) * m_levels[level].m_height * m_pParams->m_faces;
+         total_blocks += static_cast<uint64>((m_levels[level].m_width + 3) >> 2) * ((m_levels[level].m_height + 3) >> 2) * m_pParams->m_faces;
+      }
+
+      uint num_comps = 0;
+      for (uint i = 0; i < cNumComps; i++)
+         num_comps += m_has_comp[i];
+
+      const uint chunk_indices_size = sizeof(chunk_detail) + num_comps * (cChunkMaxTiles + cChunkBlockWidth * cChunkBlockHeight) * sizeof(uint);
+
+      // An encoding and the endpoint and selector indices per chunk, 8 bytes a symbol, twice over for the symbol vector's growth.
+      const uint chunk_symbols_size = 2 * (1 + num_comps * (cChunkMaxTiles + cChunkBlockWidth * cChunkBlockHeight)) * 8;
+
+      return total_pixels * sizeof(color_quad_u8) +
+         static_cast<uint64>(m_total_chunks) * chunk_indices_size +
+         static_cast<uint64>(m_mip_groups[0].m_num_chunks) * chunk_symbols_size +
+         2 * total_blocks * crn_get_bytes_per_dxt_block(static_cast<crn_format>(m_pParams->m_format));
+   }
+
+   bool crn_comp::init_memory_budget(const dxt_hc::params& params)
+   {
+      // Fewer chunks than this make for useless codebooks, or for an encode_chunks() call per handful of chunks.
+      const uint cMinBudgetChunks = 256;
+
+      const uint64 limit = static_cast<uint64>(m_pParams->m_crn_memory_limit_mb) << 20;
+      const uint64 fixed_size = get_fixed_memory_size() + dxt_hc::get_codebook_memory_size(params);
+
+      // optimize_codebooks() reorders one codebook at a time with a memory limit, after the last batch has been encoded.
+      const uint max_size = params.m_max_endpoint_codebook_size;
+      const uint num_alpha_comps = m_has_comp[cAlpha0] + m_has_comp[cAlpha1];
+      uint64 reorder_size = 0;
+      if (m_has_comp[cColor])
+      {
+         reorder_size = math::maximum(reorder_size, get_zeng_reorder_table_size(math::maximum(params.m_color_endpoint_codebook_size, max_size), m_total_chunks * cChunkMaxTiles));
+         reorder_size = math::maximum(reorder_size, get_zeng_reorder_table_size(math::maximum(params.m_color_selector_codebook_size, max_size), m_total_chunks * cChunkBlockWidth * cChunkBlockHeight));
+      }
+      if (num_alpha_comps)
+      {
+         reorder_size = math::maximum(reorder_size, get_zeng_reorder_table_size(math::maximum(params.m_alpha_endpoint_codebook_size, max_size), num_alpha_comps * m_total_chunks * cChunkMaxTiles));
+         reorder_size = math::maximum(reorder_size, get_zeng_reorder_table_size(math::maximum(params.m_alpha_selector_codebook_size, max_size), num_alpha_comps * m_total_chunks * cChunkBlockWidth * cChunkBlockHeight));
+      }
+
+      // The rest is split evenly between the sampled chunks (whose analysis m_hvq keeps) and the batches of chunks encode_levels()
+      // encodes with the codebooks built from them, whose memory the reordering then reuses.
+      const uint sample_chunk_size = sizeof(dxt_hc::pixel_chunk) + dxt_hc::get_chunk_analysis_size(params.m_format);
+      const uint batch_chunk_size = sample_chunk_size + sizeof(dxt_hc::chunk_encoding);
+      const uint min_chunks = math::minimum(cMinBudgetChunks, m_total_chunks);
+
+      const uint64 available = (limit > fixed_size) ? (limit - fixed_size) : 0;
+      const uint64 batch_budget = available / 2;
+      const uint64 sample_budget = available - math::minimum(available, math::maximum(batch_budget, reorder_size));
+      m_max_sample_chunks = static_cast<uint>(math::minimum<uint64>(sample_budget / sample_chunk_size, m_total_chunks));
+      m_max_batch_chunks = static_cast<uint>(math::minimum<uint64>(batch_budget / batch_chunk_size, m_total_chunks));
+
+      if (m_pParams->m_flags & cCRNCompFlagDebugging)
+      {
+         console::debug("Memory limit fixed size: " CRNLIB_INT64_FORMAT_SPECIFIER " bytes, reordering: " CRNLIB_INT64_FORMAT_SPECIFIER " bytes, sampled chunks: %u, batch chunks: %u",
+            (int64)fixed_size, (int64)reorder_size, m_max_sample_chunks, m_max_batch_chunks);
+      }
+
+      if ((m_max_sample_chunks < min_chunks) || (m_max_batch_chunks < min_chunks))
+      {
+         const uint64 min_size = fixed_size + static_cast<uint64>(min_chunks) * sample_chunk_size +
+            math::maximum(static_cast<uint64>(min_chunks) * batch_chunk_size, reorder_size);
+         console::error("The CRN memory limit of %uMB is too small for this texture, it needs at least %uMB",
+            m_pParams->m_crn_memory_limit_mb, static_cast<uint>((min_size + (1 << 20) - 1) >> 20));
+         return false;
+      }
+
+      return true;
+   }
+
+   void crn_comp::create_sample_chunks()
+   {
+      const uint num_samples = m_max_sample_chunks;
+
+      m_chunks.reserve(num_samples);
+      m_chunks.resize(0);
+
+      for (uint level = 0; level < m_pParams->m_levels; level++)
+      {
+         m_levels[level].m_first_sample_chunk = m_chunks.size();
 
+         // A chunk is sampled if it starts a new m_total_chunks / num_samples long stretch of the chain, which spreads the samples
+         // evenly over every level and face.
+         for (uint i = 0; i < m_levels[level].m_num_chunks; i++)
+         {
+            const uint64 chunk_index = m_levels[level].m_first_chunk + i;
+            if (((chunk_index * num_samples) % m_total_chunks) < num_samples)
+               append_level_chunks(level, i, 1, m_chunks);
+         }
+
+         m_levels[level].m_num_sample_chunks = m_chunks.size() - m_levels[level].m_first_sample_chunk;
+      }
+
+      CRNLIB_ASSERT(m_chunks.size() == num_samples);
+   }
+
+   void crn_comp::clear()
+   {
       for (uint f = 0; f < cCRNMaxFaces; f++)
          for (uint l = 0; l < cCRNMaxLevels; l++)
             m_images[f][l].clear();
@@ -1172,6 +1436,24 @@ namespace crnlib
 
       m_mip_groups.clear();
 
+      m_total_chunks = 0;
+
+      m_chunks.clear();
+      m_chunk_conv_type = image_utils::cConversion_Invalid;
+      m_max_sample_chunks = 0;
+      m_max_batch_chunks = 0;
+
+      m_chunk_params.clear();
+
+      m_hvq.clear();
+
+      clear_pass();
+   }
+
+   void crn_comp::clear_pass()
+   {
+      m_pParams = NULL;
+
       utils::zero_object(m_has_comp);
 
       m_chunk_details.clear();
@@ -1182,28 +1464,17 @@ namespace crnlib
          m_selector_indices[i].clear();
       }
 
-      m_total_chunks = 0;
-
-      m_chunks.clear();
-
       utils::zero_object(m_crn_header);
 
       m_comp_data.clear();
 
-      m_hvq.clear();
-
-      m_chunk_encoding_hist.clear();
-      m_chunk_encoding_dm.clear();
-      for (uint i = 0; i < 2; i++)
-      {
-         m_endpoint_index_hist[i].clear();
-         m_endpoint_index_dm[i].clear();
-         m_selector_index_hist[i].clear();
-         m_selector_index_dm[i].clear();
-      }
+      m_chunk_models.clear();
 
       for (uint i = 0; i < cCRNMaxLevels; i++)
+      {
          m_packed_chunks[i].clear();
+         m_slices[i].clear();
+      }
 
       m_packed_data_models.clear();
 
@@ -1213,10 +1484,8 @@ namespace crnlib
       m_packed_alpha_selectors.clear();
    }
 
-   bool crn_comp::quantize_chunks()
+   bool crn_comp::init_hvq_params(dxt_hc::params& params)
    {
-      dxt_hc::params params;
-
       params.m_adaptive_tile_alpha_psnr_derating = m_pParams->m_crn_adaptive_tile_alpha_psnr_derating;
       params.m_adaptive_tile_color_psnr_derating = m_pParams->m_crn_adaptive_tile_color_psnr_derating;
 
@@ -1254,7 +1523,21 @@ namespace crnlib
          float alpha_selector_quality = powf(quality, 1.65f * alpha_quality_power_mul);
          params.m_alpha_endpoint_codebook_size = math::clamp<uint>(math::float_to_uint(.5f + math::lerp<float>(math::maximum<float>(24, cCRNMinPaletteSize), (float)max_codebook_entries, alpha_endpoint_quality)), cCRNMinPaletteSize, cCRNMaxPaletteSize);;
          params.m_alpha_selector_codebook_size = math::clamp<uint>(math::float_to_uint(.5f + math::lerp<float>(math::maximum<float>(48, cCRNMinPaletteSize), (float)max_codebook_entries, alpha_selector_quality)), cCRNMinPaletteSize, cCRNMaxPaletteSize);;
-      }
+
+         // A bitrate search runs one pass per trial quality level over the same chunks. Let m_hvq keep its chunk analysis
+         // and build its endpoint trees at the highest quality's size, so later passes only have to cut them. This only saves
+         // about 10% of the search: each pass still optimizes the endpoints of its new clusters, and builds and assigns its
+         // selector codebook from scratch, since the selectors depend on the pass's quantized endpoints.
+         if (m_pParams->m_target_bitrate > 0.0f)
+         {
+            params.m_reuse_analysis = true;
+            params.m_max_endpoint_codebook_size = max_codebook_entries;
+         }
+      }
+
+      // encode_levels() encodes the chunks with m_hvq's codebooks and endpoint trees after they're built.
+      if (m_pParams->m_crn_memory_limit_mb)
+         params.m_reuse_analysis = true;
 
       if (m_pParams->m_flags & cCRNCompFlagDebugging)
       {
@@ -1266,6 +1549,7 @@ namespace crnlib
 
       params.m_hierarchical = (m_pParams->m_flags & cCRNCompFlagHierarchical) != 0;
       params.m_perceptual = (m_pParams->m_flags & cCRNCompFlagPerceptual) != 0;
+      params.m_dxt_quality = m_pParams->m_dxt_quality;
 
       params.m_pProgress_func = m_pParams->m_pProgress_func;
       params.m_pProgress_func_data = m_pParams->m_pProgress_func_data;
@@ -1344,8 +1628,9 @@ namespace crnlib
          }
          case cCRNFmtETC1:
          {
-            console::warning("crn_comp::quantize_chunks: This class does not support ETC1");
-            return false;
+            params.m_format = cETC1;
+            m_has_comp[cColor] = true;
+            break;
          }
          default:
          {
@@ -1354,18 +1639,26 @@ namespace crnlib
       }
       params.m_debugging = (m_pParams->m_flags & cCRNCompFlagDebugging) != 0;
 
+      return true;
+   }
+
+   bool crn_comp::quantize_chunks(dxt_hc::params& params)
+   {
+      // With a memory limit, m_chunks only holds the sampled chunks of each level.
+      const bool sampled = m_pParams->m_crn_memory_limit_mb != 0;
+
       params.m_num_levels = m_pParams->m_levels;
       for (uint i = 0; i < m_pParams->m_levels; i++)
       {
-         params.m_levels[i].m_first_chunk = m_levels[i].m_first_chunk;
-         params.m_levels[i].m_num_chunks = m_levels[i].m_num_chunks;
+         params.m_levels[i].m_first_chunk = sampled ? m_levels[i].m_first_sample_chunk : m_levels[i].m_first_chunk;
+         params.m_levels[i].m_num_chunks = sampled ? m_levels[i].m_num_sample_chunks : m_levels[i].m_num_chunks;
       }
 
-      if (!m_hvq.compress(params, m_total_chunks, &m_chunks[0], m_task_pool))
+      if (!m_hvq.compress(params, m_chunks.size(), &m_chunks[0], *m_pTask_pool))
          return false;
 
 #if CRNLIB_CREATE_DEBUG_IMAGES
-      if (params.m_debugging)
+      if ((params.m_debugging) && (!sampled))
       {
          const dxt_hc::pixel_chunk_vec& pixel_chunks = m_hvq.get_compressed_chunk_pixels_final();
 
@@ -1389,549 +1682,457 @@ namespace crnlib
       }
 
       for (uint chunk_index = 0; chunk_index < m_total_chunks; chunk_index++)
-      {
-         const dxt_hc::chunk_encoding& chunk_encoding = m_hvq.get_chunk_encoding(chunk_index);
-
-         for (uint i = 0; i < cNumComps; i++)
-         {
-            if (m_has_comp[i])
-            {
-               m_chunk_details[chunk_index].m_first_endpoint_index = m_endpoint_indices[i].size();
-               m_chunk_details[chunk_index].m_first_selector_index = m_selector_indices[i].size();
-               break;
-            }
-         }
-
-         for (uint i = 0; i < cNumComps; i++)
-         {
-            if (!m_has_comp[i])
-               continue;
-
-            for (uint tile_index = 0; tile_index < chunk_encoding.m_num_tiles; tile_index++)
-               m_endpoint_indices[i].push_back(chunk_encoding.m_endpoint_indices[i][tile_index]);
-
-            for (uint y = 0; y < cChunkBlockHeight; y++)
-               for (uint x = 0; x < cChunkBlockWidth; x++)
-                  m_selector_indices[i].push_back(chunk_encoding.m_selector_indices[i][y][x]);
-         }
-      }
+         append_chunk_indices(chunk_index, m_hvq.get_chunk_encoding(chunk_index));
    }
 
-   struct optimize_color_endpoint_codebook_params
+   void crn_comp::append_chunk_indices(uint chunk_index, const dxt_hc::chunk_encoding& chunk_encoding)
    {
-      crnlib::vector<uint>* m_pTrial_color_endpoint_remap;
-      uint m_iter_index;
-      uint m_max_iter_index;
-   };
+      m_chunk_details[chunk_index].m_encoding_index = chunk_encoding.m_encoding_index;
+      m_chunk_details[chunk_index].m_num_tiles = chunk_encoding.m_num_tiles;
 
-   void crn_comp::optimize_color_endpoint_codebook_task(uint64 data, void* pData_ptr)
-   {
-      data;
-      optimize_color_endpoint_codebook_params* pParams = reinterpret_cast<optimize_color_endpoint_codebook_params*>(pData_ptr);
-
-      if (pParams->m_iter_index == pParams->m_max_iter_index)
-      {
-         sort_color_endpoint_codebook(*pParams->m_pTrial_color_endpoint_remap, m_hvq.get_color_endpoint_vec());
-      }
-      else
+      for (uint i = 0; i < cNumComps; i++)
       {
-         float f = pParams->m_iter_index / static_cast<float>(pParams->m_max_iter_index - 1);
-
-         create_zeng_reorder_table(
-            m_hvq.get_color_endpoint_codebook_size(),
-            m_endpoint_indices[cColor].size(),
-            &m_endpoint_indices[cColor][0],
-            *pParams->m_pTrial_color_endpoint_remap,
-            pParams->m_iter_index ? color_endpoint_similarity_func : NULL,
-            &m_hvq,
-            f);
+         if (m_has_comp[i])
+         {
+            m_chunk_details[chunk_index].m_first_endpoint_index = m_endpoint_indices[i].size();
+            m_chunk_details[chunk_index].m_first_selector_index = m_selector_indices[i].size();
+            break;
+         }
       }
 
-      crnlib_delete(pParams);
-   }
-
-   bool crn_comp::optimize_color_endpoint_codebook(crnlib::vector<uint>& remapping)
-   {
-      if (m_pParams->m_flags & cCRNCompFlagQuick)
+      for (uint i = 0; i < cNumComps; i++)
       {
-         remapping.resize(m_hvq.get_color_endpoint_vec().size());
-         for (uint i = 0; i < m_hvq.get_color_endpoint_vec().size(); i++)
-            remapping[i] = i;
+         if (!m_has_comp[i])
+            continue;
 
-         if (!pack_color_endpoints(m_packed_color_endpoints, remapping, m_endpoint_indices[cColor], 0))
-            return false;
+         for (uint tile_index = 0; tile_index < chunk_encoding.m_num_tiles; tile_index++)
+            m_endpoint_indices[i].push_back(chunk_encoding.m_endpoint_indices[i][tile_index]);
 
-         return true;
+         for (uint y = 0; y < cChunkBlockHeight; y++)
+            for (uint x = 0; x < cChunkBlockWidth; x++)
+               m_selector_indices[i].push_back(chunk_encoding.m_selector_indices[i][y][x]);
       }
+   }
 
-      const uint cMaxEndpointRemapIters = 3;
-
-      uint best_bits = UINT_MAX;
-
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("----- Begin optimization of color endpoint codebook");
-#endif
+   bool crn_comp::encode_levels()
+   {
+      const uint max_batch_chunks = m_max_batch_chunks;
 
-      crnlib::vector<uint> trial_color_endpoint_remaps[cMaxEndpointRemapIters + 1];
+      m_chunk_details.resize(m_total_chunks);
 
-      for (uint i = 0; i <= cMaxEndpointRemapIters; i++)
+      // Reserved at their largest, as counted by get_fixed_memory_size(), so they never grow past it.
+      for (uint i = 0; i < cNumComps; i++)
       {
-         optimize_color_endpoint_codebook_params* pParams = crnlib_new<optimize_color_endpoint_codebook_params>();
-         pParams->m_iter_index = i;
-         pParams->m_max_iter_index = cMaxEndpointRemapIters;
-         pParams->m_pTrial_color_endpoint_remap = &trial_color_endpoint_remaps[i];
+         m_endpoint_indices[i].clear();
+         m_selector_indices[i].clear();
 
-         m_task_pool.queue_object_task(this, &crn_comp::optimize_color_endpoint_codebook_task, 0, pParams);
+         if (m_has_comp[i])
+         {
+            m_endpoint_indices[i].reserve(m_total_chunks * cChunkMaxTiles);
+            m_selector_indices[i].reserve(m_total_chunks * cChunkBlockWidth * cChunkBlockHeight);
+         }
       }
 
-      m_task_pool.join();
+      dxt_hc::pixel_chunk_vec chunks;
+      dxt_hc::chunk_encoding_vec chunk_encodings;
 
-      for (uint i = 0; i <= cMaxEndpointRemapIters; i++)
+      // Each level is its own mip group. Only one batch of its chunks exists at a time, and only their indices are kept.
+      for (uint level = 0; level < m_pParams->m_levels; level++)
       {
-         if (!update_progress(20, i, cMaxEndpointRemapIters+1))
-            return false;
+         const uint num_chunks = m_levels[level].m_num_chunks;
 
-         crnlib::vector<uint>& trial_color_endpoint_remap = trial_color_endpoint_remaps[i];
-
-         crnlib::vector<uint8> packed_data;
-         if (!pack_color_endpoints(packed_data, trial_color_endpoint_remap, m_endpoint_indices[cColor], i))
-            return false;
+         for (uint first_chunk = 0; first_chunk < num_chunks; first_chunk += max_batch_chunks)
+         {
+            const uint num_batch_chunks = math::minimum(max_batch_chunks, num_chunks - first_chunk);
 
-         uint total_packed_chunk_bits;
-         if (!pack_chunks_simulation(0, m_total_chunks, total_packed_chunk_bits, &trial_color_endpoint_remap, NULL, NULL, NULL))
-            return false;
+            chunks.resize(0);
+            append_level_chunks(level, first_chunk, num_batch_chunks, chunks);
 
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Pack chunks simulation: %u bits", total_packed_chunk_bits);
-#endif
+            chunk_encodings.resize(num_batch_chunks);
 
-         uint total_bits = packed_data.size() * 8 + total_packed_chunk_bits;
-
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Total bits: %u", total_bits);
-#endif
+            if (!m_hvq.encode_chunks(num_batch_chunks, &chunks[0], level, &chunk_encodings[0], *m_pTask_pool))
+               return false;
 
-         if (total_bits < best_bits)
-         {
-            m_packed_color_endpoints.swap(packed_data);
-            remapping.swap(trial_color_endpoint_remap);
-            best_bits = total_bits;
+            for (uint i = 0; i < num_batch_chunks; i++)
+               append_chunk_indices(m_levels[level].m_first_chunk + first_chunk + i, chunk_encodings[i]);
          }
       }
 
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("End optimization of color endpoint codebook");
-#endif
-
       return true;
    }
 
-   struct optimize_color_selector_codebook_params
+   struct crn_comp::codebook_trial
    {
-      crnlib::vector<uint>* m_pTrial_color_selector_remap;
-      uint m_iter_index;
-      uint m_max_iter_index;
+      uint                          m_codebook;
+      uint                          m_trial_index;
+      uint                          m_max_trial_index;
+      const crnlib::vector<uint>*   m_pIndices;
+
+      crnlib::vector<uint>          m_remapping;
+      crnlib::vector<uint8>         m_packed_data;
+      uint                          m_total_packed_chunk_bits;
+      bool                          m_status;
+
+      // Chunk statistics gathered by simulate_chunks_task(), one set per range of chunks.
+      crnlib::vector<chunk_models>  m_range_models;
+      uint                          m_chunks_per_range;
+      atomic32_t                    m_simulation_failed;
    };
 
-   void crn_comp::optimize_color_selector_codebook_task(uint64 data, void* pData_ptr)
+   // Creates one trial ordering of a codebook and packs the codebook with it. Trials only read the quantized chunks,
+   // so every trial of every codebook can run at the same time.
+   void crn_comp::optimize_codebook_task(uint64 data, void* pData_ptr)
    {
       data;
-      optimize_color_selector_codebook_params* pParams = reinterpret_cast<optimize_color_selector_codebook_params*>(pData_ptr);
+      codebook_trial& trial = *static_cast<codebook_trial*>(pData_ptr);
+      const bool quick = (m_pParams->m_flags & cCRNCompFlagQuick) != 0;
+      const float f = trial.m_max_trial_index ? (trial.m_trial_index / static_cast<float>(trial.m_max_trial_index - 1)) : 0.0f;
 
-      if (pParams->m_iter_index == pParams->m_max_iter_index)
+      switch (trial.m_codebook)
       {
-         sort_selector_codebook(*pParams->m_pTrial_color_selector_remap, m_hvq.get_color_selectors_vec(), g_dxt1_to_linear);
-      }
-      else
-      {
-         float f = pParams->m_iter_index / static_cast<float>(pParams->m_max_iter_index - 1);
-         create_zeng_reorder_table(
-            m_hvq.get_color_selector_codebook_size(),
-            m_selector_indices[cColor].size(),
-            &m_selector_indices[cColor][0],
-            *pParams->m_pTrial_color_selector_remap,
-            pParams->m_iter_index ? color_selector_similarity_func : NULL,
-            (void*)&m_hvq.get_color_selectors_vec(),
-            f);
-      }
-
-      crnlib_delete(pParams);
-   }
-
-   bool crn_comp::optimize_color_selector_codebook(crnlib::vector<uint>& remapping)
-   {
-      if (m_pParams->m_flags & cCRNCompFlagQuick)
-      {
-         remapping.resize(m_hvq.get_color_selectors_vec().size());
-         for (uint i = 0; i < m_hvq.get_color_selectors_vec().size(); i++)
-            remapping[i] = i;
-
-         if (!pack_selectors(
-            m_packed_color_selectors,
-            m_selector_indices[cColor],
-            m_hvq.get_color_selectors_vec(),
-            remapping,
-            3,
-            g_dxt1_to_linear, 0))
+         case cColorEndpointCodebook:
          {
-            return false;
-         }
-
-         return true;
-      }
-
-      const uint cMaxSelectorRemapIters = 3;
-
-      uint best_bits = UINT_MAX;
-
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("----- Begin optimization of color selector codebook");
-#endif
-
-      crnlib::vector<uint> trial_color_selector_remaps[cMaxSelectorRemapIters + 1];
-
-      for (uint i = 0; i <= cMaxSelectorRemapIters; i++)
-      {
-         optimize_color_selector_codebook_params* pParams = crnlib_new<optimize_color_selector_codebook_params>();
-         pParams->m_iter_index = i;
-         pParams->m_max_iter_index = cMaxSelectorRemapIters;
-         pParams->m_pTrial_color_selector_remap = &trial_color_selector_remaps[i];
-
-         m_task_pool.queue_object_task(this, &crn_comp::optimize_color_selector_codebook_task, 0, pParams);
-      }
-
-      m_task_pool.join();
-
-      for (uint i = 0; i <= cMaxSelectorRemapIters; i++)
-      {
-         if (!update_progress(21, i, cMaxSelectorRemapIters+1))
-            return false;
-
-         crnlib::vector<uint>& trial_color_selector_remap = trial_color_selector_remaps[i];
+            if (quick)
+            {
+               trial.m_remapping.resize(m_hvq.get_color_endpoint_vec().size());
+               for (uint i = 0; i < m_hvq.get_color_endpoint_vec().size(); i++)
+                  trial.m_remapping[i] = i;
+            }
+            else if (trial.m_trial_index == trial.m_max_trial_index)
+               sort_color_endpoint_codebook(trial.m_remapping, m_hvq.get_color_endpoint_vec(), m_pParams->m_format);
+            else
+            {
+               create_zeng_reorder_table(
+                  m_hvq.get_color_endpoint_codebook_size(),
+                  trial.m_pIndices->size(),
+                  &(*trial.m_pIndices)[0],
+                  trial.m_remapping,
+                  trial.m_trial_index ? color_endpoint_similarity_func : NULL,
+                  this,
+                  f);
+            }
 
-         crnlib::vector<uint8> packed_data;
-         if (!pack_selectors(
-            packed_data,
-            m_selector_indices[cColor],
-            m_hvq.get_color_selectors_vec(),
-            trial_color_selector_remap,
-            3,
-            g_dxt1_to_linear, i))
-         {
-            return false;
+            trial.m_status = pack_color_endpoints(trial.m_packed_data, trial.m_remapping, *trial.m_pIndices, trial.m_trial_index);
+            break;
          }
+         case cColorSelectorCodebook:
+         {
+            if (quick)
+            {
+               trial.m_remapping.resize(m_hvq.get_color_selectors_vec().size());
+               for (uint i = 0; i < m_hvq.get_color_selectors_vec().size(); i++)
+                  trial.m_remapping[i] = i;
+            }
+            else if (trial.m_trial_index == trial.m_max_trial_index)
+               sort_selector_codebook(trial.m_remapping, m_hvq.get_color_selectors_vec(), get_color_selector_to_linear(m_pParams->m_format));
+            else
+            {
+               create_zeng_reorder_table(
+                  m_hvq.get_color_selector_codebook_size(),
+                  trial.m_pIndices->size(),
+                  &(*trial.m_pIndices)[0],
+                  trial.m_remapping,
+                  trial.m_trial_index ? color_selector_similarity_func : NULL,
+                  this,
+                  f);
+            }
 
-         uint total_packed_chunk_bits;
-         if (!pack_chunks_simulation(0, m_total_chunks, total_packed_chunk_bits, NULL, &trial_color_selector_remap, NULL, NULL))
-            return false;
-
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Pack chunks simulation: %u bits", total_packed_chunk_bits);
-#endif
+            trial.m_status = pack_selectors(
+               trial.m_packed_data,
+               *trial.m_pIndices,
+               m_hvq.get_color_selectors_vec(),
+               trial.m_remapping,
+               3,
+               get_color_selector_to_linear(m_pParams->m_format), trial.m_trial_index);
+            break;
+         }
+         case cAlphaEndpointCodebook:
+         {
+            if (quick)
+            {
+               trial.m_remapping.resize(m_hvq.get_alpha_endpoint_vec().size());
+               for (uint i = 0; i < m_hvq.get_alpha_endpoint_vec().size(); i++)
+                  trial.m_remapping[i] = i;
+            }
+            else if (trial.m_trial_index == trial.m_max_trial_index)
+               sort_alpha_endpoint_codebook(trial.m_remapping, m_hvq.get_alpha_endpoint_vec());
+            else
+            {
+               create_zeng_reorder_table(
+                  m_hvq.get_alpha_endpoint_codebook_size(),
+                  trial.m_pIndices->size(),
+                  &(*trial.m_pIndices)[0],
+                  trial.m_remapping,
+                  trial.m_trial_index ? alpha_endpoint_similarity_func : NULL,
+                  &m_hvq,
+                  f);
+            }
 
-         uint total_bits = packed_data.size() * 8 + total_packed_chunk_bits;
+            trial.m_status = pack_alpha_endpoints(trial.m_packed_data, trial.m_remapping, *trial.m_pIndices, trial.m_trial_index);
+            break;
+         }
+         case cAlphaSelectorCodebook:
+         {
+            if (quick)
+            {
+               trial.m_remapping.resize(m_hvq.get_alpha_selectors_vec().size());
+               for (uint i = 0; i < m_hvq.get_alpha_selectors_vec().size(); i++)
+                  trial.m_remapping[i] = i;
+            }
+            else if (trial.m_trial_index == trial.m_max_trial_index)
+               sort_selector_codebook(trial.m_remapping, m_hvq.get_alpha_selectors_vec(), g_dxt5_to_linear);
+            else
+            {
+               create_zeng_reorder_table(
+                  m_hvq.get_alpha_selector_codebook_size(),
+                  trial.m_pIndices->size(),
+                  &(*trial.m_pIndices)[0],
+                  trial.m_remapping,
+                  trial.m_trial_index ? alpha_selector_similarity_func : NULL,
+                  (void*)&m_hvq.get_alpha_selectors_vec(),
+                  f);
+            }
 
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Total bits: %u", total_bits);
-#endif
-         if (total_bits < best_bits)
+            trial.m_status = pack_selectors(
+               trial.m_packed_data,
+               *trial.m_pIndices,
+               m_hvq.get_alpha_selectors_vec(),
+               trial.m_remapping,
+               7,
+               g_dxt5_to_linear, trial.m_trial_index);
+            break;
+         }
+         default:
          {
-            m_packed_color_selectors.swap(packed_data);
-            remapping.swap(trial_color_selector_remap);
-            best_bits = total_bits;
+            CRNLIB_ASSERT(0);
+            trial.m_status = false;
+            break;
          }
       }
 
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("End optimization of color selector codebook");
-#endif
-
-      return true;
    }
 
-   struct optimize_alpha_endpoint_codebook_params
+   // Gathers the chunk histograms of one trial ordering over a single range of chunks. Ranges start on chunk encoding
+   // code boundaries, and their histograms sum to what a single pass over every chunk would produce.
+   void crn_comp::simulate_chunks_task(uint64 data, void* pData_ptr)
    {
-      crnlib::vector<uint>* m_pAlpha_indices;
-      crnlib::vector<uint>* m_pTrial_alpha_endpoint_remap;
-      uint m_iter_index;
-      uint m_max_iter_index;
-   };
+      const uint range_index = static_cast<uint>(data);
+      codebook_trial& trial = *static_cast<codebook_trial*>(pData_ptr);
 
-   void crn_comp::optimize_alpha_endpoint_codebook_task(uint64 data, void* pData_ptr)
-   {
-      data;
-      optimize_alpha_endpoint_codebook_params* pParams = reinterpret_cast<optimize_alpha_endpoint_codebook_params*>(pData_ptr);
+      const uint first_chunk = range_index * trial.m_chunks_per_range;
+      const uint num_chunks = math::minimum(trial.m_chunks_per_range, m_total_chunks - first_chunk);
 
-      if (pParams->m_iter_index == pParams->m_max_iter_index)
-      {
-         sort_alpha_endpoint_codebook(*pParams->m_pTrial_alpha_endpoint_remap, m_hvq.get_alpha_endpoint_vec());
-      }
-      else
-      {
-         float f = pParams->m_iter_index / static_cast<float>(pParams->m_max_iter_index - 1);
+      const crnlib::vector<uint>* pRemaps[cNumCodebooks] = { NULL, NULL, NULL, NULL };
+      pRemaps[trial.m_codebook] = &trial.m_remapping;
 
-         create_zeng_reorder_table(
-            m_hvq.get_alpha_endpoint_codebook_size(),
-            pParams->m_pAlpha_indices->size(),
-            &(*pParams->m_pAlpha_indices)[0],
-            *pParams->m_pTrial_alpha_endpoint_remap,
-            pParams->m_iter_index ? alpha_endpoint_similarity_func : NULL,
-            &m_hvq,
-            f);
+      if (!pack_chunks(first_chunk, num_chunks, true, true, NULL, trial.m_range_models[range_index],
+         pRemaps[cColorEndpointCodebook], pRemaps[cColorSelectorCodebook], pRemaps[cAlphaEndpointCodebook], pRemaps[cAlphaSelectorCodebook]))
+      {
+         atomic_exchange32(&trial.m_simulation_failed, CRNLIB_TRUE);
       }
-
-      crnlib_delete(pParams);
    }
 
-   bool crn_comp::optimize_alpha_endpoint_codebook(crnlib::vector<uint>& remapping)
+   // Each codebook is reordered several different ways, and the ordering that results in the fewest total bits is kept.
+   // First every trial ordering is created and packed in parallel, then the chunk statistics of every trial are gathered
+   // in parallel over ranges of chunks, which keeps all the threads busy even when there are only a few trials.
+   bool crn_comp::optimize_codebooks(crnlib::vector<uint> endpoint_remap[2], crnlib::vector<uint> selector_remap[2])
    {
-      crnlib::vector<uint> alpha_indices;
-      alpha_indices.reserve(m_endpoint_indices[cAlpha0].size() + m_endpoint_indices[cAlpha1].size());
-      for (uint i = 0; i < m_endpoint_indices[cAlpha0].size(); i++)
-         alpha_indices.push_back(m_endpoint_indices[cAlpha0][i]);
-      for (uint i = 0; i < m_endpoint_indices[cAlpha1].size(); i++)
-         alpha_indices.push_back(m_endpoint_indices[cAlpha1][i]);
+      const uint cMaxRemapIters = 3;
+      const uint max_trial_index = (m_pParams->m_flags & cCRNCompFlagQuick) ? 0 : cMaxRemapIters;
 
-      if (m_pParams->m_flags & cCRNCompFlagQuick)
-      {
-         remapping.resize(m_hvq.get_alpha_endpoint_vec().size());
-         for (uint i = 0; i < m_hvq.get_alpha_endpoint_vec().size(); i++)
-            remapping[i] = i;
-
-         if (!pack_alpha_endpoints(m_packed_alpha_endpoints, remapping, alpha_indices, 0))
-            return false;
-
-         return true;
-      }
-
-      const uint cMaxEndpointRemapIters = 3;
-      uint best_bits = UINT_MAX;
+      crnlib::vector<uint> alpha_endpoint_indices;
+      crnlib::vector<uint> alpha_selector_indices;
 
+      const crnlib::vector<uint>* pIndices[cNumCodebooks] = { &m_endpoint_indices[cColor], &m_selector_indices[cColor], &alpha_endpoint_indices, &alpha_selector_indices };
+      crnlib::vector<uint>* pRemapping[cNumCodebooks] = { &endpoint_remap[0], &selector_remap[0], &endpoint_remap[1], &selector_remap[1] };
+      crnlib::vector<uint8>* pPacked_data[cNumCodebooks] = { &m_packed_color_endpoints, &m_packed_color_selectors, &m_packed_alpha_endpoints, &m_packed_alpha_selectors };
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("----- Begin optimization of alpha endpoint codebook");
+      const char* pNames[cNumCodebooks] = { "color endpoint", "color selector", "alpha endpoint", "alpha selector" };
 #endif
 
-      crnlib::vector<uint> trial_alpha_endpoint_remaps[cMaxEndpointRemapIters + 1];
+      bool has_codebook[cNumCodebooks];
+      has_codebook[cColorEndpointCodebook] = has_codebook[cColorSelectorCodebook] = m_has_comp[cColor];
+      has_codebook[cAlphaEndpointCodebook] = has_codebook[cAlphaSelectorCodebook] = m_has_comp[cAlpha0];
 
-      for (uint i = 0; i <= cMaxEndpointRemapIters; i++)
+      if (m_has_comp[cAlpha0])
       {
-         optimize_alpha_endpoint_codebook_params* pParams = crnlib_new<optimize_alpha_endpoint_codebook_params>();
-         pParams->m_pAlpha_indices = &alpha_indices;
-         pParams->m_iter_index = i;
-         pParams->m_max_iter_index = cMaxEndpointRemapIters;
-         pParams->m_pTrial_alpha_endpoint_remap = &trial_alpha_endpoint_remaps[i];
+         alpha_endpoint_indices.reserve(m_endpoint_indices[cAlpha0].size() + m_endpoint_indices[cAlpha1].size());
+         alpha_endpoint_indices.append(m_endpoint_indices[cAlpha0]);
+         alpha_endpoint_indices.append(m_endpoint_indices[cAlpha1]);
 
-         m_task_pool.queue_object_task(this, &crn_comp::optimize_alpha_endpoint_codebook_task, 0, pParams);
+         alpha_selector_indices.reserve(m_selector_indices[cAlpha0].size() + m_selector_indices[cAlpha1].size());
+         alpha_selector_indices.append(m_selector_indices[cAlpha0]);
+         alpha_selector_indices.append(m_selector_indices[cAlpha1]);
       }
 
-      m_task_pool.join();
-
-      for (uint i = 0; i <= cMaxEndpointRemapIters; i++)
-      {
-         if (!update_progress(22, i, cMaxEndpointRemapIters+1))
-            return false;
-
-         crnlib::vector<uint>& trial_alpha_endpoint_remap = trial_alpha_endpoint_remaps[i];
-
-         crnlib::vector<uint8> packed_data;
-         if (!pack_alpha_endpoints(packed_data, trial_alpha_endpoint_remap, alpha_indices, i))
-            return false;
-
-         uint total_packed_chunk_bits;
-         if (!pack_chunks_simulation(0, m_total_chunks, total_packed_chunk_bits, NULL, NULL, &trial_alpha_endpoint_remap, NULL))
-            return false;
-
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Pack chunks simulation: %u bits", total_packed_chunk_bits);
-#endif
+      if (!update_progress(20, 0, 1))
+         return false;
 
-         uint total_bits = packed_data.size() * 8 + total_packed_chunk_bits;
+      codebook_trial trials[cNumCodebooks][cMaxRemapIters + 1];
+      uint num_trials = 0;
 
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Total bits: %u", total_bits);
-#endif
+      for (uint c = 0; c < cNumCodebooks; c++)
+      {
+         if (!has_codebook[c])
+            continue;
 
-         if (total_bits < best_bits)
+         for (uint i = 0; i <= max_trial_index; i++)
          {
-            m_packed_alpha_endpoints.swap(packed_data);
-            remapping.swap(trial_alpha_endpoint_remap);
-            best_bits = total_bits;
+            codebook_trial& trial = trials[c][i];
+            trial.m_codebook = c;
+            trial.m_trial_index = i;
+            trial.m_max_trial_index = max_trial_index;
+            trial.m_pIndices = pIndices[c];
+            trial.m_total_packed_chunk_bits = 0;
+            trial.m_status = false;
+            trial.m_chunks_per_range = 0;
+            trial.m_simulation_failed = CRNLIB_FALSE;
+            num_trials++;
+
+            // Each Zeng reordering builds a histogram of index pairs, so with a memory limit they're made one at a time.
+            if (m_pParams->m_crn_memory_limit_mb)
+               optimize_codebook_task(0, &trial);
+            else
+               m_pTask_pool->queue_object_task(this, &crn_comp::optimize_codebook_task, 0, &trial);
          }
       }
 
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("End optimization of alpha endpoint codebook");
-#endif
+      m_pTask_pool->join();
 
-      return true;
-   }
+      // There's only one candidate per codebook in quick mode, so don't bother scoring it.
+      if (max_trial_index)
+      {
+         // Aim for about two tasks per thread, but don't split the chunks so finely that the per-range histograms cost more
+         // to merge than they save. Ranges must start on a chunk encoding code boundary.
+         const uint cMinChunksPerRange = 512;
+         uint num_ranges = math::maximum(1U, ((m_pTask_pool->get_num_threads() + 1) * 2 + num_trials - 1) / num_trials);
+         num_ranges = math::minimum(num_ranges, math::maximum(1U, m_total_chunks / cMinChunksPerRange));
 
-   struct optimize_alpha_selector_codebook_params
-   {
-      crnlib::vector<uint>* m_pAlpha_indices;
-      crnlib::vector<uint>* m_pTrial_alpha_selector_remap;
-      uint m_iter_index;
-      uint m_max_iter_index;
-   };
+         const uint chunks_per_range = math::align_up_value((m_total_chunks + num_ranges - 1) / num_ranges, cEncodingMapNumChunksPerCode);
+         num_ranges = (m_total_chunks + chunks_per_range - 1) / chunks_per_range;
 
-   void crn_comp::optimize_alpha_selector_codebook_task(uint64 data, void* pData_ptr)
-   {
-      data;
-      optimize_alpha_selector_codebook_params* pParams = reinterpret_cast<optimize_alpha_selector_codebook_params*>(pData_ptr);
+         for (uint c = 0; c < cNumCodebooks; c++)
+         {
+            if (!has_codebook[c])
+               continue;
 
-      if (pParams->m_iter_index == pParams->m_max_iter_index)
-      {
-         sort_selector_codebook(*pParams->m_pTrial_alpha_selector_remap, m_hvq.get_alpha_selectors_vec(), g_dxt5_to_linear);
-      }
-      else
-      {
-         float f = pParams->m_iter_index / static_cast<float>(pParams->m_max_iter_index - 1);
-         create_zeng_reorder_table(
-            m_hvq.get_alpha_selector_codebook_size(),
-            pParams->m_pAlpha_indices->size(),
-            &(*pParams->m_pAlpha_indices)[0],
-            *pParams->m_pTrial_alpha_selector_remap,
-            pParams->m_iter_index ? alpha_selector_similarity_func : NULL,
-            (void*)&m_hvq.get_alpha_selectors_vec(),
-            f);
-      }
-   }
+            for (uint i = 0; i <= max_trial_index; i++)
+            {
+               codebook_trial& trial = trials[c][i];
+               if (!trial.m_status)
+                  return false;
 
-   bool crn_comp::optimize_alpha_selector_codebook(crnlib::vector<uint>& remapping)
-   {
-      crnlib::vector<uint> alpha_indices;
-      alpha_indices.reserve(m_selector_indices[cAlpha0].size() + m_selector_indices[cAlpha1].size());
-      for (uint i = 0; i < m_selector_indices[cAlpha0].size(); i++)
-         alpha_indices.push_back(m_selector_indices[cAlpha0][i]);
-      for (uint i = 0; i < m_selector_indices[cAlpha1].size(); i++)
-         alpha_indices.push_back(m_selector_indices[cAlpha1][i]);
-
-      if (m_pParams->m_flags & cCRNCompFlagQuick)
-      {
-         remapping.resize(m_hvq.get_alpha_selectors_vec().size());
-         for (uint i = 0; i < m_hvq.get_alpha_selectors_vec().size(); i++)
-            remapping[i] = i;
-
-         if (!pack_selectors(
-            m_packed_alpha_selectors,
-            alpha_indices,
-            m_hvq.get_alpha_selectors_vec(),
-            remapping,
-            7,
-            g_dxt5_to_linear, 0))
-         {
-            return false;
+               trial.m_chunks_per_range = chunks_per_range;
+               trial.m_range_models.resize(num_ranges);
+
+               for (uint r = 0; r < num_ranges; r++)
+                  m_pTask_pool->queue_object_task(this, &crn_comp::simulate_chunks_task, r, &trial);
+            }
          }
 
-         return true;
-      }
+         m_pTask_pool->join();
 
-      const uint cMaxSelectorRemapIters = 3;
+         for (uint c = 0; c < cNumCodebooks; c++)
+         {
+            if (!has_codebook[c])
+               continue;
 
-      uint best_bits = UINT_MAX;
+            for (uint i = 0; i <= max_trial_index; i++)
+            {
+               codebook_trial& trial = trials[c][i];
+               if (trial.m_simulation_failed)
+                  return false;
 
-#if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("----- Begin optimization of alpha selector codebook");
-#endif
+               chunk_models& models = trial.m_range_models[0];
+               for (uint r = 1; r < num_ranges; r++)
+               {
+                  const chunk_models& range_models = trial.m_range_models[r];
 
-      crnlib::vector<uint> trial_alpha_selector_remaps[cMaxSelectorRemapIters + 1];
+                  models.m_chunk_encoding_hist += range_models.m_chunk_encoding_hist;
+                  for (uint j = 0; j < 2; j++)
+                  {
+                     models.m_endpoint_index_hist[j] += range_models.m_endpoint_index_hist[j];
+                     models.m_selector_index_hist[j] += range_models.m_selector_index_hist[j];
+                  }
+               }
 
-      for (uint i = 0; i <= cMaxSelectorRemapIters; i++)
-      {
-         optimize_alpha_selector_codebook_params* pParams = crnlib_new<optimize_alpha_selector_codebook_params>();
-         pParams->m_pAlpha_indices = &alpha_indices;
-         pParams->m_iter_index = i;
-         pParams->m_max_iter_index = cMaxSelectorRemapIters;
-         pParams->m_pTrial_alpha_selector_remap = &trial_alpha_selector_remaps[i];
+               if (!pack_chunks_simulation(models, trial.m_total_packed_chunk_bits))
+                  return false;
 
-         m_task_pool.queue_object_task(this, &crn_comp::optimize_alpha_selector_codebook_task, 0, pParams);
+               trial.m_range_models.clear();
+            }
+         }
       }
 
-      m_task_pool.join();
-
-      for (uint i = 0; i <= cMaxSelectorRemapIters; i++)
+      for (uint c = 0; c < cNumCodebooks; c++)
       {
-         if (!update_progress(23, i, cMaxSelectorRemapIters+1))
-            return false;
+         if (!has_codebook[c])
+            continue;
+
+#if CRNLIB_ENABLE_DEBUG_MESSAGES
+         if (m_pParams->m_flags & cCRNCompFlagDebugging)
+            console::debug("----- Begin optimization of %s codebook", pNames[c]);
+#endif
 
-         crnlib::vector<uint>& trial_alpha_selector_remap = trial_alpha_selector_remaps[i];
+         uint best_bits = UINT_MAX;
 
-         crnlib::vector<uint8> packed_data;
-         if (!pack_selectors(
-            packed_data,
-            alpha_indices,
-            m_hvq.get_alpha_selectors_vec(),
-            trial_alpha_selector_remap,
-            7,
-            g_dxt5_to_linear, i))
+         for (uint i = 0; i <= max_trial_index; i++)
          {
-            return false;
-         }
-
-         uint total_packed_chunk_bits;
-         if (!pack_chunks_simulation(0, m_total_chunks, total_packed_chunk_bits, NULL, NULL, NULL, &trial_alpha_selector_remap))
-            return false;
+            codebook_trial& trial = trials[c][i];
+            if (!trial.m_status)
+               return false;
 
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Pack chunks simulation: %u bits", total_packed_chunk_bits);
+            if (m_pParams->m_flags & cCRNCompFlagDebugging)
+               console::debug("Pack chunks simulation: %u bits", trial.m_total_packed_chunk_bits);
 #endif
 
-         uint total_bits = packed_data.size() * 8 + total_packed_chunk_bits;
+            uint total_bits = trial.m_packed_data.size() * 8 + trial.m_total_packed_chunk_bits;
 
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
-         if (m_pParams->m_flags & cCRNCompFlagDebugging)
-            console::debug("Total bits: %u", total_bits);
+            if (m_pParams->m_flags & cCRNCompFlagDebugging)
+               console::debug("Total bits: %u", total_bits);
 #endif
-         if (total_bits < best_bits)
-         {
-            m_packed_alpha_selectors.swap(packed_data);
 
-            remapping.swap(trial_alpha_selector_remap);
-            best_bits = total_bits;
+            if (total_bits < best_bits)
+            {
+               pPacked_data[c]->swap(trial.m_packed_data);
+               pRemapping[c]->swap(trial.m_remapping);
+               best_bits = total_bits;
+            }
          }
-      }
 
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
-      if (m_pParams->m_flags & cCRNCompFlagDebugging)
-         console::debug("End optimization of alpha selector codebook");
+         if (m_pParams->m_flags & cCRNCompFlagDebugging)
+            console::debug("End optimization of %s codebook", pNames[c]);
 #endif
 
+         if (!update_progress(20 + c, 1, 1))
+            return false;
+      }
+
       return true;
    }
 
    bool crn_comp::pack_data_models()
    {
       symbol_codec codec;
-      codec.start_encoding(1024*1024);
+      codec.start_encoding(64*1024);
 
-      if (!codec.encode_transmit_static_huffman_data_model(m_chunk_encoding_dm, false))
+      if (!codec.encode_transmit_static_huffman_data_model(m_chunk_models.m_chunk_encoding_dm, false))
          return false;
 
       for (uint i = 0; i < 2; i++)
       {
-         if (m_endpoint_index_dm[i].get_total_syms())
+         if (m_chunk_models.m_endpoint_index_dm[i].get_total_syms())
          {
-            if (!codec.encode_transmit_static_huffman_data_model(m_endpoint_index_dm[i], false))
+            if (!codec.encode_transmit_static_huffman_data_model(m_chunk_models.m_endpoint_index_dm[i], false))
                return false;
          }
 
-         if (m_selector_index_dm[i].get_total_syms())
+         if (m_chunk_models.m_selector_index_dm[i].get_total_syms())
          {
-            if (!codec.encode_transmit_static_huffman_data_model(m_selector_index_dm[i], false))
+            if (!codec.encode_transmit_static_huffman_data_model(m_chunk_models.m_selector_index_dm[i], false))
                return false;
          }
       }
@@ -1955,8 +2156,20 @@ namespace crnlib
       m_crn_header.m_userdata0 = m_pParams->m_userdata0;
       m_crn_header.m_userdata1 = m_pParams->m_userdata1;
 
+      uint comp_data_size = sizeof(m_crn_header) + sizeof(m_crn_header.m_level_ofs[0]) * (m_pParams->m_levels - 1) +
+         m_packed_color_endpoints.size() + m_packed_color_selectors.size() + m_packed_alpha_endpoints.size() + m_packed_alpha_selectors.size() +
+         m_packed_data_models.size();
+      if (m_pParams->m_crn_slice_chunk_rows)
+      {
+         comp_data_size += sizeof(crnd::crn_slice_table);
+         for (uint i = 0; i < m_mip_groups.size(); i++)
+            comp_data_size += m_slices[i].size_in_bytes();
+      }
+      for (uint i = 0; i < m_mip_groups.size(); i++)
+         comp_data_size += m_packed_chunks[i].size();
+
       m_comp_data.clear();
-      m_comp_data.reserve(2*1024*1024);
+      m_comp_data.reserve(comp_data_size);
       append_vec(m_comp_data, &m_crn_header, sizeof(m_crn_header));
       // tack on the rest of the variable size m_level_ofs array
       m_comp_data.resize( m_comp_data.size() + sizeof(m_crn_header.m_level_ofs[0]) * (m_pParams->m_levels - 1) );
@@ -1997,6 +2210,18 @@ namespace crnlib
       m_crn_header.m_tables_size = m_packed_data_models.size();
       append_vec(m_comp_data, m_packed_data_models);
 
+      if (m_pParams->m_crn_slice_chunk_rows)
+      {
+         m_crn_header.m_slice_table_ofs = m_comp_data.size();
+
+         crnd::crn_slice_table slice_table;
+         slice_table.m_chunk_rows = static_cast<uint16>(m_pParams->m_crn_slice_chunk_rows);
+         append_vec(m_comp_data, &slice_table, sizeof(slice_table));
+
+         for (uint i = 0; i < m_mip_groups.size(); i++)
+            append_vec(m_comp_data, m_slices[i].get_ptr(), m_slices[i].size_in_bytes());
+      }
+
       uint level_ofs[cCRNMaxLevels];
       for (uint i = 0; i < m_mip_groups.size(); i++)
       {
@@ -2038,58 +2263,67 @@ namespace crnlib
       return (*m_pParams->m_pProgress_func)(phase_index, cTotalCompressionPhases, subphase_index, subphase_total, m_pParams->m_pProgress_func_data) != 0;
    }
 
-   bool crn_comp::compress_internal()
+   bool crn_comp::compress_internal(bool reuse_chunks)
    {
-      if (!alias_images())
-         return false;
-
-      create_chunks();
-
-      if (!quantize_chunks())
+      dxt_hc::params hvq_params;
+      if (!init_hvq_params(hvq_params))
          return false;
 
-      create_chunk_indices();
+      // With a memory limit, the codebooks are built from a sample of the chunks, and then every level is encoded with them a batch
+      // of chunks at a time. The sample and m_hvq's analysis of it are reused like the full set of chunks otherwise is.
+      const bool sampled = m_pParams->m_crn_memory_limit_mb != 0;
 
-      crnlib::vector<uint> endpoint_remap[2];
-      crnlib::vector<uint> selector_remap[2];
-
-      if (m_has_comp[cColor])
+      if (!reuse_chunks)
       {
-         if (!optimize_color_endpoint_codebook(endpoint_remap[0]))
-            return false;
-         if (!optimize_color_selector_codebook(selector_remap[0]))
+         if (!alias_images())
             return false;
+
+         if (sampled)
+         {
+            if (!init_memory_budget(hvq_params))
+               return false;
+
+            create_sample_chunks();
+         }
+         else
+            create_chunks();
       }
 
-      if (m_has_comp[cAlpha0])
+      if (!quantize_chunks(hvq_params))
+         return false;
+
+      if (sampled)
       {
-         if (!optimize_alpha_endpoint_codebook(endpoint_remap[1]))
-            return false;
-         if (!optimize_alpha_selector_codebook(selector_remap[1]))
+         if (!encode_levels())
             return false;
       }
+      else
+         create_chunk_indices();
 
-      m_chunk_encoding_hist.clear();
-      for (uint i = 0; i < 2; i++)
-      {
-         m_endpoint_index_hist[i].clear();
-         m_endpoint_index_dm[i].clear();
-         m_selector_index_hist[i].clear();
-         m_selector_index_dm[i].clear();
-      }
+      crnlib::vector<uint> endpoint_remap[2];
+      crnlib::vector<uint> selector_remap[2];
+
+      if (!optimize_codebooks(endpoint_remap, selector_remap))
+         return false;
+
+      m_chunk_models.clear();
 
       for (uint pass = 0; pass < 2; pass++)
       {
          for (uint mip_group = 0; mip_group < m_mip_groups.size(); mip_group++)
          {
+            const uint group_dxt_size = m_mip_groups[mip_group].m_num_chunks * cChunkBlockWidth * cChunkBlockHeight * crn_get_bytes_per_dxt_block(static_cast<crn_format>(m_pParams->m_format));
+
+            // The first pass only gathers the histograms, and the second's output is usually well under a quarter of the DXT data.
             symbol_codec codec;
-            codec.start_encoding(2*1024*1024);
+            codec.start_encoding(pass ? math::minimum<uint>(2*1024*1024, group_dxt_size / 4) : 0);
 
             if (!pack_chunks(
                m_mip_groups[mip_group].m_first_chunk, m_mip_groups[mip_group].m_num_chunks,
-               !pass && !mip_group, pass ? &codec : NULL,
+               !pass && !mip_group, false, pass ? &codec : NULL, m_chunk_models,
                m_has_comp[cColor] ? &endpoint_remap[0] : NULL, m_has_comp[cColor] ? &selector_remap[0] : NULL,
-               m_has_comp[cAlpha0] ? &endpoint_remap[1] : NULL, m_has_comp[cAlpha0] ? &selector_remap[1] : NULL))
+               m_has_comp[cAlpha0] ? &endpoint_remap[1] : NULL, m_has_comp[cAlpha0] ? &selector_remap[1] : NULL,
+               m_pParams->m_crn_slice_chunk_rows ? &m_slices[mip_group] : NULL))
             {
                return false;
             }
@@ -2102,15 +2336,15 @@ namespace crnlib
 
          if (!pass)
          {
-            m_chunk_encoding_dm.init(true, m_chunk_encoding_hist, 16);
+            m_chunk_models.m_chunk_encoding_dm.init(true, m_chunk_models.m_chunk_encoding_hist, 16);
 
             for (uint i = 0; i < 2; i++)
             {
-               if (m_endpoint_index_hist[i].size())
-                  m_endpoint_index_dm[i].init(true, m_endpoint_index_hist[i], 16);
+               if (m_chunk_models.m_endpoint_index_hist[i].size())
+                  m_chunk_models.m_endpoint_index_dm[i].init(true, m_chunk_models.m_endpoint_index_hist[i], 16);
 
-               if (m_selector_index_hist[i].size())
-                  m_selector_index_dm[i].init(true, m_selector_index_hist[i], 16);
+               if (m_chunk_models.m_selector_index_hist[i].size())
+                  m_chunk_models.m_selector_index_dm[i].init(true, m_chunk_models.m_selector_index_hist[i], 16);
             }
          }
       }
@@ -2134,13 +2368,33 @@ namespace crnlib
 
    bool crn_comp::compress_init(const crn_comp_params& params)
    {
-      params;
+      clear();
+
+      // The helper threads are created once here and reused by every pass (a bitrate search may run many passes).
+      if (params.m_pThread_pool)
+         m_pTask_pool = static_cast<task_pool*>(params.m_pThread_pool);
+      else
+      {
+         if (!m_task_pool.init(params.m_num_helper_threads))
+            return false;
+         m_pTask_pool = &m_task_pool;
+      }
+
       return true;
    }
 
    bool crn_comp::compress_pass(const crn_comp_params& params, float *pEffective_bitrate)
    {
-      clear();
+      // The passes of a bitrate search only differ in their quality level, so the chunks created by the previous pass
+      // (and the analysis m_hvq keeps of them) can be reused. The source images must not change between passes.
+      crn_comp_params chunk_params(m_chunk_params);
+      chunk_params.m_quality_level = params.m_quality_level;
+
+      const bool reuse_chunks = (m_total_chunks != 0) && (chunk_params == params);
+      if (reuse_chunks)
+         clear_pass();
+      else
+         clear();
 
       if (pEffective_bitrate) *pEffective_bitrate = 0.0f;
 
@@ -2149,12 +2403,15 @@ namespace crnlib
       if ((math::minimum(m_pParams->m_width, m_pParams->m_height) < 1) || (math::maximum(m_pParams->m_width, m_pParams->m_height) > cCRNMaxLevelResolution))
          return false;
 
-      if (!m_task_pool.init(params.m_num_helper_threads))
+      if (!m_pTask_pool)
          return false;
 
-      bool status = compress_internal();
+      bool status = compress_internal(reuse_chunks);
 
-      m_task_pool.deinit();
+      if (status)
+         m_chunk_params = params;
+      else
+         m_total_chunks = 0;
 
       if ((status) && (pEffective_bitrate))
       {
@@ -2172,6 +2429,8 @@ namespace crnlib
 
    void crn_comp::compress_deinit()
    {
+      m_task_pool.deinit();
+      m_pTask_pool = NULL;
    }
 
 } // namespace crnlib
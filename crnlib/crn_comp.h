@@ -35,8 +35,13 @@ namespace crnlib
       uint get_comp_data_size() const { return m_comp_data.size(); }
       const uint8* get_comp_data_ptr() const { return m_comp_data.size() ? &m_comp_data[0] : NULL; }
 
+      // Orders packed endpoints so each one is followed by its closest remaining neighbor.
+      static void sort_color_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints, crn_format fmt = cCRNFmtDXT1);
+      static void sort_alpha_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints);
+
    private:
       task_pool                  m_task_pool;
+      task_pool*                 m_pTask_pool;
       const crn_comp_params* m_pParams;
 
       image_u8 m_images[cCRNMaxFaces][cCRNMaxLevels];
@@ -49,6 +54,10 @@ namespace crnlib
          uint m_num_chunks;
          uint m_first_chunk;
          uint m_group_first_chunk;
+
+         // The level's chunks in m_chunks when they're sampled (see create_sample_chunks()).
+         uint m_first_sample_chunk;
+         uint m_num_sample_chunks;
       } m_levels[cCRNMaxLevels];
 
       struct mip_group
@@ -76,6 +85,10 @@ namespace crnlib
 
          uint m_first_endpoint_index;
          uint m_first_selector_index;
+
+         // Copied from the chunk's encoding, so the packing passes don't need m_hvq's encodings of every chunk.
+         uint8 m_encoding_index;
+         uint8 m_num_tiles;
       };
       typedef crnlib::vector<chunk_detail> chunk_detail_vec;
       chunk_detail_vec              m_chunk_details;
@@ -86,21 +99,47 @@ namespace crnlib
       uint                          m_total_chunks;
       dxt_hc::pixel_chunk_vec       m_chunks;
 
+      // The conversion create_chunk() applies, if the images weren't converted up front.
+      image_utils::conversion_type  m_chunk_conv_type;
+
+      // With a memory limit, the number of chunks sampled for the codebooks, and the most chunks encode_levels() encodes at once.
+      uint                          m_max_sample_chunks;
+      uint                          m_max_batch_chunks;
+
+      // The params m_chunks was created from. Passes that only change the quality level reuse the chunks.
+      crn_comp_params               m_chunk_params;
+
       crnd::crn_header              m_crn_header;
       crnlib::vector<uint8>         m_comp_data;
 
       dxt_hc                        m_hvq;
 
-      symbol_histogram              m_chunk_encoding_hist;
-      static_huffman_data_model     m_chunk_encoding_dm;
+      struct chunk_models
+      {
+         symbol_histogram              m_chunk_encoding_hist;
+         static_huffman_data_model     m_chunk_encoding_dm;
 
-      symbol_histogram              m_endpoint_index_hist[2];
-      static_huffman_data_model     m_endpoint_index_dm[2]; // color, alpha
+         symbol_histogram              m_endpoint_index_hist[2];
+         static_huffman_data_model     m_endpoint_index_dm[2]; // color, alpha
 
-      symbol_histogram              m_selector_index_hist[2];
-      static_huffman_data_model     m_selector_index_dm[2]; // color, alpha
+         symbol_histogram              m_selector_index_hist[2];
+         static_huffman_data_model     m_selector_index_dm[2]; // color, alpha
+
+         void clear();
+      };
+      chunk_models                  m_chunk_models;
+
+      enum codebook_type
+      {
+         cColorEndpointCodebook,
+         cColorSelectorCodebook,
+         cAlphaEndpointCodebook,
+         cAlphaSelectorCodebook,
+         cNumCodebooks
+      };
 
       crnlib::vector<uint8>         m_packed_chunks[cCRNMaxLevels];
+      crnlib::vector<crnd::crn_slice> m_slices[cCRNMaxLevels];
       crnlib::vector<uint8>         m_packed_data_models;
       crnlib::vector<uint8>         m_packed_color_endpoints;
       crnlib::vector<uint8>         m_packed_color_selectors;
@@ -108,13 +147,15 @@ namespace crnlib
       crnlib::vector<uint8>         m_packed_alpha_selectors;
 
       void clear();
+      void clear_pass();
 
+      void create_chunk(const image_u8& img, uint x, uint y, float weight, dxt_hc::pixel_chunk& chunk) const;
       void append_chunks(const image_u8& img, uint num_chunks_x, uint num_chunks_y, dxt_hc::pixel_chunk_vec& chunks, float weight);
+      void append_level_chunks(uint level, uint first_chunk, uint num_chunks, dxt_hc::pixel_chunk_vec& chunks);
+      static float get_mip_weight(uint level);
 
       static float color_endpoint_similarity_func(uint index_a, uint index_b, void* pContext);
       static float alpha_endpoint_similarity_func(uint index_a, uint index_b, void* pContext);
-      void sort_color_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints);
-      void sort_alpha_endpoint_codebook(crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoints);
 
       bool pack_color_endpoints(crnlib::vector<uint8>& data, const crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoint_indices, uint trial_index);
       bool pack_alpha_endpoints(crnlib::vector<uint8>& data, const crnlib::vector<uint>& remapping, const crnlib::vector<uint>& endpoint_indices, uint trial_index);
@@ -134,37 +175,33 @@ namespace crnlib
 
       bool alias_images();
       void create_chunks();
-      bool quantize_chunks();
+      uint64 get_fixed_memory_size() const;
+      bool init_memory_budget(const dxt_hc::params& params);
+      void create_sample_chunks();
+      bool init_hvq_params(dxt_hc::params& params);
+      bool quantize_chunks(dxt_hc::params& params);
       void create_chunk_indices();
+      void append_chunk_indices(uint chunk_index, const dxt_hc::chunk_encoding& chunk_encoding);
+      bool encode_levels();
 
       bool pack_chunks(
          uint first_chunk, uint num_chunks,
          bool clear_histograms,
+         bool continue_stream,
          symbol_codec* pCodec,
+         chunk_models& models,
          const crnlib::vector<uint>* pColor_endpoint_remap,
          const crnlib::vector<uint>* pColor_selector_remap,
          const crnlib::vector<uint>* pAlpha_endpoint_remap,
-         const crnlib::vector<uint>* pAlpha_selector_remap);
-
-      bool pack_chunks_simulation(
-         uint first_chunk, uint num_chunks,
-         uint& total_bits,
-         const crnlib::vector<uint>* pColor_endpoint_remap,
-         const crnlib::vector<uint>* pColor_selector_remap,
-         const crnlib::vector<uint>* pAlpha_endpoint_remap,
-         const crnlib::vector<uint>* pAlpha_selector_remap);
-
-      void optimize_color_endpoint_codebook_task(uint64 data, void* pData_ptr);
-      bool optimize_color_endpoint_codebook(crnlib::vector<uint>& remapping);
-
-      void optimize_color_selector_codebook_task(uint64 data, void* pData_ptr);
-      bool optimize_color_selector_codebook(crnlib::vector<uint>& remapping);
+         const crnlib::vector<uint>* pAlpha_selector_remap,
+         crnlib::vector<crnd::crn_slice>* pSlices = NULL);
 
-      void optimize_alpha_endpoint_codebook_task(uint64 data, void* pData_ptr);
-      bool optimize_alpha_endpoint_codebook(crnlib::vector<uint>& remapping);
+      bool pack_chunks_simulation(chunk_models& models, uint& total_bits);
 
-      void optimize_alpha_selector_codebook_task(uint64 data, void* pData_ptr);
-      bool optimize_alpha_selector_codebook(crnlib::vector<uint>& remapping);
+      struct codebook_trial;
+      void optimize_codebook_task(uint64 data, void* pData_ptr);
+      void simulate_chunks_task(uint64 data, void* pData_ptr);
+      bool optimize_codebooks(crnlib::vector<uint> endpoint_remap[2], crnlib::vector<uint> selector_remap[2]);
 
       bool create_comp_data();
 
@@ -172,7 +209,7 @@ namespace crnlib
 
       bool update_progress(uint phase_index, uint subphase_index, uint subphase_total);
 
-      bool compress_internal();
+      bool compress_internal(bool reuse_chunks);
 
       static void append_vec(crnlib::vector<uint8>& a, const void* p, uint size);
       static void append_vec(crnlib::vector<uint8>& a, const crnlib::vector<uint8>& b);
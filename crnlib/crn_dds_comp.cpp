@@ -137,7 +137,7 @@ namespace crnlib
 
          if (!m_pQDXT_state)
          {
-            m_pQDXT_state = crnlib_new<mipmapped_texture::qdxt_state>(m_task_pool);
+            m_pQDXT_state = crnlib_new<mipmapped_texture::qdxt_state>(*m_pack_params.m_pTask_pool);
                         
             if (params.m_pProgress_func)
             {
@@ -202,9 +202,14 @@ namespace crnlib
       if ((m_pixel_fmt == PIXEL_FMT_DXT1) && (m_src_tex.has_alpha()) && (m_pack_params.m_use_both_block_types) && (m_pParams->m_flags & cCRNCompFlagDXT1AForTransparency))
          m_pixel_fmt = PIXEL_FMT_DXT1A;
       
-      if (!m_task_pool.init(m_pParams->m_num_helper_threads))
-         return false;
-      m_pack_params.m_pTask_pool = &m_task_pool;
+      if (params.m_pThread_pool)
+         m_pack_params.m_pTask_pool = static_cast<task_pool*>(params.m_pThread_pool);
+      else
+      {
+         if (!m_task_pool.init(m_pParams->m_num_helper_threads))
+            return false;
+         m_pack_params.m_pTask_pool = &m_task_pool;
+      }
 
       const bool hierarchical = (params.m_flags & cCRNCompFlagHierarchical) != 0;
       m_q1_params.init(m_pack_params, params.m_quality_level, hierarchical);
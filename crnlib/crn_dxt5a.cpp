@@ -21,7 +21,7 @@ namespace crnlib
       m_pParams = &p;
       m_pResults = &r;
 
-      if ((!p.m_num_pixels) || (!p.m_pPixels))
+      if ((!p.m_num_pixels) || ((!p.m_pPixels) && (!p.m_pValues)))
          return false;
 
       m_unique_values.resize(0);
@@ -32,7 +32,7 @@ namespace crnlib
 
       for (uint i = 0; i < p.m_num_pixels; i++)
       {
-         uint alpha = p.m_pPixels[i][p.m_comp_index];
+         uint alpha = p.m_pValues ? p.m_pValues[i] : p.m_pPixels[i][p.m_comp_index];
 
          int index = m_unique_value_map[alpha];
 
@@ -140,7 +140,7 @@ namespace crnlib
 
       for (uint i = 0; i < m_pParams->m_num_pixels; i++)
       {
-         uint alpha = m_pParams->m_pPixels[i][m_pParams->m_comp_index];
+         uint alpha = m_pParams->m_pValues ? m_pParams->m_pValues[i] : m_pParams->m_pPixels[i][m_pParams->m_comp_index];
 
          int index = m_unique_value_map[alpha];
 
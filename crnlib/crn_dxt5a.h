@@ -15,6 +15,7 @@ namespace crnlib
          params() :
             m_block_index(0),
             m_pPixels(NULL),
+            m_pValues(NULL),
             m_num_pixels(0),
             m_comp_index(3),
             m_quality(cCRNDXTQualityUber),
@@ -25,6 +26,8 @@ namespace crnlib
          uint                 m_block_index;
 
          const color_quad_u8* m_pPixels;
+         // If not NULL, the component values to use instead of m_pPixels, such as a plane of a planar chunk.
+         const uint8*         m_pValues;
          uint                 m_num_pixels;
          uint                 m_comp_index;
 
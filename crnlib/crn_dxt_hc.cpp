@@ -9,6 +9,15 @@
 #define CRNLIB_USE_FAST_DXT 1
 #define CRNLIB_ENABLE_DEBUG_MESSAGES 0
 
+// compute_tile_sse() uses SSE2, or AVX2 when the compiler targets it. Define CRNLIB_NO_SIMD to always use the scalar code.
+#if !defined(CRNLIB_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define CRNLIB_TILE_SSE_SIMD 1
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#endif
+
 namespace crnlib
 {
    static color_quad_u8 g_tile_layout_colors[cNumChunkTileLayouts] =
@@ -26,6 +35,182 @@ namespace crnlib
       color_quad_u8(255,0,255,255)
    };
 
+   // Optimizes a single ETC1 base color and intensity table for a set of pixels (the pixels of a tile or of an endpoint cluster).
+   // The returned selectors are raw ETC1 selector values, like the raw DXT1 selectors the color tiles hold otherwise.
+   static uint64 optimize_etc1_endpoints(
+      const color_quad_u8* pPixels, uint num_pixels, crn_etc_quality quality,
+      uint& packed_color5, uint& inten_table, uint8* pSelectors)
+   {
+      etc1_optimizer::params params;
+      params.m_quality = quality;
+      params.m_num_src_pixels = num_pixels;
+      params.m_pSrc_pixels = pPixels;
+
+      if (quality >= cCRNETCQualityMedium)
+      {
+         static const int s_scan_delta_0_to_1[] = { -1, 0, 1 };
+         params.m_scan_delta_size = CRNLIB_ARRAY_SIZE(s_scan_delta_0_to_1);
+         params.m_pScan_deltas = s_scan_delta_0_to_1;
+      }
+
+      etc1_optimizer::results results;
+      results.m_n = num_pixels;
+      results.m_pSelectors = pSelectors;
+
+      etc1_optimizer optimizer;
+      optimizer.init(params, results);
+      const bool success = optimizer.compute();
+      CRNLIB_ASSERT(success);
+      success;
+
+      packed_color5 = etc1_block::pack_color5(results.m_block_color_unscaled, false);
+      inten_table = results.m_block_inten_table;
+
+      for (uint i = 0; i < num_pixels; i++)
+         pSelectors[i] = g_selector_index_to_etc1[pSelectors[i]];
+
+      return results.m_error;
+   }
+
+   // Returns the block colors of an ETC1 tile, indexed by raw ETC1 selector values.
+   static void get_etc1_block_colors(color_quad_u8* pColors, uint packed_color5, uint inten_table)
+   {
+      color_quad_u8 colors[cETC1SelectorValues];
+      etc1_block::get_diff_subblock_colors(colors, static_cast<uint16>(packed_color5), inten_table);
+
+      for (uint i = 0; i < cETC1SelectorValues; i++)
+         pColors[i] = colors[g_etc1_to_selector_index[i]];
+   }
+
+   // Returns the sum of squared differences between a tile of an 8x8 chunk and the tile's decoded texels, over the channels set in
+   // channel_mask. The decoded texels are looked up from pSelectors (the tile's selectors, row by row) and pColors, so the tile
+   // never has to be unpacked.
+   static uint compute_tile_sse(const color_quad_u8* pChunk_pixels, const chunk_tile_desc& tile, const uint8* pSelectors, const color_quad_u8* pColors, const color_quad_u8& channel_mask)
+   {
+      // Tiles are always visited as runs of 4 texels, one row of a 4x4 block each.
+      const uint runs_per_row = tile.m_width >> cBlockPixelWidthShift;
+      const uint num_runs = runs_per_row * tile.m_height;
+
+#if CRNLIB_TILE_SSE_SIMD
+      const __m128i zero = _mm_setzero_si128();
+      __m128i sum;
+      uint r = 0;
+
+#ifdef __AVX2__
+      // A tile always holds an even number of runs, so AVX2 handles two of them at a time.
+      const __m256i mask256 = _mm256_set1_epi32(static_cast<int>(channel_mask.m_u32));
+      __m256i sum256 = _mm256_setzero_si256();
+
+      for ( ; r < num_runs; r += 2)
+      {
+         const color_quad_u8* pRun0 = pChunk_pixels + tile.m_x_ofs + ((r % runs_per_row) << cBlockPixelWidthShift) + (tile.m_y_ofs + r / runs_per_row) * cChunkPixelWidth;
+         const color_quad_u8* pRun1 = pChunk_pixels + tile.m_x_ofs + (((r + 1) % runs_per_row) << cBlockPixelWidthShift) + (tile.m_y_ofs + (r + 1) / runs_per_row) * cChunkPixelWidth;
+         const uint8* pS = pSelectors + (r << 2);
+
+         const __m256i orig = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRun0))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRun1)), 1);
+         const __m256i decoded = _mm256_setr_epi32(
+            static_cast<int>(pColors[pS[0]].m_u32), static_cast<int>(pColors[pS[1]].m_u32), static_cast<int>(pColors[pS[2]].m_u32), static_cast<int>(pColors[pS[3]].m_u32),
+            static_cast<int>(pColors[pS[4]].m_u32), static_cast<int>(pColors[pS[5]].m_u32), static_cast<int>(pColors[pS[6]].m_u32), static_cast<int>(pColors[pS[7]].m_u32));
+
+         const __m256i delta = _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(orig, decoded), _mm256_subs_epu8(decoded, orig)), mask256);
+         const __m256i lo = _mm256_unpacklo_epi8(delta, _mm256_setzero_si256());
+         const __m256i hi = _mm256_unpackhi_epi8(delta, _mm256_setzero_si256());
+
+         sum256 = _mm256_add_epi32(sum256, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+      }
+
+      sum = _mm_add_epi32(_mm256_castsi256_si128(sum256), _mm256_extracti128_si256(sum256, 1));
+#else
+      const __m128i mask = _mm_set1_epi32(static_cast<int>(channel_mask.m_u32));
+      sum = zero;
+
+      for ( ; r < num_runs; r++)
+      {
+         const color_quad_u8* pRun = pChunk_pixels + tile.m_x_ofs + ((r % runs_per_row) << cBlockPixelWidthShift) + (tile.m_y_ofs + r / runs_per_row) * cChunkPixelWidth;
+         const uint8* pS = pSelectors + (r << 2);
+
+         const __m128i orig = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRun));
+         const __m128i decoded = _mm_setr_epi32(
+            static_cast<int>(pColors[pS[0]].m_u32), static_cast<int>(pColors[pS[1]].m_u32), static_cast<int>(pColors[pS[2]].m_u32), static_cast<int>(pColors[pS[3]].m_u32));
+
+         // |orig - decoded| per byte, then squared and summed in pairs of 16-bit lanes.
+         const __m128i delta = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(orig, decoded), _mm_subs_epu8(decoded, orig)), mask);
+         const __m128i lo = _mm_unpacklo_epi8(delta, zero);
+         const __m128i hi = _mm_unpackhi_epi8(delta, zero);
+
+         sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+      }
+#endif
+
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+      return static_cast<uint>(_mm_cvtsi128_si32(sum));
+#else
+      uint sse = 0;
+
+      for (uint r = 0; r < num_runs; r++)
+      {
+         const color_quad_u8* pRun = pChunk_pixels + tile.m_x_ofs + ((r % runs_per_row) << cBlockPixelWidthShift) + (tile.m_y_ofs + r / runs_per_row) * cChunkPixelWidth;
+         const uint8* pS = pSelectors + (r << 2);
+
+         for (uint i = 0; i < 4; i++)
+         {
+            const color_quad_u8& orig = pRun[i];
+            const color_quad_u8& decoded = pColors[pS[i]];
+
+            for (uint c = 0; c < 4; c++)
+            {
+               if (channel_mask[c])
+               {
+                  const int delta = orig[c] - decoded[c];
+                  sse += delta * delta;
+               }
+            }
+         }
+      }
+
+      return sse;
+#endif
+   }
+
+   // The PSNR image_utils::error_metrics::compute() returns for num_values values with a total squared error of sse.
+   static double compute_psnr(uint sse, uint num_values)
+   {
+      const double mean_squared = math::clamp<double>(sse / static_cast<double>(num_values), 0.0f, 255.0f*255.0f);
+      const double root_mean_squared = sqrt(mean_squared);
+
+      if (!root_mean_squared)
+         return 999999.0f;
+
+      return math::clamp<double>(log10(255.0f / root_mean_squared) * 20.0f, 0.0f, 500.0f);
+   }
+
+   void dxt_hc::pixel_chunk::get_pixels(uint x_ofs, uint y_ofs, uint width, uint height, color_quad_u8* pPixels) const
+   {
+      CRNLIB_ASSERT((x_ofs + width <= cChunkPixelWidth) && (y_ofs + height <= cChunkPixelHeight));
+
+      for (uint y = 0; y < height; y++)
+      {
+         const uint ofs = x_ofs + (y_ofs + y) * cChunkPixelWidth;
+         const uint8* pR = m_planes[0] + ofs;
+         const uint8* pG = m_planes[1] + ofs;
+         const uint8* pB = m_planes[2] + ofs;
+         const uint8* pA = m_planes[3] + ofs;
+
+         for (uint x = 0; x < width; x++, pPixels++)
+            pPixels->set_noclamp_rgba(pR[x], pG[x], pB[x], pA[x]);
+      }
+   }
+
+   void dxt_hc::pixel_chunk::get_component_values(uint x_ofs, uint y_ofs, uint width, uint height, uint comp_index, uint8* pValues) const
+   {
+      CRNLIB_ASSERT((x_ofs + width <= cChunkPixelWidth) && (y_ofs + height <= cChunkPixelHeight) && (comp_index < 4));
+
+      for (uint y = 0; y < height; y++, pValues += width)
+         memcpy(pValues, m_planes[comp_index] + x_ofs + (y_ofs + y) * cChunkPixelWidth, width);
+   }
+
    dxt_hc::dxt_hc() :
       m_num_chunks(0),
       m_pChunks(NULL),
@@ -37,7 +222,10 @@ namespace crnlib
       m_canceled(false),
       m_pTask_pool(NULL),
       m_prev_phase_index(-1),
-      m_prev_percentage_complete(-1)
+      m_prev_percentage_complete(-1),
+      m_analysis_valid(false),
+      m_color_endpoint_vq_size(0),
+      m_alpha_endpoint_vq_size(0)
    {
       utils::zero_object(m_encoding_hist);
    }
@@ -51,16 +239,11 @@ namespace crnlib
       m_num_chunks = 0;
       m_pChunks = NULL;
 
-      m_chunk_encoding.clear();
-
       m_num_alpha_blocks = 0;
       m_has_color_blocks = false;
       m_has_alpha0_blocks = false;
       m_has_alpha1_blocks = false;
 
-      m_color_selectors.clear();
-
-      m_alpha_selectors.clear();
       for (uint i = 0; i < cNumCompressedChunkVecs; i++)
          m_compressed_chunks[i].clear();
 
@@ -68,16 +251,15 @@ namespace crnlib
 
       m_total_tiles = 0;
 
-      m_color_clusters.clear();
-      m_alpha_clusters.clear();
-      m_color_selectors.clear();
-      m_alpha_selectors.clear();
+      m_chunk_levels.clear();
+      m_chunks_per_batch = 0;
+      m_next_chunk_batch = 0;
 
-      m_chunk_blocks_using_color_selectors.clear();
-      m_chunk_blocks_using_alpha_selectors.clear();
+      m_analysis_valid = false;
 
-      m_color_endpoints.clear();
-      m_alpha_endpoints.clear();
+      clear_endpoint_trees();
+
+      clear_codebooks();
 
       m_dbg_chunk_pixels.clear();
       m_dbg_chunk_pixels_tile_vis.clear();
@@ -94,6 +276,22 @@ namespace crnlib
       m_dbg_chunk_pixels_final_alpha_selectors.clear();
 
       m_dbg_chunk_pixels_final.clear();
+   }
+
+   void dxt_hc::clear_codebooks()
+   {
+      m_chunk_encoding.clear();
+
+      m_color_clusters.clear();
+      m_alpha_clusters.clear();
+      m_color_selectors.clear();
+      m_alpha_selectors.clear();
+
+      m_chunk_blocks_using_color_selectors.clear();
+      m_chunk_blocks_using_alpha_selectors.clear();
+
+      m_color_endpoints.clear();
+      m_alpha_endpoints.clear();
 
       m_canceled = false;
 
@@ -101,6 +299,90 @@ namespace crnlib
       m_prev_percentage_complete = -1;
    }
 
+   void dxt_hc::clear_endpoint_trees()
+   {
+      m_color_training_vecs.clear();
+      m_color_endpoint_vq.clear();
+      m_color_endpoint_vq_size = 0;
+
+      for (uint a = 0; a < 2; a++)
+         m_alpha_training_vecs[a].clear();
+      m_alpha_endpoint_vq.clear();
+      m_alpha_endpoint_vq_size = 0;
+
+      m_color_cluster_results.clear();
+      m_alpha_cluster_results.clear();
+   }
+
+   void dxt_hc::prepare_endpoint_cluster_results(endpoint_cluster_result_vec& results, uint num_nodes)
+   {
+      if ((!m_params.m_reuse_analysis) || (m_params.m_debugging))
+      {
+         results.clear();
+         return;
+      }
+
+      // A rebuilt tree has the same nodes as the previous one up to its old size, and a cached result is only used
+      // if its tiles match anyway.
+      results.resize(num_nodes);
+   }
+
+   void dxt_hc::prune_endpoint_cluster_results(endpoint_cluster_result_vec& results, const crnlib::vector<uint>& cluster_nodes)
+   {
+      if (results.empty())
+         return;
+
+      // Only keep the results of the current clusters, so the cache never holds more than one pass worth of selectors.
+      crnlib::vector<bool> used_nodes(results.size());
+      for (uint i = 0; i < cluster_nodes.size(); i++)
+         used_nodes[cluster_nodes[i]] = true;
+
+      for (uint i = 0; i < results.size(); i++)
+      {
+         if (!used_nodes[i])
+            results[i].clear();
+      }
+   }
+
+   static bool is_same_analysis(const dxt_hc::params& a, const dxt_hc::params& b)
+   {
+      if ((a.m_adaptive_tile_color_psnr_derating != b.m_adaptive_tile_color_psnr_derating) ||
+          (a.m_adaptive_tile_alpha_psnr_derating != b.m_adaptive_tile_alpha_psnr_derating) ||
+          (a.m_adaptive_tile_color_alpha_weighting_ratio != b.m_adaptive_tile_color_alpha_weighting_ratio) ||
+          (a.m_alpha_component_indices[0] != b.m_alpha_component_indices[0]) ||
+          (a.m_alpha_component_indices[1] != b.m_alpha_component_indices[1]) ||
+          (a.m_num_levels != b.m_num_levels) ||
+          (a.m_format != b.m_format) ||
+          (a.m_dxt_quality != b.m_dxt_quality) ||
+          (a.m_hierarchical != b.m_hierarchical) ||
+          (a.m_perceptual != b.m_perceptual) ||
+          (a.m_max_endpoint_codebook_size != b.m_max_endpoint_codebook_size))
+      {
+         return false;
+      }
+
+      for (uint i = 0; i < a.m_num_levels; i++)
+      {
+         if ((a.m_levels[i].m_first_chunk != b.m_levels[i].m_first_chunk) || (a.m_levels[i].m_num_chunks != b.m_levels[i].m_num_chunks))
+            return false;
+      }
+
+      return true;
+   }
+
+   // Cuts the endpoint codebook from the cluster tree, (re)building the tree first if it's smaller than requested.
+   template<typename VectorType>
+   static void generate_endpoint_codebook(tree_clusterizer<VectorType>& vq, uint& vq_size, uint codebook_size, uint max_codebook_size, task_pool* pTask_pool)
+   {
+      if ((!vq_size) || (codebook_size > vq_size))
+      {
+         vq_size = math::maximum(codebook_size, max_codebook_size);
+         vq.generate_codebook(vq_size, pTask_pool);
+      }
+
+      vq.set_codebook_size(codebook_size);
+   }
+
    bool dxt_hc::compress(const params& p, uint num_chunks, const pixel_chunk* pChunks, task_pool& task_pool)
    {
       m_pTask_pool = &task_pool;
@@ -120,6 +402,23 @@ namespace crnlib
       if ((m_params.m_format == cDXT1A) || (m_params.m_format == cDXT3))
          return false;
 
+      const bool reuse_analysis = p.m_reuse_analysis && !p.m_debugging && m_analysis_valid &&
+         (num_chunks == m_num_chunks) && (pChunks == m_pChunks) && is_same_analysis(p, m_params);
+
+      if (reuse_analysis)
+      {
+         m_params = p;
+         m_analysis_valid = false;
+
+         clear_codebooks();
+
+         if (!compress_codebooks())
+            return false;
+
+         m_analysis_valid = true;
+         return true;
+      }
+
       clear();
 
       m_params = p;
@@ -155,14 +454,43 @@ namespace crnlib
             m_num_alpha_blocks = 2;
             break;
          }
+         case cETC1:
+         {
+            m_has_color_blocks = true;
+            break;
+         }
          default:
          {
             return false;
          }
       }
 
+      m_chunk_levels.resize(m_num_chunks);
+      m_chunk_levels.set_all(0);
+
+      for (uint i = 0; i < m_params.m_num_levels; i++)
+      {
+         const uint end_chunk = math::minimum(m_params.m_levels[i].m_first_chunk + m_params.m_levels[i].m_num_chunks, m_num_chunks);
+         for (uint chunk_index = m_params.m_levels[i].m_first_chunk; chunk_index < end_chunk; chunk_index++)
+            m_chunk_levels[chunk_index] = static_cast<uint8>(i);
+      }
+
       determine_compressed_chunks();
 
+      if (!compress_codebooks())
+         return false;
+
+      // The endpoint trees are also kept for encode_chunks() when debugging, the analysis just isn't reused then.
+      if (m_params.m_reuse_analysis)
+         m_analysis_valid = !m_params.m_debugging;
+      else
+         clear_endpoint_trees();
+
+      return true;
+   }
+
+   bool dxt_hc::compress_codebooks()
+   {
       if (m_has_color_blocks)
       {
          if (!determine_color_endpoint_clusters())
@@ -263,30 +591,18 @@ namespace crnlib
 
    void dxt_hc::compress_dxt5_block(
       dxt5_endpoint_optimizer::results& results,
-      uint chunk_index, const image_u8& chunk, uint x_ofs, uint y_ofs, uint width, uint height, uint component_index,
+      uint chunk_index, const pixel_chunk& chunk, uint x_ofs, uint y_ofs, uint width, uint height, uint component_index,
       uint8* pAlpha_selectors)
    {
       chunk_index;
 
-      color_quad_u8 pixels[cChunkPixelWidth * cChunkPixelHeight];
-
-      for (uint y = 0; y < height; y++)
-         for (uint x = 0; x < width; x++)
-            pixels[x + y * width] = chunk(x_ofs + x, y_ofs + y);
+      uint8 values[cChunkPixelWidth * cChunkPixelHeight];
+      chunk.get_component_values(x_ofs, y_ofs, width, height, component_index, values);
 
-#if 0 //CRNLIB_USE_FAST_DXT
-      uint low, high;
-      dxt_fast::compress_alpha_block(width * height, pixels, low, high, pAlpha_selectors, component_index);
-      results.m_pSelectors = pAlpha_selectors;
-      results.m_error = INT_MAX;
-      results.m_first_endpoint = static_cast<uint8>(low);
-      results.m_second_endpoint = static_cast<uint8>(high);
-      results.m_block_type = 0;
-#else
       dxt5_endpoint_optimizer optimizer;
       dxt5_endpoint_optimizer::params params;
       params.m_block_index = chunk_index;
-      params.m_pPixels = pixels;
+      params.m_pValues = values;
       params.m_num_pixels = width * height;
       params.m_comp_index = component_index;
       params.m_use_both_block_types = false;
@@ -295,71 +611,87 @@ namespace crnlib
       results.m_pSelectors = pAlpha_selectors;
 
       optimizer.compute(params, results);
-#endif
+   }
+
+   void dxt_hc::compress_etc1_block(
+      uint& packed_color5, uint& inten_table,
+      const image_u8& chunk, uint x_ofs, uint y_ofs, uint width, uint height,
+      uint8* pColor_selectors)
+   {
+      color_quad_u8 pixels[cChunkPixelWidth * cChunkPixelHeight];
+
+      for (uint y = 0; y < height; y++)
+         for (uint x = 0; x < width; x++)
+            pixels[x + y * width] = chunk(x_ofs + x, y_ofs + y);
+
+      crn_etc_quality etc_quality = cCRNETCQualitySlow;
+      if (m_params.m_dxt_quality <= cCRNDXTQualityFast)
+         etc_quality = cCRNETCQualityFast;
+      else if (m_params.m_dxt_quality <= cCRNDXTQualityNormal)
+         etc_quality = cCRNETCQualityMedium;
+
+      optimize_etc1_endpoints(pixels, width * height, etc_quality, packed_color5, inten_table, pColor_selectors);
    }
 
    void dxt_hc::determine_compressed_chunks_task(uint64 data, void* pData_ptr)
    {
-      pData_ptr;
-      const uint thread_index = static_cast<uint>(data);
+      data, pData_ptr;
 
       image_u8 orig_chunk;
-      image_u8 decomp_chunk[cNumChunkEncodings];
-
       orig_chunk.resize(cChunkPixelWidth, cChunkPixelHeight);
-      for (uint i = 0; i < cNumChunkEncodings; i++)
-         decomp_chunk[i].resize(cChunkPixelWidth, cChunkPixelHeight);
+      CRNLIB_ASSERT(orig_chunk.get_pitch() == cChunkPixelWidth);
 
-      image_utils::error_metrics color_error_metrics[cNumChunkEncodings];
       dxt1_endpoint_optimizer::results color_optimizer_results[cNumChunkTileLayouts];
+      uint layout_etc1_endpoints[cNumChunkTileLayouts][2];
       uint8 layout_color_selectors[cNumChunkTileLayouts][cChunkPixelWidth * cChunkPixelHeight];
+      uint layout_color_sse[cNumChunkTileLayouts];
 
-      image_utils::error_metrics alpha_error_metrics[2][cNumChunkEncodings];
       dxt5_endpoint_optimizer::results alpha_optimizer_results[2][cNumChunkTileLayouts];
       uint8 layout_alpha_selectors[2][cNumChunkTileLayouts][cChunkPixelWidth * cChunkPixelHeight];
+      uint layout_alpha_sse[2][cNumChunkTileLayouts];
+
+      const color_quad_u8 color_channel_mask(255, 255, 255, 0);
+      color_quad_u8 alpha_channel_mask[2];
+      for (uint a = 0; a < 2; a++)
+      {
+         alpha_channel_mask[a].clear();
+         alpha_channel_mask[a][m_params.m_alpha_component_indices[a]] = 255;
+      }
 
       uint first_layout = 0;
       uint last_layout = cNumChunkTileLayouts;
 
-      uint first_encoding = 0;
-      uint last_encoding = cNumChunkEncodings;
-
       if (!m_params.m_hierarchical)
-      {
          first_layout = cFirst4x4ChunkTileLayout;
-         first_encoding = cNumChunkEncodings - 1;
-      }
 
-      for (uint chunk_index = 0; chunk_index < m_num_chunks; chunk_index++)
+      uint end_chunk = 0;
+
+      for (uint chunk_index = 0; ; chunk_index++)
       {
          if (m_canceled)
             return;
 
-         if ((crn_get_current_thread_id() == m_main_thread_id) && ((chunk_index & 511) == 0))
+         if (chunk_index == end_chunk)
          {
-            if (!update_progress(0, chunk_index, m_num_chunks))
-               return;
-         }
+            const uint first_chunk = static_cast<uint>(atomic_increment32(&m_next_chunk_batch) - 1) * m_chunks_per_batch;
+            if (first_chunk >= m_num_chunks)
+               break;
 
-         if (m_pTask_pool->get_num_threads())
-         {
-            if ((chunk_index % (m_pTask_pool->get_num_threads() + 1)) != thread_index)
-               continue;
-         }
+            chunk_index = first_chunk;
+            end_chunk = math::minimum(first_chunk + m_chunks_per_batch, m_num_chunks);
 
-         uint level_index = 0;
-         for (uint i = 0; i < m_params.m_num_levels; i++)
-         {
-            if ((chunk_index >= m_params.m_levels[i].m_first_chunk) && (chunk_index < m_params.m_levels[i].m_first_chunk + m_params.m_levels[i].m_num_chunks))
+            if (crn_get_current_thread_id() == m_main_thread_id)
             {
-               level_index = i;
-               break;
+               if (!update_progress(0, first_chunk, m_num_chunks))
+                  return;
             }
          }
 
-         for (uint cy = 0; cy < cChunkPixelHeight; cy++)
-            for (uint cx = 0; cx < cChunkPixelWidth; cx++)
-               orig_chunk(cx, cy) = m_pChunks[chunk_index](cx, cy);
+         const uint level_index = m_chunk_levels[chunk_index];
+
+         const pixel_chunk& chunk = m_pChunks[chunk_index];
+
+         chunk.get_pixels(0, 0, cChunkPixelWidth, cChunkPixelHeight, orig_chunk.get_ptr());
 
          if (m_has_color_blocks)
          {
@@ -367,12 +699,39 @@ namespace crnlib
             {
                utils::zero_object(layout_color_selectors[l]);
 
-               compress_dxt1_block(
-                  color_optimizer_results[l], chunk_index,
-                  orig_chunk,
-                  g_chunk_tile_layouts[l].m_x_ofs, g_chunk_tile_layouts[l].m_y_ofs,
-                  g_chunk_tile_layouts[l].m_width, g_chunk_tile_layouts[l].m_height,
-                  layout_color_selectors[l]);
+               if (m_params.m_format == cETC1)
+               {
+                  compress_etc1_block(
+                     layout_etc1_endpoints[l][0], layout_etc1_endpoints[l][1],
+                     orig_chunk,
+                     g_chunk_tile_layouts[l].m_x_ofs, g_chunk_tile_layouts[l].m_y_ofs,
+                     g_chunk_tile_layouts[l].m_width, g_chunk_tile_layouts[l].m_height,
+                     layout_color_selectors[l]);
+               }
+               else
+               {
+                  compress_dxt1_block(
+                     color_optimizer_results[l], chunk_index,
+                     orig_chunk,
+                     g_chunk_tile_layouts[l].m_x_ofs, g_chunk_tile_layouts[l].m_y_ofs,
+                     g_chunk_tile_layouts[l].m_width, g_chunk_tile_layouts[l].m_height,
+                     layout_color_selectors[l]);
+               }
+
+               if (m_params.m_hierarchical)
+               {
+                  color_quad_u8 block_colors[cDXT1SelectorValues];
+                  if (m_params.m_format == cETC1)
+                     get_etc1_block_colors(block_colors, layout_etc1_endpoints[l][0], layout_etc1_endpoints[l][1]);
+                  else
+                  {
+                     CRNLIB_ASSERT(color_optimizer_results[l].m_low_color >= color_optimizer_results[l].m_high_color);
+                     // it's okay if color_results.m_low_color == color_results.m_high_color, because in this case only selector 0 should be used
+                     dxt1_block::get_block_colors4(block_colors, color_optimizer_results[l].m_low_color, color_optimizer_results[l].m_high_color);
+                  }
+
+                  layout_color_sse[l] = compute_tile_sse(orig_chunk.get_ptr(), g_chunk_tile_layouts[l], layout_color_selectors[l], block_colors, color_channel_mask);
+               }
             }
          }
 
@@ -387,12 +746,28 @@ namespace crnlib
 
                compress_dxt5_block(
                   alpha_optimizer_results[a][l], chunk_index,
-                  orig_chunk,
+                  chunk,
                   g_chunk_tile_layouts[l].m_x_ofs, g_chunk_tile_layouts[l].m_y_ofs,
                   g_chunk_tile_layouts[l].m_width, g_chunk_tile_layouts[l].m_height,
                   m_params.m_alpha_component_indices[a],
                   layout_alpha_selectors[a][l]);
 
+               if (m_params.m_hierarchical)
+               {
+                  uint block_values[cDXT5SelectorValues];
+                  CRNLIB_ASSERT(alpha_optimizer_results[a][l].m_first_endpoint >= alpha_optimizer_results[a][l].m_second_endpoint);
+                  dxt5_block::get_block_values8(block_values, alpha_optimizer_results[a][l].m_first_endpoint, alpha_optimizer_results[a][l].m_second_endpoint);
+
+                  color_quad_u8 block_colors[cDXT5SelectorValues];
+                  for (uint i = 0; i < cDXT5SelectorValues; i++)
+                  {
+                     block_colors[i].clear();
+                     block_colors[i][m_params.m_alpha_component_indices[a]] = static_cast<uint8>(block_values[i]);
+                  }
+
+                  layout_alpha_sse[a][l] = compute_tile_sse(orig_chunk.get_ptr(), g_chunk_tile_layouts[l], layout_alpha_selectors[a][l], block_colors, alpha_channel_mask[a]);
+               }
+
                for (uint a = 0; a < m_num_alpha_blocks; a++)
                {
                   float mean = 0.0f;
@@ -402,7 +777,7 @@ namespace crnlib
                   {
                      for (uint cx = 0; cx < g_chunk_tile_layouts[l].m_width; cx++)
                      {
-                        uint s = orig_chunk(cx + g_chunk_tile_layouts[l].m_x_ofs, cy + g_chunk_tile_layouts[l].m_y_ofs)[m_params.m_alpha_component_indices[a]];
+                        uint s = chunk.get_component(cx + g_chunk_tile_layouts[l].m_x_ofs, cy + g_chunk_tile_layouts[l].m_y_ofs, m_params.m_alpha_component_indices[a]);
 
                         mean += s;
                         variance += s * s;
@@ -422,69 +797,6 @@ namespace crnlib
             }
          }
 
-         for (uint e = first_encoding; e < last_encoding; e++)
-         {
-            for (uint t = 0; t < g_chunk_encodings[e].m_num_tiles; t++)
-            {
-               const uint layout_index = g_chunk_encodings[e].m_tiles[t].m_layout_index;
-               CRNLIB_ASSERT( (layout_index >= first_layout) && (layout_index < last_layout) );
-
-               if (m_has_color_blocks)
-               {
-                  const dxt1_endpoint_optimizer::results& color_results = color_optimizer_results[layout_index];
-                  const uint8* pColor_selectors = layout_color_selectors[layout_index];
-
-                  color_quad_u8 block_colors[cDXT1SelectorValues];
-                  CRNLIB_ASSERT(color_results.m_low_color >= color_results.m_high_color);
-                  // it's okay if color_results.m_low_color == color_results.m_high_color, because in this case only selector 0 should be used
-                  dxt1_block::get_block_colors4(block_colors, color_results.m_low_color, color_results.m_high_color);
-
-                  for (uint cy = 0; cy < g_chunk_encodings[e].m_tiles[t].m_height; cy++)
-                  {
-                     for (uint cx = 0; cx < g_chunk_encodings[e].m_tiles[t].m_width; cx++)
-                     {
-                        uint s = pColor_selectors[cx + cy * g_chunk_encodings[e].m_tiles[t].m_width];
-                        CRNLIB_ASSERT(s < cDXT1SelectorValues);
-
-                        decomp_chunk[e](cx + g_chunk_encodings[e].m_tiles[t].m_x_ofs, cy + g_chunk_encodings[e].m_tiles[t].m_y_ofs) = block_colors[s];
-                     }
-                  }
-               }
-
-               for (uint a = 0; a < m_num_alpha_blocks; a++)
-               {
-                  const dxt5_endpoint_optimizer::results& alpha_results = alpha_optimizer_results[a][layout_index];
-                  const uint8* pAlpha_selectors = layout_alpha_selectors[a][layout_index];
-
-                  uint block_values[cDXT5SelectorValues];
-                  CRNLIB_ASSERT(alpha_results.m_first_endpoint >= alpha_results.m_second_endpoint);
-                  dxt5_block::get_block_values8(block_values, alpha_results.m_first_endpoint, alpha_results.m_second_endpoint);
-
-                  for (uint cy = 0; cy < g_chunk_encodings[e].m_tiles[t].m_height; cy++)
-                  {
-                     for (uint cx = 0; cx < g_chunk_encodings[e].m_tiles[t].m_width; cx++)
-                     {
-                        uint s = pAlpha_selectors[cx + cy * g_chunk_encodings[e].m_tiles[t].m_width];
-                        CRNLIB_ASSERT(s < cDXT5SelectorValues);
-
-                        decomp_chunk[e](cx + g_chunk_encodings[e].m_tiles[t].m_x_ofs, cy + g_chunk_encodings[e].m_tiles[t].m_y_ofs)[m_params.m_alpha_component_indices[a]] =
-                           static_cast<uint8>(block_values[s]);
-                     }
-                  }
-
-               }
-            } // t
-
-            if (m_params.m_hierarchical)
-            {
-               if (m_has_color_blocks)
-                  color_error_metrics[e].compute(decomp_chunk[e], orig_chunk, 0, 3);
-
-               for (uint a = 0; a < m_num_alpha_blocks; a++)
-                  alpha_error_metrics[a][e].compute(decomp_chunk[e], orig_chunk, m_params.m_alpha_component_indices[a], 1);
-            }
-         } // e
-
          uint best_encoding = cNumChunkEncodings - 1;
 
          if (m_params.m_hierarchical)
@@ -498,6 +810,21 @@ namespace crnlib
 
             for (uint e = 0; e < cNumChunkEncodings; e++)
             {
+               // An encoding's error is the sum of its tiles' errors.
+               uint color_sse = 0;
+               uint alpha_sse[2] = { 0, 0 };
+
+               for (uint t = 0; t < g_chunk_encodings[e].m_num_tiles; t++)
+               {
+                  const uint layout_index = g_chunk_encodings[e].m_tiles[t].m_layout_index;
+
+                  if (m_has_color_blocks)
+                     color_sse += layout_color_sse[layout_index];
+
+                  for (uint a = 0; a < m_num_alpha_blocks; a++)
+                     alpha_sse[a] += layout_alpha_sse[a][layout_index];
+               }
+
                if (m_has_color_blocks)
                {
                   float adaptive_tile_color_psnr_derating = m_params.m_adaptive_tile_color_psnr_derating;
@@ -508,7 +835,7 @@ namespace crnlib
                   }
 
                   float color_derating = math::lerp( 0.0f, adaptive_tile_color_psnr_derating, (g_chunk_encodings[e].m_num_tiles - 1) / 3.0f );
-                  quality[e] = (float)math::maximum<double>(color_error_metrics[e].mPeakSNR - color_derating, 0.0f);
+                  quality[e] = (float)math::maximum<double>(compute_psnr(color_sse, cChunkPixelWidth * cChunkPixelHeight * 3) - color_derating, 0.0f);
                }
 
                if (m_num_alpha_blocks)
@@ -520,7 +847,7 @@ namespace crnlib
 
                   for (uint a = 0; a < m_num_alpha_blocks; a++)
                   {
-                     quality[e] += (float)math::maximum<double>(alpha_error_metrics[a][e].mPeakSNR - alpha_derating, 0.0f);
+                     quality[e] += (float)math::maximum<double>(compute_psnr(alpha_sse[a], cChunkPixelWidth * cChunkPixelHeight) - alpha_derating, 0.0f);
 
                      for (uint t = 0; t < g_chunk_encodings[e].m_num_tiles; t++)
                      {
@@ -583,11 +910,20 @@ namespace crnlib
                   const uint8* pColor_selectors = layout_color_selectors[layout_index];
 
                   output.m_tiles[t].m_endpoint_cluster_index = 0;
-                  output.m_tiles[t].m_first_endpoint = color_results.m_low_color;
-                  output.m_tiles[t].m_second_endpoint = color_results.m_high_color;
+                  if (m_params.m_format == cETC1)
+                  {
+                     output.m_tiles[t].m_first_endpoint = layout_etc1_endpoints[layout_index][0];
+                     output.m_tiles[t].m_second_endpoint = layout_etc1_endpoints[layout_index][1];
+                     output.m_tiles[t].m_alpha_encoding = false;
+                  }
+                  else
+                  {
+                     output.m_tiles[t].m_first_endpoint = color_results.m_low_color;
+                     output.m_tiles[t].m_second_endpoint = color_results.m_high_color;
+                     output.m_tiles[t].m_alpha_encoding = color_results.m_alpha_block;
+                  }
 
                   memcpy(output.m_tiles[t].m_selectors, pColor_selectors, cChunkPixelWidth * cChunkPixelHeight);
-                  output.m_tiles[t].m_alpha_encoding = color_results.m_alpha_block;
                }
                else
                {
@@ -610,7 +946,7 @@ namespace crnlib
          {
             for (uint y = 0; y < cChunkPixelHeight; y++)
                for (uint x = 0; x < cChunkPixelWidth; x++)
-                  m_dbg_chunk_pixels[chunk_index](x, y) = decomp_chunk[best_encoding](x, y);
+                  m_dbg_chunk_pixels[chunk_index].set_pixel(x, y, color_quad_u8::make_black());
 
             for (uint t = 0; t < g_chunk_encodings[best_encoding].m_num_tiles; t++)
             {
@@ -618,9 +954,33 @@ namespace crnlib
 
                const chunk_tile_desc& tile_desc = g_chunk_tile_layouts[layout_index];
 
+               if (m_has_color_blocks)
+               {
+                  color_quad_u8 block_colors[cDXT1SelectorValues];
+                  if (m_params.m_format == cETC1)
+                     get_etc1_block_colors(block_colors, layout_etc1_endpoints[layout_index][0], layout_etc1_endpoints[layout_index][1]);
+                  else
+                     dxt1_block::get_block_colors4(block_colors, color_optimizer_results[layout_index].m_low_color, color_optimizer_results[layout_index].m_high_color);
+
+                  for (uint ty = 0; ty < tile_desc.m_height; ty++)
+                     for (uint tx = 0; tx < tile_desc.m_width; tx++)
+                        m_dbg_chunk_pixels[chunk_index].set_pixel(tile_desc.m_x_ofs + tx, tile_desc.m_y_ofs + ty, block_colors[layout_color_selectors[layout_index][tx + ty * tile_desc.m_width]]);
+               }
+
+               for (uint a = 0; a < m_num_alpha_blocks; a++)
+               {
+                  uint block_values[cDXT5SelectorValues];
+                  dxt5_block::get_block_values8(block_values, alpha_optimizer_results[a][layout_index].m_first_endpoint, alpha_optimizer_results[a][layout_index].m_second_endpoint);
+
+                  for (uint ty = 0; ty < tile_desc.m_height; ty++)
+                     for (uint tx = 0; tx < tile_desc.m_width; tx++)
+                        m_dbg_chunk_pixels[chunk_index].set_component(tile_desc.m_x_ofs + tx, tile_desc.m_y_ofs + ty, m_params.m_alpha_component_indices[a],
+                           static_cast<uint8>(block_values[layout_alpha_selectors[a][layout_index][tx + ty * tile_desc.m_width]]));
+               }
+
                for (uint ty = 0; ty < tile_desc.m_height; ty++)
                   for (uint tx = 0; tx < tile_desc.m_width; tx++)
-                     m_dbg_chunk_pixels_tile_vis[chunk_index](tile_desc.m_x_ofs + tx, tile_desc.m_y_ofs + ty) = g_tile_layout_colors[layout_index];
+                     m_dbg_chunk_pixels_tile_vis[chunk_index].set_pixel(tile_desc.m_x_ofs + tx, tile_desc.m_y_ofs + ty, g_tile_layout_colors[layout_index]);
             }
          }
 
@@ -654,7 +1014,16 @@ namespace crnlib
 
       m_total_tiles = 0;
 
-      for (uint i = 0; i <= m_pTask_pool->get_num_threads(); i++)
+      CRNLIB_ASSERT(m_chunk_levels.size() == m_num_chunks);
+
+      // The tasks claim contiguous batches of chunks until none are left, roughly cBatchesPerTask each, so textures whose
+      // chunks vary a lot in cost (like those with large solid regions) still balance out.
+      const uint cBatchesPerTask = 16;
+      const uint num_tasks = m_pTask_pool->get_num_threads() + 1;
+      m_chunks_per_batch = math::maximum<uint>(1, (m_num_chunks + num_tasks * cBatchesPerTask - 1) / (num_tasks * cBatchesPerTask));
+      m_next_chunk_batch = 0;
+
+      for (uint i = 0; i < num_tasks; i++)
          m_pTask_pool->queue_object_task(this, &dxt_hc::determine_compressed_chunks_task, i);
 
       m_pTask_pool->join();
@@ -712,22 +1081,91 @@ namespace crnlib
       }
    }
 
-   bool dxt_hc::determine_color_endpoint_clusters()
+   dxt_hc::vec6F dxt_hc::compute_color_training_vec(const pixel_chunk& chunk, const compressed_tile& tile) const
    {
-      if (!m_has_color_blocks)
-         return true;
+      const float r_scale = .5f;
+      const float b_scale = .25f;
 
+      const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
+
+      vec6F vv;
+
+      if (m_params.m_format == cETC1)
+      {
+         // An ETC1 endpoint can only move the base color along the grayscale axis, so the tile's darkest and brightest
+         // ETC1 colors (left unclamped) are used instead of a 2 color palette of its pixels.
+         const color_quad_u8 base_color(etc1_block::unpack_color5(static_cast<uint16>(tile.m_first_endpoint), true));
+         const float inten = g_etc1_inten_tables[tile.m_second_endpoint][cETC1SelectorValues - 1] * (1.0f/255.0f);
+
+         for (uint i = 0; i < 3; i++)
+         {
+            float scale = 1.0f;
+            if (m_params.m_perceptual)
+               scale = (i == 0) ? r_scale : ((i == 2) ? b_scale : 1.0f);
+
+            vv[i] = (base_color[i] * (1.0f/255.0f) - inten) * scale;
+            vv[3 + i] = (base_color[i] * (1.0f/255.0f) + inten) * scale;
+         }
+
+         return vv;
+      }
+
+      tree_clusterizer<vec3F> palettizer;
+      for (uint y = 0; y < layout.m_height; y++)
+      {
+         for (uint x = 0; x < layout.m_width; x++)
+         {
+            const color_quad_u8 c(chunk(layout.m_x_ofs + x, layout.m_y_ofs + y));
+
+            vec3F v;
+            if (m_params.m_perceptual)
+            {
+               v.set(c[0] * 1.0f/255.0f, c[1] * 1.0f/255.0f, c[2] * 1.0f/255.0f);
+               v[0] *= r_scale;
+               v[2] *= b_scale;
+            }
+            else
+            {
+               v.set(c[0] * 1.0f/255.0f, c[1] * 1.0f/255.0f, c[2] * 1.0f/255.0f);
+            }
+
+            palettizer.add_training_vec(v, 1);
+         }
+      }
+
+      palettizer.generate_codebook(2);
+
+      vec3F v[2];
+      utils::zero_object(v);
+
+      for (uint i = 0; i < palettizer.get_codebook_size(); i++)
+         v[i] = palettizer.get_codebook_entry(i);
+
+      if (palettizer.get_codebook_size() == 1)
+         v[1] = v[0];
+      if (v[0].length() > v[1].length())
+         utils::swap(v[0], v[1]);
+
+      for (uint i = 0; i < 2; i++)
+      {
+         vv[i*3+0] = v[i][0];
+         vv[i*3+1] = v[i][1];
+         vv[i*3+2] = v[i][2];
+      }
+
+      return vv;
+   }
+
+   bool dxt_hc::create_color_endpoint_training_vecs()
+   {
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
       if (m_params.m_debugging)
          console::info("Generating color training vectors");
 #endif
 
-      const float r_scale = .5f;
-      const float b_scale = .25f;
-
-      vec6F_tree_vq vq;
+      vec6F_tree_vq& vq = m_color_endpoint_vq;
 
-      crnlib::vector< crnlib::vector<vec6F> > training_vecs;
+      crnlib::vector< crnlib::vector<vec6F> >& training_vecs = m_color_training_vecs;
 
       training_vecs.resize(m_num_chunks);
 
@@ -747,54 +1185,10 @@ namespace crnlib
          {
             const compressed_tile& tile = chunk.m_tiles[tile_index];
 
-            const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
-
-            tree_clusterizer<vec3F> palettizer;
-            for (uint y = 0; y < layout.m_height; y++)
-            {
-               for (uint x = 0; x < layout.m_width; x++)
-               {
-                  const color_quad_u8& c =  m_pChunks[chunk_index](layout.m_x_ofs + x, layout.m_y_ofs + y);
-
-                  vec3F v;
-                  if (m_params.m_perceptual)
-                  {
-                     v.set(c[0] * 1.0f/255.0f, c[1] * 1.0f/255.0f, c[2] * 1.0f/255.0f);
-                     v[0] *= r_scale;
-                     v[2] *= b_scale;
-                  }
-                  else
-                  {
-                     v.set(c[0] * 1.0f/255.0f, c[1] * 1.0f/255.0f, c[2] * 1.0f/255.0f);
-                  }
-
-                  palettizer.add_training_vec(v, 1);
-               }
-            }
-
-            palettizer.generate_codebook(2);
-
             uint tile_weight = tile.m_pixel_width * tile.m_pixel_height;
             tile_weight = static_cast<uint>(tile_weight * m_pChunks[chunk_index].m_weight);
 
-            vec3F v[2];
-            utils::zero_object(v);
-
-            for (uint i = 0; i < palettizer.get_codebook_size(); i++)
-               v[i] = palettizer.get_codebook_entry(i);
-
-            if (palettizer.get_codebook_size() == 1)
-               v[1] = v[0];
-            if (v[0].length() > v[1].length())
-               utils::swap(v[0], v[1]);
-
-            vec6F vv;
-            for (uint i = 0; i < 2; i++)
-            {
-               vv[i*3+0] = v[i][0];
-               vv[i*3+1] = v[i][1];
-               vv[i*3+2] = v[i][2];
-            }
+            const vec6F vv(compute_color_training_vec(m_pChunks[chunk_index], tile));
 
             vq.add_training_vec(vv, tile_weight);
 
@@ -802,6 +1196,23 @@ namespace crnlib
          }
       }
 
+      return true;
+   }
+
+   bool dxt_hc::determine_color_endpoint_clusters()
+   {
+      if (!m_has_color_blocks)
+         return true;
+
+      // The training vectors only depend on the chunk analysis, so they're kept when it's reused.
+      if (m_color_training_vecs.empty())
+      {
+         if (!create_color_endpoint_training_vecs())
+            return false;
+      }
+
+      vec6F_tree_vq& vq = m_color_endpoint_vq;
+
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
       if (m_params.m_debugging)
          console::info("Begin color cluster analysis");
@@ -810,7 +1221,7 @@ namespace crnlib
 #endif
 
       uint codebook_size = math::minimum<uint>(m_total_tiles, m_params.m_color_endpoint_codebook_size);
-      vq.generate_codebook(codebook_size);
+      generate_endpoint_codebook(vq, m_color_endpoint_vq_size, codebook_size, m_params.m_reuse_analysis ? math::minimum<uint>(m_total_tiles, m_params.m_max_endpoint_codebook_size) : 0, m_pTask_pool);
 
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
       if (m_params.m_debugging)
@@ -827,7 +1238,7 @@ namespace crnlib
          console::info("Begin color cluster assignment");
 #endif
 
-      assign_color_endpoint_clusters_state state(vq, training_vecs);
+      assign_color_endpoint_clusters_state state(vq, m_color_training_vecs);
 
       for (uint i = 0; i <= m_pTask_pool->get_num_threads(); i++)
          m_pTask_pool->queue_object_task(this, &dxt_hc::assign_color_endpoint_clusters_task, i, &state);
@@ -884,7 +1295,7 @@ namespace crnlib
 
             for (uint tile_index = 0; tile_index < chunk.m_num_tiles; tile_index++)
             {
-               uint cluster_index = state.m_vq.find_best_codebook_entry_fs(state.m_training_vecs[a][chunk_index][tile_index]);
+               uint cluster_index = state.m_vq.find_best_codebook_entry_fs(state.m_pTraining_vecs[a][chunk_index][tile_index]);
 
                chunk.m_endpoint_cluster_index[tile_index] = static_cast<uint16>(cluster_index);
             }
@@ -892,21 +1303,51 @@ namespace crnlib
       }
    }
 
-   bool dxt_hc::determine_alpha_endpoint_clusters()
+   vec2F dxt_hc::compute_alpha_training_vec(const pixel_chunk& chunk, const compressed_tile& tile, uint comp_index) const
    {
-      if (!m_num_alpha_blocks)
-         return true;
+      const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
+
+      tree_clusterizer<vec1F> palettizer;
+
+      for (uint y = 0; y < layout.m_height; y++)
+      {
+         for (uint x = 0; x < layout.m_width; x++)
+         {
+            uint c = chunk.get_component(layout.m_x_ofs + x, layout.m_y_ofs + y, comp_index);
+
+            vec1F v(c * 1.0f/255.0f);
+
+            palettizer.add_training_vec(v, 1);
+         }
+      }
+      palettizer.generate_codebook(2);
 
+      vec1F v[2];
+      utils::zero_object(v);
+
+      for (uint i = 0; i < palettizer.get_codebook_size(); i++)
+         v[i] = palettizer.get_codebook_entry(i);
+
+      if (palettizer.get_codebook_size() == 1)
+         v[1] = v[0];
+      if (v[0] > v[1])
+         utils::swap(v[0], v[1]);
+
+      return vec2F(v[0][0], v[1][0]);
+   }
+
+   bool dxt_hc::create_alpha_endpoint_training_vecs()
+   {
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
       if (m_params.m_debugging)
          console::info("Generating alpha training vectors");
 #endif
 
-      determine_alpha_endpoint_clusters_state state;
+      determine_alpha_endpoint_clusters_state state(m_alpha_endpoint_vq, m_alpha_training_vecs);
 
       for (uint a = 0; a < m_num_alpha_blocks; a++)
       {
-         state.m_training_vecs[a].resize(m_num_chunks);
+         state.m_pTraining_vecs[a].resize(m_num_chunks);
 
          for (uint chunk_index = 0; chunk_index < m_num_chunks; chunk_index++)
          {
@@ -918,52 +1359,40 @@ namespace crnlib
 
             const compressed_chunk& chunk = m_compressed_chunks[cAlpha0Chunks + a][chunk_index];
 
-            state.m_training_vecs[a][chunk_index].resize(chunk.m_num_tiles);
-
-            for (uint tile_index = 0; tile_index < chunk.m_num_tiles; tile_index++)
-            {
-               const compressed_tile& tile = chunk.m_tiles[tile_index];
-
-               const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
-
-               tree_clusterizer<vec1F> palettizer;
-
-               for (uint y = 0; y < layout.m_height; y++)
-               {
-                  for (uint x = 0; x < layout.m_width; x++)
-                  {
-                     uint c = m_pChunks[chunk_index](layout.m_x_ofs + x, layout.m_y_ofs + y)[m_params.m_alpha_component_indices[a]];
-
-                     vec1F v(c * 1.0f/255.0f);
-
-                     palettizer.add_training_vec(v, 1);
-                  }
-               }
-               palettizer.generate_codebook(2);
-
-               const uint tile_weight = tile.m_pixel_width * tile.m_pixel_height;
-
-               vec1F v[2];
-               utils::zero_object(v);
+            state.m_pTraining_vecs[a][chunk_index].resize(chunk.m_num_tiles);
 
-               for (uint i = 0; i < palettizer.get_codebook_size(); i++)
-                  v[i] = palettizer.get_codebook_entry(i);
+            for (uint tile_index = 0; tile_index < chunk.m_num_tiles; tile_index++)
+            {
+               const compressed_tile& tile = chunk.m_tiles[tile_index];
 
-               if (palettizer.get_codebook_size() == 1)
-                  v[1] = v[0];
-               if (v[0] > v[1])
-                  utils::swap(v[0], v[1]);
+               const uint tile_weight = tile.m_pixel_width * tile.m_pixel_height;
 
-               vec2F vv(v[0][0], v[1][0]);
+               const vec2F vv(compute_alpha_training_vec(m_pChunks[chunk_index], tile, m_params.m_alpha_component_indices[a]));
 
                state.m_vq.add_training_vec(vv, tile_weight);
 
-               state.m_training_vecs[a][chunk_index][tile_index] = vv;
+               state.m_pTraining_vecs[a][chunk_index][tile_index] = vv;
 
             } // tile_index
          } // chunk_index
       } // a
 
+      return true;
+   }
+
+   bool dxt_hc::determine_alpha_endpoint_clusters()
+   {
+      if (!m_num_alpha_blocks)
+         return true;
+
+      if (m_alpha_training_vecs[0].empty())
+      {
+         if (!create_alpha_endpoint_training_vecs())
+            return false;
+      }
+
+      determine_alpha_endpoint_clusters_state state(m_alpha_endpoint_vq, m_alpha_training_vecs);
+
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
       if (m_params.m_debugging)
          console::info("Begin alpha cluster analysis");
@@ -972,7 +1401,7 @@ namespace crnlib
 #endif
 
       uint codebook_size = math::minimum<uint>(m_total_tiles, m_params.m_alpha_endpoint_codebook_size);
-      state.m_vq.generate_codebook(codebook_size);
+      generate_endpoint_codebook(state.m_vq, m_alpha_endpoint_vq_size, codebook_size, m_params.m_reuse_analysis ? math::minimum<uint>(m_total_tiles, m_params.m_max_endpoint_codebook_size) : 0, m_pTask_pool);
 
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
       if (m_params.m_debugging)
@@ -1059,52 +1488,83 @@ namespace crnlib
             continue;
          }
 
-         pixels.resize(0);
+         endpoint_cluster_result* pCached_result = NULL;
+         if (m_color_cluster_results.size())
+            pCached_result = &m_color_cluster_results[m_color_endpoint_vq.get_codebook_nodes()[cluster_index]];
 
-         for (uint t = 0; t < cluster.m_tiles.size(); t++)
+         const uint8* pCluster_selectors;
+
+         if ((pCached_result) && (pCached_result->m_tiles == cluster.m_tiles))
          {
-            const uint chunk_index = cluster.m_tiles[t].first;
-            const uint tile_index = cluster.m_tiles[t].second;
-            CRNLIB_ASSERT(chunk_index < m_num_chunks);
-            CRNLIB_ASSERT(tile_index < cChunkMaxTiles);
+            cluster.m_first_endpoint = pCached_result->m_first_endpoint;
+            cluster.m_second_endpoint = pCached_result->m_second_endpoint;
+            cluster.m_alpha_encoding = pCached_result->m_alpha_encoding;
+            cluster.m_error = pCached_result->m_error;
 
-            const compressed_chunk& chunk = m_compressed_chunks[cColorChunks][chunk_index];
+            pCluster_selectors = &pCached_result->m_selectors[0];
+         }
+         else
+         {
+            pixels.resize(0);
 
-            CRNLIB_ASSERT(tile_index < chunk.m_num_tiles);
-            const compressed_tile& tile = chunk.m_tiles[tile_index];
+            for (uint t = 0; t < cluster.m_tiles.size(); t++)
+            {
+               const uint chunk_index = cluster.m_tiles[t].first;
+               const uint tile_index = cluster.m_tiles[t].second;
+               CRNLIB_ASSERT(chunk_index < m_num_chunks);
+               CRNLIB_ASSERT(tile_index < cChunkMaxTiles);
 
-            const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
+               const compressed_chunk& chunk = m_compressed_chunks[cColorChunks][chunk_index];
 
-            for (uint y = 0; y < layout.m_height; y++)
-               for (uint x = 0; x < layout.m_width; x++)
-                  pixels.push_back( m_pChunks[chunk_index](layout.m_x_ofs + x, layout.m_y_ofs + y) );
-         }
+               CRNLIB_ASSERT(tile_index < chunk.m_num_tiles);
+               const compressed_tile& tile = chunk.m_tiles[tile_index];
 
-         total_pixels += pixels.size();
+               const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
+
+               for (uint y = 0; y < layout.m_height; y++)
+                  for (uint x = 0; x < layout.m_width; x++)
+                     pixels.push_back( m_pChunks[chunk_index](layout.m_x_ofs + x, layout.m_y_ofs + y) );
+            }
 
-         selectors.resize(pixels.size());
+            total_pixels += pixels.size();
 
-         dxt1_endpoint_optimizer::params params;
-         params.m_block_index = cluster_index;
-         params.m_pPixels = &pixels[0];
-         params.m_num_pixels = pixels.size();
-         params.m_pixels_have_alpha = false;
-         params.m_use_alpha_blocks = false;
-         params.m_perceptual = m_params.m_perceptual;
-         params.m_quality = cCRNDXTQualityUber;
-         params.m_endpoint_caching = false;
+            selectors.resize(pixels.size());
 
-         dxt1_endpoint_optimizer::results results;
-         results.m_pSelectors = &selectors[0];
+            if (m_params.m_format == cETC1)
+            {
+               cluster.m_error = optimize_etc1_endpoints(&pixels[0], pixels.size(), cCRNETCQualityMedium, cluster.m_first_endpoint, cluster.m_second_endpoint, &selectors[0]);
+               cluster.m_alpha_encoding = false;
+            }
+            else
+            {
+               dxt1_endpoint_optimizer::params params;
+               params.m_block_index = cluster_index;
+               params.m_pPixels = &pixels[0];
+               params.m_num_pixels = pixels.size();
+               params.m_pixels_have_alpha = false;
+               params.m_use_alpha_blocks = false;
+               params.m_perceptual = m_params.m_perceptual;
+               params.m_quality = cCRNDXTQualityUber;
+               params.m_endpoint_caching = false;
+
+               dxt1_endpoint_optimizer::results results;
+               results.m_pSelectors = &selectors[0];
+
+               dxt1_endpoint_optimizer optimizer;
+               const bool all_transparent = optimizer.compute(params, results);
+               all_transparent;
+
+               cluster.m_first_endpoint = results.m_low_color;
+               cluster.m_second_endpoint = results.m_high_color;
+               cluster.m_alpha_encoding = results.m_alpha_block;
+               cluster.m_error = results.m_error;
+            }
 
-         dxt1_endpoint_optimizer optimizer;
-         const bool all_transparent = optimizer.compute(params, results);
-         all_transparent;
+            pCluster_selectors = &selectors[0];
 
-         cluster.m_first_endpoint = results.m_low_color;
-         cluster.m_second_endpoint = results.m_high_color;
-         cluster.m_alpha_encoding = results.m_alpha_block;
-         cluster.m_error = results.m_error;
+            if (pCached_result)
+               pCached_result->set(cluster, selectors);
+         }
 
          uint pixel_index = 0;
 
@@ -1131,15 +1591,15 @@ namespace crnlib
             const uint total_pixels = tile.m_pixel_width * tile.m_pixel_height;
 
             quantized_tile.m_endpoint_cluster_index = cluster_index;
-            quantized_tile.m_first_endpoint = results.m_low_color;
-            quantized_tile.m_second_endpoint = results.m_high_color;
+            quantized_tile.m_first_endpoint = cluster.m_first_endpoint;
+            quantized_tile.m_second_endpoint = cluster.m_second_endpoint;
             //quantized_tile.m_error = results.m_error;
-            quantized_tile.m_alpha_encoding = results.m_alpha_block;
+            quantized_tile.m_alpha_encoding = cluster.m_alpha_encoding;
             quantized_tile.m_pixel_width = tile.m_pixel_width;
             quantized_tile.m_pixel_height = tile.m_pixel_height;
             quantized_tile.m_layout_index = tile.m_layout_index;
 
-            memcpy(quantized_tile.m_selectors, &selectors[pixel_index], total_pixels);
+            memcpy(quantized_tile.m_selectors, &pCluster_selectors[pixel_index], total_pixels);
 
             pixel_index += total_pixels;
          }
@@ -1166,11 +1626,15 @@ namespace crnlib
          console::info("Computing optimal color cluster endpoints");
 #endif
 
+      prepare_endpoint_cluster_results(m_color_cluster_results, m_color_endpoint_vq.get_num_nodes());
+
       for (uint i = 0; i <= m_pTask_pool->get_num_threads(); i++)
          m_pTask_pool->queue_object_task(this, &dxt_hc::determine_color_endpoint_codebook_task, i, NULL);
 
       m_pTask_pool->join();
 
+      prune_endpoint_cluster_results(m_color_cluster_results, m_color_endpoint_vq.get_codebook_nodes());
+
       return !m_canceled;
    }
 
@@ -1180,8 +1644,8 @@ namespace crnlib
 
       const uint thread_index = static_cast<uint>(data);
 
-      crnlib::vector<color_quad_u8> pixels;
-      pixels.reserve(512);
+      crnlib::vector<uint8> values;
+      values.reserve(512);
 
       crnlib::vector<uint8> selectors;
       selectors.reserve(512);
@@ -1211,61 +1675,78 @@ namespace crnlib
             continue;
          }
 
-         pixels.resize(0);
+         endpoint_cluster_result* pCached_result = NULL;
+         if (m_alpha_cluster_results.size())
+            pCached_result = &m_alpha_cluster_results[m_alpha_endpoint_vq.get_codebook_nodes()[cluster_index]];
 
-         for (uint tile_iter = 0; tile_iter < cluster.m_tiles.size(); tile_iter++)
+         const uint8* pCluster_selectors;
+
+         if ((pCached_result) && (pCached_result->m_tiles == cluster.m_tiles))
          {
-            const uint chunk_index = cluster.m_tiles[tile_iter].first;
-            const uint tile_index = cluster.m_tiles[tile_iter].second & 0xFFFFU;
-            const uint alpha_index = cluster.m_tiles[tile_iter].second >> 16U;
+            cluster.m_first_endpoint = pCached_result->m_first_endpoint;
+            cluster.m_second_endpoint = pCached_result->m_second_endpoint;
+            cluster.m_alpha_encoding = pCached_result->m_alpha_encoding;
+            cluster.m_error = pCached_result->m_error;
 
-            CRNLIB_ASSERT(chunk_index < m_num_chunks);
-            CRNLIB_ASSERT(tile_index < cChunkMaxTiles);
-            CRNLIB_ASSERT(alpha_index < m_num_alpha_blocks);
+            pCluster_selectors = &pCached_result->m_selectors[0];
+         }
+         else
+         {
+            values.resize(0);
 
-            const compressed_chunk& chunk = m_compressed_chunks[cAlpha0Chunks + alpha_index][chunk_index];
+            for (uint tile_iter = 0; tile_iter < cluster.m_tiles.size(); tile_iter++)
+            {
+               const uint chunk_index = cluster.m_tiles[tile_iter].first;
+               const uint tile_index = cluster.m_tiles[tile_iter].second & 0xFFFFU;
+               const uint alpha_index = cluster.m_tiles[tile_iter].second >> 16U;
 
-            CRNLIB_ASSERT(chunk.m_endpoint_cluster_index[tile_index] == cluster_index);
+               CRNLIB_ASSERT(chunk_index < m_num_chunks);
+               CRNLIB_ASSERT(tile_index < cChunkMaxTiles);
+               CRNLIB_ASSERT(alpha_index < m_num_alpha_blocks);
 
-            CRNLIB_ASSERT(tile_index < chunk.m_num_tiles);
-            const compressed_tile& tile = chunk.m_tiles[tile_index];
+               const compressed_chunk& chunk = m_compressed_chunks[cAlpha0Chunks + alpha_index][chunk_index];
 
-            const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
+               CRNLIB_ASSERT(chunk.m_endpoint_cluster_index[tile_index] == cluster_index);
 
-            color_quad_u8 c(cClear);
+               CRNLIB_ASSERT(tile_index < chunk.m_num_tiles);
+               const compressed_tile& tile = chunk.m_tiles[tile_index];
 
-            for (uint y = 0; y < layout.m_height; y++)
-            {
-               for (uint x = 0; x < layout.m_width; x++)
-               {
-                  c[0] = m_pChunks[chunk_index](layout.m_x_ofs + x, layout.m_y_ofs + y)[ m_params.m_alpha_component_indices[alpha_index] ];
+               const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
 
-                  pixels.push_back(c);
-               }
+               const uint first_value = values.size();
+               values.resize(first_value + layout.m_width * layout.m_height, true);
+
+               m_pChunks[chunk_index].get_component_values(layout.m_x_ofs, layout.m_y_ofs, layout.m_width, layout.m_height,
+                  m_params.m_alpha_component_indices[alpha_index], &values[first_value]);
             }
-         }
 
-         selectors.resize(pixels.size());
+            selectors.resize(values.size());
+
+            dxt5_endpoint_optimizer::params params;
+            params.m_block_index = cluster_index;
+            params.m_pValues = &values[0];
+            params.m_num_pixels = values.size();
+            params.m_comp_index = 0;
+            params.m_quality = cCRNDXTQualityUber;
+            params.m_use_both_block_types = false;
 
-         dxt5_endpoint_optimizer::params params;
-         params.m_block_index = cluster_index;
-         params.m_pPixels = &pixels[0];
-         params.m_num_pixels = pixels.size();
-         params.m_comp_index = 0;
-         params.m_quality = cCRNDXTQualityUber;
-         params.m_use_both_block_types = false;
+            dxt5_endpoint_optimizer::results results;
+            results.m_pSelectors = &selectors[0];
 
-         dxt5_endpoint_optimizer::results results;
-         results.m_pSelectors = &selectors[0];
+            dxt5_endpoint_optimizer optimizer;
+            const bool all_transparent = optimizer.compute(params, results);
+            all_transparent;
 
-         dxt5_endpoint_optimizer optimizer;
-         const bool all_transparent = optimizer.compute(params, results);
-         all_transparent;
+            cluster.m_first_endpoint = results.m_first_endpoint;
+            cluster.m_second_endpoint = results.m_second_endpoint;
+            cluster.m_alpha_encoding = results.m_block_type != 0;
+            cluster.m_error = results.m_error;
 
-         cluster.m_first_endpoint = results.m_first_endpoint;
-         cluster.m_second_endpoint = results.m_second_endpoint;
-         cluster.m_alpha_encoding = results.m_block_type != 0;
-         cluster.m_error = results.m_error;
+            pCluster_selectors = &selectors[0];
+
+            if (pCached_result)
+               pCached_result->set(cluster, selectors);
+         }
 
          uint pixel_index = 0;
 
@@ -1293,15 +1774,15 @@ namespace crnlib
             const uint total_pixels = tile.m_pixel_width * tile.m_pixel_height;
 
             quantized_tile.m_endpoint_cluster_index = cluster_index;
-            quantized_tile.m_first_endpoint = results.m_first_endpoint;
-            quantized_tile.m_second_endpoint = results.m_second_endpoint;
+            quantized_tile.m_first_endpoint = cluster.m_first_endpoint;
+            quantized_tile.m_second_endpoint = cluster.m_second_endpoint;
             //quantized_tile.m_error = results.m_error;
-            quantized_tile.m_alpha_encoding = results.m_block_type != 0;
+            quantized_tile.m_alpha_encoding = cluster.m_alpha_encoding;
             quantized_tile.m_pixel_width = tile.m_pixel_width;
             quantized_tile.m_pixel_height = tile.m_pixel_height;
             quantized_tile.m_layout_index = tile.m_layout_index;
 
-            memcpy(quantized_tile.m_selectors, &selectors[pixel_index], total_pixels);
+            memcpy(quantized_tile.m_selectors, &pCluster_selectors[pixel_index], total_pixels);
 
             pixel_index += total_pixels;
          }
@@ -1326,11 +1807,15 @@ namespace crnlib
          console::info("Computing optimal alpha cluster endpoints");
 #endif
 
+      prepare_endpoint_cluster_results(m_alpha_cluster_results, m_alpha_endpoint_vq.get_num_nodes());
+
       for (uint i = 0; i <= m_pTask_pool->get_num_threads(); i++)
          m_pTask_pool->queue_object_task(this, &dxt_hc::determine_alpha_endpoint_codebook_task, i, NULL);
 
       m_pTask_pool->join();
 
+      prune_endpoint_cluster_results(m_alpha_cluster_results, m_alpha_endpoint_vq.get_codebook_nodes());
+
       return !m_canceled;
    }
 
@@ -1386,8 +1871,13 @@ namespace crnlib
                const uint8* pColor_Selectors = quantized_tile.m_selectors;
 
                color_quad_u8 block_colors[cDXT1SelectorValues];
-               CRNLIB_ASSERT(quantized_tile.m_first_endpoint >= quantized_tile.m_second_endpoint);
-               dxt1_block::get_block_colors(block_colors, static_cast<uint16>(quantized_tile.m_first_endpoint), static_cast<uint16>(quantized_tile.m_second_endpoint));
+               if (m_params.m_format == cETC1)
+                  get_etc1_block_colors(block_colors, quantized_tile.m_first_endpoint, quantized_tile.m_second_endpoint);
+               else
+               {
+                  CRNLIB_ASSERT(quantized_tile.m_first_endpoint >= quantized_tile.m_second_endpoint);
+                  dxt1_block::get_block_colors(block_colors, static_cast<uint16>(quantized_tile.m_first_endpoint), static_cast<uint16>(quantized_tile.m_second_endpoint));
+               }
 
                for (uint y = 0; y < layout.m_height; y++)
                {
@@ -1395,11 +1885,11 @@ namespace crnlib
                   {
                      const uint selector = pColor_Selectors[x + y * layout.m_width];
 
-                     output_chunk_selectors(x + layout.m_x_ofs, y + layout.m_y_ofs) = selector*255/(cDXT1SelectorValues-1);
+                     output_chunk_selectors.set_pixel(x + layout.m_x_ofs, y + layout.m_y_ofs, color_quad_u8(selector*255/(cDXT1SelectorValues-1)));
 
-                     output_chunk_orig_selectors(x + layout.m_x_ofs, y + layout.m_y_ofs) = color_chunk.m_tiles[tile_index].m_selectors[x + y * layout.m_width] * 255 / (cDXT1SelectorValues-1);
+                     output_chunk_orig_selectors.set_pixel(x + layout.m_x_ofs, y + layout.m_y_ofs, color_quad_u8(color_chunk.m_tiles[tile_index].m_selectors[x + y * layout.m_width] * 255 / (cDXT1SelectorValues-1)));
 
-                     output_chunk_color_quantized(x + layout.m_x_ofs, y + layout.m_y_ofs) = block_colors[selector];
+                     output_chunk_color_quantized.set_pixel(x + layout.m_x_ofs, y + layout.m_y_ofs, block_colors[selector]);
                   }
                }
             }
@@ -1433,11 +1923,11 @@ namespace crnlib
 
                      CRNLIB_ASSERT(selector < cDXT5SelectorValues);
 
-                     output_chunk_selectors(x + layout.m_x_ofs, y + layout.m_y_ofs)[m_params.m_alpha_component_indices[a]] = static_cast<uint8>(selector*255/(cDXT5SelectorValues-1));
+                     output_chunk_selectors.set_component(x + layout.m_x_ofs, y + layout.m_y_ofs, m_params.m_alpha_component_indices[a], static_cast<uint8>(selector*255/(cDXT5SelectorValues-1)));
 
-                     output_chunk_orig_selectors(x + layout.m_x_ofs, y + layout.m_y_ofs)[m_params.m_alpha_component_indices[a]] = static_cast<uint8>(alpha_chunk.m_tiles[tile_index].m_selectors[x + y * layout.m_width]*255/(cDXT5SelectorValues-1));
+                     output_chunk_orig_selectors.set_component(x + layout.m_x_ofs, y + layout.m_y_ofs, m_params.m_alpha_component_indices[a], static_cast<uint8>(alpha_chunk.m_tiles[tile_index].m_selectors[x + y * layout.m_width]*255/(cDXT5SelectorValues-1)));
 
-                     output_chunk_alpha_quantized(x + layout.m_x_ofs, y + layout.m_y_ofs)[m_params.m_alpha_component_indices[a]] = static_cast<uint8>(block_values[selector]);
+                     output_chunk_alpha_quantized.set_component(x + layout.m_x_ofs, y + layout.m_y_ofs, m_params.m_alpha_component_indices[a], static_cast<uint8>(block_values[selector]));
                   }
                }
             }
@@ -1446,6 +1936,93 @@ namespace crnlib
       }
    }
 
+   // Returns the selector codebook entry closest to a block of alpha values, given the values of its tile's endpoints.
+   static uint find_best_alpha_selectors(const dxt_hc::selectors_vec& selectors_cb, const uint8* pBlock_alpha, const uint* pBlock_values)
+   {
+      uint best_error = UINT_MAX;
+      uint best_index = 0;
+
+      for (uint i = 0; i < selectors_cb.size(); i++)
+      {
+         const dxt_hc::selectors& s = selectors_cb[i];
+
+         uint total_error = 0;
+
+         for (uint y = 0; y < cBlockPixelHeight; y++)
+         {
+            for (uint x = 0; x < cBlockPixelWidth; x++)
+            {
+               int a = pBlock_alpha[x + y * cBlockPixelWidth];
+               int b = pBlock_values[s.m_selectors[y][x]];
+               int error = a - b;
+               error *= error;
+
+               total_error += error;
+               if (total_error > best_error)
+                  goto early_out;
+            } // x
+         } //y
+
+early_out:
+         if (total_error < best_error)
+         {
+            best_error = total_error;
+            best_index = i;
+
+            if (best_error == 0)
+               break;
+         }
+      } // i
+
+      return best_index;
+   }
+
+   // Returns the selector codebook entry closest to a block of pixels, given the colors of its tile's endpoints.
+   static uint find_best_color_selectors(const dxt_hc::selectors_vec& selectors_cb, const color_quad_u8* pBlock_pixels, const color_quad_u8* pBlock_colors, bool block_with_alpha, bool perceptual)
+   {
+      uint best_error = UINT_MAX;
+      uint best_index = 0;
+
+      for (uint i = 0; i < selectors_cb.size(); i++)
+      {
+         const dxt_hc::selectors& s = selectors_cb[i];
+
+         uint total_error = 0;
+
+         for (uint y = 0; y < cBlockPixelHeight; y++)
+         {
+            for (uint x = 0; x < cBlockPixelWidth; x++)
+            {
+               const color_quad_u8& a = pBlock_pixels[x + y * cBlockPixelWidth];
+
+               uint selector_index = s.m_selectors[y][x];
+               if ((block_with_alpha) && (selector_index == 3))
+                  total_error += 999999;
+
+               const color_quad_u8& b = pBlock_colors[selector_index];
+
+               uint error = color::color_distance(perceptual, a, b, false);
+
+               total_error += error;
+               if (total_error > best_error)
+                  goto early_out;
+            } // x
+         } //y
+
+early_out:
+         if (total_error < best_error)
+         {
+            best_error = total_error;
+            best_index = i;
+
+            if (best_error == 0)
+               break;
+         }
+      } // i
+
+      return best_index;
+   }
+
    void dxt_hc::create_selector_codebook_task(uint64 data, void* pData_ptr)
    {
       const uint thread_index = static_cast<uint>(data);
@@ -1499,42 +2076,11 @@ namespace crnlib
    #if 0
                         uint best_index = selector_vq.find_best_codebook_entry_fs(training_vecs[comp_chunk_index][(tile_block_ofs_x+bx)+(tile_block_ofs_y+by)*2][chunk_index]);
    #else
-                        const dxt_pixel_block& block = m_pChunks[chunk_index].m_blocks[tile_block_ofs_y + by][tile_block_ofs_x + bx];
+                        uint8 block_alpha[cBlockPixelWidth * cBlockPixelHeight];
+                        m_pChunks[chunk_index].get_component_values((tile_block_ofs_x + bx) << cBlockPixelWidthShift, (tile_block_ofs_y + by) << cBlockPixelHeightShift,
+                           cBlockPixelWidth, cBlockPixelHeight, alpha_pixel_comp, block_alpha);
 
-                        uint best_error = UINT_MAX;
-                        uint best_index = 0;
-
-                        for (uint i = 0; i < state.m_selectors_cb.size(); i++)
-                        {
-                           const selectors& s = state.m_selectors_cb[i];
-
-                           uint total_error = 0;
-
-                           for (uint y = 0; y < cBlockPixelHeight; y++)
-                           {
-                              for (uint x = 0; x < cBlockPixelWidth; x++)
-                              {
-                                 int a = block.m_pixels[y][x][alpha_pixel_comp];
-                                 int b = block_values[s.m_selectors[y][x]];
-                                 int error = a - b;
-                                 error *= error;
-
-                                 total_error += error;
-                                 if (total_error > best_error)
-                                    goto early_out;
-                              } // x
-                           } //y
-
-   early_out:
-                           if (total_error < best_error)
-                           {
-                              best_error = total_error;
-                              best_index = i;
-
-                              if (best_error == 0)
-                                 break;
-                           }
-                        } // i
+                        const uint best_index = find_best_alpha_selectors(state.m_selectors_cb, block_alpha, block_values);
    #endif
 
                         CRNLIB_ASSERT( (tile_block_ofs_x + bx) < 2 );
@@ -1554,56 +2100,25 @@ namespace crnlib
                }
                else
                {
+                  const bool etc1 = (m_params.m_format == cETC1);
+
                   color_quad_u8 block_colors[cDXT1SelectorValues];
-                  dxt1_block::get_block_colors4(block_colors, static_cast<uint16>(quantized_tile.m_first_endpoint), static_cast<uint16>(quantized_tile.m_second_endpoint));
+                  if (etc1)
+                     get_etc1_block_colors(block_colors, quantized_tile.m_first_endpoint, quantized_tile.m_second_endpoint);
+                  else
+                     dxt1_block::get_block_colors4(block_colors, static_cast<uint16>(quantized_tile.m_first_endpoint), static_cast<uint16>(quantized_tile.m_second_endpoint));
 
-                  const bool block_with_alpha = quantized_tile.m_first_endpoint == quantized_tile.m_second_endpoint;
+                  const bool block_with_alpha = (!etc1) && (quantized_tile.m_first_endpoint == quantized_tile.m_second_endpoint);
 
                   for (uint by = 0; by < tile_blocks_y; by++)
                   {
                      for (uint bx = 0; bx < tile_blocks_x; bx++)
                      {
-                        const dxt_pixel_block& block = m_pChunks[chunk_index].m_blocks[tile_block_ofs_y + by][tile_block_ofs_x + bx];
-
-                        uint best_error = UINT_MAX;
-                        uint best_index = 0;
-
-                        for (uint i = 0; i < state.m_selectors_cb.size(); i++)
-                        {
-                           const selectors& s = state.m_selectors_cb[i];
-
-                           uint total_error = 0;
-
-                           for (uint y = 0; y < cBlockPixelHeight; y++)
-                           {
-                              for (uint x = 0; x < cBlockPixelWidth; x++)
-                              {
-                                 const color_quad_u8& a = block.m_pixels[y][x];
-
-                                 uint selector_index = s.m_selectors[y][x];
-                                 if ((block_with_alpha) && (selector_index == 3))
-                                    total_error += 999999;
+                        dxt_pixel_block block;
+                        m_pChunks[chunk_index].get_pixels((tile_block_ofs_x + bx) << cBlockPixelWidthShift, (tile_block_ofs_y + by) << cBlockPixelHeightShift,
+                           cBlockPixelWidth, cBlockPixelHeight, &block.m_pixels[0][0]);
 
-                                 const color_quad_u8& b = block_colors[selector_index];
-
-                                 uint error = color::color_distance(m_params.m_perceptual, a, b, false);
-
-                                 total_error += error;
-                                 if (total_error > best_error)
-                                    goto early_out2;
-                              } // x
-                           } //y
-
-   early_out2:
-                           if (total_error < best_error)
-                           {
-                              best_error = total_error;
-                              best_index = i;
-
-                              if (best_error == 0)
-                                 break;
-                           }
-                        } // i
+                        const uint best_index = find_best_color_selectors(state.m_selectors_cb, &block.m_pixels[0][0], block_colors, block_with_alpha, m_params.m_perceptual);
 
                         CRNLIB_ASSERT( (tile_block_ofs_x + bx) < 2 );
                         CRNLIB_ASSERT( (tile_block_ofs_y + by) < 2 );
@@ -1650,6 +2165,9 @@ namespace crnlib
 
       crnlib::vector<vec16F> training_vecs[cNumCompressedChunkVecs][4];
 
+      const uint8* pColor_to_linear = (m_params.m_format == cETC1) ? g_etc1_to_selector_index : g_dxt1_to_linear;
+      const uint8* pColor_from_linear = (m_params.m_format == cETC1) ? g_selector_index_to_etc1 : g_dxt1_from_linear;
+
       for (uint comp_chunk_index = comp_index_start; comp_chunk_index <= comp_index_end; comp_chunk_index++)
       {
          for (uint i = 0; i < 4; i++)
@@ -1675,8 +2193,19 @@ namespace crnlib
                uint weight;
                if (comp_chunk_index == cColorChunks)
                {
-                  const color_quad_u8 first_color(dxt1_block::unpack_color(static_cast<uint16>(quantized_tile.m_first_endpoint), true));
-                  const color_quad_u8 second_color(dxt1_block::unpack_color(static_cast<uint16>(quantized_tile.m_second_endpoint), true));
+                  color_quad_u8 first_color, second_color;
+                  if (m_params.m_format == cETC1)
+                  {
+                     color_quad_u8 block_colors[cETC1SelectorValues];
+                     etc1_block::get_diff_subblock_colors(block_colors, static_cast<uint16>(quantized_tile.m_first_endpoint), quantized_tile.m_second_endpoint);
+                     first_color = block_colors[0];
+                     second_color = block_colors[cETC1SelectorValues - 1];
+                  }
+                  else
+                  {
+                     first_color = dxt1_block::unpack_color(static_cast<uint16>(quantized_tile.m_first_endpoint), true);
+                     second_color = dxt1_block::unpack_color(static_cast<uint16>(quantized_tile.m_second_endpoint), true);
+                  }
                   const uint dist = color::color_distance(m_params.m_perceptual, first_color, second_color, false);
 
                   weight = dist / cColorDistToWeight;
@@ -1743,7 +2272,7 @@ namespace crnlib
                      if (comp_chunk_index == cColorChunks)
                      {
                         CRNLIB_ASSERT(s < cDXT1SelectorValues);
-                        f = (g_dxt1_to_linear[s] + .5f) * 1.0f/4.0f;
+                        f = (pColor_to_linear[s] + .5f) * 1.0f/4.0f;
                      }
                      else
                      {
@@ -1769,7 +2298,7 @@ namespace crnlib
       timer t;
       t.start();
 
-      selector_vq.generate_codebook(alpha_blocks ? m_params.m_alpha_selector_codebook_size : m_params.m_color_selector_codebook_size);
+      selector_vq.generate_codebook(alpha_blocks ? m_params.m_alpha_selector_codebook_size : m_params.m_color_selector_codebook_size, m_pTask_pool);
 
 #if CRNLIB_ENABLE_DEBUG_MESSAGES
       if (m_params.m_debugging)
@@ -1798,7 +2327,7 @@ namespace crnlib
             else
             {
                s = math::clamp<int>(static_cast<int>(v[j] * 4.0f), 0, 3);
-               s = g_dxt1_from_linear[s];
+               s = pColor_from_linear[s];
             }
 
             selectors_cb[i].m_selectors[j >> 2][j & 3] = static_cast<uint8>(s);
@@ -1878,13 +2407,18 @@ namespace crnlib
                      //const chunk_tile_desc& tile_desc = g_chunk_tile_layouts[tile.m_layout_index];
 
                      color_quad_u8 block_colors[cDXT1SelectorValues];
-                     CRNLIB_ASSERT(tile.m_first_endpoint >= tile.m_second_endpoint);
-                     dxt1_block::get_block_colors4(block_colors, static_cast<uint16>(tile.m_first_endpoint), static_cast<uint16>(tile.m_second_endpoint));
+                     if (m_params.m_format == cETC1)
+                        get_etc1_block_colors(block_colors, tile.m_first_endpoint, tile.m_second_endpoint);
+                     else
+                     {
+                        CRNLIB_ASSERT(tile.m_first_endpoint >= tile.m_second_endpoint);
+                        dxt1_block::get_block_colors4(block_colors, static_cast<uint16>(tile.m_first_endpoint), static_cast<uint16>(tile.m_second_endpoint));
 
-                     if ((tile.m_first_endpoint == tile.m_second_endpoint) && (s == 3))
-                        total_error += 999999;
+                        if ((tile.m_first_endpoint == tile.m_second_endpoint) && (s == 3))
+                           total_error += 999999;
+                     }
 
-                     const color_quad_u8& orig_pixel = m_pChunks[chunk_index](chunk_block_x * cBlockPixelWidth + x, chunk_block_y * cBlockPixelHeight + y);
+                     const color_quad_u8 orig_pixel(m_pChunks[chunk_index](chunk_block_x * cBlockPixelWidth + x, chunk_block_y * cBlockPixelHeight + y));
                      const color_quad_u8& quantized_pixel = block_colors[s];
 
                      const uint error = color::color_distance(m_params.m_perceptual, orig_pixel, quantized_pixel, false);
@@ -1986,7 +2520,7 @@ namespace crnlib
                      CRNLIB_ASSERT(tile.m_first_endpoint >= tile.m_second_endpoint);
                      dxt5_block::get_block_values(block_values, tile.m_first_endpoint, tile.m_second_endpoint);
 
-                     int orig_value = m_pChunks[chunk_index](chunk_block_x * cBlockPixelWidth + x, chunk_block_y * cBlockPixelHeight + y)[m_params.m_alpha_component_indices[alpha_index]];
+                     int orig_value = m_pChunks[chunk_index].get_component(chunk_block_x * cBlockPixelWidth + x, chunk_block_y * cBlockPixelHeight + y, m_params.m_alpha_component_indices[alpha_index]);
                      int quantized_value = block_values[s];
 
                      int error = (orig_value - quantized_value);
@@ -2032,6 +2566,11 @@ namespace crnlib
       if (!m_has_color_blocks)
          return true;
 
+      // The ETC1 optimizer already refines each cluster's base color against the selectors it returns, which are the selectors
+      // the refiner would use.
+      if (m_params.m_format == cETC1)
+         return true;
+
       uint total_refined_tiles = 0;
       uint total_refined_pixels = 0;
 
@@ -2213,7 +2752,7 @@ namespace crnlib
                {
                   selectors.push_back(tile.m_selectors[x + y * tile.m_pixel_width]);
 
-                  pixels.push_back(color_quad_u8(src_pixels(x + tile_layout.m_x_ofs, y + tile_layout.m_y_ofs)[m_params.m_alpha_component_indices[alpha_index]]));
+                  pixels.push_back(color_quad_u8(src_pixels.get_component(x + tile_layout.m_x_ofs, y + tile_layout.m_y_ofs, m_params.m_alpha_component_indices[alpha_index])));
                }
             }
          }
@@ -2303,7 +2842,10 @@ namespace crnlib
                const chunk_tile_desc& layout = g_chunk_tile_layouts[quantized_tile.m_layout_index];
 
                color_quad_u8 block_colors[cDXT1SelectorValues];
-               dxt1_block::get_block_colors(block_colors, static_cast<uint16>(quantized_tile.m_first_endpoint), static_cast<uint16>(quantized_tile.m_second_endpoint));
+               if (m_params.m_format == cETC1)
+                  get_etc1_block_colors(block_colors, quantized_tile.m_first_endpoint, quantized_tile.m_second_endpoint);
+               else
+                  dxt1_block::get_block_colors(block_colors, static_cast<uint16>(quantized_tile.m_first_endpoint), static_cast<uint16>(quantized_tile.m_second_endpoint));
 
                for (uint y = 0; y < layout.m_height; y++)
                {
@@ -2317,8 +2859,8 @@ namespace crnlib
 
                      uint selector = s.m_selectors[chunk_y_ofs & 3][chunk_x_ofs & 3];
 
-                     output_chunk_final(x + layout.m_x_ofs, y + layout.m_y_ofs) = block_colors[selector];
-                     output_chunk_quantized_color_selectors(x + layout.m_x_ofs, y + layout.m_y_ofs) = g_tile_layout_colors[selector];
+                     output_chunk_final.set_pixel(x + layout.m_x_ofs, y + layout.m_y_ofs, block_colors[selector]);
+                     output_chunk_quantized_color_selectors.set_pixel(x + layout.m_x_ofs, y + layout.m_y_ofs, g_tile_layout_colors[selector]);
                   }
                }
             }
@@ -2358,9 +2900,9 @@ namespace crnlib
 
                         CRNLIB_ASSERT(selector < cDXT5SelectorValues);
 
-                        output_chunk_final(x + layout.m_x_ofs, y + layout.m_y_ofs)[m_params.m_alpha_component_indices[a]] = static_cast<uint8>(block_values[selector]);
+                        output_chunk_final.set_component(x + layout.m_x_ofs, y + layout.m_y_ofs, m_params.m_alpha_component_indices[a], static_cast<uint8>(block_values[selector]));
 
-                        output_chunk_quantized_alpha_selectors(x + layout.m_x_ofs, y + layout.m_y_ofs)[m_params.m_alpha_component_indices[a]] = static_cast<uint8>(selector*255/(cDXT5SelectorValues-1));
+                        output_chunk_quantized_alpha_selectors.set_component(x + layout.m_x_ofs, y + layout.m_y_ofs, m_params.m_alpha_component_indices[a], static_cast<uint8>(selector*255/(cDXT5SelectorValues-1)));
                      } //x
                   } // y
                } // tile_index
@@ -2464,6 +3006,217 @@ namespace crnlib
       return true;
    }
 
+   uint dxt_hc::get_chunk_analysis_size(dxt_format fmt)
+   {
+      const uint num_comps = ((fmt == cDXT5) || (fmt == cDXN_XY) || (fmt == cDXN_YX)) ? 2 : 1;
+
+      const uint cBlocksPerChunk = cChunkBlockWidth * cChunkBlockHeight;
+
+      // Per component: the compressed chunk, the endpoint training vector (kept here and by the endpoint clusterizer) and cluster
+      // entry of each tile, and the selector training vector (kept twice as well) and selector user entry of each block.
+      const uint comp_size = sizeof(compressed_chunk) + sizeof(crnlib::vector<vec6F>) +
+         cChunkMaxTiles * (sizeof(vec6F) + vec6F_tree_vq::get_training_vec_size() + sizeof(std::pair<uint, uint>)) +
+         cBlocksPerChunk * (sizeof(vec16F) + vec16F_tree_vq::get_training_vec_size() + sizeof(block_id));
+
+      const uint size = num_comps * comp_size + sizeof(chunk_encoding) + sizeof(uint8);
+
+      // Half again for the spare capacity of the vectors grown a chunk at a time, which is rounded up to a power of 2.
+      return size + size / 2;
+   }
+
+   uint64 dxt_hc::get_codebook_memory_size(const params& p)
+   {
+      const bool has_color = (p.m_format == cDXT1) || (p.m_format == cDXT5) || (p.m_format == cETC1);
+      const uint num_alpha_comps = ((p.m_format == cDXN_XY) || (p.m_format == cDXN_YX)) ? 2 : ((p.m_format == cDXT5) || (p.m_format == cDXT5A)) ? 1 : 0;
+
+      // m_max_endpoint_codebook_size is set for a bitrate search, any pass of which may build codebooks of up to that size.
+      const uint max_size = p.m_max_endpoint_codebook_size;
+
+      uint64 size = 0;
+      if (has_color)
+      {
+         size += static_cast<uint64>(math::maximum(p.m_color_endpoint_codebook_size, max_size)) * vec6F_tree_vq::get_codebook_entry_size();
+         size += static_cast<uint64>(math::maximum(p.m_color_selector_codebook_size, max_size)) * vec16F_tree_vq::get_codebook_entry_size();
+      }
+      if (num_alpha_comps)
+      {
+         size += static_cast<uint64>(math::maximum(p.m_alpha_endpoint_codebook_size, max_size)) * vec2F_tree_vq::get_codebook_entry_size();
+         size += static_cast<uint64>(math::maximum(p.m_alpha_selector_codebook_size, max_size)) * vec16F_tree_vq::get_codebook_entry_size();
+      }
+
+      return size;
+   }
+
+   void dxt_hc::encode_chunks_task(uint64 data, void* pData_ptr)
+   {
+      data;
+      chunk_encoding* pEncodings = static_cast<chunk_encoding*>(pData_ptr);
+
+      uint end_chunk = 0;
+
+      for (uint chunk_index = 0; ; chunk_index++)
+      {
+         if (m_canceled)
+            return;
+
+         if (chunk_index == end_chunk)
+         {
+            const uint first_chunk = static_cast<uint>(atomic_increment32(&m_next_chunk_batch) - 1) * m_chunks_per_batch;
+            if (first_chunk >= m_num_chunks)
+               break;
+
+            chunk_index = first_chunk;
+            end_chunk = math::minimum(first_chunk + m_chunks_per_batch, m_num_chunks);
+
+            if (crn_get_current_thread_id() == m_main_thread_id)
+            {
+               if (!update_progress(19, first_chunk, m_num_chunks))
+                  return;
+            }
+         }
+
+         const pixel_chunk& pixels = m_pChunks[chunk_index];
+
+         chunk_encoding& encoding = pEncodings[chunk_index];
+         encoding = chunk_encoding();
+
+         for (uint q = 0; q < cNumCompressedChunkVecs; q++)
+         {
+            if (m_compressed_chunks[q].empty())
+               continue;
+
+            const compressed_chunk& chunk = m_compressed_chunks[q][chunk_index];
+
+            encoding.m_encoding_index = chunk.m_encoding_index;
+            encoding.m_num_tiles = chunk.m_num_tiles;
+
+            const uint alpha_pixel_comp = (q != cColorChunks) ? m_params.m_alpha_component_indices[q - cAlpha0Chunks] : 0;
+
+            for (uint tile_index = 0; tile_index < chunk.m_num_tiles; tile_index++)
+            {
+               const compressed_tile& tile = chunk.m_tiles[tile_index];
+
+               const chunk_tile_desc& layout = g_chunk_tile_layouts[tile.m_layout_index];
+
+               uint cluster_index;
+               if (q == cColorChunks)
+                  cluster_index = m_color_endpoint_vq.find_best_codebook_entry_fs(compute_color_training_vec(pixels, tile));
+               else
+                  cluster_index = m_alpha_endpoint_vq.find_best_codebook_entry_fs(compute_alpha_training_vec(pixels, tile, alpha_pixel_comp));
+
+               encoding.m_endpoint_indices[q][tile_index] = static_cast<uint16>(cluster_index);
+
+               const tile_cluster& cluster = (q == cColorChunks) ? m_color_clusters[cluster_index] : m_alpha_clusters[cluster_index];
+
+               color_quad_u8 block_colors[cDXT1SelectorValues];
+               uint block_values[cDXT5SelectorValues];
+               bool block_with_alpha = false;
+
+               if (q != cColorChunks)
+                  dxt5_block::get_block_values(block_values, cluster.m_first_endpoint, cluster.m_second_endpoint);
+               else if (m_params.m_format == cETC1)
+                  get_etc1_block_colors(block_colors, cluster.m_first_endpoint, cluster.m_second_endpoint);
+               else
+               {
+                  dxt1_block::get_block_colors4(block_colors, static_cast<uint16>(cluster.m_first_endpoint), static_cast<uint16>(cluster.m_second_endpoint));
+                  block_with_alpha = (cluster.m_first_endpoint == cluster.m_second_endpoint);
+               }
+
+               const uint end_block_x = (layout.m_x_ofs + layout.m_width) >> 2;
+               const uint end_block_y = (layout.m_y_ofs + layout.m_height) >> 2;
+
+               for (uint by = layout.m_y_ofs >> 2; by < end_block_y; by++)
+               {
+                  for (uint bx = layout.m_x_ofs >> 2; bx < end_block_x; bx++)
+                  {
+                     uint selector_index;
+
+                     if (q == cColorChunks)
+                     {
+                        dxt_pixel_block block;
+                        pixels.get_pixels(bx << cBlockPixelWidthShift, by << cBlockPixelHeightShift, cBlockPixelWidth, cBlockPixelHeight, &block.m_pixels[0][0]);
+
+                        selector_index = find_best_color_selectors(m_color_selectors, &block.m_pixels[0][0], block_colors, block_with_alpha, m_params.m_perceptual);
+                     }
+                     else
+                     {
+                        uint8 block_alpha[cBlockPixelWidth * cBlockPixelHeight];
+                        pixels.get_component_values(bx << cBlockPixelWidthShift, by << cBlockPixelHeightShift, cBlockPixelWidth, cBlockPixelHeight, alpha_pixel_comp, block_alpha);
+
+                        selector_index = find_best_alpha_selectors(m_alpha_selectors, block_alpha, block_values);
+                     }
+
+                     encoding.m_selector_indices[q][by][bx] = static_cast<uint16>(selector_index);
+                  } // bx
+               } // by
+            } // tile_index
+         } // q
+      } // chunk_index
+   }
+
+   bool dxt_hc::encode_chunks(uint num_chunks, const pixel_chunk* pChunks, uint level_index, chunk_encoding* pEncodings, task_pool& task_pool)
+   {
+      if ((!num_chunks) || (!pChunks) || (!pEncodings))
+         return false;
+
+      // The codebooks and endpoint trees of the last compress() call must still be around.
+      if ((!m_params.m_reuse_analysis) || (m_chunk_encoding.empty()))
+         return false;
+      if ((m_has_color_blocks) && (!m_color_endpoint_vq_size))
+         return false;
+      if ((m_num_alpha_blocks) && (!m_alpha_endpoint_vq_size))
+         return false;
+
+      m_pTask_pool = &task_pool;
+      m_main_thread_id = crn_get_current_thread_id();
+
+      // Set the analysis of the chunks the codebooks were built from aside, so a later compress() call can still reuse it.
+      const uint analyzed_num_chunks = m_num_chunks;
+      const pixel_chunk* pAnalyzed_chunks = m_pChunks;
+      const atomic32_t analyzed_total_tiles = m_total_tiles;
+
+      compressed_chunk_vec analyzed_chunks[cNumCompressedChunkVecs];
+      for (uint i = 0; i < cNumCompressedChunkVecs; i++)
+         analyzed_chunks[i].swap(m_compressed_chunks[i]);
+
+      crnlib::vector<uint8> analyzed_chunk_levels;
+      analyzed_chunk_levels.swap(m_chunk_levels);
+
+      m_num_chunks = num_chunks;
+      m_pChunks = pChunks;
+
+      m_chunk_levels.resize(num_chunks);
+      m_chunk_levels.set_all(static_cast<uint8>(level_index));
+
+      bool status = determine_compressed_chunks();
+
+      if (status)
+      {
+         // Same batches as determine_compressed_chunks().
+         m_next_chunk_batch = 0;
+
+         for (uint i = 0; i <= m_pTask_pool->get_num_threads(); i++)
+            m_pTask_pool->queue_object_task(this, &dxt_hc::encode_chunks_task, i, pEncodings);
+
+         m_pTask_pool->join();
+
+         status = !m_canceled;
+      }
+
+      m_num_chunks = analyzed_num_chunks;
+      m_pChunks = pAnalyzed_chunks;
+      m_total_tiles = analyzed_total_tiles;
+
+      for (uint i = 0; i < cNumCompressedChunkVecs; i++)
+         m_compressed_chunks[i].swap(analyzed_chunks[i]);
+
+      m_chunk_levels.swap(analyzed_chunk_levels);
+
+      m_pTask_pool = NULL;
+
+      return status;
+   }
+
    void dxt_hc::create_debug_image_from_chunks(uint num_chunks_x, uint num_chunks_y, const pixel_chunk_vec& chunks, const chunk_encoding_vec *pChunk_encodings, image_u8& img, bool serpentine_scan, int comp_index)
    {
       if (chunks.empty())
@@ -2486,7 +3239,7 @@ namespace crnlib
             {
                for (uint cy = 0; cy < cChunkPixelHeight; cy++)
                   for (uint cx = 0; cx < cChunkPixelWidth; cx++)
-                     img(x * cChunkPixelWidth + cx, y * cChunkPixelHeight + cy) = chunks[c](cx, cy)[comp_index];
+                     img(x * cChunkPixelWidth + cx, y * cChunkPixelHeight + cy) = chunks[c].get_component(cx, cy, comp_index);
             }
             else
             {
@@ -3,6 +3,7 @@
 #pragma once
 #include "crn_dxt1.h"
 #include "crn_dxt5a.h"
+#include "crn_etc.h"
 #include "crn_dxt_endpoint_refiner.h"
 #include "crn_image.h"
 #include "crn_dxt.h"
@@ -24,28 +25,58 @@ namespace crnlib
       dxt_hc();
       ~dxt_hc();
 
-      struct pixel_chunk
+      // An 8x8 chunk of pixels, stored as separate R, G, B and A planes of 64 bytes each (row by row), so passes over a single
+      // component only touch that component's plane.
+      struct CRNLIB_ALIGNED(16) pixel_chunk
       {
          pixel_chunk() { clear(); }
 
-         dxt_pixel_block m_blocks[cChunkBlockHeight][cChunkBlockWidth];
+         enum { cPlaneSize = cChunkPixelWidth * cChunkPixelHeight };
 
-         const color_quad_u8& operator() (uint cx, uint cy) const
+         uint8 m_planes[4][cPlaneSize];
+
+         inline color_quad_u8 operator() (uint cx, uint cy) const
          {
             CRNLIB_ASSERT((cx < cChunkPixelWidth) && (cy < cChunkPixelHeight));
 
-            return m_blocks[cy >> cBlockPixelHeightShift][cx >> cBlockPixelWidthShift].m_pixels
-                           [cy & (cBlockPixelHeight - 1)][cx & (cBlockPixelWidth - 1)];
+            const uint i = cx + cy * cChunkPixelWidth;
+            return color_quad_u8(m_planes[0][i], m_planes[1][i], m_planes[2][i], m_planes[3][i]);
+         }
+
+         inline uint8 get_component(uint cx, uint cy, uint comp_index) const
+         {
+            CRNLIB_ASSERT((cx < cChunkPixelWidth) && (cy < cChunkPixelHeight) && (comp_index < 4));
+
+            return m_planes[comp_index][cx + cy * cChunkPixelWidth];
          }
 
-         color_quad_u8& operator() (uint cx, uint cy)
+         inline void set_pixel(uint cx, uint cy, const color_quad_u8& c)
          {
             CRNLIB_ASSERT((cx < cChunkPixelWidth) && (cy < cChunkPixelHeight));
 
-            return m_blocks[cy >> cBlockPixelHeightShift][cx >> cBlockPixelWidthShift].m_pixels
-                           [cy & (cBlockPixelHeight - 1)][cx & (cBlockPixelWidth - 1)];
+            const uint i = cx + cy * cChunkPixelWidth;
+            m_planes[0][i] = c.r;
+            m_planes[1][i] = c.g;
+            m_planes[2][i] = c.b;
+            m_planes[3][i] = c.a;
          }
 
+         inline void set_component(uint cx, uint cy, uint comp_index, uint8 v)
+         {
+            CRNLIB_ASSERT((cx < cChunkPixelWidth) && (cy < cChunkPixelHeight) && (comp_index < 4));
+
+            m_planes[comp_index][cx + cy * cChunkPixelWidth] = v;
+         }
+
+         inline const uint8* get_plane(uint comp_index) const { CRNLIB_ASSERT(comp_index < 4); return m_planes[comp_index]; }
+         inline uint8* get_plane(uint comp_index) { CRNLIB_ASSERT(comp_index < 4); return m_planes[comp_index]; }
+
+         // Interleaves a width x height rectangle of the chunk into pPixels, row by row.
+         void get_pixels(uint x_ofs, uint y_ofs, uint width, uint height, color_quad_u8* pPixels) const;
+
+         // Copies a width x height rectangle of one component's plane into pValues, row by row.
+         void get_component_values(uint x_ofs, uint y_ofs, uint width, uint height, uint comp_index, uint8* pValues) const;
+
          inline void clear()
          {
             utils::zero_object(*this);
@@ -69,9 +100,12 @@ namespace crnlib
             m_adaptive_tile_color_alpha_weighting_ratio(3.0f),
             m_num_levels(0),
             m_format(cDXT1),
+            m_dxt_quality(cCRNDXTQualityUber),
             m_hierarchical(true),
             m_perceptual(true),
             m_debugging(false),
+            m_reuse_analysis(false),
+            m_max_endpoint_codebook_size(0),
             m_pProgress_func(NULL),
             m_pProgress_func_data(NULL)
          {
@@ -113,8 +147,13 @@ namespace crnlib
          miplevel_desc m_levels[cCRNMaxLevels];
          uint        m_num_levels;
 
+         // cDXT1, cDXT5, cDXT5A, cDXN_XY, cDXN_YX or cETC1. ETC1 tiles use a single 555 base color and intensity table for both
+         // subblocks of all their blocks, and are stored like DXT1 tiles with the base color as the first endpoint and the table as the second.
          dxt_format  m_format;
 
+         // Only used by cETC1, which fits the tiles with the cCRNETCQuality level matching it (like dxt_image does for ETC1).
+         crn_dxt_quality m_dxt_quality;
+
          // If m_hierarchical is false, only 4x4 blocks will be used by the encoder (leading to higher quality/larger files).
          bool        m_hierarchical;
 
@@ -123,6 +162,14 @@ namespace crnlib
 
          bool        m_debugging;
 
+         // If m_reuse_analysis is true, the chunk analysis, endpoint cluster trees and cluster endpoints are kept after compress() returns, and the
+         // next compress() call on the same (unmodified) chunks with params that only differ in their codebook sizes reuses them.
+         // The endpoint trees are built up to m_max_endpoint_codebook_size entries, so any smaller codebook can be cut from them.
+         // The selector codebook isn't kept, as it's trained on the tiles' selectors quantized with the new endpoint codebook.
+         // Ignored when m_debugging is true, except that encode_chunks() needs it.
+         bool        m_reuse_analysis;
+         uint        m_max_endpoint_codebook_size;
+
          crn_progress_callback_func m_pProgress_func;
          void*       m_pProgress_func_data;
       };
@@ -156,6 +203,17 @@ namespace crnlib
       inline const chunk_encoding& get_chunk_encoding(uint chunk_index) const { return m_chunk_encoding[chunk_index]; }
       inline const chunk_encoding_vec& get_chunk_encoding_vec() const { return m_chunk_encoding; }
 
+      // Encodes further chunks, all of mip level level_index, with the codebooks of the last compress() call, which must have been
+      // made with params::m_reuse_analysis set. The codebooks aren't changed: each tile goes to the endpoint cluster its training
+      // vector falls in, and each block gets the selector codebook entry that fits it best with its tile's endpoints.
+      bool encode_chunks(uint num_chunks, const pixel_chunk* pChunks, uint level_index, chunk_encoding* pEncodings, task_pool& task_pool);
+
+      // Rough number of bytes compress() and encode_chunks() use per chunk of the given format, not counting the chunk itself.
+      static uint get_chunk_analysis_size(dxt_format fmt);
+
+      // Rough number of bytes compress() uses for the codebooks of the given parameters, however many chunks it's given.
+      static uint64 get_codebook_memory_size(const params& p);
+
       struct selectors
       {
          selectors() { utils::zero_object(*this); }
@@ -275,6 +333,11 @@ namespace crnlib
 
       atomic32_t m_total_tiles;
 
+      // Mip level of each chunk, and the contiguous batches of chunks determine_compressed_chunks_task() and encode_chunks_task() claim.
+      crnlib::vector<uint8> m_chunk_levels;
+      uint m_chunks_per_batch;
+      volatile atomic32_t m_next_chunk_batch;
+
       void compress_dxt1_block(
          dxt1_endpoint_optimizer::results& results,
          uint chunk_index, const image_u8& chunk, uint x_ofs, uint y_ofs, uint width, uint height,
@@ -282,9 +345,14 @@ namespace crnlib
 
       void compress_dxt5_block(
          dxt5_endpoint_optimizer::results& results,
-         uint chunk_index, const image_u8& chunk, uint x_ofs, uint y_ofs, uint width, uint height, uint component_index,
+         uint chunk_index, const pixel_chunk& chunk, uint x_ofs, uint y_ofs, uint width, uint height, uint component_index,
          uint8* pAlpha_selectors);
 
+      void compress_etc1_block(
+         uint& packed_color5, uint& inten_table,
+         const image_u8& chunk, uint x_ofs, uint y_ofs, uint width, uint height,
+         uint8* pColor_selectors);
+
       void determine_compressed_chunks_task(uint64 data, void* pData_ptr);
       bool determine_compressed_chunks();
 
@@ -308,6 +376,43 @@ namespace crnlib
       tile_cluster_vec m_color_clusters;
       tile_cluster_vec m_alpha_clusters;
 
+      // Endpoint optimizer output of a cluster, kept per endpoint tree node while the analysis is reused. Most clusters come out
+      // with exactly the same tiles when the codebook sizes only change a little, so they don't need to be optimized again.
+      struct endpoint_cluster_result
+      {
+         endpoint_cluster_result() : m_first_endpoint(0), m_second_endpoint(0), m_error(0), m_alpha_encoding(false) { }
+
+         void set(const tile_cluster& cluster, const crnlib::vector<uint8>& selectors)
+         {
+            m_tiles = cluster.m_tiles;
+            m_selectors = selectors;
+            m_first_endpoint = cluster.m_first_endpoint;
+            m_second_endpoint = cluster.m_second_endpoint;
+            m_error = cluster.m_error;
+            m_alpha_encoding = cluster.m_alpha_encoding;
+         }
+
+         void clear()
+         {
+            m_tiles.clear();
+            m_selectors.clear();
+         }
+
+         crnlib::vector< std::pair<uint, uint> > m_tiles;
+         crnlib::vector<uint8> m_selectors;
+
+         uint m_first_endpoint;
+         uint m_second_endpoint;
+         uint64 m_error;
+
+         bool m_alpha_encoding;
+      };
+
+      typedef crnlib::vector<endpoint_cluster_result> endpoint_cluster_result_vec;
+
+      endpoint_cluster_result_vec m_color_cluster_results;
+      endpoint_cluster_result_vec m_alpha_cluster_results;
+
       selectors_vec m_color_selectors;
       selectors_vec m_alpha_selectors;
 
@@ -362,6 +467,17 @@ namespace crnlib
       typedef tree_clusterizer<vec6F> vec6F_tree_vq;
       typedef tree_clusterizer<vec16F> vec16F_tree_vq;
 
+      // Chunk analysis kept across compress() calls (see params::m_reuse_analysis).
+      bool m_analysis_valid;
+
+      crnlib::vector< crnlib::vector<vec6F> > m_color_training_vecs;
+      vec6F_tree_vq m_color_endpoint_vq;
+      uint m_color_endpoint_vq_size;
+
+      crnlib::vector< crnlib::vector<vec2F> > m_alpha_training_vecs[2];
+      vec2F_tree_vq m_alpha_endpoint_vq;
+      uint m_alpha_endpoint_vq_size;
+
       struct assign_color_endpoint_clusters_state
       {
          CRNLIB_NO_COPY_OR_ASSIGNMENT_OP(assign_color_endpoint_clusters_state);
@@ -399,16 +515,26 @@ namespace crnlib
          mutable spinlock                    m_chunk_blocks_using_selectors_lock;
       };
 
+      vec6F compute_color_training_vec(const pixel_chunk& chunk, const compressed_tile& tile) const;
+      vec2F compute_alpha_training_vec(const pixel_chunk& chunk, const compressed_tile& tile, uint comp_index) const;
+
       void assign_color_endpoint_clusters_task(uint64 data, void* pData_ptr);
+      bool create_color_endpoint_training_vecs();
       bool determine_color_endpoint_clusters();
 
       struct determine_alpha_endpoint_clusters_state
       {
-         vec2F_tree_vq m_vq;
-         crnlib::vector< crnlib::vector<vec2F> > m_training_vecs[2];
+         CRNLIB_NO_COPY_OR_ASSIGNMENT_OP(determine_alpha_endpoint_clusters_state);
+
+         determine_alpha_endpoint_clusters_state(vec2F_tree_vq& vq, crnlib::vector< crnlib::vector<vec2F> >* pTraining_vecs) :
+            m_vq(vq), m_pTraining_vecs(pTraining_vecs) { }
+
+         vec2F_tree_vq& m_vq;
+         crnlib::vector< crnlib::vector<vec2F> >* m_pTraining_vecs;
       };
 
       void determine_alpha_endpoint_clusters_task(uint64 data, void* pData_ptr);
+      bool create_alpha_endpoint_training_vecs();
       bool determine_alpha_endpoint_clusters();
 
       void determine_color_endpoint_codebook_task(uint64 data, void* pData_ptr);
@@ -428,7 +554,13 @@ namespace crnlib
       bool refine_quantized_alpha_selectors();
       void create_final_debug_image();
       bool create_chunk_encodings();
+      void encode_chunks_task(uint64 data, void* pData_ptr);
       bool update_progress(uint phase_index, uint subphase_index, uint subphase_total);
+      void clear_codebooks();
+      void clear_endpoint_trees();
+      void prepare_endpoint_cluster_results(endpoint_cluster_result_vec& results, uint num_nodes);
+      void prune_endpoint_cluster_results(endpoint_cluster_result_vec& results, const crnlib::vector<uint>& cluster_nodes);
+      bool compress_codebooks();
       bool compress_internal(const params& p, uint num_chunks, const pixel_chunk* pChunks);
    };
 
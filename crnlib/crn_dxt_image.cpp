@@ -228,9 +228,38 @@ namespace crnlib
       const image_u8*               m_pImg;
       const dxt_image::pack_params* m_pParams;
       crn_thread_id_t               m_main_thread;
+      uint                          m_num_tasks;
+      uint                          m_blocks_per_chunk;
+      uint                          m_num_chunks;
+      atomic32_t                    m_next_chunk;
+      atomic32_t                    m_blocks_completed;
       atomic32_t                    m_canceled;
    };
 
+   void dxt_image::init_block(uint block_x, uint block_y, const image_u8& img, const pack_params& p, set_block_pixels_context& context)
+   {
+      color_quad_u8 pixels[cDXTBlockSize * cDXTBlockSize];
+
+      const uint pixel_ofs_x = block_x * cDXTBlockSize;
+      const uint pixel_ofs_y = block_y * cDXTBlockSize;
+
+      for (uint y = 0; y < cDXTBlockSize; y++)
+      {
+         const uint iy = math::minimum(pixel_ofs_y + y, img.get_height() - 1);
+
+         for (uint x = 0; x < cDXTBlockSize; x++)
+         {
+            const uint ix = math::minimum(pixel_ofs_x + x, img.get_width() - 1);
+
+            pixels[x + y * cDXTBlockSize] = img(ix, iy);
+         }
+      }
+
+      set_block_pixels(block_x, block_y, pixels, p, context);
+   }
+
+   // Each task repeatedly claims the next contiguous run of blocks (in raster order) until none are left, so threads
+   // work on disjoint cache lines of the source image and destination elements, and fast tasks pick up the slack of slow ones.
    void dxt_image::init_task(uint64 data, void* pData_ptr)
    {
       const uint thread_index = static_cast<uint>(data);
@@ -240,23 +269,65 @@ namespace crnlib
       const pack_params& p = *pInit_params->m_pParams;
       const bool is_main_thread = (crn_get_current_thread_id() == pInit_params->m_main_thread);
 
-      uint block_index = 0;
-
       set_block_pixels_context optimizer_context;
       int prev_progress_percentage = -1;
 
-      for (uint block_y = 0; block_y < m_blocks_y; block_y++)
+      if (p.m_interleaved_blocks)
       {
-         const uint pixel_ofs_y = block_y * cDXTBlockSize;
+         uint block_index = 0;
 
-         for (uint block_x = 0; block_x < m_blocks_x; block_x++, block_index++)
+         for (uint block_y = 0; block_y < m_blocks_y; block_y++)
+         {
+            for (uint block_x = 0; block_x < m_blocks_x; block_x++, block_index++)
+            {
+               if (pInit_params->m_canceled)
+                  return;
+
+               if (p.m_pProgress_callback && is_main_thread && ((block_index & 63) == 63))
+               {
+                  const uint progress_percentage = p.m_progress_start + ((block_index * p.m_progress_range + get_total_blocks() / 2) / get_total_blocks());
+                  if ((int)progress_percentage != prev_progress_percentage)
+                  {
+                     prev_progress_percentage = progress_percentage;
+                     if (!(p.m_pProgress_callback)(progress_percentage, p.m_pProgress_callback_user_data_ptr))
+                     {
+                        atomic_exchange32(&pInit_params->m_canceled, CRNLIB_TRUE);
+                        return;
+                     }
+                  }
+               }
+
+               if ((block_index % pInit_params->m_num_tasks) != thread_index)
+                  continue;
+
+               init_block(block_x, block_y, img, p, optimizer_context);
+            }
+         }
+
+         return;
+      }
+
+      for ( ; ; )
+      {
+         const uint chunk_index = static_cast<uint>(atomic_increment32(&pInit_params->m_next_chunk) - 1);
+         if (chunk_index >= pInit_params->m_num_chunks)
+            break;
+
+         const uint first_block = chunk_index * pInit_params->m_blocks_per_chunk;
+         const uint end_block = math::minimum(first_block + pInit_params->m_blocks_per_chunk, m_total_blocks);
+
+         uint block_x = first_block % m_blocks_x;
+         uint block_y = first_block / m_blocks_x;
+
+         for (uint block_index = first_block; block_index < end_block; block_index++)
          {
             if (pInit_params->m_canceled)
                return;
 
-            if (p.m_pProgress_callback && is_main_thread && ((block_index & 63) == 63))
+            if (p.m_pProgress_callback && is_main_thread && (((block_index - first_block) & 63) == 63))
             {
-               const uint progress_percentage = p.m_progress_start + ((block_index * p.m_progress_range + get_total_blocks() / 2) / get_total_blocks());
+               const uint total_completed = pInit_params->m_blocks_completed + (block_index - first_block);
+               const uint progress_percentage = p.m_progress_start + ((total_completed * p.m_progress_range + get_total_blocks() / 2) / get_total_blocks());
                if ((int)progress_percentage != prev_progress_percentage)
                {
                   prev_progress_percentage = progress_percentage;
@@ -268,30 +339,16 @@ namespace crnlib
                }
             }
 
-            if (p.m_num_helper_threads)
-            {
-               if ((block_index % (p.m_num_helper_threads + 1)) != thread_index)
-                  continue;
-            }
-
-            color_quad_u8 pixels[cDXTBlockSize * cDXTBlockSize];
+            init_block(block_x, block_y, img, p, optimizer_context);
 
-            const uint pixel_ofs_x = block_x * cDXTBlockSize;
-
-            for (uint y = 0; y < cDXTBlockSize; y++)
+            if (++block_x == m_blocks_x)
             {
-               const uint iy = math::minimum(pixel_ofs_y + y, img.get_height() - 1);
-
-               for (uint x = 0; x < cDXTBlockSize; x++)
-               {
-                  const uint ix = math::minimum(pixel_ofs_x + x, img.get_width() - 1);
-
-                  pixels[x + y * cDXTBlockSize] = img(ix, iy);
-               }
+               block_x = 0;
+               block_y++;
             }
-
-            set_block_pixels(block_x, block_y, pixels, p, optimizer_context);
          }
+
+         atomic_add32(&pInit_params->m_blocks_completed, end_block - first_block);
       }
    }
 
@@ -416,9 +473,18 @@ namespace crnlib
       init_params.m_pImg = &img;
       init_params.m_pParams = &p;
       init_params.m_main_thread = crn_get_current_thread_id();
+      init_params.m_num_tasks = pPool->get_num_threads() + 1;
       init_params.m_canceled = false;
 
-      for (uint i = 0; i <= p.m_num_helper_threads; i++)
+      // Hand out roughly cChunksPerTask chunks to each task so uneven regions still balance out, but keep every chunk big
+      // enough that claiming it is cheap next to packing it.
+      const uint cChunksPerTask = 8, cMinBlocksPerChunk = 32;
+      init_params.m_blocks_per_chunk = math::maximum<uint>(cMinBlocksPerChunk, (m_total_blocks + init_params.m_num_tasks * cChunksPerTask - 1) / (init_params.m_num_tasks * cChunksPerTask));
+      init_params.m_num_chunks = (m_total_blocks + init_params.m_blocks_per_chunk - 1) / init_params.m_blocks_per_chunk;
+      init_params.m_next_chunk = 0;
+      init_params.m_blocks_completed = 0;
+
+      for (uint i = 0; i < init_params.m_num_tasks; i++)
          pPool->queue_object_task(this, &dxt_image::init_task, i, &init_params);
 
       pPool->join();
@@ -105,6 +105,7 @@ namespace crnlib
             m_progress_range = 100;
             m_use_transparent_indices_for_black = false;
             m_pTask_pool = NULL;
+            m_interleaved_blocks = false;
             m_color_weights[0] = 1;
             m_color_weights[1] = 1;
             m_color_weights[2] = 1;
@@ -114,6 +115,7 @@ namespace crnlib
          {
             m_perceptual = (params.m_flags & cCRNCompFlagPerceptual) != 0;
             m_num_helper_threads = params.m_num_helper_threads;
+            m_pTask_pool = static_cast<task_pool*>(params.m_pThread_pool);
             m_use_both_block_types = (params.m_flags & cCRNCompFlagUseBothBlockTypes) != 0;
             m_use_transparent_indices_for_black = (params.m_flags & cCRNCompFlagUseTransparentIndicesForBlack) != 0;
             m_dxt1a_alpha_threshold = params.m_dxt1a_alpha_threshold;
@@ -147,6 +149,9 @@ namespace crnlib
 
          task_pool               *m_pTask_pool;
 
+         // Assign blocks to tasks round-robin instead of in contiguous chunks. Slower, only kept for benchmarking.
+         bool                    m_interleaved_blocks;
+
          int                     m_color_weights[3];
       };
       
@@ -236,6 +241,7 @@ namespace crnlib
       
       bool init_internal(dxt_format fmt, uint width, uint height);
       void init_task(uint64 data, void* pData_ptr);
+      void init_block(uint block_x, uint block_y, const image_u8& img, const pack_params& p, set_block_pixels_context& context);
 
 #if CRNLIB_SUPPORT_ATI_COMPRESS   
       bool init_ati_compress(dxt_format fmt, const image_u8& img, const pack_params& p);
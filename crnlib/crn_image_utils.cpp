@@ -601,10 +601,16 @@ namespace crnlib
             }
          }
 
-         task_pool tp;
-         tp.init(g_number_of_processors - 1);
+         task_pool tmp_pool;
+         task_pool* pPool = params.m_pTask_pool;
+         if (!pPool)
+         {
+            if (!tmp_pool.init(g_number_of_processors - 1))
+               return false;
+            pPool = &tmp_pool;
+         }
 
-         threaded_resampler resampler(tp);
+         threaded_resampler resampler(*pPool);
          threaded_resampler::params p;
          p.m_src_width = src_width;
          p.m_src_height = src_height;
@@ -712,7 +718,8 @@ namespace crnlib
 
       bool resample(const image_u8& src, image_u8& dst, const resample_params& params)
       {
-         if ((params.m_multithreaded) && (g_number_of_processors > 1))
+         const bool have_helper_threads = params.m_pTask_pool ? (params.m_pTask_pool->get_num_threads() > 0) : (g_number_of_processors > 1);
+         if ((params.m_multithreaded) && (have_helper_threads))
             return resample_multithreaded(src, dst, params);
          else
             return resample_single_thread(src, dst, params);
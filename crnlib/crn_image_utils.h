@@ -6,6 +6,8 @@
 
 namespace crnlib
 {
+   class task_pool;
+
    enum pixel_format;
 
    namespace image_utils
@@ -62,7 +64,8 @@ namespace crnlib
             m_first_comp(0),
             m_num_comps(4),
             m_source_gamma(2.2f), // 1.75f
-            m_multithreaded(true)
+            m_multithreaded(true),
+            m_pTask_pool(NULL)
          {
          }
 
@@ -76,6 +79,9 @@ namespace crnlib
          uint        m_num_comps;
          float       m_source_gamma;
          bool        m_multithreaded;
+
+         // Optional pool used when m_multithreaded is true. If NULL a temporary pool is created.
+         task_pool*  m_pTask_pool;
       };
 
       bool resample_single_thread(const image_u8& src, image_u8& dst, const resample_params& params);
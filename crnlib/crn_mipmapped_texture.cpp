@@ -2069,13 +2069,18 @@ namespace crnlib
          q1_params.m_perceptual = false;
       }
 
-      task_pool tp;
-      if (!tp.init(p.m_num_helper_threads))
-         return false;
+      task_pool tmp_pool;
+      task_pool* pPool = p.m_pTask_pool;
+      if (!pPool)
+      {
+         if (!tmp_pool.init(p.m_num_helper_threads))
+            return false;
+         pPool = &tmp_pool;
+      }
 
       mipmapped_texture packed_tex;
 
-      qdxt_state state(tp);
+      qdxt_state state(*pPool);
       if (!src_tex.qdxt_pack_init(state, packed_tex, q1_params, q5_params, fmt, false))
          return false;
 
@@ -2247,6 +2252,7 @@ namespace crnlib
          rparams.m_wrapping = params.m_wrapping;
          rparams.m_pFilter = params.m_pFilter;
          rparams.m_multithreaded = params.m_multithreaded;
+         rparams.m_pTask_pool = params.m_pTask_pool;
 
          if (!image_utils::resample(*pImg, *pMip, rparams))
          {
@@ -2335,6 +2341,7 @@ namespace crnlib
                rparams.m_wrapping = params.m_wrapping;
                rparams.m_pFilter = params.m_pFilter;
                rparams.m_multithreaded = params.m_multithreaded;
+               rparams.m_pTask_pool = params.m_pTask_pool;
 
                if (!image_utils::resample(*pImg, *pMip, rparams))
                {
@@ -3144,6 +3151,8 @@ namespace crnlib
       console::debug("Color selectors: %u", p.m_crn_color_selector_palette_size);
       console::debug("Alpha endpoints: %u", p.m_crn_alpha_endpoint_palette_size);
       console::debug("Alpha selectors: %u", p.m_crn_alpha_selector_palette_size);
+      console::debug("Slice chunk rows: %u", p.m_crn_slice_chunk_rows);
+      console::debug("Memory limit: %uMB", p.m_crn_memory_limit_mb);
       console::debug("Flags:");
       console::debug("    Perceptual: %u", p.get_flag(cCRNCompFlagPerceptual));
       console::debug("  Hierarchical: %u", p.get_flag(cCRNCompFlagHierarchical));
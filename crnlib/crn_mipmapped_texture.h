@@ -221,7 +221,8 @@ namespace crnlib
             m_renormalize(false),
             m_filter_scale(.9f),
             m_gamma(1.75f),    // or 2.2f
-            m_multithreaded(true)
+            m_multithreaded(true),
+            m_pTask_pool(NULL)
          {
          }
 
@@ -232,6 +233,7 @@ namespace crnlib
          float       m_filter_scale;
          float       m_gamma;
          bool        m_multithreaded;
+         task_pool*  m_pTask_pool;
       };
 
       bool resize(uint new_width, uint new_height, const resample_params& params);
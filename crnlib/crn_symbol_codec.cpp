@@ -56,6 +56,17 @@ namespace crnlib
       return total;
    }
 
+   symbol_histogram& symbol_histogram::operator+= (const symbol_histogram& other)
+   {
+      if (other.m_hist.size() > m_hist.size())
+         m_hist.resize(other.m_hist.size());
+
+      for (uint i = 0; i < other.m_hist.size(); i++)
+         inc_freq(i, other.m_hist[i]);
+
+      return *this;
+   }
+
    adaptive_huffman_data_model::adaptive_huffman_data_model(bool encoding, uint total_syms) :
       m_total_syms(0),
       m_update_cycle(0),
@@ -452,6 +463,16 @@ namespace crnlib
       return init(encoding, hist.size(), hist.get_ptr(), code_size_limit);
    }
 
+   uint64 static_huffman_data_model::get_total_cost(const symbol_histogram& hist) const
+   {
+      CRNLIB_ASSERT(hist.size() <= m_code_sizes.size());
+
+      uint64 total = 0;
+      for (uint i = 0; i < hist.size(); i++)
+         total += static_cast<uint64>(hist[i]) * m_code_sizes[i];
+      return total;
+   }
+
    bool static_huffman_data_model::prepare_decoder_tables()
    {
       uint total_syms = m_code_sizes.size();
@@ -47,6 +47,9 @@ namespace crnlib
 
       uint64 get_total() const;
 
+      // Adds other's frequencies to this histogram, growing it if needed.
+      symbol_histogram& operator+= (const symbol_histogram& other);
+
    private:
       crnlib::vector<uint> m_hist;
    };
@@ -112,6 +115,9 @@ namespace crnlib
       uint get_total_syms() const { return m_total_syms; }
       uint get_cost(uint sym) const { return m_code_sizes[sym]; }
 
+      // Returns the number of bits needed to code every symbol counted in hist with this model.
+      uint64 get_total_cost(const symbol_histogram& hist) const;
+
       const uint8* get_code_sizes() const { return m_code_sizes.empty() ? NULL : &m_code_sizes[0]; }
 
    private:
@@ -447,7 +447,9 @@ namespace crnlib
          res_params.m_filter_scale = 1.0f;
          res_params.m_gamma = mipmap_params.m_gamma;
          res_params.m_srgb = srgb;
-         res_params.m_multithreaded = (params.m_num_helper_threads > 0);
+         // The multithreaded resampler keeps float copies of the whole image, several times its size.
+         res_params.m_multithreaded = ((params.m_num_helper_threads > 0) || (params.m_pThread_pool != NULL)) && (!params.m_crn_memory_limit_mb);
+         res_params.m_pTask_pool = static_cast<task_pool*>(params.m_pThread_pool);
 
          if (!work_tex.resize(new_width, new_height, res_params))
          {
@@ -469,7 +471,8 @@ namespace crnlib
          gen_params.m_filter_scale = mipmap_params.m_blurriness;
          gen_params.m_gamma = mipmap_params.m_gamma;
          gen_params.m_srgb = srgb;
-         gen_params.m_multithreaded = params.m_num_helper_threads > 0;
+         gen_params.m_multithreaded = ((params.m_num_helper_threads > 0) || (params.m_pThread_pool != NULL)) && (!params.m_crn_memory_limit_mb);
+         gen_params.m_pTask_pool = static_cast<task_pool*>(params.m_pThread_pool);
          gen_params.m_max_mips = mipmap_params.m_max_levels;
          gen_params.m_min_mip_size = mipmap_params.m_min_mip_size;
 
@@ -483,6 +483,7 @@ namespace crnlib
                pack_params.m_use_both_block_types = false;
 
             pack_params.m_num_helper_threads = comp_params.m_num_helper_threads;
+            pack_params.m_pTask_pool = static_cast<task_pool*>(comp_params.m_pThread_pool);
             pack_params.m_use_transparent_indices_for_black = comp_params.get_flag(cCRNCompFlagUseTransparentIndicesForBlack);
 
             console::info("Converting texture format from %s to %s", pixel_format_helpers::get_pixel_format_string(work_tex.get_format()), pixel_format_helpers::get_pixel_format_string(dst_format));
@@ -643,12 +644,6 @@ namespace crnlib
          else if (dst_format == PIXEL_FMT_DXT1A)
             comp_params.set_flag(cCRNCompFlagDXT1AForTransparency, true);
         
-         if ((dst_format == PIXEL_FMT_ETC1) && (params.m_dst_file_type == texture_file_types::cFormatCRN))
-         {
-            console::warning("CRN file format does not support ETC1 compressed textures - converting to DXT1 instead.");
-            dst_format = PIXEL_FMT_DXT1;
-         }
-
          if ((dst_format == PIXEL_FMT_DXT1A) && (params.m_dst_file_type == texture_file_types::cFormatCRN))
          {
             console::warning("CRN file format does not support DXT1A compressed textures - converting to DXT5 instead.");
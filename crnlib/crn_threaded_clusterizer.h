@@ -22,8 +22,7 @@ namespace crnlib
 
       void clear()
       {
-         for (uint i = 0; i < cMaxClusterizers; i++)
-            m_clusterizers[i].clear();
+         m_clusterizers.clear();
       }
 
       struct weighted_vec
@@ -51,38 +50,46 @@ namespace crnlib
 
          if (max_clusters >= 128)
          {
-            crnlib::vector<uint> primary_indices(weighted_vecs.size());
+            // Recursively split the training vectors into a power of 2 number of partitions (at least 4, more when there are enough
+            // helper threads to go around) and clusterize each partition in parallel.
+            uint num_partitions = 4;
+            while ((num_partitions < (m_pTask_pool->get_num_threads() + 1)) && ((max_clusters / (num_partitions * 2)) >= cMinClustersPerPartition))
+               num_partitions *= 2;
+
+            m_clusterizers.resize(num_partitions);
+
+            crnlib::vector< crnlib::vector<uint> > indices(num_partitions * 2 - 1);
+
+            crnlib::vector<uint>& primary_indices = indices[0];
+            primary_indices.resize(weighted_vecs.size());
             for (uint i = 0; i < weighted_vecs.size(); i++)
                primary_indices[i] = i;
 
-            CRNLIB_ASSUME(cMaxClusterizers == 4);
-
-            crnlib::vector<uint> indices[6];
+            for (uint i = 0; i < (num_partitions - 1); i++)
+               compute_split(weighted_vecs, indices[i], indices[i * 2 + 1], indices[i * 2 + 2]);
 
-            compute_split(weighted_vecs, primary_indices, indices[0], indices[1]);
-            compute_split(weighted_vecs, indices[0], indices[2], indices[3]);
-            compute_split(weighted_vecs, indices[1], indices[4], indices[5]);
+            const uint first_partition = num_partitions - 1;
 
-            create_clusters_task_state task_state[4];
+            crnlib::vector<create_clusters_task_state> task_state(num_partitions);
 
             m_cluster_task_displayed_progress = false;
 
             uint total_partitions = 0;
-            for (uint i = 0; i < 4; i++)
+            for (uint i = 0; i < num_partitions; i++)
             {
-               const uint num_indices = indices[2 + i].size();
+               const uint num_indices = indices[first_partition + i].size();
                if (num_indices)
                   total_partitions++;
             }
 
-            for (uint i = 0; i < 4; i++)
+            for (uint i = 0; i < num_partitions; i++)
             {
-               const uint num_indices = indices[2 + i].size();
+               const uint num_indices = indices[first_partition + i].size();
                if (!num_indices)
                   continue;
 
                task_state[i].m_pWeighted_vecs = &weighted_vecs;
-               task_state[i].m_pIndices = &indices[2 + i];
+               task_state[i].m_pIndices = &indices[first_partition + i];
                task_state[i].m_max_clusters = (max_clusters + (total_partitions / 2)) / total_partitions;
 
                m_pTask_pool->queue_object_task(this, &threaded_clusterizer::create_clusters_task, i, &task_state[i]);
@@ -94,13 +101,13 @@ namespace crnlib
                return false;
 
             uint total_clusters = 0;
-            for (uint i = 0; i < 4; i++)
+            for (uint i = 0; i < num_partitions; i++)
                total_clusters += task_state[i].m_cluster_indices.size();
 
             cluster_indices.reserve(total_clusters);
             cluster_indices.resize(0);
 
-            for (uint i = 0; i < 4; i++)
+            for (uint i = 0; i < num_partitions; i++)
             {
                const uint ofs = cluster_indices.size();
 
@@ -114,6 +121,7 @@ namespace crnlib
          }
          else
          {
+            m_clusterizers.resize(1);
             m_clusterizers[0].clear();
             m_clusterizers[0].get_training_vecs().reserve(weighted_vecs.size());
 
@@ -153,8 +161,8 @@ namespace crnlib
 
       typedef clusterizer<VectorType> vector_clusterizer;
 
-      enum { cMaxClusterizers = 4 };
-      vector_clusterizer m_clusterizers[cMaxClusterizers];
+      enum { cMinClustersPerPartition = 32 };
+      crnlib::vector<vector_clusterizer> m_clusterizers;
       bool m_cluster_task_displayed_progress;
 
       progress_callback_func m_pProgress_callback;
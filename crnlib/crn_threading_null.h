@@ -187,6 +187,12 @@ namespace crnlib
       }
 
       inline void join() { }
+
+      class scoped_task_group
+      {
+      public:
+         inline scoped_task_group(task_pool* pPool) { pPool; }
+      };
    };
 
 } // namespace crnlib
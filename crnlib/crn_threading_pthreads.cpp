@@ -36,6 +36,17 @@ namespace crnlib
 #endif
    }
 
+   uint crn_get_max_helper_threads()
+   {
+      if (g_number_of_processors > 1)
+      {
+         // use all CPU's
+         return g_number_of_processors - 1;
+      }
+
+      return 0;
+   }
+
    crn_thread_id_t crn_get_current_thread_id()
    {
       // FIXME: Not portable
@@ -220,25 +231,35 @@ namespace crnlib
    }
 
    task_pool::task_pool() :
+      m_pTask_queues(NULL),
+      m_num_task_queues(0),
       m_num_threads(0),
-      m_tasks_available(0, 32767),
-      m_all_tasks_completed(0, 1),
-      m_total_submitted_tasks(0),
-      m_total_completed_tasks(0),
+      m_total_queued_tasks(0),
+      m_num_sleeping_threads(0),
+      m_next_queue_index(0),
+      m_next_thread_index(0),
       m_exit_flag(false)
    {
-      utils::zero_object(m_threads);
+      init_sync_objects();
+
+      if (!create_task_queues(1))
+         CRNLIB_FAIL("task_pool: out of memory");
    }
 
    task_pool::task_pool(uint num_threads) :
+      m_pTask_queues(NULL),
+      m_num_task_queues(0),
       m_num_threads(0),
-      m_tasks_available(0, 32767),
-      m_all_tasks_completed(0, 1),
-      m_total_submitted_tasks(0),
-      m_total_completed_tasks(0),
+      m_total_queued_tasks(0),
+      m_num_sleeping_threads(0),
+      m_next_queue_index(0),
+      m_next_thread_index(0),
       m_exit_flag(false)
    {
-      utils::zero_object(m_threads);
+      init_sync_objects();
+
+      if (!create_task_queues(1))
+         CRNLIB_FAIL("task_pool: out of memory");
 
       bool status = init(num_threads);
       CRNLIB_VERIFY(status);
@@ -247,15 +268,55 @@ namespace crnlib
    task_pool::~task_pool()
    {
       deinit();
+
+      crnlib_delete_array(m_pTask_queues);
+
+      pthread_cond_destroy(&m_group_completed);
+      pthread_cond_destroy(&m_tasks_available);
+      pthread_mutex_destroy(&m_wake_mutex);
+      pthread_key_delete(m_group_key);
+      pthread_key_delete(m_queue_index_key);
    }
 
-   bool task_pool::init(uint num_threads)
+   void task_pool::init_sync_objects()
+   {
+      if ( (pthread_key_create(&m_queue_index_key, NULL)) ||
+           (pthread_key_create(&m_group_key, NULL)) ||
+           (pthread_mutex_init(&m_wake_mutex, NULL)) ||
+           (pthread_cond_init(&m_tasks_available, NULL)) ||
+           (pthread_cond_init(&m_group_completed, NULL)) )
+      {
+         CRNLIB_FAIL("task_pool: failed creating synchronization objects");
+      }
+   }
+
+   bool task_pool::create_task_queues(uint num_queues)
    {
-      CRNLIB_ASSERT(num_threads <= cMaxThreads);
-      num_threads = math::minimum<uint>(num_threads, cMaxThreads);
+      crnlib_delete_array(m_pTask_queues);
+      m_num_task_queues = 0;
 
+      m_pTask_queues = crnlib_new_array< tsdeque<task> >(num_queues);
+      if (!m_pTask_queues)
+         return false;
+
+      m_num_task_queues = num_queues;
+      return true;
+   }
+
+   bool task_pool::init(uint num_threads)
+   {
       deinit();
 
+      if (!m_threads.try_resize(num_threads))
+         return false;
+
+      if (!create_task_queues(num_threads + 1))
+      {
+         m_threads.clear();
+         create_task_queues(1);
+         return false;
+      }
+
       bool succeeded = true;
 
       m_num_threads = 0;
@@ -286,9 +347,10 @@ namespace crnlib
       {
          join();
 
+         pthread_mutex_lock(&m_wake_mutex);
          atomic_exchange32(&m_exit_flag, true);
-
-         m_tasks_available.release(m_num_threads);
+         pthread_cond_broadcast(&m_tasks_available);
+         pthread_mutex_unlock(&m_wake_mutex);
 
          for (uint i = 0; i < m_num_threads; i++)
             pthread_join(m_threads[i], NULL);
@@ -298,9 +360,104 @@ namespace crnlib
          atomic_exchange32(&m_exit_flag, false);
       }
 
-      m_task_stack.clear();
-      m_total_submitted_tasks = 0;
-      m_total_completed_tasks = 0;
+      m_threads.clear();
+
+      for (uint i = 0; i < m_num_task_queues; i++)
+         m_pTask_queues[i].clear();
+
+      m_default_group.m_num_outstanding_tasks = 0;
+      m_total_queued_tasks = 0;
+      m_num_sleeping_threads = 0;
+      m_next_queue_index = 0;
+      m_next_thread_index = 0;
+   }
+
+   uint task_pool::get_current_queue_index()
+   {
+      // Worker threads own the first m_num_threads queues, everybody else shares the last one.
+      const uint index_plus_one = static_cast<uint>(reinterpret_cast<ptr_bits_t>(pthread_getspecific(m_queue_index_key)));
+      return index_plus_one ? (index_plus_one - 1) : m_num_threads;
+   }
+
+   task_pool::task_group* task_pool::get_current_group() const
+   {
+      task_group* pGroup = static_cast<task_group*>(pthread_getspecific(m_group_key));
+      return pGroup ? pGroup : const_cast<task_group*>(&m_default_group);
+   }
+
+   void task_pool::set_current_group(task_group* pGroup)
+   {
+      pthread_setspecific(m_group_key, (pGroup == &m_default_group) ? NULL : pGroup);
+   }
+
+   bool task_pool::push_task(task& tsk)
+   {
+      // Workers queue sub-tasks onto their own queue, where they'll be popped LIFO while still in the cache.
+      // Tasks from other threads are spread round robin over all the queues, so each worker usually has something local to pop before it needs to steal.
+      uint queue_index = get_current_queue_index();
+      if (queue_index == m_num_threads)
+         queue_index = static_cast<uint>(atomic_increment32(&m_next_queue_index)) % (m_num_threads + 1);
+
+      tsk.m_pGroup = get_current_group();
+      atomic_increment32(&tsk.m_pGroup->m_num_outstanding_tasks);
+
+      // Count the task as queued before it's visible, so a thread that sees an empty count never misses it.
+      atomic_increment32(&m_total_queued_tasks);
+
+      if (!m_pTask_queues[queue_index].try_push_back(tsk))
+      {
+         atomic_decrement32(&m_total_queued_tasks);
+         atomic_decrement32(&tsk.m_pGroup->m_num_outstanding_tasks);
+         return false;
+      }
+
+      return true;
+   }
+
+   bool task_pool::pop_task(uint queue_index, task& tsk)
+   {
+      if (m_total_queued_tasks <= 0)
+         return false;
+
+      // Newest task from our own queue first, then steal the oldest task from the other queues.
+      bool found = m_pTask_queues[queue_index].pop_back(tsk);
+      if (!found)
+      {
+         const uint num_queues = m_num_threads + 1;
+         for (uint i = 1; i < num_queues; i++)
+         {
+            tsdeque<task>& victim = m_pTask_queues[(queue_index + i) % num_queues];
+            if ((victim.size()) && (victim.pop_front(tsk)))
+            {
+               found = true;
+               break;
+            }
+         }
+      }
+
+      if (found)
+         atomic_decrement32(&m_total_queued_tasks);
+
+      return found;
+   }
+
+   void task_pool::wake_threads(uint num_tasks)
+   {
+      // The push_task() increment of m_total_queued_tasks is a full barrier, and sleepers increment m_num_sleeping_threads before
+      // rechecking m_total_queued_tasks under the mutex, so either we see the sleeper here or the sleeper sees the new task.
+      const uint num_sleeping_threads = static_cast<uint>(m_num_sleeping_threads);
+      if (!num_sleeping_threads)
+         return;
+
+      pthread_mutex_lock(&m_wake_mutex);
+      if (num_tasks >= num_sleeping_threads)
+         pthread_cond_broadcast(&m_tasks_available);
+      else
+      {
+         for (uint i = 0; i < num_tasks; i++)
+            pthread_cond_signal(&m_tasks_available);
+      }
+      pthread_mutex_unlock(&m_wake_mutex);
    }
 
    bool task_pool::queue_task(task_callback_func pFunc, uint64 data, void* pData_ptr)
@@ -313,14 +470,10 @@ namespace crnlib
       tsk.m_pData_ptr = pData_ptr;
       tsk.m_flags = 0;
 
-      atomic_increment32(&m_total_submitted_tasks);
-      if (!m_task_stack.try_push(tsk))
-      {
-         atomic_increment32(&m_total_completed_tasks);
+      if (!push_task(tsk))
          return false;
-      }
 
-      m_tasks_available.release(1);
+      wake_threads(1);
 
       return true;
    }
@@ -336,68 +489,126 @@ namespace crnlib
       tsk.m_pData_ptr = pData_ptr;
       tsk.m_flags = cTaskFlagObject;
 
-      atomic_increment32(&m_total_submitted_tasks);
-      if (!m_task_stack.try_push(tsk))
-      {
-         atomic_increment32(&m_total_completed_tasks);
+      if (!push_task(tsk))
          return false;
-      }
 
-      m_tasks_available.release(1);
+      wake_threads(1);
 
       return true;
    }
 
    void task_pool::process_task(task& tsk)
    {
+      // The task's sub-tasks go into a group of their own, so joining them doesn't wait on the task itself.
+      task_group* pPrev_group = get_current_group();
+      task_group group;
+      set_current_group(&group);
+
       if (tsk.m_flags & cTaskFlagObject)
          tsk.m_pObj->execute_task(tsk.m_data, tsk.m_pData_ptr);
       else
          tsk.m_callback(tsk.m_data, tsk.m_pData_ptr);
 
-      if (atomic_increment32(&m_total_completed_tasks) == m_total_submitted_tasks)
+      // Sub-tasks the task didn't join still point at its group.
+      if (group.m_num_outstanding_tasks)
+         join();
+
+      set_current_group(pPrev_group);
+
+      // The group may go away as soon as its count hits 0, so only the pool is touched after the decrement.
+      if (!atomic_decrement32(&tsk.m_pGroup->m_num_outstanding_tasks))
       {
-         // Try to signal the semaphore (the max count is 1 so this may actually fail).
-         m_all_tasks_completed.try_release();
+         pthread_mutex_lock(&m_wake_mutex);
+         pthread_cond_broadcast(&m_group_completed);
+         pthread_mutex_unlock(&m_wake_mutex);
       }
    }
 
    void task_pool::join()
    {
-      // Try to steal any outstanding tasks. This could cause one or more worker threads to wake up and immediately go back to sleep, which is wasteful but should be harmless.
+      // The calling thread works on the outstanding tasks itself (stealing from the workers if needed), and only blocks once
+      // there's nothing left to run and the remaining tasks are still executing on other threads.
+      // Tasks from other groups may get run too, but it stops taking new tasks once its own group is done.
+      const uint queue_index = get_current_queue_index();
+      task_group* pGroup = get_current_group();
+
       task tsk;
-      while (m_task_stack.pop(tsk))
-         process_task(tsk);
-
-      // At this point the task stack is empty.
-      // Now wait for all concurrent tasks to complete. The m_all_tasks_completed semaphore has a max count of 1, so it's possible it could have saturated to 1 as the tasks
-      // where issued and asynchronously completed, so this loop may iterate a few times.
-      const int total_submitted_tasks = atomic_add32(&m_total_submitted_tasks, 0);
-      while (m_total_completed_tasks != total_submitted_tasks)
+      for ( ; ; )
       {
-         // If the previous (m_total_completed_tasks != total_submitted_tasks) check failed the semaphore MUST be eventually signalled once the last task completes.
-         // So I think this can actually be an INFINITE delay, but it shouldn't really matter if it's 1ms.
-         m_all_tasks_completed.wait(1);
+         while ((pGroup->m_num_outstanding_tasks) && (pop_task(queue_index, tsk)))
+            process_task(tsk);
+
+         if (!atomic_add32(&pGroup->m_num_outstanding_tasks, 0))
+            break;
+
+         pthread_mutex_lock(&m_wake_mutex);
+         while ((pGroup->m_num_outstanding_tasks) && (m_total_queued_tasks <= 0))
+            pthread_cond_wait(&m_group_completed, &m_wake_mutex);
+         pthread_mutex_unlock(&m_wake_mutex);
+      }
+   }
+
+   task_pool::scoped_task_group::scoped_task_group(task_pool* pPool) :
+      m_pPool(pPool),
+      m_pPrev_group(NULL)
+   {
+      if (m_pPool)
+      {
+         m_pPrev_group = m_pPool->get_current_group();
+         m_pPool->set_current_group(&m_group);
+      }
+   }
+
+   task_pool::scoped_task_group::~scoped_task_group()
+   {
+      if (m_pPool)
+      {
+         if (m_group.m_num_outstanding_tasks)
+            m_pPool->join();
+
+         m_pPool->set_current_group(m_pPrev_group);
       }
    }
 
    void * task_pool::thread_func(void *pContext)
    {
       task_pool* pPool = static_cast<task_pool*>(pContext);
+
+      const uint queue_index = static_cast<uint>(atomic_increment32(&pPool->m_next_thread_index) - 1);
+      pthread_setspecific(pPool->m_queue_index_key, reinterpret_cast<void*>(static_cast<ptr_bits_t>(queue_index + 1)));
+
       task tsk;
 
       for ( ; ; )
       {
-         if (!pPool->m_tasks_available.wait())
-            break;
-
          if (pPool->m_exit_flag)
             break;
 
-         if (pPool->m_task_stack.pop(tsk))
+         if (pPool->pop_task(queue_index, tsk))
          {
             pPool->process_task(tsk);
+            continue;
+         }
+
+         // Spin briefly before going to sleep, tasks are usually queued in bursts.
+         const uint cSpinCount = 64;
+         uint spin_count;
+         for (spin_count = 0; spin_count < cSpinCount; spin_count++)
+         {
+            if ((pPool->m_total_queued_tasks > 0) || (pPool->m_exit_flag))
+               break;
+            crnlib_yield_processor();
          }
+
+         if (spin_count < cSpinCount)
+            continue;
+
+         pthread_mutex_lock(&pPool->m_wake_mutex);
+         atomic_increment32(&pPool->m_num_sleeping_threads);
+         while ((pPool->m_total_queued_tasks <= 0) && (!pPool->m_exit_flag))
+            pthread_cond_wait(&pPool->m_tasks_available, &pPool->m_wake_mutex);
+         atomic_decrement32(&pPool->m_num_sleeping_threads);
+         pthread_mutex_unlock(&pPool->m_wake_mutex);
       }
 
       return NULL;
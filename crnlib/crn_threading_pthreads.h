@@ -103,46 +103,73 @@ namespace crnlib
       spinlock& m_lock;
    };
 
-   template<typename T, uint cMaxSize>
-   class tsstack
+   // Spinlock protected, growable double ended queue.
+   // The owning thread pushes and pops at the back (LIFO), other threads steal from the front (FIFO).
+   template<typename T>
+   class tsdeque
    {
+      CRNLIB_NO_COPY_OR_ASSIGNMENT_OP(tsdeque);
+
    public:
-      inline tsstack() :
-         m_top(0)
+      inline tsdeque() :
+         m_head(0),
+         m_size(0)
       {
       }
 
-      inline ~tsstack()
+      inline ~tsdeque()
       {
       }
 
       inline void clear()
       {
          m_spinlock.lock();
-         m_top = 0;
+         m_buf.clear();
+         m_head = 0;
+         m_size = 0;
          m_spinlock.unlock();
       }
 
-      inline bool try_push(const T& obj)
+      inline uint size() const { return m_size; }
+
+      inline bool try_push_back(const T& obj)
+      {
+         bool result = true;
+         m_spinlock.lock();
+         if ((m_size == m_buf.size()) && (!grow()))
+            result = false;
+         else
+         {
+            m_buf[(m_head + m_size) & (m_buf.size() - 1)] = obj;
+            m_size++;
+         }
+         m_spinlock.unlock();
+         return result;
+      }
+
+      inline bool pop_back(T& obj)
       {
          bool result = false;
          m_spinlock.lock();
-         if (m_top < (int)cMaxSize)
+         if (m_size)
          {
-            m_stack[m_top++] = obj;
+            m_size--;
+            obj = m_buf[(m_head + m_size) & (m_buf.size() - 1)];
             result = true;
          }
          m_spinlock.unlock();
          return result;
       }
 
-      inline bool pop(T& obj)
+      inline bool pop_front(T& obj)
       {
          bool result = false;
          m_spinlock.lock();
-         if (m_top > 0)
+         if (m_size)
          {
-            obj = m_stack[--m_top];
+            obj = m_buf[m_head];
+            m_head = (m_head + 1) & (m_buf.size() - 1);
+            m_size--;
             result = true;
          }
          m_spinlock.unlock();
@@ -151,8 +178,26 @@ namespace crnlib
 
    private:
       spinlock m_spinlock;
-      T m_stack[cMaxSize];
-      int m_top;
+      crnlib::vector<T> m_buf;
+      uint m_head;
+      volatile uint m_size;
+
+      // Caller must hold the spinlock. The capacity is always a power of 2.
+      bool grow()
+      {
+         const uint new_capacity = m_buf.size() ? (m_buf.size() * 2) : 16;
+
+         crnlib::vector<T> new_buf;
+         if (!new_buf.try_resize(new_capacity))
+            return false;
+
+         for (uint i = 0; i < m_size; i++)
+            new_buf[i] = m_buf[(m_head + i) & (m_buf.size() - 1)];
+
+         m_buf.swap(new_buf);
+         m_head = 0;
+         return true;
+      }
    };
 
    class task_pool
@@ -162,12 +207,12 @@ namespace crnlib
       task_pool(uint num_threads);
       ~task_pool();
 
-      enum { cMaxThreads = 16 };
+      // The number of threads is only limited by the OS, all per-thread state is allocated in init().
       bool init(uint num_threads);
       void deinit();
 
       inline uint get_num_threads() const { return m_num_threads; }
-      inline uint32 get_num_outstanding_tasks() const { return m_total_submitted_tasks - m_total_completed_tasks; }
+      inline uint32 get_num_outstanding_tasks() const { return get_current_group()->m_num_outstanding_tasks; }
 
       // C-style task callback
       typedef void (*task_callback_func)(uint64 data, void* pData_ptr);
@@ -188,12 +233,39 @@ namespace crnlib
       template<typename S, typename T>
       inline bool queue_multiple_object_tasks(S* pObject, T pObject_method, uint64 first_data, uint num_tasks, void* pData_ptr = NULL);
 
+      // Waits for the outstanding tasks of the calling thread's current task group, running queued tasks (from any group) meanwhile.
       void join();
 
+      // Tasks belong to the group that was current on the thread which queued them. Every task runs in a new group of its own, so
+      // tasks may queue and join sub-tasks, and threads outside the pool use the pool's default group unless a scoped_task_group
+      // gives them their own.
+      struct task_group
+      {
+         inline task_group() : m_num_outstanding_tasks(0) { }
+
+         volatile atomic32_t m_num_outstanding_tasks;
+      };
+
+      // Makes a new task group current on the calling thread for the lifetime of the object, so callers sharing a pool only
+      // join their own tasks. Joins the group's tasks on destruction. pPool may be NULL.
+      class scoped_task_group
+      {
+         CRNLIB_NO_COPY_OR_ASSIGNMENT_OP(scoped_task_group);
+
+      public:
+         scoped_task_group(task_pool* pPool);
+         ~scoped_task_group();
+
+      private:
+         task_pool* m_pPool;
+         task_group* m_pPrev_group;
+         task_group m_group;
+      };
+
    private:
       struct task
       {
-         inline task() : m_data(0), m_pData_ptr(NULL), m_pObj(NULL), m_flags(0) { }
+         inline task() : m_data(0), m_pData_ptr(NULL), m_pObj(NULL), m_flags(0), m_pGroup(NULL) { }
 
          uint64 m_data;
          void* m_pData_ptr;
@@ -205,28 +277,48 @@ namespace crnlib
          };
 
          uint m_flags;
+
+         task_group* m_pGroup;
       };
 
-      tsstack<task, cMaxThreads> m_task_stack;
+      // One queue per worker thread, plus one for threads outside the pool (the last queue).
+      tsdeque<task>* m_pTask_queues;
+      uint m_num_task_queues;
 
       uint m_num_threads;
-      pthread_t m_threads[cMaxThreads];
+      crnlib::vector<pthread_t> m_threads;
+
+      // Holds (queue index + 1) for each worker thread, NULL on all other threads.
+      pthread_key_t m_queue_index_key;
 
-      // Signalled whenever a task is queued up.
-      semaphore m_tasks_available;
+      // Holds each thread's current task group, NULL means m_default_group.
+      pthread_key_t m_group_key;
+      task_group m_default_group;
 
-      // Signalled when all outstanding tasks are completed.
-      semaphore m_all_tasks_completed;
+      // Sleeping workers wait on m_tasks_available, join() waits on m_group_completed.
+      pthread_mutex_t m_wake_mutex;
+      pthread_cond_t m_tasks_available;
+      pthread_cond_t m_group_completed;
 
       enum task_flags
       {
          cTaskFlagObject = 1
       };
 
-      volatile atomic32_t m_total_submitted_tasks;
-      volatile atomic32_t m_total_completed_tasks;
+      volatile atomic32_t m_total_queued_tasks;
+      volatile atomic32_t m_num_sleeping_threads;
+      volatile atomic32_t m_next_queue_index;
+      volatile atomic32_t m_next_thread_index;
       volatile atomic32_t m_exit_flag;
 
+      void init_sync_objects();
+      bool create_task_queues(uint num_queues);
+      uint get_current_queue_index();
+      task_group* get_current_group() const;
+      void set_current_group(task_group* pGroup);
+      bool push_task(task& tsk);
+      bool pop_task(uint queue_index, task& tsk);
+      void wake_threads(uint num_tasks);
       void process_task(task& tsk);
 
       static void* thread_func(void *pContext);
@@ -309,24 +401,22 @@ namespace crnlib
       uint i;
       for (i = 0; i < num_tasks; i++)
       {
-         task tsk;
-
-         tsk.m_pObj = crnlib_new< object_task<S> >(pObject, pObject_method, cObjectTaskFlagDeleteAfterExecution);
-         if (!tsk.m_pObj)
+         object_task<S> *pTask = crnlib_new< object_task<S> >(pObject, pObject_method, cObjectTaskFlagDeleteAfterExecution);
+         if (!pTask)
          {
             status = false;
             break;
          }
 
+         task tsk;
+         tsk.m_pObj = pTask;
          tsk.m_data = first_data + i;
          tsk.m_pData_ptr = pData_ptr;
          tsk.m_flags = cTaskFlagObject;
 
-         atomic_increment32(&m_total_submitted_tasks);
-
-         if (!m_task_stack.try_push(tsk))
+         if (!push_task(tsk))
          {
-            atomic_increment32(&m_total_completed_tasks);
+            crnlib_delete(pTask);
 
             status = false;
             break;
@@ -335,7 +425,7 @@ namespace crnlib
 
       if (i)
       {
-         m_tasks_available.release(i);
+         wake_threads(i);
       }
 
       return status;
@@ -32,7 +32,7 @@ namespace crnlib
       if (g_number_of_processors > 1)
       {
          // use all CPU's
-         return CRNLIB_MIN((int)task_pool::cMaxThreads, (int)g_number_of_processors - 1);
+         return g_number_of_processors - 1;
       }
 
       return 0;
@@ -221,25 +221,24 @@ namespace crnlib
       m_pTask_stack(crnlib_new<ts_task_stack_t>()),
       m_num_threads(0),
       m_tasks_available(0, 32767),
-      m_all_tasks_completed(0, 1),
-      m_total_submitted_tasks(0),
-      m_total_completed_tasks(0),
+      m_group_completed(0, 1),
+      m_group_tls_index(TlsAlloc()),
       m_exit_flag(false)
    {
-      utils::zero_object(m_threads);
+      if (m_group_tls_index == TLS_OUT_OF_INDEXES)
+         CRNLIB_FAIL("task_pool: TlsAlloc() failed");
    }
 
    task_pool::task_pool(uint num_threads) :
       m_pTask_stack(crnlib_new<ts_task_stack_t>()),
       m_num_threads(0),
       m_tasks_available(0, 32767),
-      m_all_tasks_completed(0, 1),
-      m_total_submitted_tasks(0),
-      m_total_completed_tasks(0),
+      m_group_completed(0, 1),
+      m_group_tls_index(TlsAlloc()),
       m_exit_flag(false)
    {
-      utils::zero_object(m_threads);
-
+      if (m_group_tls_index == TLS_OUT_OF_INDEXES)
+         CRNLIB_FAIL("task_pool: TlsAlloc() failed");
       bool status = init(num_threads);
       CRNLIB_VERIFY(status);
    }
@@ -248,15 +247,16 @@ namespace crnlib
    {
       deinit();
       crnlib_delete(m_pTask_stack);
+      TlsFree(m_group_tls_index);
    }
 
    bool task_pool::init(uint num_threads)
    {
-      CRNLIB_ASSERT(num_threads <= cMaxThreads);
-      num_threads = math::minimum<uint>(num_threads, cMaxThreads);
-
       deinit();
 
+      if (!m_threads.try_resize(num_threads))
+         return false;
+
       bool succeeded = true;
 
       m_num_threads = 0;
@@ -312,6 +312,7 @@ namespace crnlib
             }
          }
 
+         m_threads.clear();
          m_num_threads = 0;
 
          atomic_exchange32(&m_exit_flag, false);
@@ -319,8 +320,32 @@ namespace crnlib
 
       if (m_pTask_stack)
          m_pTask_stack->clear();
-      m_total_submitted_tasks = 0;
-      m_total_completed_tasks = 0;
+      m_default_group.m_num_outstanding_tasks = 0;
+   }
+
+   task_pool::task_group* task_pool::get_current_group() const
+   {
+      task_group* pGroup = static_cast<task_group*>(TlsGetValue(m_group_tls_index));
+      return pGroup ? pGroup : const_cast<task_group*>(&m_default_group);
+   }
+
+   void task_pool::set_current_group(task_group* pGroup)
+   {
+      TlsSetValue(m_group_tls_index, (pGroup == &m_default_group) ? NULL : pGroup);
+   }
+
+   bool task_pool::push_task(task& tsk)
+   {
+      tsk.m_pGroup = get_current_group();
+      atomic_increment32(&tsk.m_pGroup->m_num_outstanding_tasks);
+
+      if (!m_pTask_stack->try_push(tsk))
+      {
+         atomic_decrement32(&tsk.m_pGroup->m_num_outstanding_tasks);
+         return false;
+      }
+
+      return true;
    }
 
    bool task_pool::queue_task(task_callback_func pFunc, uint64 data, void* pData_ptr)
@@ -333,13 +358,8 @@ namespace crnlib
       tsk.m_pData_ptr = pData_ptr;
       tsk.m_flags = 0;
 
-      atomic_increment32(&m_total_submitted_tasks);
-
-      if (!m_pTask_stack->try_push(tsk))
-      {
-         atomic_increment32(&m_total_completed_tasks);
+      if (!push_task(tsk))
          return false;
-      }
             
       m_tasks_available.release(1);
       
@@ -357,13 +377,8 @@ namespace crnlib
       tsk.m_pData_ptr = pData_ptr;
       tsk.m_flags = cTaskFlagObject;
 
-      atomic_increment32(&m_total_submitted_tasks);
-
-      if (!m_pTask_stack->try_push(tsk))
-      {
-         atomic_increment32(&m_total_completed_tasks);
+      if (!push_task(tsk))
          return false;
-      }
             
       m_tasks_available.release(1);
 
@@ -372,34 +387,68 @@ namespace crnlib
 
    void task_pool::process_task(task& tsk)
    {
+      // The task's sub-tasks go into a group of their own, so joining them doesn't wait on the task itself.
+      task_group* pPrev_group = get_current_group();
+      task_group group;
+      set_current_group(&group);
+
       if (tsk.m_flags & cTaskFlagObject)
          tsk.m_pObj->execute_task(tsk.m_data, tsk.m_pData_ptr);
       else
          tsk.m_callback(tsk.m_data, tsk.m_pData_ptr);
 
-      if (atomic_increment32(&m_total_completed_tasks) == m_total_submitted_tasks)
+      // Sub-tasks the task didn't join still point at its group.
+      if (group.m_num_outstanding_tasks)
+         join();
+
+      set_current_group(pPrev_group);
+
+      // The group may go away as soon as its count hits 0, so only the pool is touched after the decrement.
+      if (!atomic_decrement32(&tsk.m_pGroup->m_num_outstanding_tasks))
       {
          // Try to signal the semaphore (the max count is 1 so this may actually fail).
-         m_all_tasks_completed.try_release();
+         m_group_completed.try_release();
       }
    }
 
    void task_pool::join()
    {
       // Try to steal any outstanding tasks. This could cause one or more worker threads to wake up and immediately go back to sleep, which is wasteful but should be harmless.
+      // Tasks from other groups may get run too, but it stops taking new tasks once its own group is done.
+      task_group* pGroup = get_current_group();
+
       task tsk;
-      while (m_pTask_stack->pop(tsk))
+      while ((pGroup->m_num_outstanding_tasks) && (m_pTask_stack->pop(tsk)))
          process_task(tsk);
       
-      // At this point the task stack is empty.
-      // Now wait for all concurrent tasks to complete. The m_all_tasks_completed semaphore has a max count of 1, so it's possible it could have saturated to 1 as the tasks 
-      // where issued and asynchronously completed, so this loop may iterate a few times.
-      const int total_submitted_tasks = atomic_add32(&m_total_submitted_tasks, 0);
-      while (m_total_completed_tasks != total_submitted_tasks)
+      // Now wait for the group's concurrent tasks to complete. The m_group_completed semaphore has a max count of 1 and is shared by all the groups,
+      // so it may have been saturated by another group's completion and this loop may iterate a few times.
+      while (atomic_add32(&pGroup->m_num_outstanding_tasks, 0))
       {
-         // If the previous (m_total_completed_tasks != total_submitted_tasks) check failed the semaphore MUST be eventually signalled once the last task completes.
-         // So I think this can actually be an INFINITE delay, but it shouldn't really matter if it's 1ms.
-         m_all_tasks_completed.wait(1);
+         // Whenever a group's count drops to 0 the semaphore is signalled, and the 1ms timeout covers the case where the signal went to another joining thread.
+         m_group_completed.wait(1);
+      }
+   }
+
+   task_pool::scoped_task_group::scoped_task_group(task_pool* pPool) :
+      m_pPool(pPool),
+      m_pPrev_group(NULL)
+   {
+      if (m_pPool)
+      {
+         m_pPrev_group = m_pPool->get_current_group();
+         m_pPool->set_current_group(&m_group);
+      }
+   }
+
+   task_pool::scoped_task_group::~scoped_task_group()
+   {
+      if (m_pPool)
+      {
+         if (m_group.m_num_outstanding_tasks)
+            m_pPool->join();
+
+         m_pPool->set_current_group(m_pPrev_group);
       }
    }
 
@@ -230,12 +230,12 @@ namespace crnlib
       task_pool(uint num_threads);
       ~task_pool();
 
-      enum { cMaxThreads = 16 };
+      // The number of threads is only limited by the OS, all per-thread state is allocated in init().
       bool init(uint num_threads);
       void deinit();
 
       inline uint get_num_threads() const { return m_num_threads; }
-      inline uint32 get_num_outstanding_tasks() const { return m_total_submitted_tasks - m_total_completed_tasks; }
+      inline uint32 get_num_outstanding_tasks() const { return get_current_group()->m_num_outstanding_tasks; }
 
       // C-style task callback
       typedef void (*task_callback_func)(uint64 data, void* pData_ptr);
@@ -256,10 +256,36 @@ namespace crnlib
       template<typename S, typename T>
       inline bool queue_multiple_object_tasks(S* pObject, T pObject_method, uint64 first_data, uint num_tasks, void* pData_ptr = NULL);
 
-      // Waits for all outstanding tasks (if any) to complete.
+      // Waits for the outstanding tasks (if any) of the calling thread's current task group to complete.
       // The calling thread will steal any outstanding tasks from worker threads, if possible.
       void join();
 
+      // Tasks belong to the group that was current on the thread which queued them. Every task runs in a new group of its own, so
+      // tasks may queue and join sub-tasks, and threads outside the pool use the pool's default group unless a scoped_task_group
+      // gives them their own.
+      struct task_group
+      {
+         inline task_group() : m_num_outstanding_tasks(0) { }
+
+         volatile atomic32_t m_num_outstanding_tasks;
+      };
+
+      // Makes a new task group current on the calling thread for the lifetime of the object, so callers sharing a pool only
+      // join their own tasks. Joins the group's tasks on destruction. pPool may be NULL.
+      class scoped_task_group
+      {
+         CRNLIB_NO_COPY_OR_ASSIGNMENT_OP(scoped_task_group);
+
+      public:
+         scoped_task_group(task_pool* pPool);
+         ~scoped_task_group();
+
+      private:
+         task_pool* m_pPool;
+         task_group* m_pPrev_group;
+         task_group m_group;
+      };
+
    private:
       struct task
       {
@@ -275,29 +301,36 @@ namespace crnlib
          };
 
          uint m_flags;
+
+         task_group* m_pGroup;
       };
 
       typedef tsstack<task> ts_task_stack_t;
       ts_task_stack_t* m_pTask_stack;
 
       uint m_num_threads;
-      HANDLE m_threads[cMaxThreads];
+      crnlib::vector<HANDLE> m_threads;
 
       // Signalled whenever a task is queued up.
       semaphore m_tasks_available;
       
-      // Signalled when all outstanding tasks are completed.
-      semaphore m_all_tasks_completed;
+      // Signalled when the last outstanding task of a group is completed.
+      semaphore m_group_completed;
+
+      // TLS slot holding each thread's current task group, NULL means m_default_group.
+      uint32 m_group_tls_index;
+      task_group m_default_group;
 
       enum task_flags
       {
          cTaskFlagObject = 1
       };
 
-      volatile atomic32_t m_total_submitted_tasks;
-      volatile atomic32_t m_total_completed_tasks;
       volatile atomic32_t m_exit_flag;
 
+      task_group* get_current_group() const;
+      void set_current_group(task_group* pGroup);
+      bool push_task(task& tsk);
       void process_task(task& tsk);
 
       static unsigned __stdcall thread_func(void* pContext);
@@ -393,12 +426,8 @@ namespace crnlib
          tsk.m_pData_ptr = pData_ptr;
          tsk.m_flags = cTaskFlagObject;
          
-         atomic_increment32(&m_total_submitted_tasks);
-         
-         if (!m_pTask_stack->try_push(tsk))
+         if (!push_task(tsk))
          {
-            atomic_increment32(&m_total_completed_tasks);
-            
             status = false;
             break;
          }
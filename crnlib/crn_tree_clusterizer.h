@@ -2,6 +2,7 @@
 // See Copyright Notice and license at the end of inc/crnlib.h
 #pragma once
 #include "crn_matrix.h"
+#include "crn_threading.h"
 
 namespace crnlib
 {
@@ -10,7 +11,8 @@ namespace crnlib
    {
    public:
       tree_clusterizer() :
-         m_overall_variance(0.0f)
+         m_overall_variance(0.0f),
+         m_num_active_nodes(0)
       {
       }
 
@@ -18,10 +20,18 @@ namespace crnlib
       {
          m_hist.clear();
          m_codebook.clear();
+         m_codebook_nodes.clear();
          m_nodes.clear();
+         m_split_node_counts.clear();
          m_overall_variance = 0.0f;
+         m_num_active_nodes = 0;
       }
 
+      // Rough number of bytes generate_codebook() needs per distinct training vector (its histogram node and the copy and indices
+      // made from it), and per codebook entry (the two nodes and the split that make it).
+      static uint get_training_vec_size() { return sizeof(typename vector_map_type::value_type) + 4 * sizeof(void*) + sizeof(std::pair<VectorType, uint>) + 2 * sizeof(uint); }
+      static uint get_codebook_entry_size() { return 2 * sizeof(vq_node) + sizeof(vq_split) + sizeof(VectorType) + sizeof(uint); }
+
       void add_training_vec(const VectorType& v, uint weight)
       {
          const std::pair<typename vector_map_type::iterator, bool> insert_result( m_hist.insert( std::make_pair(v, 0U) ) );
@@ -35,7 +45,11 @@ namespace crnlib
             it->second = it->second + weight;
       }
 
-      bool generate_codebook(uint max_size)
+      // Splits the leaf with the highest variance until there are max_size leaves (or no leaf can be split). The training vectors
+      // are sorted into a single index array, each node owning a range of it that its split partitions in place. With a task pool,
+      // the splits of the leaves likeliest to be split next are computed in parallel before they're needed; the leaves own disjoint
+      // ranges, and each split only depends on its own range, so the resulting tree is the same with or without helper threads.
+      bool generate_codebook(uint max_size, task_pool* pTask_pool = NULL)
       {
          if (m_hist.empty())
             return false;
@@ -43,7 +57,9 @@ namespace crnlib
          double ttsum = 0.0f;
 
          vq_node root;
-         root.m_vectors.reserve(static_cast<uint>(m_hist.size()));
+
+         m_training_vecs.clear();
+         m_training_vecs.reserve(static_cast<uint>(m_hist.size()));
 
          for (typename vector_map_type::const_iterator it = m_hist.begin(); it != m_hist.end(); ++it)
          {
@@ -52,7 +68,7 @@ namespace crnlib
 
             root.m_centroid += (v * (float)weight);
             root.m_total_weight += weight;
-            root.m_vectors.push_back( std::make_pair(v, weight) );
+            m_training_vecs.push_back( std::make_pair(v, weight) );
 
             ttsum += v.dot(v) * weight;
          }
@@ -61,59 +77,142 @@ namespace crnlib
 
          root.m_centroid *= (1.0f / root.m_total_weight);
 
+         const uint num_vecs = m_training_vecs.size();
+
+         m_indices.resize(num_vecs);
+         m_temp_indices.resize(num_vecs);
+         for (uint i = 0; i < num_vecs; i++)
+            m_indices[i] = i;
+
+         root.m_begin = 0;
+         root.m_end = num_vecs;
+
          m_nodes.clear();
          m_nodes.reserve(max_size * 2 + 1);
 
          m_nodes.push_back(root);
 
+         m_splits.clear();
+         m_splits.resize(1);
+
+         m_split_node_counts.clear();
+
          // Warning: if this code is NOT compiled with -fno-strict-aliasing, m_nodes.get_ptr() can be NULL here. (Argh!)
 
+         // Max-heap of the leaves that can be chosen for splitting, see leaf_entry::operator<.
+         crnlib::vector<leaf_entry> leaves;
+         leaves.reserve(max_size + 1);
+
+         if (root.m_variance > 0.0f)
+            leaves.push_back(leaf_entry(root.m_variance, 0));
+
          uint total_leaves = 1;
 
-         while (total_leaves < max_size)
+         while ((total_leaves < max_size) && (!leaves.empty()))
          {
-            int worst_node_index = -1;
-            float worst_variance = -1.0f;
+            const uint worst_node_index = leaves[0].m_node_index;
 
-            for (uint i = 0; i < m_nodes.size(); i++)
+            if (m_splits[worst_node_index].m_status == cSplitPending)
+               compute_splits(leaves, pTask_pool);
+
+            const vq_split split(m_splits[worst_node_index]);
+
+            if (split.m_status == cSplitSingleVector)
             {
-               vq_node& node = m_nodes[i];
+               // A leaf holding a single vector is left as is, so it remains the worst leaf, and every remaining split is a no-op.
+               for ( ; total_leaves < max_size; total_leaves++)
+                  m_split_node_counts.push_back(m_nodes.size());
+               break;
+            }
+
+            std::pop_heap(leaves.begin(), leaves.end());
+            leaves.pop_back();
+
+            if (split.m_status == cSplitFailed)
+               m_nodes[worst_node_index].m_unsplittable = true;
+            else
+            {
+               const uint left_child_index = m_nodes.size();
+               const uint right_child_index = m_nodes.size() + 1;
+
+               m_nodes.resize(m_nodes.size() + 2);
+               m_splits.resize(m_nodes.size(), true);
 
-               // Skip internal and unsplittable nodes.
-               if ((node.m_left != -1) || (node.m_unsplittable))
-                  continue;
+               vq_node& parent_node = m_nodes[worst_node_index];
+               vq_node& left_child_node = m_nodes[left_child_index];
+               vq_node& right_child_node = m_nodes[right_child_index];
 
-               if (node.m_variance > worst_variance)
+               parent_node.m_left = left_child_index;
+               parent_node.m_right = right_child_index;
+
+               left_child_node.m_centroid = split.m_left_centroid;
+               left_child_node.m_total_weight = split.m_left_weight;
+               left_child_node.m_variance = split.m_left_variance;
+               left_child_node.m_begin = parent_node.m_begin;
+               left_child_node.m_end = split.m_middle;
+
+               right_child_node.m_centroid = split.m_right_centroid;
+               right_child_node.m_total_weight = split.m_right_weight;
+               right_child_node.m_variance = split.m_right_variance;
+               right_child_node.m_begin = split.m_middle;
+               right_child_node.m_end = parent_node.m_end;
+
+               // Leaves without a positive variance (or with a NaN one) are never chosen.
+               if (left_child_node.m_variance > 0.0f)
                {
-                  worst_variance = node.m_variance;
-                  worst_node_index = i;
+                  leaves.push_back(leaf_entry(left_child_node.m_variance, left_child_index));
+                  std::push_heap(leaves.begin(), leaves.end());
                }
-            }
 
-            if (worst_variance <= 0.0f)
-               break;
+               if (right_child_node.m_variance > 0.0f)
+               {
+                  leaves.push_back(leaf_entry(right_child_node.m_variance, right_child_index));
+                  std::push_heap(leaves.begin(), leaves.end());
+               }
+            }
 
-            split_node(worst_node_index);
             total_leaves++;
+
+            m_split_node_counts.push_back(m_nodes.size());
          }
 
+         m_training_vecs.clear();
+         m_indices.clear();
+         m_temp_indices.clear();
+         m_splits.clear();
+
+         return set_codebook_size(max_size);
+      }
+
+      // Selects the codebook generate_codebook() would have returned for max_size = size, by only keeping the nodes
+      // created by the first (size - 1) splits of the existing tree. The splits don't depend on max_size, so a tree
+      // generated once at the largest size of interest can be cut down to any smaller size without being rebuilt.
+      // size must not exceed the max_size the tree was generated with.
+      bool set_codebook_size(uint size)
+      {
+         if (m_nodes.empty())
+            return false;
+
+         const uint num_splits = math::minimum<uint>(size ? (size - 1) : 0, m_split_node_counts.size());
+         m_num_active_nodes = num_splits ? m_split_node_counts[num_splits - 1] : 1;
+
          m_codebook.clear();
+         m_codebook_nodes.clear();
 
          m_overall_variance = 0.0f;
 
-         for (uint i = 0; i < m_nodes.size(); i++)
+         for (uint i = 0; i < m_num_active_nodes; i++)
          {
             vq_node& node = m_nodes[i];
-            if (node.m_left != -1)
+            if (is_active_internal_node(node))
             {
                CRNLIB_ASSERT(node.m_right != -1);
                continue;
             }
 
-            CRNLIB_ASSERT((node.m_left == -1) && (node.m_right == -1));
-
             node.m_codebook_index = m_codebook.size();
             m_codebook.push_back(node.m_centroid);
+            m_codebook_nodes.push_back(i);
 
             m_overall_variance += node.m_variance;
          }
@@ -133,6 +232,17 @@ namespace crnlib
          return m_codebook[index];
       }
 
+      // Index of the tree node each codebook entry was taken from. A node keeps its index (and centroid) in every cut of the tree.
+      inline const crnlib::vector<uint>& get_codebook_nodes() const
+      {
+         return m_codebook_nodes;
+      }
+
+      inline uint get_num_nodes() const
+      {
+         return m_nodes.size();
+      }
+
       typedef crnlib::vector<VectorType> vector_vec_type;
       inline const vector_vec_type& get_codebook() const
       {
@@ -147,7 +257,7 @@ namespace crnlib
          {
             const vq_node& cur_node = m_nodes[cur_node_index];
 
-            if (cur_node.m_left == -1)
+            if (!is_active_internal_node(cur_node))
                return cur_node.m_codebook_index;
 
             const vq_node& left_node = m_nodes[cur_node.m_left];
@@ -190,14 +300,16 @@ namespace crnlib
 
       struct vq_node
       {
-         vq_node() : m_centroid(cClear), m_total_weight(0), m_left(-1), m_right(-1), m_codebook_index(-1), m_unsplittable(false) { }
+         vq_node() : m_centroid(cClear), m_total_weight(0), m_begin(0), m_end(0), m_left(-1), m_right(-1), m_codebook_index(-1), m_unsplittable(false) { }
 
          VectorType        m_centroid;
          uint64            m_total_weight;
 
          float             m_variance;
 
-         crnlib::vector< std::pair<VectorType, uint> > m_vectors;
+         // The node's training vectors are m_training_vecs[m_indices[m_begin...m_end-1]].
+         uint              m_begin;
+         uint              m_end;
 
          int               m_left;
          int               m_right;
@@ -207,29 +319,146 @@ namespace crnlib
          bool              m_unsplittable;
       };
 
+      enum split_status
+      {
+         cSplitPending,
+         cSplitDone,
+         cSplitFailed,        // All the vectors went to one side.
+         cSplitSingleVector
+      };
+
+      // The outcome of splitting a leaf, computed ahead of the leaf actually being split by generate_codebook(). When done, the
+      // leaf's range of m_indices has been partitioned: [m_begin, m_middle) are the left child's vectors, the rest the right's.
+      struct vq_split
+      {
+         vq_split() : m_status(cSplitPending) { }
+
+         VectorType        m_left_centroid;
+         VectorType        m_right_centroid;
+         uint64            m_left_weight;
+         uint64            m_right_weight;
+         float             m_left_variance;
+         float             m_right_variance;
+         uint              m_middle;
+         split_status      m_status;
+      };
+
+      struct leaf_entry
+      {
+         leaf_entry() { }
+         leaf_entry(float variance, uint node_index) : m_variance(variance), m_node_index(node_index) { }
+
+         float             m_variance;
+         uint              m_node_index;
+
+         // Orders the heap by variance, then by lowest node index, the leaf the original linear scan over the nodes picked.
+         inline bool operator< (const leaf_entry& other) const
+         {
+            if (m_variance != other.m_variance)
+               return m_variance < other.m_variance;
+            return m_node_index > other.m_node_index;
+         }
+
+         static inline bool is_greater(const leaf_entry& lhs, const leaf_entry& rhs)
+         {
+            return rhs < lhs;
+         }
+      };
+
       typedef crnlib::vector<vq_node> node_vec_type;
 
       node_vec_type m_nodes;
 
+      // Number of nodes in m_nodes after each split made by generate_codebook().
+      crnlib::vector<uint> m_split_node_counts;
+
+      // Only valid inside generate_codebook().
+      crnlib::vector< std::pair<VectorType, uint> > m_training_vecs;
+      crnlib::vector<uint> m_indices;
+      crnlib::vector<uint> m_temp_indices;
+      crnlib::vector<vq_split> m_splits;
+
       vector_vec_type m_codebook;
+      crnlib::vector<uint> m_codebook_nodes;
 
       float m_overall_variance;
 
+      uint m_num_active_nodes;
+
+      inline bool is_active_internal_node(const vq_node& node) const
+      {
+         return (node.m_left != -1) && (static_cast<uint>(node.m_left) < m_num_active_nodes);
+      }
+
       random m_rand;
 
+      void compute_split_task(uint64 data, void* pData_ptr)
+      {
+         pData_ptr;
+         split_node(static_cast<uint>(data));
+      }
+
+      // Computes the split of the worst leaf (leaves[0]), along with the splits of the large leaves with the highest variances that
+      // haven't been computed yet. Without helper threads only the worst leaf is split, so no split is ever computed in vain.
+      void compute_splits(const crnlib::vector<leaf_entry>& leaves, task_pool* pTask_pool)
+      {
+         if ((!pTask_pool) || (!pTask_pool->get_num_threads()))
+         {
+            split_node(leaves[0].m_node_index);
+            return;
+         }
+
+         // Leaves with fewer vectors are split faster than they can be handed to a helper thread.
+         const uint cMinParallelSplitVecs = 1024;
+
+         crnlib::vector<leaf_entry> pending;
+         pending.reserve(leaves.size());
+         pending.push_back(leaves[0]);
+
+         for (uint i = 1; i < leaves.size(); i++)
+         {
+            const vq_node& node = m_nodes[leaves[i].m_node_index];
+            if ((m_splits[leaves[i].m_node_index].m_status == cSplitPending) && ((node.m_end - node.m_begin) >= cMinParallelSplitVecs))
+               pending.push_back(leaves[i]);
+         }
+
+         const uint max_splits = (pTask_pool->get_num_threads() + 1) * 2;
+         if (pending.size() > max_splits)
+         {
+            std::nth_element(pending.begin(), pending.begin() + max_splits, pending.end(), leaf_entry::is_greater);
+            pending.resize(max_splits);
+         }
+
+         for (uint i = 1; i < pending.size(); i++)
+            pTask_pool->queue_object_task(this, &tree_clusterizer::compute_split_task, pending[i].m_node_index);
+
+         split_node(pending[0].m_node_index);
+
+         pTask_pool->join();
+      }
+
+      // Splits the leaf's vectors into two clusters, and partitions its range of m_indices accordingly. Only touches the
+      // leaf's own range of m_indices and m_temp_indices, and its entry of m_splits.
       void split_node(uint index)
       {
-         vq_node& parent_node = m_nodes[index];
+         const vq_node& parent_node = m_nodes[index];
+         vq_split& split = m_splits[index];
 
-         if (parent_node.m_vectors.size() == 1)
+         const uint num_vecs = parent_node.m_end - parent_node.m_begin;
+         uint* pIndices = &m_indices[parent_node.m_begin];
+
+         if (num_vecs == 1)
+         {
+            split.m_status = cSplitSingleVector;
             return;
+         }
 
          VectorType furthest(0);
          double furthest_dist = -1.0f;
 
-         for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+         for (uint i = 0; i < num_vecs; i++)
          {
-            const VectorType& v = parent_node.m_vectors[i].first;
+            const VectorType& v = m_training_vecs[pIndices[i]].first;
 
             double dist = v.squared_distance(parent_node.m_centroid);
             if (dist > furthest_dist)
@@ -242,9 +471,9 @@ namespace crnlib
          VectorType opposite;
          double opposite_dist = -1.0f;
 
-         for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+         for (uint i = 0; i < num_vecs; i++)
          {
-            const VectorType& v = parent_node.m_vectors[i].first;
+            const VectorType& v = m_training_vecs[pIndices[i]].first;
 
             double dist = v.squared_distance(furthest);
             if (dist > opposite_dist)
@@ -257,17 +486,17 @@ namespace crnlib
          VectorType left_child((furthest + parent_node.m_centroid) * .5f);
          VectorType right_child((opposite + parent_node.m_centroid) * .5f);
 
-         if (parent_node.m_vectors.size() > 2)
+         if (num_vecs > 2)
          {
             const uint N = VectorType::num_elements;
 
             matrix<N, N, float> covar;
             covar.clear();
 
-            for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+            for (uint i = 0; i < num_vecs; i++)
             {
-               const VectorType v(parent_node.m_vectors[i].first - parent_node.m_centroid);
-               const VectorType w(v * (float)parent_node.m_vectors[i].second);
+               const VectorType v(m_training_vecs[pIndices[i]].first - parent_node.m_centroid);
+               const VectorType w(v * (float)m_training_vecs[pIndices[i]].second);
 
                for (uint x = 0; x < N; x++)
                   for (uint y = x; y < N; y++)
@@ -321,11 +550,11 @@ namespace crnlib
             double left_weight = 0.0f;
             double right_weight = 0.0f;
 
-            for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+            for (uint i = 0; i < num_vecs; i++)
             {
-               const float weight = (float)parent_node.m_vectors[i].second;
+               const float weight = (float)m_training_vecs[pIndices[i]].second;
 
-               const VectorType& v = parent_node.m_vectors[i].first;
+               const VectorType& v = m_training_vecs[pIndices[i]].first;
 
                double t = (v - parent_node.m_centroid) * axis;
                if (t < 0.0f)
@@ -350,11 +579,10 @@ namespace crnlib
          uint64 left_weight = 0;
          uint64 right_weight = 0;
 
-         crnlib::vector< std::pair<VectorType, uint> > left_children;
-         crnlib::vector< std::pair<VectorType, uint> > right_children;
-
-         left_children.reserve(parent_node.m_vectors.size() / 2);
-         right_children.reserve(parent_node.m_vectors.size() / 2);
+         // Each iteration records its assignment in the leaf's range of m_temp_indices: the left child's vectors from the front,
+         // the right child's from the back. The last iteration's assignment becomes the children's.
+         uint* pAssigned = &m_temp_indices[parent_node.m_begin];
+         uint num_left = 0;
 
          float prev_total_variance = 1e+10f;
 
@@ -365,8 +593,8 @@ namespace crnlib
          const uint cMaxLoops = 1024;
          for (uint total_loops = 0; total_loops < cMaxLoops; total_loops++)
          {
-            left_children.resize(0);
-            right_children.resize(0);
+            num_left = 0;
+            uint* pAssigned_right = pAssigned + num_vecs;
 
             VectorType new_left_child(cClear);
             VectorType new_right_child(cClear);
@@ -377,17 +605,17 @@ namespace crnlib
             left_weight = 0;
             right_weight = 0;
 
-            for (uint i = 0; i < parent_node.m_vectors.size(); i++)
+            for (uint i = 0; i < num_vecs; i++)
             {
-               const VectorType& v = parent_node.m_vectors[i].first;
-               const uint weight = parent_node.m_vectors[i].second;
+               const VectorType& v = m_training_vecs[pIndices[i]].first;
+               const uint weight = m_training_vecs[pIndices[i]].second;
 
                double left_dist2 = left_child.squared_distance(v);
                double right_dist2 = right_child.squared_distance(v);
 
                if (left_dist2 < right_dist2)
                {
-                  left_children.push_back(parent_node.m_vectors[i]);
+                  pAssigned[num_left++] = pIndices[i];
 
                   new_left_child += (v * (float)weight);
                   left_weight += weight;
@@ -396,7 +624,7 @@ namespace crnlib
                }
                else
                {
-                  right_children.push_back(parent_node.m_vectors[i]);
+                  *--pAssigned_right = pIndices[i];
 
                   new_right_child += (v * (float)weight);
                   right_weight += weight;
@@ -407,7 +635,7 @@ namespace crnlib
 
             if ((!left_weight) || (!right_weight))
             {
-               parent_node.m_unsplittable = true;
+               split.m_status = cSplitFailed;
                return;
             }
 
@@ -418,10 +646,7 @@ namespace crnlib
             new_right_child *= (1.0f / right_weight);
 
             left_child = new_left_child;
-            left_weight = left_weight;
-
             right_child = new_right_child;
-            right_weight = right_weight;
 
             float total_variance = left_variance + right_variance;
             if (total_variance < .00001f)
@@ -433,28 +658,21 @@ namespace crnlib
             prev_total_variance = total_variance;
          }
 
-         const uint left_child_index = m_nodes.size();
-         const uint right_child_index = m_nodes.size() + 1;
-
-         parent_node.m_left = m_nodes.size();
-         parent_node.m_right = m_nodes.size() + 1;
-
-         m_nodes.resize(m_nodes.size() + 2);
-
-         // parent_node is invalid now, because m_nodes has been changed
+         // Stable partition, so each child's vectors are visited in the same order as the parent's.
+         memcpy(pIndices, pAssigned, num_left * sizeof(uint));
+         for (uint i = num_left; i < num_vecs; i++)
+            pIndices[i] = pAssigned[num_vecs - 1 - (i - num_left)];
 
-         vq_node& left_child_node = m_nodes[left_child_index];
-         vq_node& right_child_node = m_nodes[right_child_index];
+         split.m_left_centroid = left_child;
+         split.m_left_weight = left_weight;
+         split.m_left_variance = left_variance;
 
-         left_child_node.m_centroid = left_child;
-         left_child_node.m_total_weight = left_weight;
-         left_child_node.m_vectors.swap(left_children);
-         left_child_node.m_variance = left_variance;
+         split.m_right_centroid = right_child;
+         split.m_right_weight = right_weight;
+         split.m_right_variance = right_variance;
 
-         right_child_node.m_centroid = right_child;
-         right_child_node.m_total_weight = right_weight;
-         right_child_node.m_vectors.swap(right_children);
-         right_child_node.m_variance = right_variance;
+         split.m_middle = parent_node.m_begin + num_left;
+         split.m_status = cSplitDone;
       }
 
    };
@@ -285,5 +285,16 @@ namespace crnlib
 //      printf("create_zeng_reorder_table end:\n");
    }
 
+   uint64 get_zeng_reorder_table_size(uint n, uint num_indices)
+   {
+#if USE_SPARSE_ARRAY
+      // A pointer per group of pairs, and about one group for every four indices in practice.
+      return static_cast<uint64>(n) * n / hist_type::N * sizeof(uint*) + static_cast<uint64>(num_indices / 4) * (hist_type::N * sizeof(uint) + 16);
+#else
+      num_indices;
+      return static_cast<uint64>(n) * n * sizeof(uint);
+#endif
+   }
+
 } // namespace crnlib
    
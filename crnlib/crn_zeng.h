@@ -6,5 +6,8 @@ namespace crnlib
    typedef float (*zeng_similarity_func)(uint index_a, uint index_b, void* pContext);
    
    void create_zeng_reorder_table(uint n, uint num_indices, const uint* pIndices, crnlib::vector<uint>& remap_table, zeng_similarity_func pFunc, void* pContext, float similarity_func_weight);
+
+   // Rough number of bytes create_zeng_reorder_table() needs for its histogram of index pairs.
+   uint64 get_zeng_reorder_table_size(uint n, uint num_indices);
    
 } // namespace crnlib
@@ -174,6 +174,9 @@ void *crn_compress(const crn_comp_params &comp_params, crn_uint32 &compressed_si
    if (!comp_params.check())
       return NULL;
 
+   // On a shared pool, this call only joins its own tasks.
+   task_pool::scoped_task_group task_group(static_cast<task_pool *>(comp_params.m_pThread_pool));
+
    crnlib::vector<uint8> crn_file_data;
    if (!create_compressed_texture(comp_params, crn_file_data, pActual_quality_level, pActual_bitrate))
       return NULL;
@@ -191,6 +194,9 @@ void *crn_compress(const crn_comp_params &comp_params, const crn_mipmap_params &
    if ((!comp_params.check()) || (!mip_params.check()))
       return NULL;
 
+   // On a shared pool, this call only joins its own tasks.
+   task_pool::scoped_task_group task_group(static_cast<task_pool *>(comp_params.m_pThread_pool));
+
    crnlib::vector<uint8> crn_file_data;
    if (!create_compressed_texture(comp_params, mip_params, crn_file_data, pActual_quality_level, pActual_bitrate))
       return NULL;
@@ -199,6 +205,34 @@ void *crn_compress(const crn_comp_params &comp_params, const crn_mipmap_params &
    return crn_file_data.assume_ownership();
 }
 
+crn_thread_pool_t crn_create_thread_pool(crn_uint32 num_helper_threads)
+{
+   if (num_helper_threads > cCRNMaxHelperThreads)
+      return NULL;
+
+   task_pool *pPool = crnlib_new<task_pool>();
+   if (!pPool)
+      return NULL;
+
+   if (!pPool->init(num_helper_threads))
+   {
+      crnlib_delete(pPool);
+      return NULL;
+   }
+
+   return pPool;
+}
+
+crn_uint32 crn_get_thread_pool_num_helper_threads(crn_thread_pool_t pPool)
+{
+   return pPool ? static_cast<task_pool *>(pPool)->get_num_threads() : 0;
+}
+
+void crn_free_thread_pool(crn_thread_pool_t pPool)
+{
+   crnlib_delete(static_cast<task_pool *>(pPool));
+}
+
 void *crn_decompress_crn_to_dds(const void *pCRN_file_data, crn_uint32 &file_size)
 {
    mipmapped_texture tex;
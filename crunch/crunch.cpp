@@ -41,17 +41,22 @@ class crunch
    uint32 m_num_succeeded;
    uint32 m_num_skipped;
 
+   // Shared by every file processed by this instance, so worker threads are only created once.
+   crn_thread_pool_t m_pThread_pool;
+
 public:
    crunch() :
       m_num_processed(0),
       m_num_failed(0),
       m_num_succeeded(0),
-      m_num_skipped(0)
+      m_num_skipped(0),
+      m_pThread_pool(NULL)
    {
    }
 
    ~crunch()
    {
+      crn_free_thread_pool(m_pThread_pool);
    }
 
    enum convert_status
@@ -95,7 +100,7 @@ public:
       console::printf("-info - Only display input file statistics (no output files are written).");
 
       console::message("\nMisc. options:");
-      console::printf("-helperThreads # - Set number of helper threads, 0-16, default=(# of CPU's)-1");
+      console::printf("-helperThreads # - Set number of helper threads, 0-%u, default=(# of CPU's)-1", cCRNMaxHelperThreads);
       console::printf("-noprogress - Disable progress output");
       console::printf("-quiet - Disable all console output");
       console::printf("-ignoreerrors - Continue processing files after errors. Note: The default");
@@ -132,6 +137,8 @@ public:
       console::printf("-s # - Color selector palette size, 32-8192, default=3072");
       console::printf("-ca # - Alpha endpoint palette size, 32-8192, default=3072");
       console::printf("-sa # - Alpha selector palette size, 32-8192, default=3072");
+      console::printf("-slices # - Add a slice table every # chunk rows, for parallel transcoding");
+      console::printf("-memLimit # - Cap the CRN compressor's memory, source images included, to about # MB (samples the codebooks)");
 
       //                -------------------------------------------------------------------------------
       console::message("\nMipmap filtering options:");
@@ -209,6 +216,8 @@ public:
          { "s", 1, false },
          { "ca", 1, false },
          { "sa", 1, false },
+         { "slices", 1, false },
+         { "memLimit", 1, false },
 
          { "mipMode", 1, false },
          { "mipFilter", 1, false },
@@ -888,6 +897,9 @@ private:
          comp_params.m_crn_alpha_selector_palette_size = alpha_selectors;
       }
 
+      comp_params.m_crn_slice_chunk_rows = m_params.get_value_as_int("slices", 0, 0, 0, cCRNMaxLevelResolution / 8);
+      comp_params.m_crn_memory_limit_mb = m_params.get_value_as_int("memLimit", 0, 0, 0, INT_MAX);
+
       if (m_params.has_key("alphaThreshold"))
       {
          int dxt1a_alpha_threshold = m_params.get_value_as_int("alphaThreshold", 0, 128, 0, 255);
@@ -906,6 +918,10 @@ private:
       else if (g_number_of_processors > 1)
          comp_params.m_num_helper_threads = g_number_of_processors - 1;
 
+      if ((comp_params.m_num_helper_threads) && (!m_pThread_pool))
+         m_pThread_pool = crn_create_thread_pool(comp_params.m_num_helper_threads);
+      comp_params.m_pThread_pool = m_pThread_pool;
+
       dynamic_string comp_name;
       if (m_params.get_value_as_string("compressor", 0, comp_name))
       {
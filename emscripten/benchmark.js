@@ -0,0 +1,139 @@
+// Times the javascript transcoder builds made by the Makefile against each other under node, and checks they unpack identically.
+//
+// Usage: node benchmark.js build1.js [build2.js ...] file1.crn [file2.crn ...]
+
+var fs = require('fs');
+var path = require('path');
+
+var kRuns = 10;
+var kWordsPerTexture = 14;  // sizeof(crnd_batch_texture) / 4 on wasm32
+var kFaces = 9;
+var kUnpackedSize = 12;
+
+function loadModule(file) {
+  return require(path.resolve(file))();
+}
+
+function now() {
+  var t = process.hrtime();
+  return t[0] * 1000 + t[1] / 1e6;
+}
+
+function copyFiles(Module, files) {
+  return files.map(function(data) {
+    var ptr = Module._malloc(data.length);
+    Module.HEAPU8.set(data, ptr);
+    return { ptr: ptr, size: data.length };
+  });
+}
+
+// Fills in the crnd_batch_texture array, queries the unpacked sizes and allocates the destination buffers.
+function setupBatch(Module, srcs) {
+  var desc = Module._malloc(srcs.length * kWordsPerTexture * 4);
+  Module.HEAPU32.fill(0, desc >> 2, (desc >> 2) + srcs.length * kWordsPerTexture);
+  srcs.forEach(function(src, i) {
+    var w = (desc >> 2) + i * kWordsPerTexture;
+    Module.HEAPU32[w + 0] = src.ptr;
+    Module.HEAPU32[w + 1] = src.size;
+  });
+  Module._crn_decompress_batch(desc, srcs.length);
+
+  var total = 0;
+  srcs.forEach(function(src, i) {
+    var w = (desc >> 2) + i * kWordsPerTexture;
+    var size = Module.HEAPU32[w + kUnpackedSize];
+    Module.HEAPU32[w + 4] = Module._malloc(size);
+    Module.HEAPU32[w + 5] = size;
+    total += size;
+  });
+  return { desc: desc, total: total };
+}
+
+function timeBest(fn) {
+  var best = Infinity;
+  for (var i = 0; i < kRuns; i++) {
+    var start = now();
+    fn();
+    best = Math.min(best, now() - start);
+  }
+  return best;
+}
+
+function run(file, files) {
+  var Module = loadModule(file);
+  return Promise.resolve(Module).then(function(Module) {
+    var srcs = copyFiles(Module, files);
+    var batch = setupBatch(Module, srcs);
+    var count = srcs.length;
+
+    var ok = 0;
+    var batchMs = timeBest(function() { ok = Module._crn_decompress_batch(batch.desc, count); });
+    if (ok != count)
+      throw new Error(file + ': ' + (count - ok) + ' textures failed to unpack');
+
+    // One crn_decompress() call per file, all levels, on the textures with a single face.
+    var serial = srcs.filter(function(src, i) {
+      return Module.HEAPU32[(batch.desc >> 2) + i * kWordsPerTexture + kFaces] == 1;
+    });
+    var serialBytes = 0;
+    serial.forEach(function(src) {
+      src.dstSize = Module.HEAPU32[(batch.desc >> 2) + srcs.indexOf(src) * kWordsPerTexture + kUnpackedSize];
+      src.dst = Module._malloc(src.dstSize);
+      serialBytes += src.dstSize;
+    });
+    var serialMs = timeBest(function() {
+      serial.forEach(function(src) {
+        if (!Module._crn_decompress(src.ptr, src.size, src.dst, src.dstSize, 0, Module._crn_get_levels(src.ptr, src.size)))
+          throw new Error(file + ': crn_decompress failed on file ' + srcs.indexOf(src));
+      });
+    });
+
+    var unpacked = srcs.map(function(src, i) {
+      var w = (batch.desc >> 2) + i * kWordsPerTexture;
+      var dst = Module.HEAPU32[w + 4];
+      return Buffer.from(Module.HEAPU8.subarray(dst, dst + Module.HEAPU32[w + kUnpackedSize]));
+    });
+    serial.forEach(function(src) {
+      if (!Buffer.from(Module.HEAPU8.subarray(src.dst, src.dst + src.dstSize)).equals(unpacked[srcs.indexOf(src)]))
+        throw new Error(file + ': crn_decompress and crn_decompress_batch differ on file ' + srcs.indexOf(src));
+    });
+
+    return { file: file, batchMs: batchMs, batchBytes: batch.total, serialMs: serialMs, serialBytes: serialBytes, unpacked: unpacked };
+  });
+}
+
+function mbs(bytes, ms) {
+  return (bytes / (1024 * 1024) / (ms / 1000)).toFixed(1);
+}
+
+var args = process.argv.slice(2);
+var builds = args.filter(function(a) { return /\.js$/.test(a); });
+var files = args.filter(function(a) { return !/\.js$/.test(a); }).map(function(f) { return fs.readFileSync(f); });
+
+if (!builds.length || !files.length) {
+  console.log('Usage: node benchmark.js build1.js [build2.js ...] file1.crn [file2.crn ...]');
+  process.exit(1);
+}
+
+var results = [];
+builds.reduce(function(p, build) {
+  return p.then(function() { return run(build, files); }).then(function(r) { results.push(r); });
+}, Promise.resolve()).then(function() {
+  console.log(files.length + ' files, best of ' + kRuns + ' runs');
+  results.forEach(function(r) {
+    console.log(r.file + ':');
+    console.log('  crn_decompress_batch: ' + r.batchMs.toFixed(2) + ' ms, ' + mbs(r.batchBytes, r.batchMs) + ' MB/s');
+    console.log('  crn_decompress:       ' + r.serialMs.toFixed(2) + ' ms, ' + mbs(r.serialBytes, r.serialMs) + ' MB/s');
+  });
+  for (var i = 1; i < results.length; i++) {
+    results[i].unpacked.forEach(function(u, j) {
+      if (!u.equals(results[0].unpacked[j]))
+        throw new Error(results[i].file + ' and ' + results[0].file + ' differ on file ' + j);
+    });
+    console.log(results[i].file + ' vs ' + results[0].file + ': ' + (results[0].batchMs / results[i].batchMs).toFixed(2) + 'x');
+  }
+  process.exit(0);
+}).catch(function(e) {
+  console.error(e.message);
+  process.exit(1);
+});
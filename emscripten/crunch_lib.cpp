@@ -20,13 +20,16 @@ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
-#define PLATFORM_NACL // This disables use of 64 bit integers, among other things.
-
 #include <stddef.h> // For NULL, size_t
 #include <cstring> // for malloc etc
 
 #include "crn_decomp.h"
 
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <pthread.h>
+#include <emscripten/threading.h>
+#endif
+
 extern "C" {
   unsigned int crn_get_width(void *src, unsigned int src_size);
   unsigned int crn_get_height(void *src, unsigned int src_size);
@@ -34,7 +37,90 @@ extern "C" {
   unsigned int crn_get_dxt_format(void *src, unsigned int src_size);
   unsigned int crn_get_bytes_per_block(void *src, unsigned int src_size);
   unsigned int crn_get_uncompressed_size(void *p, unsigned int size, unsigned int level);
-  void crn_decompress(void *src, unsigned int src_size, void *dst, unsigned int dst_size, unsigned int firstLevel, unsigned int levelCount);
+  // Unpacks levelCount levels starting with firstLevel to dst, one after another. Returns 1 on success, 0 if the parameters or the
+  // file are invalid.
+  unsigned int crn_decompress(void *src, unsigned int src_size, void *dst, unsigned int dst_size, unsigned int firstLevel, unsigned int levelCount);
+
+  // Transcodes many textures in one call. textures points to count crnd_batch_texture structs of 14 32-bit words each:
+  // src, src_size, first_level, level_count (0 for all), dst, dst_size, followed by the words the call fills in: width, height,
+  // levels, faces, bytes_per_block, format, unpacked_size and status. Call it with dst = 0 first to get the sizes of the buffers.
+  // Returns the number of textures with status 1.
+  unsigned int crn_decompress_batch(void *textures, unsigned int count);
+
+  // Sets the number of threads crn_decompress() and crn_decompress_batch() spread their levels and textures over, in builds
+  // with pthreads (see the Makefile). 0, the default, uses one thread per logical core. Either way the calling thread is only
+  // joined by up to CRN_PTHREAD_POOL_SIZE threads. Ignored by single threaded builds.
+  void crn_set_num_threads(unsigned int num_threads);
+}
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+// Must match the -s PTHREAD_POOL_SIZE the module is linked with (the Makefile passes both).
+#ifndef CRN_PTHREAD_POOL_SIZE
+#define CRN_PTHREAD_POOL_SIZE 4
+#endif
+
+static const unsigned int cMaxThreads = CRN_PTHREAD_POOL_SIZE + 1;
+static unsigned int g_num_threads;
+
+struct dispatch_state {
+  crnd::crnd_unpack_job_func job_func;
+  void *job_data;
+  unsigned int num_jobs;
+  unsigned int next_job;
+};
+
+static void *dispatch_worker(void *p) {
+  dispatch_state *state = static_cast<dispatch_state*>(p);
+  for ( ; ; ) {
+    const unsigned int job_index = __sync_fetch_and_add(&state->next_job, 1);
+    if (job_index >= state->num_jobs)
+      break;
+    state->job_func(state->job_data, job_index);
+  }
+  return NULL;
+}
+
+// A crnd_unpack_dispatch_func running the jobs on the calling thread and up to g_num_threads - 1 pthreads. pthread_create() can
+// only start a thread without returning to the event loop when emscripten's prewarmed worker pool has a free worker, and the
+// calling thread blocks in pthread_join() below, so it never starts more than PTHREAD_POOL_SIZE (cMaxThreads - 1) threads.
+static void dispatch_jobs(crnd::crnd_unpack_job_func job_func, void *job_data, crn_uint32 num_jobs, void *user_data) {
+  dispatch_state state;
+  state.job_func = job_func;
+  state.job_data = job_data;
+  state.num_jobs = num_jobs;
+  state.next_job = 0;
+
+  unsigned int num_threads = g_num_threads ? g_num_threads : emscripten_num_logical_cores();
+  if (num_threads > num_jobs)
+    num_threads = num_jobs;
+  if (num_threads > cMaxThreads)
+    num_threads = cMaxThreads;
+
+  pthread_t threads[cMaxThreads];
+  unsigned int num_started = 0;
+  while ((num_started + 1) < num_threads) {
+    if (pthread_create(&threads[num_started], NULL, dispatch_worker, &state))
+      break;
+    num_started++;
+  }
+
+  dispatch_worker(&state);
+
+  for (unsigned int i = 0; i < num_started; i++)
+    pthread_join(threads[i], NULL);
+}
+
+#define CRN_DISPATCH_FUNC dispatch_jobs
+#else
+#define CRN_DISPATCH_FUNC NULL
+#endif
+
+void crn_set_num_threads(unsigned int num_threads) {
+#ifdef __EMSCRIPTEN_PTHREADS__
+  g_num_threads = num_threads;
+#else
+  (void)num_threads;
+#endif
 }
 
 unsigned int crn_get_width(void *src, unsigned int src_size) {
@@ -70,8 +156,8 @@ unsigned int crn_get_bytes_per_block(void *src, unsigned int src_size) {
 unsigned int crn_get_uncompressed_size(void *src, unsigned int src_size, unsigned int level) {
   crnd::crn_texture_info tex_info;
   crnd::crnd_get_texture_info(static_cast<crn_uint8*>(src), src_size, &tex_info);
-  const crn_uint32 width = tex_info.m_width >> level;
-  const crn_uint32 height = tex_info.m_height >> level;
+  const crn_uint32 width = tex_info.m_width >> level ? tex_info.m_width >> level : 1;
+  const crn_uint32 height = tex_info.m_height >> level ? tex_info.m_height >> level : 1;
   const crn_uint32 blocks_x = (width + 3) >> 2;
   const crn_uint32 blocks_y = (height + 3) >> 2;
   const crn_uint32 row_pitch = blocks_x * crnd::crnd_get_bytes_per_dxt_block(tex_info.m_format);
@@ -79,32 +165,80 @@ unsigned int crn_get_uncompressed_size(void *src, unsigned int src_size, unsigne
   return total_face_size;
 }
 
-void crn_decompress(void *src, unsigned int src_size, void *dst, unsigned int dst_size, unsigned int firstLevel, unsigned int levelCount) {
+struct decompress_state {
+  crnd::crnd_unpack_context context;
+  unsigned int first_level;
+  void *level_dst[cCRNMaxLevels];
+  crn_uint32 level_size[cCRNMaxLevels];
+  crn_uint32 row_pitch[cCRNMaxLevels];
+  bool level_ok[cCRNMaxLevels];
+};
+
+static void decompress_level(void *job_data, crn_uint32 job_index) {
+  decompress_state *state = static_cast<decompress_state*>(job_data);
+  state->level_ok[job_index] = crnd::crnd_unpack_level(state->context, &state->level_dst[job_index], state->level_size[job_index], state->row_pitch[job_index], state->first_level + job_index);
+}
+
+unsigned int crn_decompress(void *src, unsigned int src_size, void *dst, unsigned int dst_size, unsigned int firstLevel, unsigned int levelCount) {
   crnd::crn_texture_info tex_info;
-  crnd::crnd_get_texture_info(static_cast<crn_uint8*>(src), src_size, &tex_info);
+  if (!crnd::crnd_get_texture_info(static_cast<crn_uint8*>(src), src_size, &tex_info))
+    return 0;
 
   crn_uint32 width = tex_info.m_width >> firstLevel;
   crn_uint32 height = tex_info.m_height >> firstLevel;
   crn_uint32 bytes_per_block = crnd::crnd_get_bytes_per_dxt_block(tex_info.m_format);
+  if (!width)
+    width = 1;
+  if (!height)
+    height = 1;
+
+  if (levelCount > cCRNMaxLevels)
+    return 0;
 
-  void *pDecomp_images[1];
-  pDecomp_images[0] = dst;
+  decompress_state state;
+  state.first_level = firstLevel;
 
-  crnd::crnd_unpack_context pContext =
-      crnd::crnd_unpack_begin(static_cast<crn_uint8*>(src), src_size);
+  char *pDecomp_image = static_cast<char*>(dst);
 
-  for (int i = firstLevel; i < firstLevel + levelCount; ++i) {
+  for (unsigned int i = 0; i < levelCount; ++i) {
     crn_uint32 blocks_x = (width + 3) >> 2;
     crn_uint32 blocks_y = (height + 3) >> 2;
     crn_uint32 row_pitch = blocks_x * bytes_per_block;
     crn_uint32 total_level_size = row_pitch * blocks_y;
 
-    crnd::crnd_unpack_level(pContext, pDecomp_images, total_level_size, row_pitch, i);
-    pDecomp_images[0] = (char*)pDecomp_images[0] + total_level_size;
+    state.level_dst[i] = pDecomp_image;
+    state.level_size[i] = total_level_size;
+    state.row_pitch[i] = row_pitch;
+    pDecomp_image += total_level_size;
 
-    width = width >> 1;
-    height = height >> 1;
+    width = width > 1 ? width >> 1 : 1;
+    height = height > 1 ? height >> 1 : 1;
+  }
+  if (static_cast<unsigned int>(pDecomp_image - static_cast<char*>(dst)) > dst_size)
+    return 0;
+
+  state.context = crnd::crnd_unpack_begin(static_cast<crn_uint8*>(src), src_size);
+  if (!state.context)
+    return 0;
+
+  // Each level is a job, see crn_set_num_threads().
+  crnd::crnd_unpack_dispatch_func dispatch = CRN_DISPATCH_FUNC;
+  if (dispatch)
+    dispatch(decompress_level, &state, levelCount, NULL);
+  else {
+    for (unsigned int i = 0; i < levelCount; ++i)
+      decompress_level(&state, i);
   }
 
-  crnd::crnd_unpack_end(pContext);
-}
\ No newline at end of file
+  crnd::crnd_unpack_end(state.context);
+
+  for (unsigned int i = 0; i < levelCount; ++i) {
+    if (!state.level_ok[i])
+      return 0;
+  }
+  return 1;
+}
+
+unsigned int crn_decompress_batch(void *textures, unsigned int count) {
+  return crnd::crnd_unpack_batch(static_cast<crnd::crnd_batch_texture*>(textures), count, CRN_DISPATCH_FUNC, NULL);
+}
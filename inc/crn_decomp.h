@@ -139,6 +139,15 @@ namespace crnd
    // The crn_level_info.m_struct_size field must be set before calling this function.
    bool crnd_get_level_info(const void* pData, uint32 data_size, uint32 level_index, crn_level_info* pLevel_info);
 
+   // Pixel formats written by crnd_unpack_level_pixels().
+   enum crnd_pixel_format
+   {
+      cCRNDPixelFmtRGBA8888,  // 4 bytes per pixel, in R, G, B, A order.
+      cCRNDPixelFmtRGB565,    // 16-bit native endian pixels, red in the top 5 bits. Alpha is dropped.
+
+      cCRNDPixelFmtTotal
+   };
+
    // Transcode/unpack context handle.
    typedef void* crnd_unpack_context;
 
@@ -146,12 +155,25 @@ namespace crnd
    // Once you call this function, you may call crnd_unpack_level() to unpack one or more mip levels.
    // Don't call this once per mip level (unless you absolutely must)!
    // This function allocates enough memory to hold: Huffman decompression tables, and the endpoint/selector palettes (color and/or alpha).
-   // Worst case allocation is approx. 200k, assuming all palettes contain 8192 entries.
+   // Worst case allocation is approx. 270k, assuming all palettes contain 8192 entries.
    // pData must point to a buffer holding all of the compressed .CRN file data.
    // This buffer must be stable until crnd_unpack_end() is called.
    // Returns NULL if out of memory, or if any of the input parameters are invalid.
    crnd_unpack_context crnd_unpack_begin(const void* pData, uint32 data_size);
 
+   // crnd_get_unpack_arena_size() - Returns the size of the scratch buffer crnd_unpack_begin_arena() needs to unpack the texture,
+   // computed from the header alone. Returns 0 if the header is invalid.
+   uint32 crnd_get_unpack_arena_size(const void* pData, uint32 data_size);
+
+   // crnd_unpack_begin_arena() - Same as crnd_unpack_begin(), but the context, its decoder tables and its palettes are placed in
+   // the caller supplied scratch buffer pArena, so no heap memory is allocated by this or any other function using the context.
+   // pArena must be aligned to CRND_MIN_ALLOC_ALIGNMENT bytes, hold at least crnd_get_unpack_arena_size() bytes, and be stable
+   // until crnd_unpack_end() is called. crnd_unpack_end() doesn't free the buffer, which can be reused once it returns.
+   // crnd_unpack_level_region() and crnd_unpack_level_slices() take their temporary buffers from the scratch buffer, so on
+   // contexts created by this function they may not be called by several threads at once. The other functions stay thread safe.
+   // Returns NULL if the scratch buffer is too small, or if any of the input parameters are invalid.
+   crnd_unpack_context crnd_unpack_begin_arena(const void* pData, uint32 data_size, void* pArena, uint32 arena_size);
+
    // Returns a pointer to the compressed .CRN data associated with a crnd_unpack_context.
    // Returns false if any of the input parameters are invalid.
    bool crnd_get_data(crnd_unpack_context pContext, const void** ppData, uint32* pData_size);
@@ -164,11 +186,43 @@ namespace crnd
    // level_index - mipmap level index, where 0 is the largest/first level.
    // Returns false if any of the input parameters, or the compressed stream, are invalid.
    // This function does not allocate any memory.
+   // This function is thread safe: several threads may unpack different levels (or the same level to different buffers) from one context at once.
    bool crnd_unpack_level(
       crnd_unpack_context pContext,
       void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
       uint32 level_index);
 
+   // crnd_unpack_level_reference() - Same as crnd_unpack_level(), but decodes the level with the original one symbol per table lookup
+   // Huffman decoder. Produces identical output, and is only useful for testing and benchmarking crnd_unpack_level().
+   bool crnd_unpack_level_reference(
+      crnd_unpack_context pContext,
+      void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index);
+
+   // crnd_unpack_level_region() - Transcodes the blocks of a rectangle of the specified mipmap level, for example a virtual texturing tile.
+   // ppDst - A pointer to an array of 1 or 6 destination buffer pointers, one per face, each receiving the rectangle's blocks of that face.
+   // row_pitch_in_bytes - The pitch in bytes from one row of blocks to the next, or 0 for ((x + width + 3) / 4 - x / 4) blocks. Must be a multiple of 4.
+   // x, y, width, height - The rectangle in pixels. It must lie inside the level, and is extended outwards to whole blocks.
+   // The rows of chunks (8 pixel rows each) holding the rectangle are always decoded entirely. Files compressed with a slice table
+   // (see crn_comp_params::m_crn_slice_chunk_rows) let this function start decoding at the slice holding the rectangle's first row;
+   // otherwise each face is decoded from the start of the level. This function allocates a temporary buffer holding two rows of blocks.
+   bool crnd_unpack_level_region(
+      crnd_unpack_context pContext,
+      void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index, uint32 x, uint32 y, uint32 width, uint32 height);
+
+   // crnd_unpack_level_pixels() - Decodes the specified mipmap level straight to pixels, for clients without DXT support, without
+   // transcoding to DXT blocks first. Each destination buffer receives width x height pixels of the level, in the given pixel format.
+   // row_pitch_in_bytes - The pitch in bytes from one row of pixels to the next, or 0 for tightly packed rows. Must be a multiple of the pixel size.
+   // The pixels are those crnlib's dxt_image::unpack() decodes from the transcoded blocks: channels without a block (like B and A
+   // of DXN) are 0, except A which is 255. Swizzled DXT5 formats are not unswizzled, DXT5A can only be unpacked to RGBA8888, and
+   // ETC1 is not supported.
+   // This function is thread safe, and does not allocate any memory.
+   bool crnd_unpack_level_pixels(
+      crnd_unpack_context pContext,
+      void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index, crnd_pixel_format pixel_format);
+
    // crnd_unpack_level_segmented() - Unpacks the specified mipmap level from a "segmented" CRN file.
    // See the crnd_create_segmented_file() API below.
    // Segmented files allow the user to control where the compressed mipmap data is stored.
@@ -178,6 +232,119 @@ namespace crnd
       void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
       uint32 level_index);
 
+   // crnd_unpack_begin_tables() - Same as crnd_unpack_begin(), but the context keeps its own copy of the file's header, palettes and tables
+   // (see crnd_get_segmented_file_size()), so pData doesn't need to stay around. The file may be a normal or a segmented file.
+   // The context only unpacks levels with crnd_unpack_level_segmented(), and can be kept as a texture's decoded tables: decoding them is
+   // the expensive part of crnd_unpack_begin(), and it's only done once for all of the levels of all of the files sharing them.
+   // Returns NULL if out of memory, or if any of the input parameters are invalid.
+   crnd_unpack_context crnd_unpack_begin_tables(const void* pData, uint32 data_size);
+
+   // Returns true if the levels of the specified .CRN file (normal or segmented) can be unpacked with the context's tables: the file must
+   // have the same dimensions, format, palettes and tables. Segmented files created from the same texture always share them.
+   bool crnd_unpack_tables_match(crnd_unpack_context pContext, const void* pData, uint32 data_size);
+
+   // Job function passed to a crnd_unpack_dispatch_func. Runs job job_index of the jobs described by pJob_data.
+   typedef void (*crnd_unpack_job_func)(void* pJob_data, uint32 job_index);
+
+   // Caller supplied job dispatcher used by crnd_unpack_levels(), typically backed by the caller's thread pool.
+   // It must call pJob_func(pJob_data, i) exactly once for each i in [0, num_jobs), from any threads, and must not return until all of these calls have returned.
+   // pUser_data is the value passed to crnd_unpack_levels().
+   typedef void (*crnd_unpack_dispatch_func)(crnd_unpack_job_func pJob_func, void* pJob_data, uint32 num_jobs, void* pUser_data);
+
+   // crnd_unpack_levels() - Transcodes every mipmap level of the texture, one job per level.
+   // pContext - Context created by a call to crnd_unpack_begin().
+   // pppDst - An array holding one ppDst array per level (see crnd_unpack_level()), each with 1 or 6 destination buffer pointers.
+   // pDst_sizes_in_bytes - Optional array of destination buffer sizes, one per level. May be NULL.
+   // pRow_pitches_in_bytes - Optional array of row pitches, one per level. May be NULL, in which case each level is tightly packed.
+   // pDispatch - Runs the per-level jobs. If NULL, the levels are unpacked one after another on the calling thread.
+   // The faces of a level are stored in a single compressed stream, so they are always unpacked by the same job.
+   // Returns false if any of the input parameters are invalid, or if any level failed to unpack.
+   bool crnd_unpack_levels(
+      crnd_unpack_context pContext,
+      void*** pppDst, const uint32* pDst_sizes_in_bytes, const uint32* pRow_pitches_in_bytes,
+      crnd_unpack_dispatch_func pDispatch, void* pUser_data);
+
+   // Returns the number of slices of the specified level, counting the slices of every face. Files compressed with a slice table
+   // (see crn_comp_params::m_crn_slice_chunk_rows) split each face of a level into bands of rows that can be unpacked independently.
+   // Returns 1 if the file has no slice table, and 0 if any of the input parameters are invalid.
+   uint32 crnd_get_level_num_slices(crnd_unpack_context pContext, uint32 level_index);
+
+   // crnd_unpack_level_slice() - Transcodes one slice of the specified mipmap level. Same parameters as crnd_unpack_level(), but only
+   // the blocks of the slice's rows of the slice's face are written. Slices are numbered face by face, from top to bottom.
+   // This function is thread safe, and does not allocate any memory.
+   bool crnd_unpack_level_slice(
+      crnd_unpack_context pContext,
+      void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index, uint32 slice_index);
+
+   // crnd_unpack_level_slices() - Transcodes the specified mipmap level, one job per slice.
+   // pDispatch - Runs the per-slice jobs, see crnd_unpack_levels(). If NULL, the slices are unpacked one after another on the calling thread.
+   // Returns false if any of the input parameters are invalid, or if any slice failed to unpack.
+   bool crnd_unpack_level_slices(
+      crnd_unpack_context pContext,
+      void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index,
+      crnd_unpack_dispatch_func pDispatch, void* pUser_data);
+
+   // One texture of a crnd_unpack_batch() call. Every member is 32 bits wide on 32-bit platforms, so the array can be filled in
+   // directly by the JavaScript side of an emscripten build.
+   struct crnd_batch_texture
+   {
+      // Set by the caller.
+      const void* m_pData;             // The .CRN file.
+      uint32      m_data_size;
+      uint32      m_first_level;
+      uint32      m_num_levels;        // 0 unpacks all levels starting with m_first_level.
+      void*       m_pDst;              // Receives the levels one after another, each holding its faces one after another, tightly packed.
+      uint32      m_dst_size;
+
+      // Set by crnd_unpack_batch().
+      uint32      m_width;
+      uint32      m_height;
+      uint32      m_levels;
+      uint32      m_faces;
+      uint32      m_bytes_per_block;
+      crn_format  m_format;
+      uint32      m_unpacked_size;     // The number of bytes of m_pDst taken by the unpacked levels.
+      uint32      m_status;            // 1 if the levels were unpacked (or, if m_pDst is NULL, if the members above were set), 0 otherwise.
+   };
+
+   // crnd_unpack_batch() - Reads the header of every texture once, and transcodes the requested levels of all of them.
+   // If a texture's m_pDst is NULL, only its header members and m_unpacked_size are set, to size its buffer for a following call.
+   // pDispatch - Runs one job per texture, see crnd_unpack_levels(). If NULL, the textures are unpacked one after another on the calling thread.
+   // Returns the number of textures whose m_status is 1.
+   uint32 crnd_unpack_batch(crnd_batch_texture* pTextures, uint32 num_textures, crnd_unpack_dispatch_func pDispatch, void* pUser_data);
+
+   // The following API's transcode a .CRN file while its bytes are still arriving, for example from the network.
+   // Stream contexts hold a copy of the file. They must not be used by several threads at once while bytes are pushed or
+   // streamed levels unpacked, but levels whose data is complete may be unpacked with any of the functions above.
+
+   // crnd_unpack_stream_begin() - Creates a context for a .CRN file whose bytes will be passed to crnd_unpack_stream_push(), in order.
+   // Returns NULL if out of memory.
+   crnd_unpack_context crnd_unpack_stream_begin();
+
+   // crnd_unpack_stream_push() - Appends the next data_size bytes of the file to the context.
+   // Once the header, palettes and tables (all stored before the first level) have arrived, they're decoded, and crnd_unpack_stream_is_ready() returns true.
+   // Returns false if out of memory, if the data is invalid, or if more bytes than the file holds are pushed. The context can't be used after that.
+   bool crnd_unpack_stream_push(crnd_unpack_context pContext, const void* pData, uint32 data_size);
+
+   // Returns true once the context's tables have been decoded. Until then, every other function fails on the context.
+   bool crnd_unpack_stream_is_ready(crnd_unpack_context pContext);
+
+   // Returns the number of levels whose data has completely arrived. Levels are stored starting with the largest (level 0).
+   uint32 crnd_unpack_stream_get_num_complete_levels(crnd_unpack_context pContext);
+
+   // crnd_unpack_stream_level() - Transcodes the rows of chunks (2 rows of blocks each) of the level that can be decoded from the bytes
+   // pushed so far, and which haven't been transcoded by earlier calls. Call again with the same destination buffers as more bytes arrive.
+   // pNum_rows_ready - Receives the number of the level's rows of chunks that have been transcoded, counting the rows of all faces in order:
+   // row y of face f is ready once the count exceeds f * ((height + 7) / 8) + y. The level is done when the count reaches faces * ((height + 7) / 8).
+   // Blocks of rows that aren't ready yet may be overwritten with garbage, which is replaced once they're ready.
+   // Returns false if any of the input parameters are invalid.
+   bool crnd_unpack_stream_level(
+      crnd_unpack_context pContext,
+      void** ppDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index, uint32* pNum_rows_ready);
+
    // crnd_unpack_end() - Frees the decompress tables and unpacked palettes associated with the specified unpack context.
    // Returns false if the context is NULL, or if it points to an invalid context.
    // This function frees all memory associated with the context.
@@ -284,7 +451,8 @@ namespace crnd
       crn_packed_uint<1>    m_format;
       crn_packed_uint<2>    m_flags;
 
-      crn_packed_uint<4>    m_reserved;
+      // Offset of the optional crn_slice_table, or 0. Older decoders ignore it.
+      crn_packed_uint<4>    m_slice_table_ofs;
       crn_packed_uint<4>    m_userdata0;
       crn_packed_uint<4>    m_userdata1;
 
@@ -303,6 +471,28 @@ namespace crnd
 
    const unsigned int cCRNHeaderMinSize = 62U;
 
+   // Written by the compressor when crn_comp_params::m_crn_slice_chunk_rows is non-zero. Each level's chunk stream is still
+   // a single stream, but the table holds the decoder state at the start of every m_chunk_rows rows of chunks, so each of
+   // these slices can be decoded on its own. The table is followed by the slices of each face of each level, in level,
+   // face, row order.
+   struct crn_slice_table
+   {
+      crn_packed_uint<2>    m_chunk_rows;
+   };
+
+   struct crn_slice
+   {
+      // Offset in bits from the start of the level's data.
+      crn_packed_uint<4>    m_bit_ofs;
+
+      // The chunk encodings left over from the previous chunk encoding symbol, with a 1 bit above the last one.
+      crn_packed_uint<2>    m_chunk_encoding_bits;
+
+      // The previous palette indices: color, alpha0 and alpha1.
+      crn_packed_uint<2>    m_endpoint_index[3];
+      crn_packed_uint<2>    m_selector_index[3];
+   };
+
 #pragma pack(pop)
 
 } // namespace crnd
@@ -331,15 +521,74 @@ namespace crnd
 #pragma intrinsic(_ReadWriteBarrier)
 #define CRND_WRITE_BARRIER _WriteBarrier();
 #define CRND_FULL_BARRIER _ReadWriteBarrier();
+#define CRND_THREAD_LOCAL __declspec(thread)
 #else
 #define CRND_WRITE_BARRIER
 #define CRND_FULL_BARRIER
+#define CRND_THREAD_LOCAL __thread
 #endif
 
 #ifdef _MSC_VER
 #pragma warning(disable:4127) // warning C4127: conditional expression is constant
 #endif
 
+// The few 128-bit vector operations used to unpack the selector palettes, on SSE2, NEON or WASM SIMD128.
+// Define CRND_NO_SIMD to always use the scalar code.
+#if !defined(CRND_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#include <emmintrin.h>
+#define CRND_SIMD 1
+typedef __m128i crnd_vec;
+#define CRND_VEC_LOAD(p) _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))
+#define CRND_VEC_STORE(p, v) _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v)
+#define CRND_VEC_SPLAT8(x) _mm_set1_epi8(static_cast<char>(x))
+#define CRND_VEC_SPLAT16(x) _mm_set1_epi16(static_cast<short>(x))
+#define CRND_VEC_SPLAT32(x) _mm_set1_epi32(static_cast<int>(x))
+#define CRND_VEC_ADD8(a, b) _mm_add_epi8(a, b)
+#define CRND_VEC_AND(a, b) _mm_and_si128(a, b)
+#define CRND_VEC_OR(a, b) _mm_or_si128(a, b)
+#define CRND_VEC_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define CRND_VEC_CMPEQ8(a, b) _mm_cmpeq_epi8(a, b)
+#define CRND_VEC_SRL16(v, n) _mm_srli_epi16(v, n)
+#define CRND_VEC_SRL32(v, n) _mm_srli_epi32(v, n)
+#define CRND_VEC_SRL64(v, n) _mm_srli_epi64(v, n)
+#elif !defined(CRND_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#define CRND_SIMD 1
+typedef uint8x16_t crnd_vec;
+#define CRND_VEC_LOAD(p) vld1q_u8(reinterpret_cast<const uint8_t*>(p))
+#define CRND_VEC_STORE(p, v) vst1q_u8(reinterpret_cast<uint8_t*>(p), v)
+#define CRND_VEC_SPLAT8(x) vdupq_n_u8(static_cast<uint8_t>(x))
+#define CRND_VEC_SPLAT16(x) vreinterpretq_u8_u16(vdupq_n_u16(static_cast<uint16_t>(x)))
+#define CRND_VEC_SPLAT32(x) vreinterpretq_u8_u32(vdupq_n_u32(static_cast<uint32_t>(x)))
+#define CRND_VEC_ADD8(a, b) vaddq_u8(a, b)
+#define CRND_VEC_AND(a, b) vandq_u8(a, b)
+#define CRND_VEC_OR(a, b) vorrq_u8(a, b)
+#define CRND_VEC_ANDNOT(a, b) vbicq_u8(b, a)
+#define CRND_VEC_CMPEQ8(a, b) vceqq_u8(a, b)
+#define CRND_VEC_SRL16(v, n) vreinterpretq_u8_u16(vshrq_n_u16(vreinterpretq_u16_u8(v), n))
+#define CRND_VEC_SRL32(v, n) vreinterpretq_u8_u32(vshrq_n_u32(vreinterpretq_u32_u8(v), n))
+#define CRND_VEC_SRL64(v, n) vreinterpretq_u8_u64(vshrq_n_u64(vreinterpretq_u64_u8(v), n))
+#elif !defined(CRND_NO_SIMD) && defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define CRND_SIMD 1
+typedef v128_t crnd_vec;
+#define CRND_VEC_LOAD(p) wasm_v128_load(p)
+#define CRND_VEC_STORE(p, v) wasm_v128_store(p, v)
+#define CRND_VEC_SPLAT8(x) wasm_i8x16_splat(static_cast<int8_t>(x))
+#define CRND_VEC_SPLAT16(x) wasm_i16x8_splat(static_cast<int16_t>(x))
+#define CRND_VEC_SPLAT32(x) wasm_i32x4_splat(static_cast<int32_t>(x))
+#define CRND_VEC_ADD8(a, b) wasm_i8x16_add(a, b)
+#define CRND_VEC_AND(a, b) wasm_v128_and(a, b)
+#define CRND_VEC_OR(a, b) wasm_v128_or(a, b)
+#define CRND_VEC_ANDNOT(a, b) wasm_v128_andnot(b, a)
+#define CRND_VEC_CMPEQ8(a, b) wasm_i8x16_eq(a, b)
+#define CRND_VEC_SRL16(v, n) wasm_u16x8_shr(v, n)
+#define CRND_VEC_SRL32(v, n) wasm_u32x4_shr(v, n)
+#define CRND_VEC_SRL64(v, n) wasm_u64x2_shr(v, n)
+#else
+#define CRND_SIMD 0
+#endif
+
 #ifdef CRND_DEVEL
 #ifndef _WIN32_WINNT
 #define _WIN32_WINNT 0x500
@@ -656,6 +905,48 @@ namespace crnd
       }
    }
 
+   // Allocates from a caller supplied buffer instead of the heap, see crnd_unpack_begin_arena(). Blocks are handed out in order,
+   // and only the last block can be resized in place or given back, which is all the unpacker needs.
+   class crnd_arena
+   {
+   public:
+      enum { cBlockHeaderSize = CRND_MIN_ALLOC_ALIGNMENT };
+
+      // Returns the number of bytes of the buffer taken by a block of size bytes.
+      static inline uint32 get_block_size(uint32 size) { return ((size + CRND_MIN_ALLOC_ALIGNMENT - 1U) & ~(CRND_MIN_ALLOC_ALIGNMENT - 1U)) + cBlockHeaderSize; }
+
+      void init(void* pBuf, uint32 size);
+
+      inline bool contains(const void* p) const { return (p >= m_pBuf) && (p < m_pBuf + m_size); }
+
+      // Same semantics as a crnd_realloc_func.
+      void* realloc(void* p, size_t size, size_t* pActual_size, bool movable);
+      size_t msize(void* p) const;
+
+   private:
+      uint8* m_pBuf;
+      uint32 m_size;
+      uint32 m_ofs;
+
+      inline uint32& get_block_size_ref(void* p) const { return reinterpret_cast<uint32*>(p)[-1]; }
+      inline bool is_last_block(void* p) const { return static_cast<uint8*>(p) + get_block_size_ref(p) == m_pBuf + m_ofs; }
+   };
+
+   // While a crnd_arena_scope is alive, its thread's crnd_malloc() calls allocate from the arena, and crnd_realloc(), crnd_free()
+   // and crnd_msize() calls on the arena's blocks are handled by the arena. Other threads still use the heap.
+   class crnd_arena_scope
+   {
+   public:
+      explicit crnd_arena_scope(crnd_arena* pArena);
+      ~crnd_arena_scope();
+
+   private:
+      crnd_arena* m_pPrev_arena;
+
+      crnd_arena_scope(const crnd_arena_scope&);
+      crnd_arena_scope& operator= (const crnd_arena_scope&);
+   };
+
 } // namespace crnd
 
 // File: crnd_math.h
@@ -1147,6 +1438,12 @@ namespace crnd
 {
    const crn_header* crnd_get_header(crn_header& header, const void* pData, uint32 data_size);
 
+   // Returns the number of slices of a level, counting the slices of every face.
+   uint32 crnd_calc_level_num_slices(const crn_header* pHeader, uint32 slice_chunk_rows, uint32 level_index);
+
+   // Returns the size of the file's slice table in bytes, or 0 if it doesn't have one (or the table doesn't fit in data_size bytes).
+   uint32 crnd_get_slice_table_size(const crn_header* pHeader, uint32 data_size);
+
 } // namespace crnd
 
 // File: checksum.h
@@ -1634,6 +1931,9 @@ namespace crnd
    // Converts DXT5 linear alpha selector index to a raw value (inverse of g_dxt5_to_linear).
    extern const uint8 g_dxt5_from_linear[cDXT5SelectorValues];
 
+   // Converts ETC1 linear color selector index (in intensity modifier order) to a raw value.
+   extern const uint8 g_etc1_from_linear[cDXT1SelectorValues];
+
    extern const uint8 g_six_alpha_invert_table[cDXT5SelectorValues];
    extern const uint8 g_eight_alpha_invert_table[cDXT5SelectorValues];
 
@@ -1865,17 +2165,30 @@ namespace crnd
       const uint32 cMaxExpectedCodeSize = 16;
       const uint32 cMaxSupportedSyms = 8192;
       const uint32 cMaxTableBits = 11;
+      const uint32 cMaxMultiSymbols = 2;
+
+      // One entry of the multi-symbol lookup table: the symbols whose codes fit entirely in the entry's index bits, and the
+      // total code length after each of them. m_num_syms is 0 if the first code is longer than the table.
+      struct multi_symbol_entry
+      {
+         uint16                  m_syms[cMaxMultiSymbols];
+         uint8                   m_num_syms;
+         uint8                   m_code_sizes[cMaxMultiSymbols];
+         uint8                   m_pad;
+      };
 
       class decoder_tables
       {
       public:
          inline decoder_tables() :
-            m_cur_lookup_size(0), m_lookup(NULL), m_cur_sorted_symbol_order_size(0), m_sorted_symbol_order(NULL)
+            m_cur_lookup_size(0), m_lookup(NULL), m_cur_sorted_symbol_order_size(0), m_sorted_symbol_order(NULL),
+            m_multi_table_bits(0), m_cur_multi_lookup_size(0), m_multi_lookup(NULL)
          {
          }
 
          inline decoder_tables(const decoder_tables& other) :
-            m_cur_lookup_size(0), m_lookup(NULL), m_cur_sorted_symbol_order_size(0), m_sorted_symbol_order(NULL)
+            m_cur_lookup_size(0), m_lookup(NULL), m_cur_sorted_symbol_order_size(0), m_sorted_symbol_order(NULL),
+            m_multi_table_bits(0), m_cur_multi_lookup_size(0), m_multi_lookup(NULL)
          {
             *this = other;
          }
@@ -1903,6 +2216,18 @@ namespace crnd
                   memcpy(m_sorted_symbol_order, other.m_sorted_symbol_order, sizeof(m_sorted_symbol_order[0]) * m_cur_sorted_symbol_order_size);
             }
 
+            if (other.m_multi_lookup)
+            {
+               m_multi_lookup = crnd_new_array<multi_symbol_entry>(m_cur_multi_lookup_size);
+               if (m_multi_lookup)
+                  memcpy(m_multi_lookup, other.m_multi_lookup, sizeof(m_multi_lookup[0]) * m_cur_multi_lookup_size);
+               else
+               {
+                  m_multi_table_bits = 0;
+                  m_cur_multi_lookup_size = 0;
+               }
+            }
+
             return *this;
          }
 
@@ -1921,6 +2246,14 @@ namespace crnd
                m_sorted_symbol_order = NULL;
                m_cur_sorted_symbol_order_size = 0;
             }
+
+            if (m_multi_lookup)
+            {
+               crnd_delete_array(m_multi_lookup);
+               m_multi_lookup = NULL;
+               m_cur_multi_lookup_size = 0;
+            }
+            m_multi_table_bits = 0;
          }
 
          inline ~decoder_tables()
@@ -1930,10 +2263,36 @@ namespace crnd
 
             if (m_sorted_symbol_order)
                crnd_delete_array(m_sorted_symbol_order);
+
+            if (m_multi_lookup)
+               crnd_delete_array(m_multi_lookup);
          }
 
          bool init(uint32 num_syms, const uint8* pCodesizes, uint32 table_bits);
 
+         // Builds the multi-symbol lookup table from the tables init() created. init() discards it.
+         bool init_multi_symbol_lookup();
+
+         // Decodes the code at the top of the 16-bit left justified value bits, returning its size, or 0 if the code is invalid.
+         inline uint32 decode_code(uint32 bits, uint32& sym) const
+         {
+            const uint32 k = bits + 1;
+
+            uint32 len = m_min_code_size;
+            while ((len <= m_max_code_size) && (k > m_max_codes[len - 1]))
+               len++;
+
+            if (len > m_max_code_size)
+               return 0;
+
+            const uint32 val_ptr = m_val_ptrs[len - 1] + (bits >> (16 - len));
+            if (val_ptr >= m_total_used_syms)
+               return 0;
+
+            sym = m_sorted_symbol_order[val_ptr];
+            return len;
+         }
+
          // DO NOT use any complex classes here - it is bitwise copied.
 
          uint32                  m_num_syms;
@@ -1955,6 +2314,10 @@ namespace crnd
          uint32                  m_cur_sorted_symbol_order_size;
          uint16*                 m_sorted_symbol_order;
 
+         uint32                  m_multi_table_bits;
+         uint32                  m_cur_multi_lookup_size;
+         multi_symbol_entry*     m_multi_lookup;
+
          inline uint32 get_unshifted_max_code(uint32 len) const
          {
             CRND_ASSERT( (len >= 1) && (len <= cMaxExpectedCodeSize) );
@@ -1992,6 +2355,9 @@ namespace crnd
 
       inline const uint8* get_code_sizes() const { return m_code_sizes.empty() ? NULL : &m_code_sizes[0]; }
 
+      // Enables multi-symbol decoding of this model by fast_symbol_codec.
+      bool init_multi_symbol_lookup();
+
    public:
       uint32                           m_total_syms;
       crnd::vector<uint8>              m_code_sizes;
@@ -2009,11 +2375,16 @@ namespace crnd
    public:
       symbol_codec();
 
-      bool start_decoding(const uint8* pBuf, uint32 buf_size);
+      // start_bit_ofs skips that many bits of the buffer before the first symbol.
+      bool start_decoding(const uint8* pBuf, uint32 buf_size, uint32 start_bit_ofs = 0);
       bool decode_receive_static_data_model(static_huffman_data_model& model);
 
       uint32 decode_bits(uint32 num_bits);
       uint32 decode(const static_huffman_data_model& model);
+      void decode(const static_huffman_data_model& model, uint32* pSyms, uint32 num_syms);
+
+      // Returns the number of bits decoded since the start of the buffer, counting the 0's read past its end.
+      inline uint32 get_bits_decoded() const { return static_cast<uint32>(m_pDecode_buf_next - m_pDecode_buf) * 8U + m_num_pad_bits - m_bit_count; }
 
       uint64 stop_decoding();
 
@@ -2029,16 +2400,59 @@ namespace crnd
 
       int                  m_bit_count;
 
+      // The 0 bits shifted into m_bit_buf past the end of the buffer, which m_pDecode_buf_next doesn't account for.
+      uint32               m_num_pad_bits;
+
    private:
       void get_bits_init();
       uint32 get_bits(uint32 num_bits);
    };
 
+   // Decodes the chunk streams of the levels, producing exactly the same symbols as symbol_codec.
+   // The bit buffer is 64 bits wide and refilled a whole word at a time, without branches until the last 8 bytes of the stream.
+   // Runs of symbols coded with the same model (endpoint and selector deltas) are decoded up to two at a time from the model's
+   // multi-symbol lookup table, see static_huffman_data_model::init_multi_symbol_lookup().
+   class fast_symbol_codec
+   {
+   public:
+      fast_symbol_codec();
+
+      bool start_decoding(const uint8* pBuf, uint32 buf_size, uint32 start_bit_ofs = 0);
+
+      inline uint32 decode(const static_huffman_data_model& model);
+      inline void decode(const static_huffman_data_model& model, uint32* pSyms, uint32 num_syms);
+
+      // Returns the number of bits decoded since the start of the buffer, or cUINT32_MAX once the decoder has read up to the
+      // buffer's end (after which the count isn't tracked).
+      inline uint32 get_bits_decoded() const
+      {
+         if (m_pDecode_buf_next == m_pDecode_buf_end)
+            return cUINT32_MAX;
+         return static_cast<uint32>(m_pDecode_buf_next - m_pDecode_buf) * 8U - m_bit_count;
+      }
+
+      uint64 stop_decoding();
+
+   private:
+      const uint8*         m_pDecode_buf;
+      const uint8*         m_pDecode_buf_next;
+      const uint8*         m_pDecode_buf_end;
+
+      uint64               m_bit_buf;
+      uint32               m_bit_count;
+
+      inline void refill();
+      void refill_tail();
+      inline void consume(uint32 num_bits) { m_bit_buf <<= num_bits; m_bit_count -= num_bits; }
+      uint32 decode_slow(const static_huffman_data_model& model);
+   };
+
 } // namespace crnd
 
 #define CRND_HUFF_DECODE_BEGIN(x)
 #define CRND_HUFF_DECODE_END(x)
 #define CRND_HUFF_DECODE(codec, model, symbol) symbol = codec.decode(model);
+#define CRND_HUFF_DECODE_MULTI(codec, model, pSymbols, num_symbols) codec.decode(model, pSymbols, num_symbols);
 
 namespace crnd
 {
@@ -2203,6 +2617,7 @@ namespace crnd
             return false;
 
          m_num_syms = num_syms;
+         m_multi_table_bits = 0;
 
          uint32 num_codes[cMaxExpectedCodeSize + 1];
          utils::zero_object(num_codes);
@@ -2374,6 +2789,53 @@ namespace crnd
          return true;
       }
 
+      bool decoder_tables::init_multi_symbol_lookup()
+      {
+         // Two codes of the maximum size is plenty, any larger and the table only grows.
+         const uint32 table_bits = math::minimum<uint32>(cMaxTableBits, m_max_code_size * cMaxMultiSymbols);
+         const uint32 table_size = 1U << table_bits;
+
+         if (table_size > m_cur_multi_lookup_size)
+         {
+            if (m_multi_lookup)
+               crnd_delete_array(m_multi_lookup);
+
+            m_cur_multi_lookup_size = 0;
+            m_multi_lookup = crnd_new_array<multi_symbol_entry>(table_size);
+            if (!m_multi_lookup)
+               return false;
+
+            m_cur_multi_lookup_size = table_size;
+         }
+
+         for (uint32 i = 0; i < table_size; i++)
+         {
+            multi_symbol_entry& entry = m_multi_lookup[i];
+            utils::zero_object(entry);
+
+            uint32 bits = i << (16 - table_bits);
+            uint32 total_len = 0;
+
+            for (uint32 s = 0; s < cMaxMultiSymbols; s++)
+            {
+               uint32 sym = 0;
+               const uint32 len = decode_code(bits, sym);
+               if ((!len) || ((total_len + len) > table_bits))
+                  break;
+
+               total_len += len;
+               bits = (bits << len) & cUINT16_MAX;
+
+               entry.m_syms[s] = static_cast<uint16>(sym);
+               entry.m_code_sizes[s] = static_cast<uint8>(total_len);
+               entry.m_num_syms++;
+            }
+         }
+
+         m_multi_table_bits = table_bits;
+         return true;
+      }
+
    } // namespace prefix_codig
 
 } // namespace crnd
@@ -2506,6 +2968,102 @@ namespace crnd
       crnd_assert(p_msg, __FILE__, __LINE__);
    }
 
+   void crnd_arena::init(void* pBuf, uint32 size)
+   {
+      m_pBuf = static_cast<uint8*>(pBuf);
+      m_size = size & ~(CRND_MIN_ALLOC_ALIGNMENT - 1U);
+      m_ofs = 0;
+   }
+
+   void* crnd_arena::realloc(void* p, size_t size, size_t* pActual_size, bool movable)
+   {
+      const uint32 old_size = p ? get_block_size_ref(p) : 0;
+
+      if (pActual_size)
+         *pActual_size = old_size;
+
+      if (!size)
+      {
+         if ((p) && (is_last_block(p)))
+            m_ofs = static_cast<uint32>(static_cast<uint8*>(p) - m_pBuf) - cBlockHeaderSize;
+         if (pActual_size)
+            *pActual_size = 0;
+         return NULL;
+      }
+
+      if (size > MAX_POSSIBLE_BLOCK_SIZE)
+         return NULL;
+
+      const uint32 new_size = get_block_size(static_cast<uint32>(size)) - cBlockHeaderSize;
+
+      if ((p) && (is_last_block(p)))
+      {
+         const uint32 block_ofs = static_cast<uint32>(static_cast<uint8*>(p) - m_pBuf);
+         if (new_size > m_size - block_ofs)
+         {
+            if (!movable)
+               return NULL;
+         }
+         else
+         {
+            get_block_size_ref(p) = new_size;
+            m_ofs = block_ofs + new_size;
+            if (pActual_size)
+               *pActual_size = new_size;
+            return p;
+         }
+      }
+      else if (p)
+      {
+         if (new_size <= old_size)
+            return p;
+         if (!movable)
+            return NULL;
+      }
+
+      if (get_block_size(new_size) > m_size - m_ofs)
+         return NULL;
+
+      uint8* p_new = m_pBuf + m_ofs + cBlockHeaderSize;
+      get_block_size_ref(p_new) = new_size;
+      m_ofs += new_size + cBlockHeaderSize;
+
+      if (p)
+         memcpy(p_new, p, math::minimum(old_size, new_size));
+
+      if (pActual_size)
+         *pActual_size = new_size;
+
+      return p_new;
+   }
+
+   size_t crnd_arena::msize(void* p) const
+   {
+      return p ? get_block_size_ref(p) : 0;
+   }
+
+   static CRND_THREAD_LOCAL crnd_arena* g_pThread_arena;
+
+   crnd_arena_scope::crnd_arena_scope(crnd_arena* pArena) :
+      m_pPrev_arena(g_pThread_arena)
+   {
+      g_pThread_arena = pArena;
+   }
+
+   crnd_arena_scope::~crnd_arena_scope()
+   {
+      g_pThread_arena = m_pPrev_arena;
+   }
+
+   // Returns the arena handling block p, or the arena new blocks come from if p is NULL.
+   static inline crnd_arena* crnd_get_arena(void* p)
+   {
+      crnd_arena* pArena = g_pThread_arena;
+      if ((pArena) && (p) && (!pArena->contains(p)))
+         return NULL;
+      return pArena;
+   }
+
    void* crnd_malloc(size_t size, size_t* pActual_size)
    {
       size = (size + sizeof(uint32) - 1U) & ~(sizeof(uint32) - 1U);
@@ -2519,7 +3077,8 @@ namespace crnd
       }
 
       size_t actual_size = size;
-      uint8* p_new = static_cast<uint8*>((*g_pRealloc)(NULL, size, &actual_size, true, g_pUser_data));
+      crnd_arena* pArena = crnd_get_arena(NULL);
+      uint8* p_new = static_cast<uint8*>(pArena ? pArena->realloc(NULL, size, &actual_size, true) : (*g_pRealloc)(NULL, size, &actual_size, true, g_pUser_data));
 
       if (pActual_size)
          *pActual_size = actual_size;
@@ -2550,7 +3109,8 @@ namespace crnd
       }
 
       size_t actual_size = size;
-      void* p_new = (*g_pRealloc)(p, size, &actual_size, movable, g_pUser_data);
+      crnd_arena* pArena = crnd_get_arena(p);
+      void* p_new = pArena ? pArena->realloc(p, size, &actual_size, movable) : (*g_pRealloc)(p, size, &actual_size, movable, g_pUser_data);
 
       if (pActual_size)
          *pActual_size = actual_size;
@@ -2571,7 +3131,11 @@ namespace crnd
          return;
       }
 
-      (*g_pRealloc)(p, 0, NULL, true, g_pUser_data);
+      crnd_arena* pArena = crnd_get_arena(p);
+      if (pArena)
+         pArena->realloc(p, 0, NULL, true);
+      else
+         (*g_pRealloc)(p, 0, NULL, true, g_pUser_data);
    }
 
    size_t crnd_msize(void* p)
@@ -2585,7 +3149,8 @@ namespace crnd
          return 0;
       }
 
-      return (*g_pMSize)(p, g_pUser_data);
+      crnd_arena* pArena = crnd_get_arena(p);
+      return pArena ? pArena->msize(p) : (*g_pMSize)(p, g_pUser_data);
    }
 
 } // namespace crnd
@@ -2696,6 +3261,35 @@ namespace crnd
       return &file_header;
    }
 
+   uint32 crnd_calc_level_num_slices(const crn_header* pHeader, uint32 slice_chunk_rows, uint32 level_index)
+   {
+      const uint32 height = math::maximum(pHeader->m_height >> level_index, 1U);
+      const uint32 chunks_y = (height + 7U) >> 3U;
+
+      return pHeader->m_faces * ((chunks_y + slice_chunk_rows - 1) / slice_chunk_rows);
+   }
+
+   uint32 crnd_get_slice_table_size(const crn_header* pHeader, uint32 data_size)
+   {
+      const uint32 table_ofs = pHeader->m_slice_table_ofs;
+      if ((!table_ofs) || ((table_ofs + sizeof(crn_slice_table)) > data_size))
+         return 0;
+
+      const crn_slice_table* pTable = reinterpret_cast<const crn_slice_table*>(reinterpret_cast<const uint8*>(pHeader) + table_ofs);
+      if (!pTable->m_chunk_rows)
+         return 0;
+
+      uint32 total_slices = 0;
+      for (uint32 level_index = 0; level_index < pHeader->m_levels; level_index++)
+         total_slices += crnd_calc_level_num_slices(pHeader, pTable->m_chunk_rows, level_index);
+
+      const uint32 table_size = sizeof(crn_slice_table) + total_slices * sizeof(crn_slice);
+      if ((table_ofs + table_size) > data_size)
+         return 0;
+
+      return table_size;
+   }
+
    bool crnd_validate_file(const void* pData, uint32 data_size, crn_file_info* pFile_info)
    {
       if (pFile_info)
@@ -2780,7 +3374,7 @@ namespace crnd
       pInfo->m_levels = pHeader->m_levels;
       pInfo->m_faces = pHeader->m_faces;
       pInfo->m_format = static_cast<crn_format>((uint32)pHeader->m_format);
-      pInfo->m_bytes_per_block = ((pHeader->m_format == cCRNFmtDXT1) || (pHeader->m_format == cCRNFmtDXT5A)) ? 8 : 16;
+      pInfo->m_bytes_per_block = ((pHeader->m_format == cCRNFmtDXT1) || (pHeader->m_format == cCRNFmtDXT5A) || (pHeader->m_format == cCRNFmtETC1)) ? 8 : 16;
       pInfo->m_userdata0 = pHeader->m_userdata0;
       pInfo->m_userdata1 = pHeader->m_userdata1;
 
@@ -2811,7 +3405,7 @@ namespace crnd
       pLevel_info->m_faces = pHeader->m_faces;
       pLevel_info->m_blocks_x = (width + 3) >> 2;
       pLevel_info->m_blocks_y = (height + 3) >> 2;
-      pLevel_info->m_bytes_per_block = ((pHeader->m_format == cCRNFmtDXT1) || (pHeader->m_format == cCRNFmtDXT5A)) ? 8 : 16;
+      pLevel_info->m_bytes_per_block = ((pHeader->m_format == cCRNFmtDXT1) || (pHeader->m_format == cCRNFmtDXT5A) || (pHeader->m_format == cCRNFmtETC1)) ? 8 : 16;
       pLevel_info->m_format = static_cast<crn_format>((uint32)pHeader->m_format);
 
       return true;
@@ -2865,6 +3459,10 @@ namespace crnd
       size = math::maximum(size, pHeader->m_alpha_selectors.m_ofs + pHeader->m_alpha_selectors.m_size);
       size = math::maximum(size, pHeader->m_tables_ofs + pHeader->m_tables_size);
 
+      const uint32 slice_table_size = crnd_get_slice_table_size(pHeader, data_size);
+      if (slice_table_size)
+         size = math::maximum(size, pHeader->m_slice_table_ofs + slice_table_size);
+
       return size;
    }
 
@@ -2991,7 +3589,11 @@ bool static_huffman_data_model::init(uint32 total_syms, const uint8* pCode_sizes
       return false;
 
    if (!m_pDecode_tables)
+   {
       m_pDecode_tables = crnd_new<prefix_coding::decoder_tables>();
+      if (!m_pDecode_tables)
+         return false;
+   }
 
    if (!m_pDecode_tables->init(m_total_syms, &m_code_sizes[0], compute_decoder_table_bits()))
       return false;
@@ -3008,11 +3610,23 @@ bool static_huffman_data_model::prepare_decoder_tables()
    m_total_syms = total_syms;
 
    if (!m_pDecode_tables)
+   {
       m_pDecode_tables = crnd_new<prefix_coding::decoder_tables>();
+      if (!m_pDecode_tables)
+         return false;
+   }
 
    return m_pDecode_tables->init(m_total_syms, &m_code_sizes[0], compute_decoder_table_bits());
 }
 
+bool static_huffman_data_model::init_multi_symbol_lookup()
+{
+   if (!m_pDecode_tables)
+      return false;
+
+   return m_pDecode_tables->init_multi_symbol_lookup();
+}
+
 uint static_huffman_data_model::compute_decoder_table_bits() const
 {
 #if CRND_PREFIX_CODING_USE_FIXED_TABLE_SIZE
@@ -3031,7 +3645,8 @@ symbol_codec::symbol_codec() :
   m_pDecode_buf_end(NULL),
   m_decode_buf_size(0),
   m_bit_buf(0),
-  m_bit_count(0)
+  m_bit_count(0),
+  m_num_pad_bits(0)
 {
 }
 
@@ -3157,18 +3772,21 @@ bool symbol_codec::decode_receive_static_data_model(static_huffman_data_model& m
    return model.prepare_decoder_tables();
 }
 
-bool symbol_codec::start_decoding(const uint8* pBuf, uint32 buf_size)
+bool symbol_codec::start_decoding(const uint8* pBuf, uint32 buf_size, uint32 start_bit_ofs)
 {
-   if (!buf_size)
+   if ((!buf_size) || ((start_bit_ofs >> 3U) >= buf_size))
       return false;
 
    m_pDecode_buf = pBuf;
-   m_pDecode_buf_next = pBuf;
+   m_pDecode_buf_next = pBuf + (start_bit_ofs >> 3U);
    m_decode_buf_size = buf_size;
    m_pDecode_buf_end = pBuf + buf_size;
 
    get_bits_init();
 
+   if (start_bit_ofs & 7U)
+      get_bits(start_bit_ofs & 7U);
+
    return true;
 }
 
@@ -3176,6 +3794,7 @@ void symbol_codec::get_bits_init()
 {
    m_bit_buf = 0;
    m_bit_count = 0;
+   m_num_pad_bits = 0;
 }
 
 uint32 symbol_codec::decode_bits(uint32 num_bits)
@@ -3203,6 +3822,8 @@ uint32 symbol_codec::get_bits(uint32 num_bits)
       bit_buf_type c = 0;
       if (m_pDecode_buf_next != m_pDecode_buf_end)
          c = *m_pDecode_buf_next++;
+      else
+         m_num_pad_bits += 8;
 
       m_bit_count += 8;
       CRND_ASSERT(m_bit_count <= cBitBufSize);
@@ -3230,6 +3851,7 @@ uint32 symbol_codec::decode(const static_huffman_data_model& model)
          const uint8* p = m_pDecode_buf_next;
          if (p < m_pDecode_buf_end) c0 = *p++;
          if (p < m_pDecode_buf_end) c1 = *p++;
+         m_num_pad_bits += 16 - static_cast<uint32>(p - m_pDecode_buf_next) * 8U;
          m_pDecode_buf_next = p;
          m_bit_count += 16;
          uint32 c = (c0 << 8) | c1;
@@ -3237,7 +3859,11 @@ uint32 symbol_codec::decode(const static_huffman_data_model& model)
       }
       else
       {
-         uint32 c = (m_pDecode_buf_next < m_pDecode_buf_end) ? *m_pDecode_buf_next++ : 0;
+         uint32 c = 0;
+         if (m_pDecode_buf_next < m_pDecode_buf_end)
+            c = *m_pDecode_buf_next++;
+         else
+            m_num_pad_bits += 8;
          m_bit_count += 8;
          m_bit_buf |= (c << (32 - m_bit_count));
       }
@@ -3285,6 +3911,12 @@ uint32 symbol_codec::decode(const static_huffman_data_model& model)
    return sym;
 }
 
+   void symbol_codec::decode(const static_huffman_data_model& model, uint32* pSyms, uint32 num_syms)
+   {
+      for (uint32 i = 0; i < num_syms; i++)
+         pSyms[i] = decode(model);
+   }
+
    uint64 symbol_codec::stop_decoding()
    {
 #if 0
@@ -3299,34 +3931,189 @@ uint32 symbol_codec::decode(const static_huffman_data_model& model)
       return n;
    }
 
-} // namespace crnd
+   fast_symbol_codec::fast_symbol_codec() :
+      m_pDecode_buf(NULL),
+      m_pDecode_buf_next(NULL),
+      m_pDecode_buf_end(NULL),
+      m_bit_buf(0),
+      m_bit_count(0)
+   {
+   }
 
-// File: crnd_dxt_hc_common.cpp
-namespace crnd
-{
-   chunk_encoding_desc g_chunk_encodings[cNumChunkEncodings] =
+   bool fast_symbol_codec::start_decoding(const uint8* pBuf, uint32 buf_size, uint32 start_bit_ofs)
    {
-      { 1, { { 0, 0, 8, 8, 0 } } },
+      if ((!buf_size) || ((start_bit_ofs >> 3U) >= buf_size))
+         return false;
 
-      { 2, { { 0, 0, 8, 4, 1 }, { 0, 4, 8, 4, 2 } } },
-      { 2, { { 0, 0, 4, 8, 3 }, { 4, 0, 4, 8, 4 } } },
+      m_pDecode_buf = pBuf;
+      m_pDecode_buf_next = pBuf + (start_bit_ofs >> 3U);
+      m_pDecode_buf_end = pBuf + buf_size;
 
-      { 3, { { 0, 0, 8, 4, 1 }, { 0, 4, 4, 4, 7 }, { 4, 4, 4, 4, 8 } } },
-      { 3, { { 0, 4, 8, 4, 2 }, { 0, 0, 4, 4, 5 }, { 4, 0, 4, 4, 6 } } },
+      m_bit_buf = 0;
+      m_bit_count = 0;
 
-      { 3, { { 0, 0, 4, 8, 3 }, { 4, 0, 4, 4, 6 }, { 4, 4, 4, 4, 8 } } },
-      { 3, { { 4, 0, 4, 8, 4 }, { 0, 0, 4, 4, 5 }, { 0, 4, 4, 4, 7 } } },
+      refill();
+      consume(start_bit_ofs & 7U);
 
-      { 4, { { 0, 0, 4, 4, 5 }, { 4, 0, 4, 4, 6 }, { 0, 4, 4, 4, 7 }, { 4, 4, 4, 4, 8 } } }
-   };
+      return true;
+   }
 
-   chunk_tile_desc g_chunk_tile_layouts[cNumChunkTileLayouts] =
+   // The byte at m_pDecode_buf_next always starts at bit m_bit_count of the buffer. Loading 8 bytes and only counting the whole
+   // bytes that fit leaves the next byte's leading bits below m_bit_count, which the following refill ORs in again unchanged.
+   inline void fast_symbol_codec::refill()
    {
-      // 2x2
-      { 0, 0, 8, 8, 0 },
+      if ((m_pDecode_buf_end - m_pDecode_buf_next) >= 8)
+      {
+         uint32 hi, lo;
+         memcpy(&hi, m_pDecode_buf_next, sizeof(hi));
+         memcpy(&lo, m_pDecode_buf_next + sizeof(hi), sizeof(lo));
+         if (c_crnd_little_endian_platform)
+         {
+            hi = utils::swap32(hi);
+            lo = utils::swap32(lo);
+         }
 
-      // 2x1
-      { 0, 0, 8, 4, 1 },
+         m_bit_buf |= ((static_cast<uint64>(hi) << 32U) | lo) >> m_bit_count;
+         m_pDecode_buf_next += (63U - m_bit_count) >> 3U;
+         m_bit_count |= 56U;
+      }
+      else
+         refill_tail();
+   }
+
+   // Like symbol_codec, reads past the end of the stream return 0's.
+   void fast_symbol_codec::refill_tail()
+   {
+      while (m_bit_count <= 56U)
+      {
+         uint64 c = 0;
+         if (m_pDecode_buf_next < m_pDecode_buf_end)
+            c = *m_pDecode_buf_next++;
+
+         m_bit_buf |= c << (56U - m_bit_count);
+         m_bit_count += 8U;
+      }
+   }
+
+   // Decodes a code longer than the model's lookup table. The bit buffer must hold at least 16 bits.
+   uint32 fast_symbol_codec::decode_slow(const static_huffman_data_model& model)
+   {
+      const prefix_coding::decoder_tables* pTables = model.m_pDecode_tables;
+
+      const uint32 k = static_cast<uint32>(m_bit_buf >> 48U) + 1;
+
+      uint32 len = pTables->m_decode_start_code_size;
+      while (k > pTables->m_max_codes[len - 1])
+         len++;
+
+      int val_ptr = pTables->m_val_ptrs[len - 1] + static_cast<int>(m_bit_buf >> (64U - len));
+
+      if (((uint32)val_ptr >= model.m_total_syms))
+      {
+         // corrupted stream, or a bug
+         CRND_ASSERT(0);
+         return 0;
+      }
+
+      consume(len);
+
+      return pTables->m_sorted_symbol_order[val_ptr];
+   }
+
+   inline uint32 fast_symbol_codec::decode(const static_huffman_data_model& model)
+   {
+      const prefix_coding::decoder_tables* pTables = model.m_pDecode_tables;
+
+      refill();
+
+      const uint32 k = static_cast<uint32>(m_bit_buf >> 48U) + 1;
+      if (k <= pTables->m_table_max_code)
+      {
+         const uint32 t = pTables->m_lookup[m_bit_buf >> (64U - pTables->m_table_bits)];
+
+         CRND_ASSERT(t != cUINT32_MAX);
+         consume(t >> 16U);
+
+         return t & cUINT16_MAX;
+      }
+
+      return decode_slow(model);
+   }
+
+   inline void fast_symbol_codec::decode(const static_huffman_data_model& model, uint32* pSyms, uint32 num_syms)
+   {
+      const prefix_coding::decoder_tables* pTables = model.m_pDecode_tables;
+
+      const uint32 table_bits = pTables->m_multi_table_bits;
+      if (!table_bits)
+      {
+         for (uint32 i = 0; i < num_syms; i++)
+            pSyms[i] = decode(model);
+         return;
+      }
+
+      while (num_syms)
+      {
+         refill();
+
+         const prefix_coding::multi_symbol_entry& entry = pTables->m_multi_lookup[m_bit_buf >> (64U - table_bits)];
+
+         // The first code is longer than the multi-symbol table, but may still be short enough for the model's own table.
+         if (!entry.m_num_syms)
+         {
+            *pSyms++ = decode(model);
+            num_syms--;
+         }
+         else if ((entry.m_num_syms == 1) || (num_syms == 1))
+         {
+            *pSyms++ = entry.m_syms[0];
+            consume(entry.m_code_sizes[0]);
+            num_syms--;
+         }
+         else
+         {
+            pSyms[0] = entry.m_syms[0];
+            pSyms[1] = entry.m_syms[1];
+            consume(entry.m_code_sizes[1]);
+            pSyms += 2;
+            num_syms -= 2;
+         }
+      }
+   }
+
+   uint64 fast_symbol_codec::stop_decoding()
+   {
+      return static_cast<uint64>(m_pDecode_buf_next - m_pDecode_buf);
+   }
+
+} // namespace crnd
+
+// File: crnd_dxt_hc_common.cpp
+namespace crnd
+{
+   chunk_encoding_desc g_chunk_encodings[cNumChunkEncodings] =
+   {
+      { 1, { { 0, 0, 8, 8, 0 } } },
+
+      { 2, { { 0, 0, 8, 4, 1 }, { 0, 4, 8, 4, 2 } } },
+      { 2, { { 0, 0, 4, 8, 3 }, { 4, 0, 4, 8, 4 } } },
+
+      { 3, { { 0, 0, 8, 4, 1 }, { 0, 4, 4, 4, 7 }, { 4, 4, 4, 4, 8 } } },
+      { 3, { { 0, 4, 8, 4, 2 }, { 0, 0, 4, 4, 5 }, { 4, 0, 4, 4, 6 } } },
+
+      { 3, { { 0, 0, 4, 8, 3 }, { 4, 0, 4, 4, 6 }, { 4, 4, 4, 4, 8 } } },
+      { 3, { { 4, 0, 4, 8, 4 }, { 0, 0, 4, 4, 5 }, { 0, 4, 4, 4, 7 } } },
+
+      { 4, { { 0, 0, 4, 4, 5 }, { 4, 0, 4, 4, 6 }, { 0, 4, 4, 4, 7 }, { 4, 4, 4, 4, 8 } } }
+   };
+
+   chunk_tile_desc g_chunk_tile_layouts[cNumChunkTileLayouts] =
+   {
+      // 2x2
+      { 0, 0, 8, 8, 0 },
+
+      // 2x1
+      { 0, 0, 8, 4, 1 },
       { 0, 4, 8, 4, 2 },
 
       // 1x2
@@ -3351,6 +4138,8 @@ namespace crnd
    const uint8 g_dxt5_to_linear[cDXT5SelectorValues]     = { 0U, 7U, 1U, 2U, 3U, 4U, 5U, 6U };
    const uint8 g_dxt5_from_linear[cDXT5SelectorValues]   = { 0U, 2U, 3U, 4U, 5U, 6U, 7U, 1U };
 
+   const uint8 g_etc1_from_linear[cDXT1SelectorValues]   = { 3U, 2U, 0U, 1U };
+
    const uint8 g_six_alpha_invert_table[cDXT5SelectorValues] = { 1, 0, 5, 4, 3, 2, 6, 7 };
    const uint8 g_eight_alpha_invert_table[cDXT5SelectorValues] = { 1, 0, 7, 6, 5, 4, 3, 2 };
 
@@ -3652,7 +4441,12 @@ namespace crnd
          m_magic(cMagicValue),
          m_pData(NULL),
          m_data_size(0),
-         m_pHeader(NULL)
+         m_pHeader(NULL),
+         m_pSlices(NULL),
+         m_slice_chunk_rows(0),
+         m_data_available(0),
+         m_stream_size(0),
+         m_pArena(NULL)
       {
       }
 
@@ -3661,7 +4455,9 @@ namespace crnd
          m_magic = 0;
       }
 
-      inline bool is_valid() const { return m_magic == cMagicValue; }
+      // A streaming unpacker only becomes valid once its tables have arrived, see stream_push().
+      inline bool is_valid() const { return (m_magic == cMagicValue) && (m_pHeader); }
+      inline bool is_unpacker() const { return m_magic == cMagicValue; }
 
       bool init(const void* pData, uint32 data_size)
       {
@@ -3671,6 +4467,14 @@ namespace crnd
 
          m_pData = static_cast<const uint8*>(pData);
          m_data_size = data_size;
+         m_data_available = data_size;
+
+         for (uint32 i = 0; i < cCRNMaxLevels; i++)
+         {
+            stream_level& level = m_stream_levels[i];
+            utils::zero_object(level);
+            level.m_range.m_chunk_encoding_bits = 1;
+         }
 
          if (!init_tables())
             return false;
@@ -3678,493 +4482,1927 @@ namespace crnd
          if (!decode_palettes())
             return false;
 
+         init_slices();
+
          return true;
       }
 
+      // Once init() succeeds the unpacker is only read from, so levels may be unpacked by several threads at once. Each call
+      // decodes its level with its own fast_symbol_codec.
       bool unpack_level(
          void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
-         uint32 level_index)
+         uint32 level_index) const
       {
-         uint32 cur_level_ofs = m_pHeader->m_level_ofs[level_index];
-
-         uint32 next_level_ofs = m_data_size;
-         if ((level_index + 1) < (m_pHeader->m_levels))
-            next_level_ofs = m_pHeader->m_level_ofs[level_index + 1];
-
-         CRND_ASSERT(next_level_ofs > cur_level_ofs);
+         const uint8* pSrc;
+         uint32 src_size_in_bytes;
+         if (!get_level_data(level_index, pSrc, src_size_in_bytes))
+            return false;
 
-         return unpack_level(m_pData + cur_level_ofs, next_level_ofs - cur_level_ofs, pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+         fast_symbol_codec codec;
+         return unpack_level(codec, pSrc, src_size_in_bytes, pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, cUINT32_MAX);
       }
 
       bool unpack_level(
          const void* pSrc, uint32 src_size_in_bytes,
          void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
-         uint32 level_index)
+         uint32 level_index) const
       {
-         dst_size_in_bytes;
+         fast_symbol_codec codec;
+         return unpack_level(codec, pSrc, src_size_in_bytes, pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, cUINT32_MAX);
+      }
 
-#ifdef CRND_BUILD_DEBUG
-         for (uint32 f = 0; f < m_pHeader->m_faces; f++)
-            if (!pDst[f])
-               return false;
-#endif
+      // A level can be unpacked one slice at a time. Without a slice table, the whole level is a single slice.
+      inline uint32 get_level_num_slices(uint32 level_index) const
+      {
+         return m_pSlices ? crnd_calc_level_num_slices(m_pHeader, m_slice_chunk_rows, level_index) : 1;
+      }
 
-         const uint32 width = math::maximum(m_pHeader->m_width >> level_index, 1U);
-         const uint32 height = math::maximum(m_pHeader->m_height >> level_index, 1U);
-         const uint32 blocks_x = (width + 3U) >> 2U;
-         const uint32 blocks_y = (height + 3U) >> 2U;
-         const uint32 block_size = ((m_pHeader->m_format == cCRNFmtDXT1) || (m_pHeader->m_format == cCRNFmtDXT5A)) ? 8 : 16;
+      // Only writes the blocks of the slice's rows.
+      bool unpack_level_slice(
+         void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+         uint32 level_index, uint32 slice_index) const
+      {
+         if (slice_index >= get_level_num_slices(level_index))
+            return false;
 
-         uint32 minimal_row_pitch = block_size * blocks_x;
-         if (!row_pitch_in_bytes)
-            row_pitch_in_bytes = minimal_row_pitch;
-         else if ((row_pitch_in_bytes < minimal_row_pitch) || (row_pitch_in_bytes & 3))
+         const uint8* pSrc;
+         uint32 src_size_in_bytes;
+         if (!get_level_data(level_index, pSrc, src_size_in_bytes))
             return false;
-         if (dst_size_in_bytes < row_pitch_in_bytes * blocks_y)
+
+         fast_symbol_codec codec;
+         return unpack_level(codec, pSrc, src_size_in_bytes, pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, m_pSlices ? slice_index : cUINT32_MAX);
+      }
+
+      // Same as unpack_level(), but decodes with symbol_codec, one symbol per table lookup.
+      bool unpack_level_reference(
+         void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+         uint32 level_index) const
+      {
+         const uint8* pSrc;
+         uint32 src_size_in_bytes;
+         if (!get_level_data(level_index, pSrc, src_size_in_bytes))
+            return false;
+
+         symbol_codec codec;
+         return unpack_level(codec, pSrc, src_size_in_bytes, pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, cUINT32_MAX);
+      }
+
+      // Unpacks the blocks of the pixel rectangle [x0, x0 + width) x [y0, y0 + height) of each face of the level. pDst[f] receives the
+      // rectangle's blocks, starting with the block holding pixel (x0, y0). Each row of chunks holding part of the rectangle must still
+      // be decoded entirely. With a slice table, decoding starts at the slice holding the rectangle's first row; without one, it starts
+      // at the beginning of the level.
+      bool unpack_level_region(
+         void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+         uint32 level_index, uint32 x0, uint32 y0, uint32 width, uint32 height) const
+      {
+         const uint32 level_width = math::maximum(m_pHeader->m_width >> level_index, 1U);
+         const uint32 level_height = math::maximum(m_pHeader->m_height >> level_index, 1U);
+         if ((!width) || (!height) || (x0 >= level_width) || (y0 >= level_height) || (width > (level_width - x0)) || (height > (level_height - y0)))
             return false;
 
+         const uint32 blocks_x = (level_width + 3U) >> 2U;
+         const uint32 blocks_y = (level_height + 3U) >> 2U;
+         const uint32 block_size = ((m_pHeader->m_format == cCRNFmtDXT1) || (m_pHeader->m_format == cCRNFmtDXT5A) || (m_pHeader->m_format == cCRNFmtETC1)) ? 8 : 16;
          const uint32 chunks_x = (blocks_x + 1) >> 1;
          const uint32 chunks_y = (blocks_y + 1) >> 1;
 
-#if CRND_CREATE_BYTE_STREAMS
-         crnd_trace("Index stream: %u bytes\n", src_size_in_bytes);
-#endif
+         const uint32 first_block_x = x0 >> 2U;
+         const uint32 first_block_y = y0 >> 2U;
+         const uint32 end_block_x = (x0 + width + 3U) >> 2U;
+         const uint32 end_block_y = (y0 + height + 3U) >> 2U;
 
-         if (!m_codec.start_decoding(static_cast<const crnd::uint8*>(pSrc), src_size_in_bytes))
+         const uint32 region_row_size = (end_block_x - first_block_x) * block_size;
+         if (!row_pitch_in_bytes)
+            row_pitch_in_bytes = region_row_size;
+         else if ((row_pitch_in_bytes < region_row_size) || (row_pitch_in_bytes & 3))
+            return false;
+         if (dst_size_in_bytes < row_pitch_in_bytes * (end_block_y - first_block_y))
             return false;
 
-         bool status = false;
-         switch (m_pHeader->m_format)
-         {
-         case cCRNFmtDXT1:
-            status = unpack_dxt1((uint8**)pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
-            break;
-         case cCRNFmtDXT5:
-         case cCRNFmtDXT5_CCxY:
-         case cCRNFmtDXT5_xGBR:
-         case cCRNFmtDXT5_AGBR:
-         case cCRNFmtDXT5_xGxR:
-            status = unpack_dxt5((uint8**)pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
-            break;
-         case cCRNFmtDXT5A:
-            status = unpack_dxt5a((uint8**)pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
-            break;
-         case cCRNFmtDXN_XY:
-         case cCRNFmtDXN_YX:
-            status = unpack_dxn((uint8**)pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
-            break;
-         default:
+         const uint8* pSrc;
+         uint32 src_size_in_bytes;
+         if (!get_level_data(level_index, pSrc, src_size_in_bytes))
             return false;
-         }
-         if (!status)
+
+         // The rows of chunks are unpacked one at a time into two rows of blocks, and the region's blocks are copied out.
+         const uint32 temp_row_pitch = blocks_x * block_size;
+         crnd::vector<uint8> temp_rows;
+         if (!temp_rows.resize(temp_row_pitch * 2))
             return false;
 
-         m_codec.stop_decoding();
-         return true;
-      }
+         uint8* pTemp_rows[cCRNMaxFaces];
+         for (uint32 f = 0; f < cCRNMaxFaces; f++)
+            pTemp_rows[f] = &temp_rows[0];
 
-      inline const void* get_data() const { return m_pData; }
-      inline uint32 get_data_size() const { return m_data_size; }
+         const uint32 first_row = first_block_y >> 1;
+         const uint32 last_row = (end_block_y - 1) >> 1;
 
-   private:
-      enum { cMagicValue = 0x1EF9CABD };
-      uint32             m_magic;
+         fast_symbol_codec codec;
 
-      const uint8*       m_pData;
-      uint32             m_data_size;
-      crn_header         m_tmp_header;
-      const crn_header*  m_pHeader;
+         chunk_range range;
+         utils::zero_object(range);
+         range.m_num_faces = 1;
+         range.m_num_rows = 1;
+         range.m_chunk_encoding_bits = 1;
 
-      symbol_codec       m_codec;
+         if ((!m_pSlices) && (!codec.start_decoding(pSrc, src_size_in_bytes)))
+            return false;
 
-      static_huffman_data_model m_chunk_encoding_dm;
-      static_huffman_data_model m_endpoint_delta_dm[2];
-      static_huffman_data_model m_selector_delta_dm[2];
+         for (uint32 f = 0; f < m_pHeader->m_faces; f++)
+         {
+            // Without a slice table, the following face can only be reached by decoding the rest of this one.
+            const uint32 end_row = ((m_pSlices) || (f == (m_pHeader->m_faces - 1U))) ? last_row : (chunks_y - 1U);
 
-      crnd::vector<uint32> m_color_endpoints;
-      crnd::vector<uint32> m_color_selectors;
+            uint32 row = 0;
+            if (m_pSlices)
+            {
+               const uint32 slices_per_face = (chunks_y + m_slice_chunk_rows - 1) / m_slice_chunk_rows;
+               const uint32 start_bit_ofs = get_slice_range(level_index, f * slices_per_face + first_row / m_slice_chunk_rows, chunks_y, range);
+               if (!codec.start_decoding(pSrc, src_size_in_bytes, start_bit_ofs))
+                  return false;
 
-      crnd::vector<uint16> m_alpha_endpoints;
-      crnd::vector<uint16> m_alpha_selectors;
+               row = range.m_first_row;
+            }
 
-      bool init_tables()
-      {
-         if (!m_codec.start_decoding(m_pData + m_pHeader->m_tables_ofs, m_pHeader->m_tables_size))
-            return false;
+            uint8* pDst_row = static_cast<uint8*>(pDst[f]);
 
-         if (!m_codec.decode_receive_static_data_model(m_chunk_encoding_dm))
-            return false;
+            for ( ; row <= end_row; row++)
+            {
+               range.m_first_face = f;
+               range.m_first_row = row;
+               range.m_num_rows = 1;
 
-         if ((!m_pHeader->m_color_endpoints.m_num) && (!m_pHeader->m_alpha_endpoints.m_num))
-            return false;
+               if (!unpack_chunks(codec, range, pTemp_rows, temp_row_pitch * 2, temp_row_pitch, blocks_x, blocks_y, chunks_x, chunks_y))
+                  return false;
 
-         if (m_pHeader->m_color_endpoints.m_num)
-         {
-            if (!m_codec.decode_receive_static_data_model(m_endpoint_delta_dm[0])) return false;
-            if (!m_codec.decode_receive_static_data_model(m_selector_delta_dm[0])) return false;
-         }
+               if (row < first_row)
+                  continue;
 
-         if (m_pHeader->m_alpha_endpoints.m_num)
-         {
-            if (!m_codec.decode_receive_static_data_model(m_endpoint_delta_dm[1])) return false;
-            if (!m_codec.decode_receive_static_data_model(m_selector_delta_dm[1])) return false;
+               for (uint32 block_y = math::maximum(row * 2, first_block_y); block_y < math::minimum(row * 2 + 2, end_block_y); block_y++)
+               {
+                  memcpy(pDst_row, &temp_rows[0] + (block_y - row * 2) * temp_row_pitch + first_block_x * block_size, region_row_size);
+                  pDst_row += row_pitch_in_bytes;
+               }
+            }
          }
 
-         m_codec.stop_decoding();
-
+         codec.stop_decoding();
          return true;
       }
 
-      bool decode_palettes()
+      // Unpacks the level straight to pixels, see crnd_unpack_level_pixels().
+      bool unpack_level_pixels(
+         void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+         uint32 level_index, crnd_pixel_format pixel_format) const
       {
-         if (m_pHeader->m_color_endpoints.m_num)
+         switch (pixel_format)
          {
-            if (!decode_color_endpoints()) return false;
-            if (!decode_color_selectors()) return false;
+         case cCRNDPixelFmtRGBA8888:
+            return unpack_level_pixels<uint32>(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+         case cCRNDPixelFmtRGB565:
+            return unpack_level_pixels<uint16>(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+         default:
+            break;
          }
+         return false;
+      }
 
-         if (m_pHeader->m_alpha_endpoints.m_num)
-         {
-            if (!decode_alpha_endpoints()) return false;
-            if (!decode_alpha_selectors()) return false;
-         }
+      // Initializes the unpacker from a copy of the file's base data, see crnd_unpack_begin_tables(). Normal files are converted
+      // to segmented files, so only the levels passed to unpack_level() can be unpacked.
+      bool init_base_data_copy(const void* pData, uint32 data_size)
+      {
+         const uint32 base_data_size = crnd_get_segmented_file_size(pData, data_size);
+         if (!base_data_size)
+            return false;
 
-         return true;
+         if (!m_stream_data.resize(base_data_size))
+            return false;
+
+         const crn_header& header = *static_cast<const crn_header*>(pData);
+         if (header.m_flags & cCRNHeaderFlagSegmented)
+            memcpy(&m_stream_data[0], pData, base_data_size);
+         else if (!crnd_create_segmented_file(pData, data_size, &m_stream_data[0], base_data_size))
+            return false;
+
+         return init(&m_stream_data[0], base_data_size);
       }
 
-      bool decode_color_endpoints()
+      // Returns true if the levels of the file can be unpacked with this unpacker's tables and palettes: the dimensions, format,
+      // palettes and tables must all be the same.
+      bool tables_match(const void* pData, uint32 data_size) const
       {
-         const uint32 num_color_endpoints = m_pHeader->m_color_endpoints.m_num;
-
-         if (!m_color_endpoints.resize(num_color_endpoints))
+         crn_header tmp_header;
+         const crn_header* pHeader = crnd_get_header(tmp_header, pData, data_size);
+         if (!pHeader)
             return false;
 
-         if (!m_codec.start_decoding(m_pData + m_pHeader->m_color_endpoints.m_ofs, m_pHeader->m_color_endpoints.m_size))
+         if ((pHeader->m_width != m_pHeader->m_width) || (pHeader->m_height != m_pHeader->m_height) ||
+             (pHeader->m_levels != m_pHeader->m_levels) || (pHeader->m_faces != m_pHeader->m_faces) ||
+             (pHeader->m_format != m_pHeader->m_format))
             return false;
 
-         static_huffman_data_model dm[2];
-         for (uint32 i = 0; i < 2; i++)
-            if (!m_codec.decode_receive_static_data_model(dm[i]))
-               return false;
+         const uint8* pFile_data = static_cast<const uint8*>(pData);
 
-         uint32 a = 0, b = 0, c = 0;
-         uint32 d = 0, e = 0, f = 0;
+         const crn_palette* pPalettes[] = { &pHeader->m_color_endpoints, &pHeader->m_color_selectors, &pHeader->m_alpha_endpoints, &pHeader->m_alpha_selectors };
+         const crn_palette* pOur_palettes[] = { &m_pHeader->m_color_endpoints, &m_pHeader->m_color_selectors, &m_pHeader->m_alpha_endpoints, &m_pHeader->m_alpha_selectors };
+         for (uint32 i = 0; i < 4; i++)
+         {
+            const crn_palette& palette = *pPalettes[i];
+            const crn_palette& our_palette = *pOur_palettes[i];
+            if ((palette.m_num != our_palette.m_num) || (palette.m_size != our_palette.m_size))
+               return false;
+            if ((palette.m_ofs + palette.m_size) > data_size)
+               return false;
+            if (memcmp(pFile_data + palette.m_ofs, m_pData + our_palette.m_ofs, palette.m_size))
+               return false;
+         }
 
-         uint32* CRND_RESTRICT pDst = &m_color_endpoints[0];
+         if ((pHeader->m_tables_size != m_pHeader->m_tables_size) || ((pHeader->m_tables_ofs + pHeader->m_tables_size) > data_size))
+            return false;
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+         return memcmp(pFile_data + pHeader->m_tables_ofs, m_pData + m_pHeader->m_tables_ofs, m_pHeader->m_tables_size) == 0;
+      }
 
-#if CRND_CREATE_BYTE_STREAMS
-         vector<uint8> byte_stream;
-#endif
+      // Appends the next bytes of a file being streamed in, see crnd_unpack_stream_push(). The file is copied, so it can be decoded
+      // before all of it arrived. Once the bytes preceding the first level are in, the unpacker is initialized.
+      bool stream_push(const void* pData, uint32 data_size)
+      {
+         const uint8* pSrc = static_cast<const uint8*>(pData);
 
-         for (uint32 i = 0; i < num_color_endpoints; i++)
+         // The file's size is only known once the start of its header arrived.
+         if (m_stream_size < cCRNHeaderMinSize)
          {
-            uint32 da, db, dc, dd, de, df;
-            CRND_HUFF_DECODE(m_codec, dm[0], da); a = (a + da) & 31;
-            CRND_HUFF_DECODE(m_codec, dm[1], db); b = (b + db) & 63;
-            CRND_HUFF_DECODE(m_codec, dm[0], dc); c = (c + dc) & 31;
+            const uint32 n = math::minimum(data_size, cCRNHeaderMinSize - m_stream_size);
+            if ((!m_stream_data.size()) && (!m_stream_data.resize(cCRNHeaderMinSize)))
+               return false;
 
-            CRND_HUFF_DECODE(m_codec, dm[0], dd); d = (d + dd) & 31;
-            CRND_HUFF_DECODE(m_codec, dm[1], de); e = (e + de) & 63;
-            CRND_HUFF_DECODE(m_codec, dm[0], df); f = (f + df) & 31;
+            memcpy(&m_stream_data[m_stream_size], pSrc, n);
+            m_stream_size += n;
+            pSrc += n;
+            data_size -= n;
 
-#if CRND_CREATE_BYTE_STREAMS
-            byte_stream.push_back(da);
-            byte_stream.push_back(db);
-            byte_stream.push_back(dc);
-            byte_stream.push_back(dd);
-            byte_stream.push_back(de);
-            byte_stream.push_back(df);
-#endif
+            if (m_stream_size < cCRNHeaderMinSize)
+               return true;
 
-            if (c_crnd_little_endian_platform)
-               *pDst++ = c | (b << 5U) | (a << 11U) | (f << 16U) | (e << 21U) | (d << 27U);
-            else
-               *pDst++ = f | (e << 5U) | (d << 11U) | (c << 16U) | (b << 21U) | (a << 27U);
+            const crn_header& header = *reinterpret_cast<const crn_header*>(&m_stream_data[0]);
+            if ((header.m_sig != crn_header::cCRNSigValue) || (header.m_header_size < sizeof(crn_header)) || (header.m_data_size < header.m_header_size))
+               return false;
+
+            // The padding keeps the decoder's read ahead inside the buffer, see stream_unpack_level().
+            if (!m_stream_data.resize(header.m_data_size + cStreamPadding))
+               return false;
          }
 
-         CRND_HUFF_DECODE_END(m_codec);
+         if (data_size > (m_stream_data.size() - cStreamPadding - m_stream_size))
+            return false;
 
-         m_codec.stop_decoding();
+         memcpy(&m_stream_data[m_stream_size], pSrc, data_size);
+         m_stream_size += data_size;
 
-#if CRND_CREATE_BYTE_STREAMS
-         write_array_to_file(L"colorendpoints.bin", byte_stream);
-         crnd_trace("color endpoints: %u\n", (uint)m_pHeader->m_color_endpoints.m_size);
-#endif
+         if (m_pHeader)
+            m_data_available = m_stream_size;
+         else if (m_stream_size >= sizeof(crn_header))
+         {
+            // The header, palettes, tables and slice table all precede the first level. Segmented files don't hold their levels.
+            const crn_header& header = *reinterpret_cast<const crn_header*>(&m_stream_data[0]);
+            const uint32 file_size = header.m_data_size;
+            const uint32 base_size = (header.m_flags & cCRNHeaderFlagSegmented) ? file_size : math::minimum<uint32>(header.m_level_ofs[0], file_size);
+
+            if ((m_stream_size >= header.m_header_size) && (m_stream_size >= base_size))
+            {
+               if (!init(&m_stream_data[0], file_size))
+               {
+                  m_pHeader = NULL;
+                  return false;
+               }
+
+               m_data_available = m_stream_size;
+            }
+         }
 
          return true;
       }
 
-      bool decode_color_selectors()
+      inline uint32 get_stream_size() const { return m_stream_size; }
+
+      // Returns the number of levels whose data has all arrived. Levels are stored in order, starting with the largest.
+      uint32 get_num_complete_levels() const
       {
-         const uint32 cMaxSelectorValue = 3U;
-         const uint32 cMaxUniqueSelectorDeltas = cMaxSelectorValue * 2U + 1U;
+         uint32 level_index = 0;
+         while (level_index < m_pHeader->m_levels)
+         {
+            const uint32 next_level_ofs = ((level_index + 1) < m_pHeader->m_levels) ? static_cast<uint32>(m_pHeader->m_level_ofs[level_index + 1]) : m_data_size;
+            if (next_level_ofs > m_data_available)
+               break;
+            level_index++;
+         }
+         return level_index;
+      }
 
-         const uint32 num_color_selectors = m_pHeader->m_color_selectors.m_num;
+      // Transcodes the rows of chunks of the level that can be decoded from the bytes that arrived since the last call, see
+      // crnd_unpack_stream_level(). Each row is decoded speculatively from the bytes that have arrived (and the zeros after them),
+      // and only kept if the decoder didn't consume any bits past them. Otherwise it's decoded again on a later call.
+      bool stream_unpack_level(
+         void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+         uint32 level_index, uint32& num_rows_ready)
+      {
+         const uint32 width = math::maximum(m_pHeader->m_width >> level_index, 1U);
+         const uint32 height = math::maximum(m_pHeader->m_height >> level_index, 1U);
+         const uint32 blocks_x = (width + 3U) >> 2U;
+         const uint32 blocks_y = (height + 3U) >> 2U;
+         const uint32 block_size = ((m_pHeader->m_format == cCRNFmtDXT1) || (m_pHeader->m_format == cCRNFmtDXT5A) || (m_pHeader->m_format == cCRNFmtETC1)) ? 8 : 16;
 
-         if (!m_codec.start_decoding(m_pData + m_pHeader->m_color_selectors.m_ofs, m_pHeader->m_color_selectors.m_size))
+         uint32 minimal_row_pitch = block_size * blocks_x;
+         if (!row_pitch_in_bytes)
+            row_pitch_in_bytes = minimal_row_pitch;
+         else if ((row_pitch_in_bytes < minimal_row_pitch) || (row_pitch_in_bytes & 3))
+            return false;
+         if (dst_size_in_bytes < row_pitch_in_bytes * blocks_y)
             return false;
 
-         static_huffman_data_model dm;
-         if (!m_codec.decode_receive_static_data_model(dm))
+         const uint32 chunks_x = (blocks_x + 1) >> 1;
+         const uint32 chunks_y = (blocks_y + 1) >> 1;
+         const uint32 total_rows = m_pHeader->m_faces * chunks_y;
+
+         stream_level& level = m_stream_levels[level_index];
+         num_rows_ready = level.m_rows_ready;
+
+         const uint32 cur_level_ofs = m_pHeader->m_level_ofs[level_index];
+         if ((level.m_rows_ready == total_rows) || (m_data_available <= cur_level_ofs))
+            return true;
+
+         const uint8* pSrc;
+         uint32 src_size_in_bytes;
+         const bool complete = get_level_data(level_index, pSrc, src_size_in_bytes);
+
+         // Until the level is complete, the decoder reads on into the following bytes of the padded stream buffer.
+         const uint32 bits_available = complete ? cUINT32_MAX : ((m_data_available - cur_level_ofs) * 8U);
+         if (!complete)
+            src_size_in_bytes = m_stream_data.size() - cur_level_ofs;
+
+         fast_symbol_codec codec;
+         if (!codec.start_decoding(pSrc, src_size_in_bytes, level.m_bit_ofs))
             return false;
 
-         int32 delta0[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
-         int32 delta1[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
-         int32 l = -(int32)cMaxSelectorValue, m = -(int32)cMaxSelectorValue;
-         for (uint32 i = 0; i < (cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas); i++)
+         uint8* pRow_dst[cCRNMaxFaces];
+
+         while (level.m_rows_ready < total_rows)
          {
-            delta0[i] = l;
-            delta1[i] = m;
+            chunk_range range = level.m_range;
+            range.m_first_face = level.m_rows_ready / chunks_y;
+            range.m_num_faces = 1;
+            range.m_first_row = level.m_rows_ready % chunks_y;
+            range.m_num_rows = 1;
 
-            if (++l > (int32)cMaxSelectorValue)
-            {
-               l = -(int32)cMaxSelectorValue;
-               m++;
-            }
-         }
+            pRow_dst[range.m_first_face] = static_cast<uint8*>(pDst[range.m_first_face]) + range.m_first_row * row_pitch_in_bytes * 2;
 
-         uint32 cur[16];
-         utils::zero_object(cur);
+            if (!unpack_chunks(codec, range, pRow_dst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y))
+               return false;
 
-         if (!m_color_selectors.resize(num_color_selectors))
-            return false;
+            const uint32 bit_ofs = codec.get_bits_decoded();
+            if (bit_ofs > bits_available)
+               break;
 
-         uint32* CRND_RESTRICT pDst = &m_color_selectors[0];
+            level.m_range = range;
+            level.m_bit_ofs = bit_ofs;
+            level.m_rows_ready++;
+         }
 
-         const uint8* pFrom_linear = g_dxt1_from_linear;
+         num_rows_ready = level.m_rows_ready;
+         return true;
+      }
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+      // Returns the number of arena bytes needed by an unpacker of the file, see crnd_unpack_begin_arena(). This counts every block
+      // init() allocates, as the arena doesn't reuse freed blocks, and the largest temporary buffer allocated while transcoding.
+      static uint32 get_arena_size(const crn_header* pHeader)
+      {
+         uint32 size = crnd_arena::get_block_size(sizeof(crn_unpacker));
 
-#if CRND_CREATE_BYTE_STREAMS
-         vector<uint8> byte_stream;
-#endif
+         size += get_model_arena_size(cMaxChunkEncodingSyms, false);
 
-         for (uint32 i = 0; i < num_color_selectors; i++)
+         // The palettes are decoded with models of at most cMaxPaletteModelSyms symbols: two for the color endpoints, and one
+         // for each of the other palettes. The selector palette models may get a multi-symbol lookup table.
+         if (pHeader->m_color_endpoints.m_num)
          {
-            for (uint32 j = 0; j < 8; j++)
-            {
-               int32 sym;
-               CRND_HUFF_DECODE(m_codec, dm, sym);
+            size += get_model_arena_size(pHeader->m_color_endpoints.m_num, true);
+            size += get_model_arena_size(pHeader->m_color_selectors.m_num, true);
+            size += crnd_arena::get_block_size(pHeader->m_color_endpoints.m_num * sizeof(uint32));
+            size += crnd_arena::get_block_size(pHeader->m_color_selectors.m_num * sizeof(uint32));
+            size += get_model_arena_size(cMaxPaletteModelSyms, false) * 2;
+            size += get_model_arena_size(cMaxPaletteModelSyms, true);
+         }
 
-#if CRND_CREATE_BYTE_STREAMS
-               byte_stream.push_back(sym);
+         if (pHeader->m_alpha_endpoints.m_num)
+         {
+            size += get_model_arena_size(pHeader->m_alpha_endpoints.m_num, true);
+            size += get_model_arena_size(pHeader->m_alpha_selectors.m_num, true);
+            size += crnd_arena::get_block_size(pHeader->m_alpha_endpoints.m_num * sizeof(uint16));
+            size += crnd_arena::get_block_size(pHeader->m_alpha_selectors.m_num * sizeof(uint16) * 3);
+            size += get_model_arena_size(cMaxPaletteModelSyms, false);
+            size += get_model_arena_size(cMaxPaletteModelSyms, true);
+         }
+
+         // crnd_unpack_level_region() allocates two rows of blocks, and crnd_unpack_level_slices() a status byte per slice.
+         const uint32 blocks_x = (pHeader->m_width + 3) >> 2;
+         const uint32 chunks_y = (pHeader->m_height + 7) >> 3;
+         const uint32 block_size = ((pHeader->m_format == cCRNFmtDXT1) || (pHeader->m_format == cCRNFmtDXT5A) || (pHeader->m_format == cCRNFmtETC1)) ? 8 : 16;
+         size += crnd_arena::get_block_size(math::maximum<uint32>(blocks_x * block_size * 2, pHeader->m_faces * chunks_y));
+
+         return size;
+      }
+
+      inline const void* get_data() const { return m_pData; }
+      inline uint32 get_data_size() const { return m_data_size; }
+      inline const crn_header* get_header() const { return m_pHeader; }
+
+      inline crnd_arena* get_arena() const { return m_pArena; }
+      inline void set_arena(crnd_arena* pArena) { m_pArena = pArena; }
+
+   private:
+      enum { cMagicValue = 0x1EF9CABD };
+      uint32             m_magic;
+
+      const uint8*       m_pData;
+      uint32             m_data_size;
+      crn_header         m_tmp_header;
+      const crn_header*  m_pHeader;
+
+      // Only used by init(), to decode the tables and palettes.
+      symbol_codec       m_codec;
+
+      static_huffman_data_model m_chunk_encoding_dm;
+      static_huffman_data_model m_endpoint_delta_dm[2];
+      static_huffman_data_model m_selector_delta_dm[2];
+
+      crnd::vector<uint32> m_color_endpoints;
+      crnd::vector<uint32> m_color_selectors;
+
+      crnd::vector<uint16> m_alpha_endpoints;
+      crnd::vector<uint16> m_alpha_selectors;
+
+      // The optional slice table, see crn_slice_table.
+      const crn_slice*   m_pSlices;
+      uint32             m_slice_chunk_rows;
+      uint32             m_first_slice[cCRNMaxLevels];
+
+      // The number of bytes of m_pData that have arrived, which is m_data_size unless the file is being streamed in.
+      uint32 m_data_available;
+
+      // The rows of chunks an unpack_*() call decodes from each face in [m_first_face, m_first_face + m_num_faces), and the
+      // decoder state at the first chunk. On return, the state is the state at the chunk following the range.
+      struct chunk_range
+      {
+         uint32 m_first_face;
+         uint32 m_num_faces;
+         uint32 m_first_row;
+         uint32 m_num_rows;
+
+         uint32 m_chunk_encoding_bits;
+         uint32 m_endpoint_index[3];
+         uint32 m_selector_index[3];
+      };
+
+      // The file being streamed in, see stream_push().
+      enum { cStreamPadding = 8 };
+      crnd::vector<uint8> m_stream_data;
+      uint32 m_stream_size;
+
+      // Where stream_unpack_level() resumes decoding each level.
+      struct stream_level
+      {
+         uint32 m_rows_ready;
+         uint32 m_bit_ofs;
+         chunk_range m_range;
+      };
+      stream_level m_stream_levels[cCRNMaxLevels];
+
+      // The caller supplied buffer holding this unpacker and its tables and palettes, or NULL if they're on the heap.
+      crnd_arena* m_pArena;
+
+      enum
+      {
+         cMaxChunkEncodingSyms = 512,
+         cMaxPaletteModelSyms = 256
+      };
+
+      // Returns the number of arena bytes taken by a static_huffman_data_model of up to total_syms symbols, including the model
+      // decode_receive_static_data_model() decodes its code lengths with.
+      static uint32 get_model_arena_size(uint32 total_syms, bool multi_symbol_lookup)
+      {
+         total_syms = math::minimum(total_syms, prefix_coding::cMaxSupportedSyms);
+
+         uint32 table_bits = prefix_coding::cMaxTableBits;
+#if !CRND_PREFIX_CODING_USE_FIXED_TABLE_SIZE
+         table_bits = (total_syms > 16) ? math::minimum(1 + math::ceil_log2i(total_syms), prefix_coding::cMaxTableBits) : 0;
 #endif
 
-               cur[j*2+0] = (delta0[sym] + cur[j*2+0]) & 3;
-               cur[j*2+1] = (delta1[sym] + cur[j*2+1]) & 3;
-            }
+         uint32 size = crnd_arena::get_block_size(total_syms);
+         size += crnd_arena::get_block_size(sizeof(prefix_coding::decoder_tables));
+         size += crnd_arena::get_block_size(CRND_MIN_ALLOC_ALIGNMENT + total_syms * sizeof(uint16));
+         if (table_bits)
+            size += crnd_arena::get_block_size(CRND_MIN_ALLOC_ALIGNMENT + (sizeof(uint32) << table_bits));
+         if (multi_symbol_lookup)
+            size += crnd_arena::get_block_size(CRND_MIN_ALLOC_ALIGNMENT + (sizeof(prefix_coding::multi_symbol_entry) << prefix_coding::cMaxTableBits));
 
-            if (c_crnd_little_endian_platform)
-            {
-               *pDst++ =
-                  (pFrom_linear[cur[0 ]]      ) | (pFrom_linear[cur[1 ]] <<  2) | (pFrom_linear[cur[2 ]] <<  4) | (pFrom_linear[cur[3 ]] <<  6) |
-                  (pFrom_linear[cur[4 ]] <<  8) | (pFrom_linear[cur[5 ]] << 10) | (pFrom_linear[cur[6 ]] << 12) | (pFrom_linear[cur[7 ]] << 14) |
-                  (pFrom_linear[cur[8 ]] << 16) | (pFrom_linear[cur[9 ]] << 18) | (pFrom_linear[cur[10]] << 20) | (pFrom_linear[cur[11]] << 22) |
-                  (pFrom_linear[cur[12]] << 24) | (pFrom_linear[cur[13]] << 26) | (pFrom_linear[cur[14]] << 28) | (pFrom_linear[cur[15]] << 30);
-            }
-            else
+         if (total_syms != cMaxCodelengthCodes)
+            size += get_model_arena_size(cMaxCodelengthCodes, false);
+
+         return size;
+      }
+
+      void init_slices()
+      {
+         const uint32 slice_table_size = crnd_get_slice_table_size(m_pHeader, m_data_size);
+         if (!slice_table_size)
+            return;
+
+         const crn_slice_table* pSlice_table = reinterpret_cast<const crn_slice_table*>(m_pData + m_pHeader->m_slice_table_ofs);
+         const crn_slice* pSlices = reinterpret_cast<const crn_slice*>(pSlice_table + 1);
+         const uint32 slice_chunk_rows = pSlice_table->m_chunk_rows;
+
+         uint32 total_slices = 0;
+         for (uint32 level_index = 0; level_index < m_pHeader->m_levels; level_index++)
+         {
+            m_first_slice[level_index] = total_slices;
+            total_slices += crnd_calc_level_num_slices(m_pHeader, slice_chunk_rows, level_index);
+         }
+
+         // Ignore the table (so levels can only be unpacked whole) if any slice's palette indices are out of range.
+         const uint32 num_endpoints[3] = { m_color_endpoints.size(), m_alpha_endpoints.size(), m_alpha_endpoints.size() };
+         const uint32 num_selectors[3] = { m_color_selectors.size(), m_pHeader->m_alpha_selectors.m_num, m_pHeader->m_alpha_selectors.m_num };
+
+         for (uint32 i = 0; i < total_slices; i++)
+         {
+            for (uint32 c = 0; c < 3; c++)
             {
-               *pDst++ =
-                  (pFrom_linear[cur[8 ]]      ) | (pFrom_linear[cur[9 ]] <<  2) | (pFrom_linear[cur[10]] <<  4) | (pFrom_linear[cur[11]] <<  6) |
-                  (pFrom_linear[cur[12]] <<  8) | (pFrom_linear[cur[13]] << 10) | (pFrom_linear[cur[14]] << 12) | (pFrom_linear[cur[15]] << 14) |
-                  (pFrom_linear[cur[0 ]] << 16) | (pFrom_linear[cur[1 ]] << 18) | (pFrom_linear[cur[2 ]] << 20) | (pFrom_linear[cur[3 ]] << 22) |
-                  (pFrom_linear[cur[4 ]] << 24) | (pFrom_linear[cur[5 ]] << 26) | (pFrom_linear[cur[6 ]] << 28) | (pFrom_linear[cur[7 ]] << 30);
+               if ((pSlices[i].m_endpoint_index[c] >= math::maximum(num_endpoints[c], 1U)) || (pSlices[i].m_selector_index[c] >= math::maximum(num_selectors[c], 1U)))
+                  return;
             }
          }
 
-         CRND_HUFF_DECODE_END(m_codec);
+         m_slice_chunk_rows = slice_chunk_rows;
+         m_pSlices = pSlices;
+      }
 
-         m_codec.stop_decoding();
+      // Returns false if the level's data hasn't all arrived yet (see stream_push()).
+      bool get_level_data(uint32 level_index, const uint8*& pSrc, uint32& src_size_in_bytes) const
+      {
+         uint32 cur_level_ofs = m_pHeader->m_level_ofs[level_index];
 
-#if CRND_CREATE_BYTE_STREAMS
-         write_array_to_file(L"colorselectors.bin", byte_stream);
-         crnd_trace("color selectors: %u\n", (uint)m_pHeader->m_color_selectors.m_size);
-#endif
+         uint32 next_level_ofs = m_data_size;
+         if ((level_index + 1) < (m_pHeader->m_levels))
+            next_level_ofs = m_pHeader->m_level_ofs[level_index + 1];
 
-         return true;
+         // The levels of segmented files aren't in m_pData.
+         if (next_level_ofs <= cur_level_ofs)
+            return false;
+
+         pSrc = m_pData + cur_level_ofs;
+         src_size_in_bytes = next_level_ofs - cur_level_ofs;
+
+         return next_level_ofs <= m_data_available;
       }
 
-      bool decode_alpha_endpoints()
+      // Unpacks the whole level if slice_index is cUINT32_MAX.
+      template<typename codec_type>
+      bool unpack_level(
+         codec_type& codec,
+         const void* pSrc, uint32 src_size_in_bytes,
+         void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+         uint32 level_index, uint32 slice_index) const
       {
-         const uint32 num_alpha_endpoints = m_pHeader->m_alpha_endpoints.m_num;
+         dst_size_in_bytes;
 
-         if (!m_codec.start_decoding(m_pData + m_pHeader->m_alpha_endpoints.m_ofs, m_pHeader->m_alpha_endpoints.m_size))
-            return false;
+#ifdef CRND_BUILD_DEBUG
+         for (uint32 f = 0; f < m_pHeader->m_faces; f++)
+            if (!pDst[f])
+               return false;
+#endif
 
-         static_huffman_data_model dm;
-         if (!m_codec.decode_receive_static_data_model(dm))
-            return false;
+         const uint32 width = math::maximum(m_pHeader->m_width >> level_index, 1U);
+         const uint32 height = math::maximum(m_pHeader->m_height >> level_index, 1U);
+         const uint32 blocks_x = (width + 3U) >> 2U;
+         const uint32 blocks_y = (height + 3U) >> 2U;
+         const uint32 block_size = ((m_pHeader->m_format == cCRNFmtDXT1) || (m_pHeader->m_format == cCRNFmtDXT5A) || (m_pHeader->m_format == cCRNFmtETC1)) ? 8 : 16;
 
-         if (!m_alpha_endpoints.resize(num_alpha_endpoints))
+         uint32 minimal_row_pitch = block_size * blocks_x;
+         if (!row_pitch_in_bytes)
+            row_pitch_in_bytes = minimal_row_pitch;
+         else if ((row_pitch_in_bytes < minimal_row_pitch) || (row_pitch_in_bytes & 3))
+            return false;
+         if (dst_size_in_bytes < row_pitch_in_bytes * blocks_y)
             return false;
 
-         uint16* CRND_RESTRICT pDst = &m_alpha_endpoints[0];
-         uint32 a = 0, b = 0;
+         const uint32 chunks_x = (blocks_x + 1) >> 1;
+         const uint32 chunks_y = (blocks_y + 1) >> 1;
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+#if CRND_CREATE_BYTE_STREAMS
+         crnd_trace("Index stream: %u bytes\n", src_size_in_bytes);
+#endif
 
-         for (uint32 i = 0; i < num_alpha_endpoints; i++)
-         {
-            uint sa; CRND_HUFF_DECODE(m_codec, dm, sa);
-            uint sb; CRND_HUFF_DECODE(m_codec, dm, sb);
+         chunk_range range;
+         utils::zero_object(range);
+         range.m_num_faces = m_pHeader->m_faces;
+         range.m_num_rows = chunks_y;
+         range.m_chunk_encoding_bits = 1;
 
-            a = (sa + a) & 255;
-            b = (sb + b) & 255;
+         uint32 start_bit_ofs = 0;
 
-            *pDst++ = (uint16)(a | (b << 8));
+         if (slice_index != cUINT32_MAX)
+         {
+            start_bit_ofs = get_slice_range(level_index, slice_index, chunks_y, range);
+            range.m_num_rows = math::minimum(m_slice_chunk_rows, chunks_y - range.m_first_row);
          }
 
-         CRND_HUFF_DECODE_END(m_codec);
+         if (!codec.start_decoding(static_cast<const crnd::uint8*>(pSrc), src_size_in_bytes, start_bit_ofs))
+            return false;
 
-         m_codec.stop_decoding();
+         uint8* pRow_dst[cCRNMaxFaces];
+         for (uint32 f = range.m_first_face; f < (range.m_first_face + range.m_num_faces); f++)
+            pRow_dst[f] = static_cast<uint8*>(pDst[f]) + range.m_first_row * row_pitch_in_bytes * 2;
+
+         if (!unpack_chunks(codec, range, pRow_dst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y))
+            return false;
 
+         codec.stop_decoding();
          return true;
       }
 
-      bool decode_alpha_selectors()
+      // pixel_type is uint32 for RGBA8888 pixels, and uint16 for RGB565 pixels.
+      template<typename pixel_type>
+      bool unpack_level_pixels(
+         void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+         uint32 level_index) const
       {
-         const uint32 cMaxSelectorValue = 7U;
-         const uint32 cMaxUniqueSelectorDeltas = cMaxSelectorValue * 2U + 1U;
+         const uint32 width = math::maximum(m_pHeader->m_width >> level_index, 1U);
+         const uint32 height = math::maximum(m_pHeader->m_height >> level_index, 1U);
 
-         const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
+         const uint32 minimal_row_pitch = width * sizeof(pixel_type);
+         if (!row_pitch_in_bytes)
+            row_pitch_in_bytes = minimal_row_pitch;
+         else if ((row_pitch_in_bytes < minimal_row_pitch) || (row_pitch_in_bytes % sizeof(pixel_type)))
+            return false;
+         if (dst_size_in_bytes < row_pitch_in_bytes * height)
+            return false;
 
-         if (!m_codec.start_decoding(m_pData + m_pHeader->m_alpha_selectors.m_ofs, m_pHeader->m_alpha_selectors.m_size))
+         const uint8* pSrc;
+         uint32 src_size_in_bytes;
+         if (!get_level_data(level_index, pSrc, src_size_in_bytes))
             return false;
 
-         static_huffman_data_model dm;
-         if (!m_codec.decode_receive_static_data_model(dm))
+         fast_symbol_codec codec;
+         if (!codec.start_decoding(pSrc, src_size_in_bytes))
+            return false;
+
+         chunk_range range;
+         utils::zero_object(range);
+         range.m_num_faces = m_pHeader->m_faces;
+         range.m_num_rows = (height + 7) >> 3;
+         range.m_chunk_encoding_bits = 1;
+
+         // The channels written from each DXT5 alpha block, and the value of the channels no block writes. These match what
+         // crnlib's dxt_image::unpack() produces from the transcoded blocks.
+         uint32 alpha_channels[2] = { 3, 3 };
+         bool status = false;
+         switch (m_pHeader->m_format)
+         {
+         case cCRNFmtDXT1:
+            status = unpack_pixels<fast_symbol_codec, pixel_type, true, 0>(codec, range, (uint8**)pDst, row_pitch_in_bytes, width, height, alpha_channels, 0);
+            break;
+         case cCRNFmtDXT5:
+         case cCRNFmtDXT5_CCxY:
+         case cCRNFmtDXT5_xGBR:
+         case cCRNFmtDXT5_AGBR:
+         case cCRNFmtDXT5_xGxR:
+            status = unpack_pixels<fast_symbol_codec, pixel_type, true, 1>(codec, range, (uint8**)pDst, row_pitch_in_bytes, width, height, alpha_channels, 0);
+            break;
+         case cCRNFmtDXT5A:
+            // RGB565 has nowhere to put the alpha channel.
+            if (sizeof(pixel_type) == sizeof(uint32))
+               status = unpack_pixels<fast_symbol_codec, pixel_type, false, 1>(codec, range, (uint8**)pDst, row_pitch_in_bytes, width, height, alpha_channels, 0);
+            break;
+         case cCRNFmtDXN_XY:
+         case cCRNFmtDXN_YX:
+            alpha_channels[0] = (m_pHeader->m_format == cCRNFmtDXN_XY) ? 0 : 1;
+            alpha_channels[1] = (m_pHeader->m_format == cCRNFmtDXN_XY) ? 1 : 0;
+            status = unpack_pixels<fast_symbol_codec, pixel_type, false, 2>(codec, range, (uint8**)pDst, row_pitch_in_bytes, width, height, alpha_channels, pack_pixel(0, 0, 0, 255, (pixel_type*)NULL));
+            break;
+         default:
+            break;
+         }
+         if (!status)
+            return false;
+
+         codec.stop_decoding();
+         return true;
+      }
+
+      // Shifts of the R, G, B and A bytes of an RGBA8888 pixel read as a uint32.
+      enum
+      {
+#ifdef CRND_BIG_ENDIAN_PLATFORM
+         cRGBA8888ShiftR = 24, cRGBA8888ShiftG = 16, cRGBA8888ShiftB = 8, cRGBA8888ShiftA = 0
+#else
+         cRGBA8888ShiftR = 0, cRGBA8888ShiftG = 8, cRGBA8888ShiftB = 16, cRGBA8888ShiftA = 24
+#endif
+      };
+
+      static inline uint32 pack_pixel(uint32 r, uint32 g, uint32 b, uint32 a, uint32*)
+      {
+         return (r << cRGBA8888ShiftR) | (g << cRGBA8888ShiftG) | (b << cRGBA8888ShiftB) | (a << cRGBA8888ShiftA);
+      }
+
+      static inline uint16 pack_pixel(uint32 r, uint32 g, uint32 b, uint32 a, uint16*)
+      {
+         a;
+         return static_cast<uint16>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+      }
+
+      // Expands a color endpoint palette entry to its 4 colors, like crnlib's dxt1_block::get_block_colors(). The colors are opaque,
+      // with black/transparent as the 4th color of 3 color blocks. alpha_mask is ANDed into each color.
+      template<typename pixel_type>
+      static inline void get_block_colors(pixel_type* pColors, uint32 endpoints, pixel_type alpha_mask)
+      {
+#ifdef CRND_BIG_ENDIAN_PLATFORM
+         endpoints = utils::swap32(endpoints);
+#endif
+         const uint32 color0 = endpoints & 0xFFFF;
+         const uint32 color1 = endpoints >> 16U;
+
+         const uint32 r0 = color0 >> 11U, g0 = (color0 >> 5U) & 63U, b0 = color0 & 31U;
+         const uint32 r1 = color1 >> 11U, g1 = (color1 >> 5U) & 63U, b1 = color1 & 31U;
+
+         const uint32 c0[3] = { (r0 << 3U) | (r0 >> 2U), (g0 << 2U) | (g0 >> 4U), (b0 << 3U) | (b0 >> 2U) };
+         const uint32 c1[3] = { (r1 << 3U) | (r1 >> 2U), (g1 << 2U) | (g1 >> 4U), (b1 << 3U) | (b1 >> 2U) };
+
+         pColors[0] = pack_pixel(c0[0], c0[1], c0[2], 255, pColors) & alpha_mask;
+         pColors[1] = pack_pixel(c1[0], c1[1], c1[2], 255, pColors) & alpha_mask;
+
+         if (color0 > color1)
+         {
+            pColors[2] = pack_pixel((c0[0] * 2 + c1[0]) / 3, (c0[1] * 2 + c1[1]) / 3, (c0[2] * 2 + c1[2]) / 3, 255, pColors) & alpha_mask;
+            pColors[3] = pack_pixel((c1[0] * 2 + c0[0]) / 3, (c1[1] * 2 + c0[1]) / 3, (c1[2] * 2 + c0[2]) / 3, 255, pColors) & alpha_mask;
+         }
+         else
+         {
+            pColors[2] = pack_pixel((c0[0] + c1[0]) >> 1U, (c0[1] + c1[1]) >> 1U, (c0[2] + c1[2]) >> 1U, 255, pColors) & alpha_mask;
+            pColors[3] = 0;
+         }
+      }
+
+      // Expands an alpha endpoint palette entry to its 8 values, like crnlib's dxt5_block::get_block_values(), each written to the
+      // channel'th channel of a pixel.
+      template<typename pixel_type>
+      static inline void get_block_values(pixel_type* pValues, uint32 endpoints, uint32 channel)
+      {
+#ifdef CRND_BIG_ENDIAN_PLATFORM
+         endpoints = utils::swap16(static_cast<uint16>(endpoints));
+#endif
+         const uint32 l = endpoints & 0xFF;
+         const uint32 h = (endpoints >> 8U) & 0xFF;
+
+         uint32 values[8];
+         values[0] = l;
+         values[1] = h;
+         if (l > h)
+         {
+            for (uint32 i = 1; i < 7; i++)
+               values[i + 1] = (l * (7 - i) + h * i) / 7;
+         }
+         else
+         {
+            for (uint32 i = 1; i < 5; i++)
+               values[i + 1] = (l * (5 - i) + h * i) / 5;
+            values[6] = 0;
+            values[7] = 255;
+         }
+
+         for (uint32 i = 0; i < 8; i++)
+         {
+            const uint32 v = values[i];
+            pValues[i] = pack_pixel((channel == 0) ? v : 0, (channel == 1) ? v : 0, (channel == 2) ? v : 0, (channel == 3) ? v : 0, pValues);
+         }
+      }
+
+      inline uint32 get_color_selectors(uint32 selector_index) const
+      {
+#ifdef CRND_BIG_ENDIAN_PLATFORM
+         return utils::swap32(m_color_selectors[selector_index]);
+#else
+         return m_color_selectors[selector_index];
+#endif
+      }
+
+      inline uint64 get_alpha_selectors(uint32 selector_index) const
+      {
+         const uint16* pSelectors = &m_alpha_selectors[selector_index * 3];
+#ifdef CRND_BIG_ENDIAN_PLATFORM
+         return utils::swap16(pSelectors[0]) | (static_cast<uint32>(utils::swap16(pSelectors[1])) << 16U) | (static_cast<uint64>(utils::swap16(pSelectors[2])) << 32U);
+#else
+         return pSelectors[0] | (static_cast<uint32>(pSelectors[1]) << 16U) | (static_cast<uint64>(pSelectors[2]) << 32U);
+#endif
+      }
+
+      // Decodes the chunks of any DXT format like the unpack_*() functions, but writes pixels instead of blocks. Each tile's
+      // endpoints are expanded once into a table of colors (and alpha values), which the selectors of the tile's blocks index.
+      // pDst[f] points at the first pixel row of the range in face f.
+      template<typename codec_type, typename pixel_type, bool has_color, uint32 num_alphas>
+      bool unpack_pixels(codec_type& codec, chunk_range& range, uint8** pDst, uint32 row_pitch_in_bytes, uint32 width, uint32 height, const uint32* pAlpha_channels, pixel_type base_pixel) const
+      {
+         uint32 chunk_encoding_bits = range.m_chunk_encoding_bits;
+
+         const uint32 num_color_endpoints = m_color_endpoints.size();
+         const uint32 num_color_selectors = m_color_selectors.size();
+         const uint32 num_alpha_endpoints = m_alpha_endpoints.size();
+         const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
+
+         uint32 prev_endpoint_index[3];
+         uint32 prev_selector_index[3];
+         for (uint32 i = 0; i < 3; i++)
+         {
+            prev_endpoint_index[i] = range.m_endpoint_index[i];
+            prev_selector_index[i] = range.m_selector_index[i];
+         }
+
+         const uint32 chunks_x = (width + 7) >> 3;
+         const uint32 row_pitch_in_pixels = row_pitch_in_bytes / sizeof(pixel_type);
+
+         // The color blocks of DXT5 formats don't write alpha.
+         const pixel_type alpha_mask = num_alphas ? pack_pixel(255, 255, 255, 0, (pixel_type*)NULL) : static_cast<pixel_type>(cUINT32_MAX);
+
+         CRND_HUFF_DECODE_BEGIN(codec);
+
+         for (uint32 f = range.m_first_face; f < (range.m_first_face + range.m_num_faces); f++)
+         {
+            uint8* CRND_RESTRICT pRow = pDst[f];
+
+            for (uint32 y = range.m_first_row; y < (range.m_first_row + range.m_num_rows); y++)
+            {
+               int32 start_x = 0;
+               int32 end_x = chunks_x;
+               int32 dir_x = 1;
+
+               if (y & 1)
+               {
+                  start_x = chunks_x - 1;
+                  end_x = -1;
+                  dir_x = -1;
+               }
+
+               for (int32 x = start_x; x != end_x; x += dir_x)
+               {
+                  pixel_type tile_colors[4][4];
+                  pixel_type tile_values[num_alphas ? num_alphas : 1][4][8];
+
+                  if (chunk_encoding_bits == 1)
+                  {
+                     CRND_HUFF_DECODE(codec, m_chunk_encoding_dm, chunk_encoding_bits);
+                     chunk_encoding_bits |= 512;
+                  }
+
+                  const uint32 chunk_encoding_index = chunk_encoding_bits & 7;
+                  chunk_encoding_bits >>= 3;
+
+                  const uint32 num_tiles = g_crnd_chunk_encoding_num_tiles[chunk_encoding_index];
+
+                  const uint8* pTile_indices = g_crnd_chunk_encoding_tiles[chunk_encoding_index].m_tiles;
+
+                  uint32 endpoint_deltas[4];
+                  for (uint32 a = 0; a < num_alphas; a++)
+                  {
+                     CRND_HUFF_DECODE_MULTI(codec, m_endpoint_delta_dm[1], endpoint_deltas, num_tiles);
+
+                     for (uint32 i = 0; i < num_tiles; i++)
+                     {
+                        prev_endpoint_index[1 + a] += endpoint_deltas[i];
+                        limit(prev_endpoint_index[1 + a], num_alpha_endpoints);
+                        get_block_values(tile_values[a][i], m_alpha_endpoints[prev_endpoint_index[1 + a]], pAlpha_channels[a]);
+                     }
+                  }
+
+                  if (has_color)
+                  {
+                     CRND_HUFF_DECODE_MULTI(codec, m_endpoint_delta_dm[0], endpoint_deltas, num_tiles);
+
+                     for (uint32 i = 0; i < num_tiles; i++)
+                     {
+                        prev_endpoint_index[0] += endpoint_deltas[i];
+                        limit(prev_endpoint_index[0], num_color_endpoints);
+                        get_block_colors(tile_colors[i], m_color_endpoints[prev_endpoint_index[0]], alpha_mask);
+                     }
+                  }
+
+                  // DXT5 chunks interleave the alpha and color selector deltas, which come from different models.
+                  const uint32 num_comps = (has_color ? 1 : 0) + num_alphas;
+                  uint32 selector_deltas[4 * 2];
+                  if (num_comps == 1)
+                  {
+                     CRND_HUFF_DECODE_MULTI(codec, m_selector_delta_dm[has_color ? 0 : 1], selector_deltas, 4);
+                  }
+                  else if (!has_color)
+                  {
+                     CRND_HUFF_DECODE_MULTI(codec, m_selector_delta_dm[1], selector_deltas, 8);
+                  }
+
+                  for (uint32 b = 0; b < 4; b++)
+                  {
+                     uint64 alpha_selectors[num_alphas ? num_alphas : 1];
+                     for (uint32 a = 0; a < num_alphas; a++)
+                     {
+                        uint32 delta;
+                        if (has_color)
+                        {
+                           CRND_HUFF_DECODE(codec, m_selector_delta_dm[1], delta);
+                        }
+                        else
+                           delta = selector_deltas[b * num_alphas + a];
+
+                        prev_selector_index[1 + a] += delta;
+                        limit(prev_selector_index[1 + a], num_alpha_selectors);
+                        alpha_selectors[a] = get_alpha_selectors(prev_selector_index[1 + a]);
+                     }
+
+                     uint32 color_selectors = 0;
+                     if (has_color)
+                     {
+                        uint32 delta;
+                        if (num_alphas)
+                        {
+                           CRND_HUFF_DECODE(codec, m_selector_delta_dm[0], delta);
+                        }
+                        else
+                           delta = selector_deltas[b];
+
+                        prev_selector_index[0] += delta;
+                        limit(prev_selector_index[0], num_color_selectors);
+                        color_selectors = get_color_selectors(prev_selector_index[0]);
+                     }
+
+                     const uint32 block_x = (x * 2 + (b & 1)) * 4;
+                     const uint32 block_y = (b >> 1) * 4;
+                     if ((block_x >= width) || (((y * 8) + block_y) >= height))
+                        continue;
+
+                     const uint32 num_pixels_x = math::minimum(width - block_x, 4U);
+                     const uint32 num_pixels_y = math::minimum(height - (y * 8) - block_y, 4U);
+
+                     const uint32 tile_index = pTile_indices[b];
+                     const pixel_type* pColors = tile_colors[tile_index];
+
+                     pixel_type* CRND_RESTRICT pPixels = reinterpret_cast<pixel_type*>(pRow + block_y * row_pitch_in_bytes) + block_x;
+
+                     for (uint32 py = 0; py < num_pixels_y; py++, pPixels += row_pitch_in_pixels)
+                     {
+                        for (uint32 px = 0; px < num_pixels_x; px++)
+                        {
+                           const uint32 i = py * 4 + px;
+
+                           pixel_type c = base_pixel;
+                           if (has_color)
+                              c |= pColors[(color_selectors >> (i * 2)) & 3];
+                           for (uint32 a = 0; a < num_alphas; a++)
+                              c |= tile_values[a][tile_index][(alpha_selectors[a] >> (i * 3)) & 7];
+
+                           pPixels[px] = c;
+                        }
+                     }
+                  }
+
+               } // x
+
+               pRow += row_pitch_in_bytes * 8;
+
+            } // y
+
+         } // f
+
+         CRND_HUFF_DECODE_END(codec);
+
+         range.m_chunk_encoding_bits = chunk_encoding_bits;
+         for (uint32 i = 0; i < 3; i++)
+         {
+            range.m_endpoint_index[i] = prev_endpoint_index[i];
+            range.m_selector_index[i] = prev_selector_index[i];
+         }
+
+         return true;
+      }
+
+      // Sets range to the first row of the slice's face, and the decoder state at the slice. Returns the slice's bit offset.
+      uint32 get_slice_range(uint32 level_index, uint32 slice_index, uint32 chunks_y, chunk_range& range) const
+      {
+         const uint32 slices_per_face = (chunks_y + m_slice_chunk_rows - 1) / m_slice_chunk_rows;
+         const crn_slice& slice = m_pSlices[m_first_slice[level_index] + slice_index];
+
+         range.m_first_face = slice_index / slices_per_face;
+         range.m_num_faces = 1;
+         range.m_first_row = (slice_index % slices_per_face) * m_slice_chunk_rows;
+
+         range.m_chunk_encoding_bits = slice.m_chunk_encoding_bits;
+         for (uint32 i = 0; i < 3; i++)
+         {
+            range.m_endpoint_index[i] = slice.m_endpoint_index[i];
+            range.m_selector_index[i] = slice.m_selector_index[i];
+         }
+
+         return slice.m_bit_ofs;
+      }
+
+      // pDst[f] points at the first row of the range in face f.
+      template<typename codec_type>
+      bool unpack_chunks(codec_type& codec, chunk_range& range, uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y) const
+      {
+         bool status = false;
+         switch (m_pHeader->m_format)
+         {
+         case cCRNFmtDXT1:
+            status = unpack_dxt1(codec, range, pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
+            break;
+         case cCRNFmtDXT5:
+         case cCRNFmtDXT5_CCxY:
+         case cCRNFmtDXT5_xGBR:
+         case cCRNFmtDXT5_AGBR:
+         case cCRNFmtDXT5_xGxR:
+            status = unpack_dxt5(codec, range, pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
+            break;
+         case cCRNFmtDXT5A:
+            status = unpack_dxt5a(codec, range, pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
+            break;
+         case cCRNFmtDXN_XY:
+         case cCRNFmtDXN_YX:
+            status = unpack_dxn(codec, range, pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
+            break;
+         case cCRNFmtETC1:
+            status = unpack_etc1(codec, range, pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
+            break;
+         default:
+            break;
+         }
+         return status;
+      }
+
+      bool init_tables()
+      {
+         if (!m_codec.start_decoding(m_pData + m_pHeader->m_tables_ofs, m_pHeader->m_tables_size))
+            return false;
+
+         if (!m_codec.decode_receive_static_data_model(m_chunk_encoding_dm))
+            return false;
+
+         if ((!m_pHeader->m_color_endpoints.m_num) && (!m_pHeader->m_alpha_endpoints.m_num))
             return false;
 
-         int32 delta0[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
-         int32 delta1[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
-         int32 l = -(int32)cMaxSelectorValue, m = -(int32)cMaxSelectorValue;
-         for (uint32 i = 0; i < (cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas); i++)
-         {
-            delta0[i] = l;
-            delta1[i] = m;
+         if (m_pHeader->m_color_endpoints.m_num)
+         {
+            if (!m_codec.decode_receive_static_data_model(m_endpoint_delta_dm[0])) return false;
+            if (!m_codec.decode_receive_static_data_model(m_selector_delta_dm[0])) return false;
+            if (!m_endpoint_delta_dm[0].init_multi_symbol_lookup()) return false;
+            if (!m_selector_delta_dm[0].init_multi_symbol_lookup()) return false;
+         }
+
+         if (m_pHeader->m_alpha_endpoints.m_num)
+         {
+            if (!m_codec.decode_receive_static_data_model(m_endpoint_delta_dm[1])) return false;
+            if (!m_codec.decode_receive_static_data_model(m_selector_delta_dm[1])) return false;
+            if (!m_endpoint_delta_dm[1].init_multi_symbol_lookup()) return false;
+            if (!m_selector_delta_dm[1].init_multi_symbol_lookup()) return false;
+         }
+
+         m_codec.stop_decoding();
+
+         return true;
+      }
+
+      bool decode_palettes()
+      {
+         if (m_pHeader->m_color_endpoints.m_num)
+         {
+            if (!decode_color_endpoints()) return false;
+            if (!decode_color_selectors()) return false;
+         }
+
+         if (m_pHeader->m_alpha_endpoints.m_num)
+         {
+            if (!decode_alpha_endpoints()) return false;
+            if (!decode_alpha_selectors()) return false;
+         }
+
+         return true;
+      }
+
+      bool decode_color_endpoints()
+      {
+         const uint32 num_color_endpoints = m_pHeader->m_color_endpoints.m_num;
+
+         if (!m_color_endpoints.resize(num_color_endpoints))
+            return false;
+
+         if (!m_codec.start_decoding(m_pData + m_pHeader->m_color_endpoints.m_ofs, m_pHeader->m_color_endpoints.m_size))
+            return false;
+
+         static_huffman_data_model dm[2];
+         for (uint32 i = 0; i < 2; i++)
+            if (!m_codec.decode_receive_static_data_model(dm[i]))
+               return false;
+
+         uint32 a = 0, b = 0, c = 0;
+         uint32 d = 0, e = 0, f = 0;
+
+         uint32* CRND_RESTRICT pDst = &m_color_endpoints[0];
+
+         // ETC1 endpoints are a 555 base color (a, b, c) and an intensity table (d) shared by both subblocks, which are
+         // stored as the first half of a differential mode ETC1 block with a zero delta color and the flip bit cleared.
+         const bool etc1 = (m_pHeader->m_format == cCRNFmtETC1);
+
+         CRND_HUFF_DECODE_BEGIN(m_codec);
+
+#if CRND_CREATE_BYTE_STREAMS
+         vector<uint8> byte_stream;
+#endif
+
+         for (uint32 i = 0; i < num_color_endpoints; i++)
+         {
+            uint32 da, db, dc, dd, de, df;
+            CRND_HUFF_DECODE(m_codec, dm[0], da); a = (a + da) & 31;
+            CRND_HUFF_DECODE(m_codec, dm[1], db); b = (b + db) & 63;
+            CRND_HUFF_DECODE(m_codec, dm[0], dc); c = (c + dc) & 31;
+
+            CRND_HUFF_DECODE(m_codec, dm[0], dd); d = (d + dd) & 31;
+            CRND_HUFF_DECODE(m_codec, dm[1], de); e = (e + de) & 63;
+            CRND_HUFF_DECODE(m_codec, dm[0], df); f = (f + df) & 31;
+
+#if CRND_CREATE_BYTE_STREAMS
+            byte_stream.push_back(da);
+            byte_stream.push_back(db);
+            byte_stream.push_back(dc);
+            byte_stream.push_back(dd);
+            byte_stream.push_back(de);
+            byte_stream.push_back(df);
+#endif
+
+            if (etc1)
+            {
+               const uint32 control = (d << 5U) | (d << 2U) | 2U;
+               if (c_crnd_little_endian_platform)
+                  *pDst++ = (a << 3U) | (b << 11U) | (c << 19U) | (control << 24U);
+               else
+                  *pDst++ = (a << 27U) | (b << 19U) | (c << 11U) | control;
+            }
+            else if (c_crnd_little_endian_platform)
+               *pDst++ = c | (b << 5U) | (a << 11U) | (f << 16U) | (e << 21U) | (d << 27U);
+            else
+               *pDst++ = f | (e << 5U) | (d << 11U) | (c << 16U) | (b << 21U) | (a << 27U);
+         }
+
+         CRND_HUFF_DECODE_END(m_codec);
+
+         m_codec.stop_decoding();
+
+#if CRND_CREATE_BYTE_STREAMS
+         write_array_to_file(L"colorendpoints.bin", byte_stream);
+         crnd_trace("color endpoints: %u\n", (uint)m_pHeader->m_color_endpoints.m_size);
+#endif
+
+         return true;
+      }
+
+      bool decode_color_selectors()
+      {
+         const uint32 cMaxSelectorValue = 3U;
+         const uint32 cMaxUniqueSelectorDeltas = cMaxSelectorValue * 2U + 1U;
+
+         const uint32 num_color_selectors = m_pHeader->m_color_selectors.m_num;
+
+         if (!m_codec.start_decoding(m_pData + m_pHeader->m_color_selectors.m_ofs, m_pHeader->m_color_selectors.m_size))
+            return false;
+
+         static_huffman_data_model dm;
+         if (!m_codec.decode_receive_static_data_model(dm))
+            return false;
+
+         int32 delta0[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
+         int32 delta1[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
+         int32 l = -(int32)cMaxSelectorValue, m = -(int32)cMaxSelectorValue;
+         for (uint32 i = 0; i < (cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas); i++)
+         {
+            delta0[i] = l;
+            delta1[i] = m;
+
+            if (++l > (int32)cMaxSelectorValue)
+            {
+               l = -(int32)cMaxSelectorValue;
+               m++;
+            }
+         }
+
+         uint32 cur[16];
+         utils::zero_object(cur);
+
+         if (!m_color_selectors.resize(num_color_selectors))
+            return false;
+
+         const bool etc1 = (m_pHeader->m_format == cCRNFmtETC1);
+
+#if CRND_SIMD && !CRND_CREATE_BYTE_STREAMS
+         if ((!etc1) && (c_crnd_little_endian_platform))
+         {
+            uint16 delta_pairs[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
+            for (uint32 i = 0; i < (cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas); i++)
+               delta_pairs[i] = static_cast<uint16>((delta0[i] & cMaxSelectorValue) | ((delta1[i] & cMaxSelectorValue) << 8));
+
+            m_codec.stop_decoding();
+
+            return decode_selectors_simd<2>(dm, delta_pairs, m_pHeader->m_color_selectors, &m_color_selectors[0]);
+         }
+#endif
+
+         uint32* CRND_RESTRICT pDst = &m_color_selectors[0];
+
+         const uint8* pFrom_linear = etc1 ? g_etc1_from_linear : g_dxt1_from_linear;
+
+         CRND_HUFF_DECODE_BEGIN(m_codec);
+
+#if CRND_CREATE_BYTE_STREAMS
+         vector<uint8> byte_stream;
+#endif
+
+         for (uint32 i = 0; i < num_color_selectors; i++)
+         {
+            for (uint32 j = 0; j < 8; j++)
+            {
+               int32 sym;
+               CRND_HUFF_DECODE(m_codec, dm, sym);
+
+#if CRND_CREATE_BYTE_STREAMS
+               byte_stream.push_back(sym);
+#endif
+
+               cur[j*2+0] = (delta0[sym] + cur[j*2+0]) & 3;
+               cur[j*2+1] = (delta1[sym] + cur[j*2+1]) & 3;
+            }
+
+            if (etc1)
+            {
+               // ETC1 selectors are stored column major in two big endian 16-bit planes, MSB's first.
+               uint32 msb = 0, lsb = 0;
+               for (uint32 k = 0; k < 16; k++)
+               {
+                  const uint32 s = pFrom_linear[cur[k]];
+                  const uint32 bit_index = ((k & 3) << 2) | (k >> 2);
+                  msb |= (s >> 1) << bit_index;
+                  lsb |= (s & 1) << bit_index;
+               }
+
+               if (c_crnd_little_endian_platform)
+                  *pDst++ = (msb >> 8U) | ((msb & 0xFF) << 8U) | ((lsb >> 8U) << 16U) | ((lsb & 0xFF) << 24U);
+               else
+                  *pDst++ = (msb << 16U) | lsb;
+            }
+            else if (c_crnd_little_endian_platform)
+            {
+               *pDst++ =
+                  (pFrom_linear[cur[0 ]]      ) | (pFrom_linear[cur[1 ]] <<  2) | (pFrom_linear[cur[2 ]] <<  4) | (pFrom_linear[cur[3 ]] <<  6) |
+                  (pFrom_linear[cur[4 ]] <<  8) | (pFrom_linear[cur[5 ]] << 10) | (pFrom_linear[cur[6 ]] << 12) | (pFrom_linear[cur[7 ]] << 14) |
+                  (pFrom_linear[cur[8 ]] << 16) | (pFrom_linear[cur[9 ]] << 18) | (pFrom_linear[cur[10]] << 20) | (pFrom_linear[cur[11]] << 22) |
+                  (pFrom_linear[cur[12]] << 24) | (pFrom_linear[cur[13]] << 26) | (pFrom_linear[cur[14]] << 28) | (pFrom_linear[cur[15]] << 30);
+            }
+            else
+            {
+               *pDst++ =
+                  (pFrom_linear[cur[8 ]]      ) | (pFrom_linear[cur[9 ]] <<  2) | (pFrom_linear[cur[10]] <<  4) | (pFrom_linear[cur[11]] <<  6) |
+                  (pFrom_linear[cur[12]] <<  8) | (pFrom_linear[cur[13]] << 10) | (pFrom_linear[cur[14]] << 12) | (pFrom_linear[cur[15]] << 14) |
+                  (pFrom_linear[cur[0 ]] << 16) | (pFrom_linear[cur[1 ]] << 18) | (pFrom_linear[cur[2 ]] << 20) | (pFrom_linear[cur[3 ]] << 22) |
+                  (pFrom_linear[cur[4 ]] << 24) | (pFrom_linear[cur[5 ]] << 26) | (pFrom_linear[cur[6 ]] << 28) | (pFrom_linear[cur[7 ]] << 30);
+            }
+         }
+
+         CRND_HUFF_DECODE_END(m_codec);
+
+         m_codec.stop_decoding();
+
+#if CRND_CREATE_BYTE_STREAMS
+         write_array_to_file(L"colorselectors.bin", byte_stream);
+         crnd_trace("color selectors: %u\n", (uint)m_pHeader->m_color_selectors.m_size);
+#endif
+
+         return true;
+      }
+
+      bool decode_alpha_endpoints()
+      {
+         const uint32 num_alpha_endpoints = m_pHeader->m_alpha_endpoints.m_num;
+
+         if (!m_codec.start_decoding(m_pData + m_pHeader->m_alpha_endpoints.m_ofs, m_pHeader->m_alpha_endpoints.m_size))
+            return false;
+
+         static_huffman_data_model dm;
+         if (!m_codec.decode_receive_static_data_model(dm))
+            return false;
+
+         if (!m_alpha_endpoints.resize(num_alpha_endpoints))
+            return false;
+
+         uint16* CRND_RESTRICT pDst = &m_alpha_endpoints[0];
+         uint32 a = 0, b = 0;
+
+         CRND_HUFF_DECODE_BEGIN(m_codec);
+
+         for (uint32 i = 0; i < num_alpha_endpoints; i++)
+         {
+            uint sa; CRND_HUFF_DECODE(m_codec, dm, sa);
+            uint sb; CRND_HUFF_DECODE(m_codec, dm, sb);
+
+            a = (sa + a) & 255;
+            b = (sb + b) & 255;
+
+            *pDst++ = (uint16)(a | (b << 8));
+         }
+
+         CRND_HUFF_DECODE_END(m_codec);
+
+         m_codec.stop_decoding();
+
+         return true;
+      }
+
+#if CRND_SIMD
+      // Decodes a DXT1 (cBits = 2) or DXT5 (cBits = 3) selector palette with the 16 selectors of the current entry held in the bytes
+      // of a vector, so each entry's deltas are applied, mapped from linear to raw values and packed with a few vector operations.
+      // The low and high byte of pDelta_pairs[sym] are the deltas the symbol applies to its two selectors. The symbols following
+      // dm in m_codec's stream are decoded two at a time by a fast_symbol_codec, which would otherwise take most of the time.
+      template<uint32 cBits>
+      bool decode_selectors_simd(static_huffman_data_model& dm, const uint16* pDelta_pairs, const crn_palette& palette, void* pDst)
+      {
+         if (!dm.init_multi_symbol_lookup())
+            return false;
+
+         fast_symbol_codec codec;
+         if (!codec.start_decoding(m_pData + palette.m_ofs, palette.m_size, m_codec.get_bits_decoded()))
+            return false;
+
+         const uint32 num_selectors = palette.m_num;
+
+         const uint32 cMaxSelectorValue = (1U << cBits) - 1U;
+         const uint32 cPacked_half_mask = (1U << (cBits * 8U)) - 1U;
+
+         const crnd_vec max_value = CRND_VEC_SPLAT8(cMaxSelectorValue);
+         const crnd_vec one = CRND_VEC_SPLAT8(1);
+         const crnd_vec zero = CRND_VEC_SPLAT8(0);
+         crnd_vec cur = zero;
+
+         uint16 deltas[8];
+         uint8 packed[16];
+
+         CRND_HUFF_DECODE_BEGIN(codec);
+
+         for (uint32 i = 0; i < num_selectors; i++)
+         {
+            uint32 syms[8];
+            CRND_HUFF_DECODE_MULTI(codec, dm, syms, 8);
+            for (uint32 j = 0; j < 8; j++)
+               deltas[j] = pDelta_pairs[syms[j]];
+
+            cur = CRND_VEC_AND(CRND_VEC_ADD8(cur, CRND_VEC_LOAD(deltas)), max_value);
+
+            // g_dxt1_from_linear and g_dxt5_from_linear map x to x + 1, except for 0 which stays 0, and the largest value which becomes 1.
+            crnd_vec s = CRND_VEC_ADD8(cur, one);
+            const crnd_vec is_max = CRND_VEC_CMPEQ8(cur, max_value);
+            s = CRND_VEC_OR(CRND_VEC_ANDNOT(is_max, s), CRND_VEC_AND(is_max, one));
+            s = CRND_VEC_ANDNOT(CRND_VEC_CMPEQ8(cur, zero), s);
+
+            // Merge neighboring selectors, then 16 and 32-bit lanes, until each 64-bit half holds its 8 selectors in its low bits.
+            s = CRND_VEC_AND(CRND_VEC_OR(s, CRND_VEC_SRL16(s, 8 - cBits)), CRND_VEC_SPLAT16((1U << (cBits * 2U)) - 1U));
+            s = CRND_VEC_AND(CRND_VEC_OR(s, CRND_VEC_SRL32(s, 16 - cBits * 2)), CRND_VEC_SPLAT32((1U << (cBits * 4U)) - 1U));
+            s = CRND_VEC_OR(s, CRND_VEC_SRL64(s, 32 - cBits * 4));
+
+            CRND_VEC_STORE(packed, s);
+
+            uint32 lo, hi;
+            memcpy(&lo, packed, sizeof(lo));
+            memcpy(&hi, packed + 8, sizeof(hi));
+            const uint64 bits = (lo & cPacked_half_mask) | (static_cast<uint64>(hi & cPacked_half_mask) << (cBits * 8U));
+
+            if (cBits == 2)
+               static_cast<uint32*>(pDst)[i] = static_cast<uint32>(bits);
+            else
+            {
+               uint16* pDst_words = static_cast<uint16*>(pDst) + i * 3;
+               pDst_words[0] = static_cast<uint16>(bits);
+               pDst_words[1] = static_cast<uint16>(bits >> 16U);
+               pDst_words[2] = static_cast<uint16>(bits >> 32U);
+            }
+         }
+
+         CRND_HUFF_DECODE_END(codec);
+
+         return true;
+      }
+#endif
+
+      bool decode_alpha_selectors()
+      {
+         const uint32 cMaxSelectorValue = 7U;
+         const uint32 cMaxUniqueSelectorDeltas = cMaxSelectorValue * 2U + 1U;
+
+         const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
+
+         if (!m_codec.start_decoding(m_pData + m_pHeader->m_alpha_selectors.m_ofs, m_pHeader->m_alpha_selectors.m_size))
+            return false;
+
+         static_huffman_data_model dm;
+         if (!m_codec.decode_receive_static_data_model(dm))
+            return false;
+
+         int32 delta0[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
+         int32 delta1[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
+         int32 l = -(int32)cMaxSelectorValue, m = -(int32)cMaxSelectorValue;
+         for (uint32 i = 0; i < (cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas); i++)
+         {
+            delta0[i] = l;
+            delta1[i] = m;
+
+            if (++l > (int32)cMaxSelectorValue)
+            {
+               l = -(int32)cMaxSelectorValue;
+               m++;
+            }
+         }
+
+         uint32 cur[16];
+         utils::zero_object(cur);
+
+         if (!m_alpha_selectors.resize(num_alpha_selectors * 3))
+            return false;
+
+#if CRND_SIMD
+         if (c_crnd_little_endian_platform)
+         {
+            uint16 delta_pairs[cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas];
+            for (uint32 i = 0; i < (cMaxUniqueSelectorDeltas * cMaxUniqueSelectorDeltas); i++)
+               delta_pairs[i] = static_cast<uint16>((delta0[i] & cMaxSelectorValue) | ((delta1[i] & cMaxSelectorValue) << 8));
+
+            m_codec.stop_decoding();
+
+            return decode_selectors_simd<3>(dm, delta_pairs, m_pHeader->m_alpha_selectors, &m_alpha_selectors[0]);
+         }
+#endif
+
+         uint16* CRND_RESTRICT pDst = &m_alpha_selectors[0];
+
+         const uint8* pFrom_linear = g_dxt5_from_linear;
+
+         CRND_HUFF_DECODE_BEGIN(m_codec);
+
+         for (uint32 i = 0; i < num_alpha_selectors; i++)
+         {
+            for (uint32 j = 0; j < 8; j++)
+            {
+               int32 sym;
+               CRND_HUFF_DECODE(m_codec, dm, sym);
+
+               cur[j*2+0] = (delta0[sym] + cur[j*2+0]) & 7;
+               cur[j*2+1] = (delta1[sym] + cur[j*2+1]) & 7;
+               //cur[j*2+0] = ((sym%15)-7 + cur[j*2+0]) & 7;
+               //cur[j*2+1] = ((sym/15)-7 + cur[j*2+1]) & 7;
+            }
+
+#if 0
+            dxt5_block blk;
+            for (uint32 y = 0; y < 4; y++)
+               for (uint32 x = 0; x < 4; x++)
+                  blk.set_selector(x, y, pFrom_linear[cur[x+y*4]]);
+
+            *pDst++ = blk.get_selectors_as_word(0);
+            *pDst++ = blk.get_selectors_as_word(1);
+            *pDst++ = blk.get_selectors_as_word(2);
+#else
+            *pDst++ = (uint16)((pFrom_linear[cur[0 ]]      ) | (pFrom_linear[cur[1 ]] <<  3) | (pFrom_linear[cur[2 ]] <<  6) | (pFrom_linear[cur[3 ]] <<  9) |
+               (pFrom_linear[cur[4 ]] << 12) | (pFrom_linear[cur[5 ]] << 15));
+
+            *pDst++ = (uint16)((pFrom_linear[cur[5 ]] >> 1) | (pFrom_linear[cur[6 ]] << 2) | (pFrom_linear[cur[7 ]] << 5) |
+               (pFrom_linear[cur[8 ]] << 8) | (pFrom_linear[cur[9 ]] << 11) | (pFrom_linear[cur[10]] << 14));
+
+            *pDst++ = (uint16)((pFrom_linear[cur[10]] >> 2) | (pFrom_linear[cur[11]] << 1) | (pFrom_linear[cur[12]] << 4) |
+               (pFrom_linear[cur[13]] << 7) | (pFrom_linear[cur[14]] << 10) | (pFrom_linear[cur[15]] << 13));
+#endif
+         }
+
+         CRND_HUFF_DECODE_END(m_codec);
+
+         m_codec.stop_decoding();
+
+         return true;
+      }
+
+      static inline uint32 tiled_offset_2d_outer(uint32 y, uint32 AlignedWidth, uint32 LogBpp)
+      {
+         uint32 Macro        = ((y >> 5) * (AlignedWidth >> 5)) << (LogBpp + 7);
+         uint32 Micro        = ((y & 6) << 2) << LogBpp;
+
+         return Macro +
+            ((Micro & ~15) << 1) +
+            (Micro & 15) +
+            ((y & 8) << (3 + LogBpp)) + ((y & 1) << 4);
+      }
+
+      static inline uint32 tiled_offset_2d_inner(uint32 x, uint32 y, uint32 LogBpp, uint32 BaseOffset)
+      {
+         uint32 Macro = (x >> 5) << (LogBpp + 7);
+         uint32 Micro = (x & 7) << LogBpp;
+         uint32 Offset  = BaseOffset + Macro + ((Micro & ~15) << 1) + (Micro & 15);
+
+         return ((Offset & ~511) << 3) + ((Offset & 448) << 2) + (Offset & 63) +
+            ((y & 16) << 7) +
+            (((((y & 8) >> 2) + (x >> 3)) & 3) << 6);
+      }
+
+      static inline void limit(uint& x, uint n)
+      {
+         int v = x - n;
+         int msk = (v >> 31);
+         x = (x & msk) | (v & ~msk);
+      }
+
+      // ETC1 blocks are laid out like DXT1 blocks, an endpoint dword followed by a selector dword. The color palettes of ETC1
+      // textures already hold ETC1 block halves (see decode_color_endpoints() and decode_color_selectors()), so the chunks
+      // decode exactly like DXT1 chunks.
+      template<typename codec_type>
+      bool unpack_etc1(codec_type& codec, chunk_range& range, uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y) const
+      {
+         return unpack_dxt1(codec, range, pDst, dst_size_in_bytes, row_pitch_in_bytes, blocks_x, blocks_y, chunks_x, chunks_y);
+      }
+
+      template<typename codec_type>
+      bool unpack_dxt1(codec_type& codec, chunk_range& range, uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y) const
+      {
+         dst_size_in_bytes;
+
+         uint32 chunk_encoding_bits = range.m_chunk_encoding_bits;
+
+         const uint32 num_color_endpoints = m_color_endpoints.size();
+         const uint32 num_color_selectors = m_color_selectors.size();
+
+         uint32 prev_color_endpoint_index = range.m_endpoint_index[0];
+         uint32 prev_color_selector_index = range.m_selector_index[0];
+
+         const uint32 row_pitch_in_dwords = row_pitch_in_bytes >> 2U;
+
+         const int32 cBytesPerBlock = 8;
+
+         CRND_HUFF_DECODE_BEGIN(codec);
+
+#if CRND_CREATE_BYTE_STREAMS
+         vector<uint8> tile_encoding_stream;
+         vector<uint8> endpoint_indices_stream;
+         vector<uint8> selector_indices_stream;
+#endif
+
+         for (uint32 f = range.m_first_face; f < (range.m_first_face + range.m_num_faces); f++)
+         {
+            uint8* CRND_RESTRICT pRow = pDst[f];
+
+            for (uint32 y = range.m_first_row; y < (range.m_first_row + range.m_num_rows); y++)
+            {
+               int32 start_x = 0;
+               int32 end_x = chunks_x;
+               int32 dir_x = 1;
+               int32 block_delta = cBytesPerBlock*2;
+               uint8* CRND_RESTRICT pBlock = pRow;
+
+               if (y & 1)
+               {
+                  start_x = chunks_x - 1;
+                  end_x = -1;
+                  dir_x = -1;
+                  block_delta = -cBytesPerBlock*2;
+                  pBlock += (chunks_x - 1) * cBytesPerBlock * 2;
+               }
+
+               const bool skip_bottom_row = (y == (chunks_y - 1)) && (blocks_y & 1);
+
+               for (int32 x = start_x; x != end_x; x += dir_x)
+               {
+                  uint32 color_endpoints[4];
+
+                  if (chunk_encoding_bits == 1)
+                  {
+                     CRND_HUFF_DECODE(codec, m_chunk_encoding_dm, chunk_encoding_bits);
+#if CRND_CREATE_BYTE_STREAMS
+                     tile_encoding_stream.push_back(chunk_encoding_bits & 7);
+                     tile_encoding_stream.push_back((chunk_encoding_bits >> 3) & 7);
+                     tile_encoding_stream.push_back((chunk_encoding_bits >> 6) & 7);
+#endif
+                     chunk_encoding_bits |= 512;
+                  }
+
+                  const uint32 chunk_encoding_index = chunk_encoding_bits & 7;
+                  chunk_encoding_bits >>= 3;
+
+                  const uint32 num_tiles = g_crnd_chunk_encoding_num_tiles[chunk_encoding_index];
+
+                  uint32 endpoint_deltas[4];
+                  CRND_HUFF_DECODE_MULTI(codec, m_endpoint_delta_dm[0], endpoint_deltas, num_tiles);
+
+                  for (uint32 i = 0; i < num_tiles; i++)
+                  {
+                     const uint32 delta = endpoint_deltas[i];
+#if CRND_CREATE_BYTE_STREAMS
+                     endpoint_indices_stream.push_back(delta);
+#endif
+                     prev_color_endpoint_index += delta;
+                     limit(prev_color_endpoint_index, num_color_endpoints);
+                     color_endpoints[i] = m_color_endpoints[prev_color_endpoint_index];
+                  }
+
+                  const uint8* pTile_indices = g_crnd_chunk_encoding_tiles[chunk_encoding_index].m_tiles;
+
+                  const bool skip_right_col = (blocks_x & 1) && (x == ((int32)chunks_x - 1));
+
+                  uint32* CRND_RESTRICT pD = (uint32*)pBlock;
+
+                  uint32 selector_deltas[4];
+                  CRND_HUFF_DECODE_MULTI(codec, m_selector_delta_dm[0], selector_deltas, 4);
+
+                  if ((!skip_bottom_row) && (!skip_right_col))
+                  {
+                     //CRND_ASSERT( ((uint8*)&pD[4 + row_pitch_in_dwords] - pDst) <= dst_size_in_bytes );
+
+                     pD[0] = color_endpoints[pTile_indices[0]];
+                     CRND_WRITE_BARRIER
+                     const uint32 delta0 = selector_deltas[0];
+#if CRND_CREATE_BYTE_STREAMS
+                     selector_indices_stream.push_back(delta0);
+#endif
+                     prev_color_selector_index += delta0;
+                     limit(prev_color_selector_index, num_color_selectors);
+                     pD[1] = m_color_selectors[prev_color_selector_index];
+                     CRND_WRITE_BARRIER
+
+                     pD[2] = color_endpoints[pTile_indices[1]];
+                     CRND_WRITE_BARRIER
+                     const uint32 delta1 = selector_deltas[1];
+#if CRND_CREATE_BYTE_STREAMS
+                     selector_indices_stream.push_back(delta1);
+#endif
+                     prev_color_selector_index += delta1;
+                     limit(prev_color_selector_index, num_color_selectors);
+                     pD[3] = m_color_selectors[prev_color_selector_index];
+                     CRND_WRITE_BARRIER
+
+                     pD[0 + row_pitch_in_dwords] = color_endpoints[pTile_indices[2]];
+                     CRND_WRITE_BARRIER
+                     const uint32 delta2 = selector_deltas[2];
+#if CRND_CREATE_BYTE_STREAMS
+                     selector_indices_stream.push_back(delta2);
+#endif
+                     prev_color_selector_index += delta2;
+                     limit(prev_color_selector_index, num_color_selectors);
+                     pD[1 + row_pitch_in_dwords] = m_color_selectors[prev_color_selector_index];
+                     CRND_WRITE_BARRIER
+
+                     pD[2 + row_pitch_in_dwords] = color_endpoints[pTile_indices[3]];
+                     CRND_WRITE_BARRIER
+                     const uint32 delta3 = selector_deltas[3];
+#if CRND_CREATE_BYTE_STREAMS
+                     selector_indices_stream.push_back(delta3);
+#endif
+                     prev_color_selector_index += delta3;
+                     limit(prev_color_selector_index, num_color_selectors);
+                     pD[3 + row_pitch_in_dwords] = m_color_selectors[prev_color_selector_index];
+                     CRND_WRITE_BARRIER
+                  }
+                  else
+                  {
+                     for (uint32 by = 0; by < 2; by++)
+                     {
+                        pD = (uint32*)((uint8*)pBlock + row_pitch_in_bytes * by);
+                        for (uint32 bx = 0; bx < 2; bx++, pD += 2)
+                        {
+                           const uint32 delta = selector_deltas[bx + by * 2];
+#if CRND_CREATE_BYTE_STREAMS
+                           selector_indices_stream.push_back(delta);
+#endif
+                           prev_color_selector_index += delta;
+                           limit(prev_color_selector_index, num_color_selectors);
+
+                           if (!((bx && skip_right_col) || (by && skip_bottom_row)))
+                           {
+                              pD[0] = color_endpoints[pTile_indices[bx + by * 2]];
+                              CRND_WRITE_BARRIER
+                              pD[1] = m_color_selectors[prev_color_selector_index];
+                              CRND_WRITE_BARRIER
+                           }
+                        }
+                     }
+                  }
+
+                  pBlock += block_delta;
+
+               } // x
+
+               pRow += row_pitch_in_bytes * 2;
+
+            } // y
+
+         } // f
+
+         CRND_HUFF_DECODE_END(codec);
+
+         // Leave the decoder state in range, so the following rows can be unpacked by another call.
+         range.m_chunk_encoding_bits = chunk_encoding_bits;
+         range.m_endpoint_index[0] = prev_color_endpoint_index;
+         range.m_selector_index[0] = prev_color_selector_index;
+
+#if CRND_CREATE_BYTE_STREAMS
+         write_array_to_file(L"tile_encodings.bin", tile_encoding_stream);
+         write_array_to_file(L"endpoint_indices.bin", endpoint_indices_stream);
+         write_array_to_file(L"selector_indices.bin", selector_indices_stream);
+#endif
+
+         return true;
+      }
+
+      template<typename codec_type>
+      bool unpack_dxt5(codec_type& codec, chunk_range& range, uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y) const
+      {
+         dst_size_in_bytes;
+
+         uint32 chunk_encoding_bits = range.m_chunk_encoding_bits;
+
+         const uint32 num_color_endpoints = m_color_endpoints.size();
+         const uint32 num_color_selectors = m_color_selectors.size();
+         const uint32 num_alpha_endpoints = m_alpha_endpoints.size();
+         const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
+
+         uint32 prev_color_endpoint_index = range.m_endpoint_index[0];
+         uint32 prev_color_selector_index = range.m_selector_index[0];
+         uint32 prev_alpha_endpoint_index = range.m_endpoint_index[1];
+         uint32 prev_alpha_selector_index = range.m_selector_index[1];
+
+         //const uint32 row_pitch_in_dwords = row_pitch_in_bytes >> 2U;
+
+         const int32 cBytesPerBlock = 16;
+
+         CRND_HUFF_DECODE_BEGIN(codec);
+
+         for (uint32 f = range.m_first_face; f < (range.m_first_face + range.m_num_faces); f++)
+         {
+            uint8* CRND_RESTRICT pRow = pDst[f];
+
+            for (uint32 y = range.m_first_row; y < (range.m_first_row + range.m_num_rows); y++)
+            {
+               int32 start_x = 0;
+               int32 end_x = chunks_x;
+               int32 dir_x = 1;
+               int32 block_delta = cBytesPerBlock*2;
+               uint8* CRND_RESTRICT pBlock = pRow;
+
+               if (y & 1)
+               {
+                  start_x = chunks_x - 1;
+                  end_x = -1;
+                  dir_x = -1;
+                  block_delta = -cBytesPerBlock*2;
+                  pBlock += (chunks_x - 1) * cBytesPerBlock * 2;
+               }
+
+               const bool skip_bottom_row = (y == (chunks_y - 1)) && (blocks_y & 1);
+
+               for (int32 x = start_x; x != end_x; x += dir_x)
+               {
+                  uint32 color_endpoints[4];
+                  uint32 alpha_endpoints[4];
+
+                  if (chunk_encoding_bits == 1)
+                  {
+                     CRND_HUFF_DECODE(codec, m_chunk_encoding_dm, chunk_encoding_bits);
+                     chunk_encoding_bits |= 512;
+                  }
+
+                  const uint32 chunk_encoding_index = chunk_encoding_bits & 7;
+                  chunk_encoding_bits >>= 3;
 
-            if (++l > (int32)cMaxSelectorValue)
-            {
-               l = -(int32)cMaxSelectorValue;
-               m++;
-            }
-         }
+                  const uint32 num_tiles = g_crnd_chunk_encoding_num_tiles[chunk_encoding_index];
 
-         uint32 cur[16];
-         utils::zero_object(cur);
+                  const uint8* pTile_indices = g_crnd_chunk_encoding_tiles[chunk_encoding_index].m_tiles;
 
-         if (!m_alpha_selectors.resize(num_alpha_selectors * 3))
-            return false;
+                  const bool skip_right_col = (blocks_x & 1) && (x == ((int32)chunks_x - 1));
 
-         uint16* CRND_RESTRICT pDst = &m_alpha_selectors[0];
+                  uint32* CRND_RESTRICT pD = (uint32*)pBlock;
 
-         const uint8* pFrom_linear = g_dxt5_from_linear;
+                  uint32 endpoint_deltas[4];
+                  CRND_HUFF_DECODE_MULTI(codec, m_endpoint_delta_dm[1], endpoint_deltas, num_tiles);
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+                  for (uint32 i = 0; i < num_tiles; i++)
+                  {
+                     const uint32 delta = endpoint_deltas[i];
+                     prev_alpha_endpoint_index += delta;
+                     limit(prev_alpha_endpoint_index, num_alpha_endpoints);
+                     alpha_endpoints[i] = m_alpha_endpoints[prev_alpha_endpoint_index];
+                  }
 
-         for (uint32 i = 0; i < num_alpha_selectors; i++)
-         {
-            for (uint32 j = 0; j < 8; j++)
-            {
-               int32 sym;
-               CRND_HUFF_DECODE(m_codec, dm, sym);
+                  CRND_HUFF_DECODE_MULTI(codec, m_endpoint_delta_dm[0], endpoint_deltas, num_tiles);
 
-               cur[j*2+0] = (delta0[sym] + cur[j*2+0]) & 7;
-               cur[j*2+1] = (delta1[sym] + cur[j*2+1]) & 7;
-               //cur[j*2+0] = ((sym%15)-7 + cur[j*2+0]) & 7;
-               //cur[j*2+1] = ((sym/15)-7 + cur[j*2+1]) & 7;
-            }
+                  for (uint32 i = 0; i < num_tiles; i++)
+                  {
+                     const uint32 delta = endpoint_deltas[i];
+                     prev_color_endpoint_index += delta;
+                     limit(prev_color_endpoint_index, num_color_endpoints);
+                     color_endpoints[i] = m_color_endpoints[prev_color_endpoint_index];
+                  }
 
-#if 0
-            dxt5_block blk;
-            for (uint32 y = 0; y < 4; y++)
-               for (uint32 x = 0; x < 4; x++)
-                  blk.set_selector(x, y, pFrom_linear[cur[x+y*4]]);
+                  pD = (uint32*)pBlock;
+                  for (uint32 by = 0; by < 2; by++)
+                  {
+                     for (uint32 bx = 0; bx < 2; bx++, pD += 4)
+                     {
+                        uint32 delta0; CRND_HUFF_DECODE(codec, m_selector_delta_dm[1], delta0);
+                        prev_alpha_selector_index += delta0;
+                        limit(prev_alpha_selector_index, num_alpha_selectors);
 
-            *pDst++ = blk.get_selectors_as_word(0);
-            *pDst++ = blk.get_selectors_as_word(1);
-            *pDst++ = blk.get_selectors_as_word(2);
-#else
-            *pDst++ = (uint16)((pFrom_linear[cur[0 ]]      ) | (pFrom_linear[cur[1 ]] <<  3) | (pFrom_linear[cur[2 ]] <<  6) | (pFrom_linear[cur[3 ]] <<  9) |
-               (pFrom_linear[cur[4 ]] << 12) | (pFrom_linear[cur[5 ]] << 15));
+                        uint32 delta1; CRND_HUFF_DECODE(codec, m_selector_delta_dm[0], delta1);
+                        prev_color_selector_index += delta1;
+                        limit(prev_color_selector_index, num_color_selectors);
 
-            *pDst++ = (uint16)((pFrom_linear[cur[5 ]] >> 1) | (pFrom_linear[cur[6 ]] << 2) | (pFrom_linear[cur[7 ]] << 5) |
-               (pFrom_linear[cur[8 ]] << 8) | (pFrom_linear[cur[9 ]] << 11) | (pFrom_linear[cur[10]] << 14));
+                        if (!((bx && skip_right_col) || (by && skip_bottom_row)))
+                        {
+                           const uint32 tile_index = pTile_indices[bx + by * 2];
+                           const uint16* pAlpha_selectors = &m_alpha_selectors[prev_alpha_selector_index * 3];
 
-            *pDst++ = (uint16)((pFrom_linear[cur[10]] >> 2) | (pFrom_linear[cur[11]] << 1) | (pFrom_linear[cur[12]] << 4) |
-               (pFrom_linear[cur[13]] << 7) | (pFrom_linear[cur[14]] << 10) | (pFrom_linear[cur[15]] << 13));
+#ifdef CRND_BIG_ENDIAN_PLATFORM
+                           pD[0] = (alpha_endpoints[tile_index] << 16) | pAlpha_selectors[0];
+                           CRND_WRITE_BARRIER
+                           pD[1] = (pAlpha_selectors[1] << 16) | pAlpha_selectors[2];
+                           CRND_WRITE_BARRIER
+                           pD[2] = color_endpoints[tile_index];
+                           CRND_WRITE_BARRIER
+                           pD[3] = m_color_selectors[prev_color_selector_index];
+                           CRND_WRITE_BARRIER
+#else
+                           pD[0] = alpha_endpoints[tile_index] | (pAlpha_selectors[0] << 16);
+                           CRND_WRITE_BARRIER
+                           pD[1] = pAlpha_selectors[1] | (pAlpha_selectors[2] << 16);
+                           CRND_WRITE_BARRIER
+                           pD[2] = color_endpoints[tile_index];
+                           CRND_WRITE_BARRIER
+                           pD[3] = m_color_selectors[prev_color_selector_index];
+                           CRND_WRITE_BARRIER
 #endif
-         }
+                        }
+                     }
 
-         CRND_HUFF_DECODE_END(m_codec);
+                     pD = (uint32*)((uint8*)pD - cBytesPerBlock * 2 + row_pitch_in_bytes);
+                  }
 
-         m_codec.stop_decoding();
+                  pBlock += block_delta;
 
-         return true;
-      }
+               } // x
 
-      static inline uint32 tiled_offset_2d_outer(uint32 y, uint32 AlignedWidth, uint32 LogBpp)
-      {
-         uint32 Macro        = ((y >> 5) * (AlignedWidth >> 5)) << (LogBpp + 7);
-         uint32 Micro        = ((y & 6) << 2) << LogBpp;
+               pRow += row_pitch_in_bytes * 2;
 
-         return Macro +
-            ((Micro & ~15) << 1) +
-            (Micro & 15) +
-            ((y & 8) << (3 + LogBpp)) + ((y & 1) << 4);
-      }
+            } // y
 
-      static inline uint32 tiled_offset_2d_inner(uint32 x, uint32 y, uint32 LogBpp, uint32 BaseOffset)
-      {
-         uint32 Macro = (x >> 5) << (LogBpp + 7);
-         uint32 Micro = (x & 7) << LogBpp;
-         uint32 Offset  = BaseOffset + Macro + ((Micro & ~15) << 1) + (Micro & 15);
+         } // f
 
-         return ((Offset & ~511) << 3) + ((Offset & 448) << 2) + (Offset & 63) +
-            ((y & 16) << 7) +
-            (((((y & 8) >> 2) + (x >> 3)) & 3) << 6);
-      }
+         CRND_HUFF_DECODE_END(codec);
 
-      static inline void limit(uint& x, uint n)
-      {
-         int v = x - n;
-         int msk = (v >> 31);
-         x = (x & msk) | (v & ~msk);
+         // Leave the decoder state in range, so the following rows can be unpacked by another call.
+         range.m_chunk_encoding_bits = chunk_encoding_bits;
+         range.m_endpoint_index[0] = prev_color_endpoint_index;
+         range.m_selector_index[0] = prev_color_selector_index;
+         range.m_endpoint_index[1] = prev_alpha_endpoint_index;
+         range.m_selector_index[1] = prev_alpha_selector_index;
+
+         return true;
       }
 
-      bool unpack_dxt1(uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y)
+      template<typename codec_type>
+      bool unpack_dxn(codec_type& codec, chunk_range& range, uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y) const
       {
          dst_size_in_bytes;
 
-         uint32 chunk_encoding_bits = 1;
+         uint32 chunk_encoding_bits = range.m_chunk_encoding_bits;
 
-         const uint32 num_color_endpoints = m_color_endpoints.size();
-         const uint32 num_color_selectors = m_color_selectors.size();
-
-         uint32 prev_color_endpoint_index = 0;
-         uint32 prev_color_selector_index = 0;
-
-         const uint32 num_faces = m_pHeader->m_faces;
+         const uint32 num_alpha_endpoints = m_alpha_endpoints.size();
+         const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
 
-         const uint32 row_pitch_in_dwords = row_pitch_in_bytes >> 2U;
+         uint32 prev_alpha0_endpoint_index = range.m_endpoint_index[1];
+         uint32 prev_alpha0_selector_index = range.m_selector_index[1];
+         uint32 prev_alpha1_endpoint_index = range.m_endpoint_index[2];
+         uint32 prev_alpha1_selector_index = range.m_selector_index[2];
 
-         const int32 cBytesPerBlock = 8;
+         //const uint32 row_pitch_in_dwords = row_pitch_in_bytes >> 2U;
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+         const int32 cBytesPerBlock = 16;
 
-#if CRND_CREATE_BYTE_STREAMS
-         vector<uint8> tile_encoding_stream;
-         vector<uint8> endpoint_indices_stream;
-         vector<uint8> selector_indices_stream;
-#endif
+         CRND_HUFF_DECODE_BEGIN(codec);
 
-         for (uint32 f = 0; f < num_faces; f++)
+         for (uint32 f = range.m_first_face; f < (range.m_first_face + range.m_num_faces); f++)
          {
             uint8* CRND_RESTRICT pRow = pDst[f];
 
-            for (uint32 y = 0; y < chunks_y; y++)
+            for (uint32 y = range.m_first_row; y < (range.m_first_row + range.m_num_rows); y++)
             {
                int32 start_x = 0;
                int32 end_x = chunks_x;
@@ -4185,16 +6423,12 @@ namespace crnd
 
                for (int32 x = start_x; x != end_x; x += dir_x)
                {
-                  uint32 color_endpoints[4];
+                  uint32 alpha0_endpoints[4];
+                  uint32 alpha1_endpoints[4];
 
                   if (chunk_encoding_bits == 1)
                   {
-                     CRND_HUFF_DECODE(m_codec, m_chunk_encoding_dm, chunk_encoding_bits);
-#if CRND_CREATE_BYTE_STREAMS
-                     tile_encoding_stream.push_back(chunk_encoding_bits & 7);
-                     tile_encoding_stream.push_back((chunk_encoding_bits >> 3) & 7);
-                     tile_encoding_stream.push_back((chunk_encoding_bits >> 6) & 7);
-#endif
+                     CRND_HUFF_DECODE(codec, m_chunk_encoding_dm, chunk_encoding_bits);
                      chunk_encoding_bits |= 512;
                   }
 
@@ -4203,100 +6437,77 @@ namespace crnd
 
                   const uint32 num_tiles = g_crnd_chunk_encoding_num_tiles[chunk_encoding_index];
 
-                  for (uint32 i = 0; i < num_tiles; i++)
-                  {
-                     uint32 delta;
-                     CRND_HUFF_DECODE(m_codec, m_endpoint_delta_dm[0], delta);
-#if CRND_CREATE_BYTE_STREAMS
-                     endpoint_indices_stream.push_back(delta);
-#endif
-                     prev_color_endpoint_index += delta;
-                     limit(prev_color_endpoint_index, num_color_endpoints);
-                     color_endpoints[i] = m_color_endpoints[prev_color_endpoint_index];
-                  }
-
                   const uint8* pTile_indices = g_crnd_chunk_encoding_tiles[chunk_encoding_index].m_tiles;
 
                   const bool skip_right_col = (blocks_x & 1) && (x == ((int32)chunks_x - 1));
 
                   uint32* CRND_RESTRICT pD = (uint32*)pBlock;
 
-                  if ((!skip_bottom_row) && (!skip_right_col))
-                  {
-                     //CRND_ASSERT( ((uint8*)&pD[4 + row_pitch_in_dwords] - pDst) <= dst_size_in_bytes );
+                  // Both channels' endpoint deltas, then both channels' selector deltas, come from the same models.
+                  uint32 endpoint_deltas[8];
+                  CRND_HUFF_DECODE_MULTI(codec, m_endpoint_delta_dm[1], endpoint_deltas, num_tiles * 2);
 
-                     pD[0] = color_endpoints[pTile_indices[0]];
-                     CRND_WRITE_BARRIER
-                     uint32 delta0;
-                     CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[0], delta0);
-#if CRND_CREATE_BYTE_STREAMS
-                     selector_indices_stream.push_back(delta0);
-#endif
-                     prev_color_selector_index += delta0;
-                     limit(prev_color_selector_index, num_color_selectors);
-                     pD[1] = m_color_selectors[prev_color_selector_index];
-                     CRND_WRITE_BARRIER
+                  for (uint32 i = 0; i < num_tiles; i++)
+                  {
+                     const uint32 delta = endpoint_deltas[i];
+                     prev_alpha0_endpoint_index += delta;
+                     limit(prev_alpha0_endpoint_index, num_alpha_endpoints);
+                     alpha0_endpoints[i] = m_alpha_endpoints[prev_alpha0_endpoint_index];
+                  }
 
-                     pD[2] = color_endpoints[pTile_indices[1]];
-                     CRND_WRITE_BARRIER
-                     uint32 delta1;
-                     CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[0], delta1);
-#if CRND_CREATE_BYTE_STREAMS
-                     selector_indices_stream.push_back(delta1);
-#endif
-                     prev_color_selector_index += delta1;
-                     limit(prev_color_selector_index, num_color_selectors);
-                     pD[3] = m_color_selectors[prev_color_selector_index];
-                     CRND_WRITE_BARRIER
+                  for (uint32 i = 0; i < num_tiles; i++)
+                  {
+                     const uint32 delta = endpoint_deltas[num_tiles + i];
+                     prev_alpha1_endpoint_index += delta;
+                     limit(prev_alpha1_endpoint_index, num_alpha_endpoints);
+                     alpha1_endpoints[i] = m_alpha_endpoints[prev_alpha1_endpoint_index];
+                  }
 
-                     pD[0 + row_pitch_in_dwords] = color_endpoints[pTile_indices[2]];
-                     CRND_WRITE_BARRIER
-                     uint32 delta2;
-                     CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[0], delta2);
-#if CRND_CREATE_BYTE_STREAMS
-                     selector_indices_stream.push_back(delta2);
-#endif
-                     prev_color_selector_index += delta2;
-                     limit(prev_color_selector_index, num_color_selectors);
-                     pD[1 + row_pitch_in_dwords] = m_color_selectors[prev_color_selector_index];
-                     CRND_WRITE_BARRIER
+                  uint32 selector_deltas[8];
+                  CRND_HUFF_DECODE_MULTI(codec, m_selector_delta_dm[1], selector_deltas, 8);
 
-                     pD[2 + row_pitch_in_dwords] = color_endpoints[pTile_indices[3]];
-                     CRND_WRITE_BARRIER
-                     uint32 delta3;
-                     CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[0], delta3);
-#if CRND_CREATE_BYTE_STREAMS
-                     selector_indices_stream.push_back(delta3);
-#endif
-                     prev_color_selector_index += delta3;
-                     limit(prev_color_selector_index, num_color_selectors);
-                     pD[3 + row_pitch_in_dwords] = m_color_selectors[prev_color_selector_index];
-                     CRND_WRITE_BARRIER
-                  }
-                  else
+                  pD = (uint32*)pBlock;
+                  for (uint32 by = 0; by < 2; by++)
                   {
-                     for (uint32 by = 0; by < 2; by++)
+                     for (uint32 bx = 0; bx < 2; bx++, pD += 4)
                      {
-                        pD = (uint32*)((uint8*)pBlock + row_pitch_in_bytes * by);
-                        for (uint32 bx = 0; bx < 2; bx++, pD += 2)
+                        const uint32 delta0 = selector_deltas[(bx + by * 2) * 2];
+                        prev_alpha0_selector_index += delta0;
+                        limit(prev_alpha0_selector_index, num_alpha_selectors);
+
+                        const uint32 delta1 = selector_deltas[(bx + by * 2) * 2 + 1];
+                        prev_alpha1_selector_index += delta1;
+                        limit(prev_alpha1_selector_index, num_alpha_selectors);
+
+                        if (!((bx && skip_right_col) || (by && skip_bottom_row)))
                         {
-                           uint32 delta;
-                           CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[0], delta);
-#if CRND_CREATE_BYTE_STREAMS
-                           selector_indices_stream.push_back(delta);
+                           const uint32 tile_index = pTile_indices[bx + by * 2];
+                           const uint16* pAlpha0_selectors = &m_alpha_selectors[prev_alpha0_selector_index * 3];
+                           const uint16* pAlpha1_selectors = &m_alpha_selectors[prev_alpha1_selector_index * 3];
+
+#ifdef CRND_BIG_ENDIAN_PLATFORM
+                           pD[0] = (alpha0_endpoints[tile_index] << 16) | pAlpha0_selectors[0];
+                           CRND_WRITE_BARRIER
+                           pD[1] = (pAlpha0_selectors[1] << 16) | pAlpha0_selectors[2];
+                           CRND_WRITE_BARRIER
+                           pD[2] = (alpha1_endpoints[tile_index] << 16) | pAlpha1_selectors[0];
+                           CRND_WRITE_BARRIER
+                           pD[3] = (pAlpha1_selectors[1] << 16) | pAlpha1_selectors[2];
+                           CRND_WRITE_BARRIER
+#else
+                           pD[0] = alpha0_endpoints[tile_index] | (pAlpha0_selectors[0] << 16);
+                           CRND_WRITE_BARRIER
+                           pD[1] = pAlpha0_selectors[1] | (pAlpha0_selectors[2] << 16);
+                           CRND_WRITE_BARRIER
+                           pD[2] = alpha1_endpoints[tile_index] | (pAlpha1_selectors[0] << 16);
+                           CRND_WRITE_BARRIER
+                           pD[3] = pAlpha1_selectors[1] | (pAlpha1_selectors[2] << 16);
+                           CRND_WRITE_BARRIER
 #endif
-                           prev_color_selector_index += delta;
-                           limit(prev_color_selector_index, num_color_selectors);
-
-                           if (!((bx && skip_right_col) || (by && skip_bottom_row)))
-                           {
-                              pD[0] = color_endpoints[pTile_indices[bx + by * 2]];
-                              CRND_WRITE_BARRIER
-                              pD[1] = m_color_selectors[prev_color_selector_index];
-                              CRND_WRITE_BARRIER
-                           }
                         }
                      }
+
+                     pD = (uint32*)((uint8*)pD - cBytesPerBlock * 2 + row_pitch_in_bytes);
                   }
 
                   pBlock += block_delta;
@@ -4309,46 +6520,40 @@ namespace crnd
 
          } // f
 
-         CRND_HUFF_DECODE_END(m_codec);
+         CRND_HUFF_DECODE_END(codec);
 
-#if CRND_CREATE_BYTE_STREAMS
-         write_array_to_file(L"tile_encodings.bin", tile_encoding_stream);
-         write_array_to_file(L"endpoint_indices.bin", endpoint_indices_stream);
-         write_array_to_file(L"selector_indices.bin", selector_indices_stream);
-#endif
+         // Leave the decoder state in range, so the following rows can be unpacked by another call.
+         range.m_chunk_encoding_bits = chunk_encoding_bits;
+         range.m_endpoint_index[1] = prev_alpha0_endpoint_index;
+         range.m_selector_index[1] = prev_alpha0_selector_index;
+         range.m_endpoint_index[2] = prev_alpha1_endpoint_index;
+         range.m_selector_index[2] = prev_alpha1_selector_index;
 
          return true;
       }
 
-      bool unpack_dxt5(uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y)
+      template<typename codec_type>
+      bool unpack_dxt5a(codec_type& codec, chunk_range& range, uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y) const
       {
          dst_size_in_bytes;
 
-         uint32 chunk_encoding_bits = 1;
+         uint32 chunk_encoding_bits = range.m_chunk_encoding_bits;
 
-         const uint32 num_color_endpoints = m_color_endpoints.size();
-         const uint32 num_color_selectors = m_color_selectors.size();
          const uint32 num_alpha_endpoints = m_alpha_endpoints.size();
          const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
 
-         uint32 prev_color_endpoint_index = 0;
-         uint32 prev_color_selector_index = 0;
-         uint32 prev_alpha_endpoint_index = 0;
-         uint32 prev_alpha_selector_index = 0;
+         uint32 prev_alpha0_endpoint_index = range.m_endpoint_index[1];
+         uint32 prev_alpha0_selector_index = range.m_selector_index[1];
 
-         const uint32 num_faces = m_pHeader->m_faces;
-
-         //const uint32 row_pitch_in_dwords = row_pitch_in_bytes >> 2U;
-
-         const int32 cBytesPerBlock = 16;
+         const int32 cBytesPerBlock = 8;
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+         CRND_HUFF_DECODE_BEGIN(codec);
 
-         for (uint32 f = 0; f < num_faces; f++)
+         for (uint32 f = range.m_first_face; f < (range.m_first_face + range.m_num_faces); f++)
          {
             uint8* CRND_RESTRICT pRow = pDst[f];
 
-            for (uint32 y = 0; y < chunks_y; y++)
+            for (uint32 y = range.m_first_row; y < (range.m_first_row + range.m_num_rows); y++)
             {
                int32 start_x = 0;
                int32 end_x = chunks_x;
@@ -4369,12 +6574,11 @@ namespace crnd
 
                for (int32 x = start_x; x != end_x; x += dir_x)
                {
-                  uint32 color_endpoints[4];
-                  uint32 alpha_endpoints[4];
+                  uint32 alpha0_endpoints[4];
 
                   if (chunk_encoding_bits == 1)
                   {
-                     CRND_HUFF_DECODE(m_codec, m_chunk_encoding_dm, chunk_encoding_bits);
+                     CRND_HUFF_DECODE(codec, m_chunk_encoding_dm, chunk_encoding_bits);
                      chunk_encoding_bits |= 512;
                   }
 
@@ -4389,57 +6593,43 @@ namespace crnd
 
                   uint32* CRND_RESTRICT pD = (uint32*)pBlock;
 
-                  for (uint32 i = 0; i < num_tiles; i++)
-                  {
-                     uint32 delta; CRND_HUFF_DECODE(m_codec, m_endpoint_delta_dm[1], delta);
-                     prev_alpha_endpoint_index += delta;
-                     limit(prev_alpha_endpoint_index, num_alpha_endpoints);
-                     alpha_endpoints[i] = m_alpha_endpoints[prev_alpha_endpoint_index];
-                  }
+                  uint32 endpoint_deltas[4];
+                  CRND_HUFF_DECODE_MULTI(codec, m_endpoint_delta_dm[1], endpoint_deltas, num_tiles);
 
                   for (uint32 i = 0; i < num_tiles; i++)
                   {
-                     uint32 delta; CRND_HUFF_DECODE(m_codec, m_endpoint_delta_dm[0], delta);
-                     prev_color_endpoint_index += delta;
-                     limit(prev_color_endpoint_index, num_color_endpoints);
-                     color_endpoints[i] = m_color_endpoints[prev_color_endpoint_index];
+                     const uint32 delta = endpoint_deltas[i];
+                     prev_alpha0_endpoint_index += delta;
+                     limit(prev_alpha0_endpoint_index, num_alpha_endpoints);
+                     alpha0_endpoints[i] = m_alpha_endpoints[prev_alpha0_endpoint_index];
                   }
 
+                  uint32 selector_deltas[4];
+                  CRND_HUFF_DECODE_MULTI(codec, m_selector_delta_dm[1], selector_deltas, 4);
+
                   pD = (uint32*)pBlock;
                   for (uint32 by = 0; by < 2; by++)
                   {
-                     for (uint32 bx = 0; bx < 2; bx++, pD += 4)
+                     for (uint32 bx = 0; bx < 2; bx++, pD += 2)
                      {
-                        uint32 delta0; CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[1], delta0);
-                        prev_alpha_selector_index += delta0;
-                        limit(prev_alpha_selector_index, num_alpha_selectors);
-
-                        uint32 delta1; CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[0], delta1);
-                        prev_color_selector_index += delta1;
-                        limit(prev_color_selector_index, num_color_selectors);
+                        const uint32 delta = selector_deltas[bx + by * 2];
+                        prev_alpha0_selector_index += delta;
+                        limit(prev_alpha0_selector_index, num_alpha_selectors);
 
                         if (!((bx && skip_right_col) || (by && skip_bottom_row)))
                         {
                            const uint32 tile_index = pTile_indices[bx + by * 2];
-                           const uint16* pAlpha_selectors = &m_alpha_selectors[prev_alpha_selector_index * 3];
+                           const uint16* pAlpha0_selectors = &m_alpha_selectors[prev_alpha0_selector_index * 3];
 
-#ifdef CRND_BIG_ENDIAN_PLATFORM
-                           pD[0] = (alpha_endpoints[tile_index] << 16) | pAlpha_selectors[0];
-                           CRND_WRITE_BARRIER
-                           pD[1] = (pAlpha_selectors[1] << 16) | pAlpha_selectors[2];
-                           CRND_WRITE_BARRIER
-                           pD[2] = color_endpoints[tile_index];
+#if CRND_BIG_ENDIAN_PLATFORM
+                           pD[0] = (alpha0_endpoints[tile_index] << 16) | pAlpha0_selectors[0];
                            CRND_WRITE_BARRIER
-                           pD[3] = m_color_selectors[prev_color_selector_index];
+                           pD[1] = (pAlpha0_selectors[1] << 16) | pAlpha0_selectors[2];
                            CRND_WRITE_BARRIER
 #else
-                           pD[0] = alpha_endpoints[tile_index] | (pAlpha_selectors[0] << 16);
-                           CRND_WRITE_BARRIER
-                           pD[1] = pAlpha_selectors[1] | (pAlpha_selectors[2] << 16);
-                           CRND_WRITE_BARRIER
-                           pD[2] = color_endpoints[tile_index];
+                           pD[0] = alpha0_endpoints[tile_index] | (pAlpha0_selectors[0] << 16);
                            CRND_WRITE_BARRIER
-                           pD[3] = m_color_selectors[prev_color_selector_index];
+                           pD[1] = pAlpha0_selectors[1] | (pAlpha0_selectors[2] << 16);
                            CRND_WRITE_BARRIER
 #endif
                         }
@@ -4458,338 +6648,515 @@ namespace crnd
 
          } // f
 
-         CRND_HUFF_DECODE_END(m_codec);
+         CRND_HUFF_DECODE_END(codec);
+
+         // Leave the decoder state in range, so the following rows can be unpacked by another call.
+         range.m_chunk_encoding_bits = chunk_encoding_bits;
+         range.m_endpoint_index[1] = prev_alpha0_endpoint_index;
+         range.m_selector_index[1] = prev_alpha0_selector_index;
 
          return true;
       }
+   };
+
+   crnd_unpack_context crnd_unpack_begin(const void* pData, uint32 data_size)
+   {
+      if ((!pData) || (data_size < cCRNHeaderMinSize))
+         return NULL;
+
+      crn_unpacker* p = crnd_new<crn_unpacker>();
+      if (!p)
+         return NULL;
 
-      bool unpack_dxn(uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y)
+      if (!p->init(pData, data_size))
       {
-         dst_size_in_bytes;
+         crnd_delete(p);
+         return NULL;
+      }
 
-         uint32 chunk_encoding_bits = 1;
+      return p;
+   }
 
-         const uint32 num_alpha_endpoints = m_alpha_endpoints.size();
-         const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
+   uint32 crnd_get_unpack_arena_size(const void* pData, uint32 data_size)
+   {
+      crn_header tmp_header;
+      const crn_header* pHeader = crnd_get_header(tmp_header, pData, data_size);
+      if (!pHeader)
+         return 0;
 
-         uint32 prev_alpha0_endpoint_index = 0;
-         uint32 prev_alpha0_selector_index = 0;
-         uint32 prev_alpha1_endpoint_index = 0;
-         uint32 prev_alpha1_selector_index = 0;
+      return crnd_arena::get_block_size(sizeof(crnd_arena)) + crn_unpacker::get_arena_size(pHeader);
+   }
 
-         const uint32 num_faces = m_pHeader->m_faces;
+   crnd_unpack_context crnd_unpack_begin_arena(const void* pData, uint32 data_size, void* pArena, uint32 arena_size)
+   {
+      if ((!pData) || (data_size < cCRNHeaderMinSize) || (!pArena))
+         return NULL;
 
-         //const uint32 row_pitch_in_dwords = row_pitch_in_bytes >> 2U;
+      if ((uint32)reinterpret_cast<ptr_bits>(pArena) & (CRND_MIN_ALLOC_ALIGNMENT - 1))
+         return NULL;
 
-         const int32 cBytesPerBlock = 16;
+      const uint32 arena_header_size = crnd_arena::get_block_size(sizeof(crnd_arena));
+      if (arena_size <= arena_header_size)
+         return NULL;
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+      crnd_arena* pUnpacker_arena = helpers::construct(static_cast<crnd_arena*>(pArena));
+      pUnpacker_arena->init(static_cast<uint8*>(pArena) + arena_header_size, arena_size - arena_header_size);
 
-         for (uint32 f = 0; f < num_faces; f++)
-         {
-            uint8* CRND_RESTRICT pRow = pDst[f];
+      crnd_arena_scope arena_scope(pUnpacker_arena);
 
-            for (uint32 y = 0; y < chunks_y; y++)
-            {
-               int32 start_x = 0;
-               int32 end_x = chunks_x;
-               int32 dir_x = 1;
-               int32 block_delta = cBytesPerBlock*2;
-               uint8* CRND_RESTRICT pBlock = pRow;
+      crn_unpacker* p = crnd_new<crn_unpacker>();
+      if (!p)
+         return NULL;
 
-               if (y & 1)
-               {
-                  start_x = chunks_x - 1;
-                  end_x = -1;
-                  dir_x = -1;
-                  block_delta = -cBytesPerBlock*2;
-                  pBlock += (chunks_x - 1) * cBytesPerBlock * 2;
-               }
+      p->set_arena(pUnpacker_arena);
 
-               const bool skip_bottom_row = (y == (chunks_y - 1)) && (blocks_y & 1);
+      if (!p->init(pData, data_size))
+      {
+         crnd_delete(p);
+         return NULL;
+      }
 
-               for (int32 x = start_x; x != end_x; x += dir_x)
-               {
-                  uint32 alpha0_endpoints[4];
-                  uint32 alpha1_endpoints[4];
+      return p;
+   }
 
-                  if (chunk_encoding_bits == 1)
-                  {
-                     CRND_HUFF_DECODE(m_codec, m_chunk_encoding_dm, chunk_encoding_bits);
-                     chunk_encoding_bits |= 512;
-                  }
+   bool crnd_get_data(crnd_unpack_context pContext, const void** ppData, uint32* pData_size)
+   {
+      if (!pContext)
+         return false;
 
-                  const uint32 chunk_encoding_index = chunk_encoding_bits & 7;
-                  chunk_encoding_bits >>= 3;
+      crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
+
+      if (!pUnpacker->is_valid())
+         return false;
+
+      if (ppData)
+         *ppData = pUnpacker->get_data();
+
+      if (pData_size)
+         *pData_size = pUnpacker->get_data_size();
+
+      return true;
+   }
+
+   bool crnd_unpack_level(
+      crnd_unpack_context pContext,
+      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index)
+   {
+      if ((!pContext) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
+         return false;
+
+      crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
+
+      if (!pUnpacker->is_valid())
+         return false;
+
+      return pUnpacker->unpack_level(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+   }
+
+   bool crnd_unpack_level_reference(
+      crnd_unpack_context pContext,
+      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index)
+   {
+      if ((!pContext) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
+         return false;
+
+      crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
+
+      if (!pUnpacker->is_valid())
+         return false;
+
+      return pUnpacker->unpack_level_reference(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+   }
+
+   bool crnd_unpack_level_region(
+      crnd_unpack_context pContext,
+      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index, uint32 x, uint32 y, uint32 width, uint32 height)
+   {
+      if ((!pContext) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
+         return false;
+
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
+
+      if ((!pUnpacker->is_valid()) || (level_index >= pUnpacker->get_header()->m_levels))
+         return false;
+
+      crnd_arena_scope arena_scope(pUnpacker->get_arena());
+
+      return pUnpacker->unpack_level_region(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, x, y, width, height);
+   }
+
+   bool crnd_unpack_level_pixels(
+      crnd_unpack_context pContext,
+      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index, crnd_pixel_format pixel_format)
+   {
+      if ((!pContext) || (!pDst) || (level_index >= cCRNMaxLevels))
+         return false;
+
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
+
+      if ((!pUnpacker->is_valid()) || (level_index >= pUnpacker->get_header()->m_levels))
+         return false;
+
+      return pUnpacker->unpack_level_pixels(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, pixel_format);
+   }
+
+   bool crnd_unpack_level_segmented(
+      crnd_unpack_context pContext,
+      const void* pSrc, uint32 src_size_in_bytes,
+      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index)
+   {
+      if ((!pContext) || (!pSrc) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
+         return false;
+
+      crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
+
+      if (!pUnpacker->is_valid())
+         return false;
+
+      return pUnpacker->unpack_level(pSrc, src_size_in_bytes, pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+   }
+
+   crnd_unpack_context crnd_unpack_begin_tables(const void* pData, uint32 data_size)
+   {
+      if ((!pData) || (data_size < cCRNHeaderMinSize))
+         return NULL;
+
+      crn_unpacker* p = crnd_new<crn_unpacker>();
+      if (!p)
+         return NULL;
+
+      if (!p->init_base_data_copy(pData, data_size))
+      {
+         crnd_delete(p);
+         return NULL;
+      }
+
+      return p;
+   }
+
+   bool crnd_unpack_tables_match(crnd_unpack_context pContext, const void* pData, uint32 data_size)
+   {
+      if ((!pContext) || (!pData) || (data_size < cCRNHeaderMinSize))
+         return false;
+
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
+
+      if (!pUnpacker->is_valid())
+         return false;
+
+      return pUnpacker->tables_match(pData, data_size);
+   }
 
-                  const uint32 num_tiles = g_crnd_chunk_encoding_num_tiles[chunk_encoding_index];
+   struct crnd_unpack_levels_state
+   {
+      const crn_unpacker*  m_pUnpacker;
+      void***              m_pppDst;
+      const uint32*        m_pDst_sizes_in_bytes;
+      const uint32*        m_pRow_pitches_in_bytes;
 
-                  const uint8* pTile_indices = g_crnd_chunk_encoding_tiles[chunk_encoding_index].m_tiles;
+      // Each job only writes its own level's status.
+      bool                 m_status[cCRNMaxLevels];
+   };
 
-                  const bool skip_right_col = (blocks_x & 1) && (x == ((int32)chunks_x - 1));
+   static void crnd_unpack_levels_job(void* pJob_data, uint32 job_index)
+   {
+      crnd_unpack_levels_state& state = *static_cast<crnd_unpack_levels_state*>(pJob_data);
 
-                  uint32* CRND_RESTRICT pD = (uint32*)pBlock;
+      const uint32 dst_size_in_bytes = state.m_pDst_sizes_in_bytes ? state.m_pDst_sizes_in_bytes[job_index] : cUINT32_MAX;
+      const uint32 row_pitch_in_bytes = state.m_pRow_pitches_in_bytes ? state.m_pRow_pitches_in_bytes[job_index] : 0;
 
-                  for (uint32 i = 0; i < num_tiles; i++)
-                  {
-                     uint32 delta; CRND_HUFF_DECODE(m_codec, m_endpoint_delta_dm[1], delta);
-                     prev_alpha0_endpoint_index += delta;
-                     limit(prev_alpha0_endpoint_index, num_alpha_endpoints);
-                     alpha0_endpoints[i] = m_alpha_endpoints[prev_alpha0_endpoint_index];
-                  }
+      state.m_status[job_index] = state.m_pUnpacker->unpack_level(state.m_pppDst[job_index], dst_size_in_bytes, row_pitch_in_bytes, job_index);
+   }
 
-                  for (uint32 i = 0; i < num_tiles; i++)
-                  {
-                     uint32 delta; CRND_HUFF_DECODE(m_codec, m_endpoint_delta_dm[1], delta);
-                     prev_alpha1_endpoint_index += delta;
-                     limit(prev_alpha1_endpoint_index, num_alpha_endpoints);
-                     alpha1_endpoints[i] = m_alpha_endpoints[prev_alpha1_endpoint_index];
-                  }
+   bool crnd_unpack_levels(
+      crnd_unpack_context pContext,
+      void*** pppDst, const uint32* pDst_sizes_in_bytes, const uint32* pRow_pitches_in_bytes,
+      crnd_unpack_dispatch_func pDispatch, void* pUser_data)
+   {
+      if ((!pContext) || (!pppDst))
+         return false;
 
-                  pD = (uint32*)pBlock;
-                  for (uint32 by = 0; by < 2; by++)
-                  {
-                     for (uint32 bx = 0; bx < 2; bx++, pD += 4)
-                     {
-                        uint32 delta0; CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[1], delta0);
-                        prev_alpha0_selector_index += delta0;
-                        limit(prev_alpha0_selector_index, num_alpha_selectors);
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
 
-                        uint32 delta1; CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[1], delta1);
-                        prev_alpha1_selector_index += delta1;
-                        limit(prev_alpha1_selector_index, num_alpha_selectors);
+      if (!pUnpacker->is_valid())
+         return false;
 
-                        if (!((bx && skip_right_col) || (by && skip_bottom_row)))
-                        {
-                           const uint32 tile_index = pTile_indices[bx + by * 2];
-                           const uint16* pAlpha0_selectors = &m_alpha_selectors[prev_alpha0_selector_index * 3];
-                           const uint16* pAlpha1_selectors = &m_alpha_selectors[prev_alpha1_selector_index * 3];
+      const uint32 num_levels = pUnpacker->get_header()->m_levels;
+      if (num_levels > cCRNMaxLevels)
+         return false;
 
-#ifdef CRND_BIG_ENDIAN_PLATFORM
-                           pD[0] = (alpha0_endpoints[tile_index] << 16) | pAlpha0_selectors[0];
-                           CRND_WRITE_BARRIER
-                           pD[1] = (pAlpha0_selectors[1] << 16) | pAlpha0_selectors[2];
-                           CRND_WRITE_BARRIER
-                           pD[2] = (alpha1_endpoints[tile_index] << 16) | pAlpha1_selectors[0];
-                           CRND_WRITE_BARRIER
-                           pD[3] = (pAlpha1_selectors[1] << 16) | pAlpha1_selectors[2];
-                           CRND_WRITE_BARRIER
-#else
-                           pD[0] = alpha0_endpoints[tile_index] | (pAlpha0_selectors[0] << 16);
-                           CRND_WRITE_BARRIER
-                           pD[1] = pAlpha0_selectors[1] | (pAlpha0_selectors[2] << 16);
-                           CRND_WRITE_BARRIER
-                           pD[2] = alpha1_endpoints[tile_index] | (pAlpha1_selectors[0] << 16);
-                           CRND_WRITE_BARRIER
-                           pD[3] = pAlpha1_selectors[1] | (pAlpha1_selectors[2] << 16);
-                           CRND_WRITE_BARRIER
-#endif
-                        }
-                     }
+      for (uint32 i = 0; i < num_levels; i++)
+      {
+         if ((!pppDst[i]) || ((pDst_sizes_in_bytes) && (pDst_sizes_in_bytes[i] < 8U)))
+            return false;
+      }
 
-                     pD = (uint32*)((uint8*)pD - cBytesPerBlock * 2 + row_pitch_in_bytes);
-                  }
+      crnd_unpack_levels_state state;
+      state.m_pUnpacker = pUnpacker;
+      state.m_pppDst = pppDst;
+      state.m_pDst_sizes_in_bytes = pDst_sizes_in_bytes;
+      state.m_pRow_pitches_in_bytes = pRow_pitches_in_bytes;
+      utils::zero_object(state.m_status);
 
-                  pBlock += block_delta;
+      // Jobs are numbered by level, so dispatchers that hand them out in order start with the largest level.
+      if (pDispatch)
+         pDispatch(crnd_unpack_levels_job, &state, num_levels, pUser_data);
+      else
+      {
+         for (uint32 i = 0; i < num_levels; i++)
+            crnd_unpack_levels_job(&state, i);
+      }
 
-               } // x
+      for (uint32 i = 0; i < num_levels; i++)
+         if (!state.m_status[i])
+            return false;
 
-               pRow += row_pitch_in_bytes * 2;
+      return true;
+   }
 
-            } // y
+   uint32 crnd_get_level_num_slices(crnd_unpack_context pContext, uint32 level_index)
+   {
+      if (!pContext)
+         return 0;
 
-         } // f
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
 
-         CRND_HUFF_DECODE_END(m_codec);
+      if ((!pUnpacker->is_valid()) || (level_index >= pUnpacker->get_header()->m_levels))
+         return 0;
 
-         return true;
-      }
+      return pUnpacker->get_level_num_slices(level_index);
+   }
 
-      bool unpack_dxt5a(uint8** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes, uint32 blocks_x, uint32 blocks_y, uint32 chunks_x, uint32 chunks_y)
-      {
-         dst_size_in_bytes;
+   bool crnd_unpack_level_slice(
+      crnd_unpack_context pContext,
+      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index, uint32 slice_index)
+   {
+      if ((!pContext) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
+         return false;
 
-         uint32 chunk_encoding_bits = 1;
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
 
-         const uint32 num_alpha_endpoints = m_alpha_endpoints.size();
-         const uint32 num_alpha_selectors = m_pHeader->m_alpha_selectors.m_num;
+      if ((!pUnpacker->is_valid()) || (level_index >= pUnpacker->get_header()->m_levels))
+         return false;
 
-         uint32 prev_alpha0_endpoint_index = 0;
-         uint32 prev_alpha0_selector_index = 0;
+      return pUnpacker->unpack_level_slice(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, slice_index);
+   }
 
-         const uint32 num_faces = m_pHeader->m_faces;
+   struct crnd_unpack_level_slices_state
+   {
+      const crn_unpacker*  m_pUnpacker;
+      void**               m_pDst;
+      uint32               m_dst_size_in_bytes;
+      uint32               m_row_pitch_in_bytes;
+      uint32               m_level_index;
+
+      // Each job only writes its own slice's status.
+      crnd::vector<uint8>  m_status;
+   };
 
-         const int32 cBytesPerBlock = 8;
+   static void crnd_unpack_level_slices_job(void* pJob_data, uint32 job_index)
+   {
+      crnd_unpack_level_slices_state& state = *static_cast<crnd_unpack_level_slices_state*>(pJob_data);
 
-         CRND_HUFF_DECODE_BEGIN(m_codec);
+      state.m_status[job_index] = state.m_pUnpacker->unpack_level_slice(state.m_pDst, state.m_dst_size_in_bytes, state.m_row_pitch_in_bytes, state.m_level_index, job_index);
+   }
 
-         for (uint32 f = 0; f < num_faces; f++)
-         {
-            uint8* CRND_RESTRICT pRow = pDst[f];
+   bool crnd_unpack_level_slices(
+      crnd_unpack_context pContext,
+      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
+      uint32 level_index,
+      crnd_unpack_dispatch_func pDispatch, void* pUser_data)
+   {
+      if ((!pContext) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
+         return false;
 
-            for (uint32 y = 0; y < chunks_y; y++)
-            {
-               int32 start_x = 0;
-               int32 end_x = chunks_x;
-               int32 dir_x = 1;
-               int32 block_delta = cBytesPerBlock*2;
-               uint8* CRND_RESTRICT pBlock = pRow;
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
 
-               if (y & 1)
-               {
-                  start_x = chunks_x - 1;
-                  end_x = -1;
-                  dir_x = -1;
-                  block_delta = -cBytesPerBlock*2;
-                  pBlock += (chunks_x - 1) * cBytesPerBlock * 2;
-               }
+      if ((!pUnpacker->is_valid()) || (level_index >= pUnpacker->get_header()->m_levels))
+         return false;
 
-               const bool skip_bottom_row = (y == (chunks_y - 1)) && (blocks_y & 1);
+      const uint32 num_slices = pUnpacker->get_level_num_slices(level_index);
 
-               for (int32 x = start_x; x != end_x; x += dir_x)
-               {
-                  uint32 alpha0_endpoints[4];
+      // The status vector is freed by the state's destructor, inside the scope.
+      crnd_arena_scope arena_scope(pUnpacker->get_arena());
 
-                  if (chunk_encoding_bits == 1)
-                  {
-                     CRND_HUFF_DECODE(m_codec, m_chunk_encoding_dm, chunk_encoding_bits);
-                     chunk_encoding_bits |= 512;
-                  }
+      crnd_unpack_level_slices_state state;
+      state.m_pUnpacker = pUnpacker;
+      state.m_pDst = pDst;
+      state.m_dst_size_in_bytes = dst_size_in_bytes;
+      state.m_row_pitch_in_bytes = row_pitch_in_bytes;
+      state.m_level_index = level_index;
+      if (!state.m_status.resize(num_slices))
+         return false;
 
-                  const uint32 chunk_encoding_index = chunk_encoding_bits & 7;
-                  chunk_encoding_bits >>= 3;
+      if (pDispatch)
+         pDispatch(crnd_unpack_level_slices_job, &state, num_slices, pUser_data);
+      else
+      {
+         for (uint32 i = 0; i < num_slices; i++)
+            crnd_unpack_level_slices_job(&state, i);
+      }
 
-                  const uint32 num_tiles = g_crnd_chunk_encoding_num_tiles[chunk_encoding_index];
+      for (uint32 i = 0; i < num_slices; i++)
+         if (!state.m_status[i])
+            return false;
 
-                  const uint8* pTile_indices = g_crnd_chunk_encoding_tiles[chunk_encoding_index].m_tiles;
+      return true;
+   }
 
-                  const bool skip_right_col = (blocks_x & 1) && (x == ((int32)chunks_x - 1));
+   static void crnd_unpack_batch_job(void* pJob_data, uint32 job_index)
+   {
+      crnd_batch_texture& texture = static_cast<crnd_batch_texture*>(pJob_data)[job_index];
+      texture.m_status = 0;
+      texture.m_unpacked_size = 0;
 
-                  uint32* CRND_RESTRICT pD = (uint32*)pBlock;
+      crn_header tmp_header;
+      const crn_header* pHeader = crnd_get_header(tmp_header, texture.m_pData, texture.m_data_size);
+      if (!pHeader)
+         return;
 
-                  for (uint32 i = 0; i < num_tiles; i++)
-                  {
-                     uint32 delta; CRND_HUFF_DECODE(m_codec, m_endpoint_delta_dm[1], delta);
-                     prev_alpha0_endpoint_index += delta;
-                     limit(prev_alpha0_endpoint_index, num_alpha_endpoints);
-                     alpha0_endpoints[i] = m_alpha_endpoints[prev_alpha0_endpoint_index];
-                  }
+      texture.m_width = pHeader->m_width;
+      texture.m_height = pHeader->m_height;
+      texture.m_levels = pHeader->m_levels;
+      texture.m_faces = pHeader->m_faces;
+      texture.m_format = static_cast<crn_format>(static_cast<uint32>(pHeader->m_format));
+      texture.m_bytes_per_block = crnd_get_bytes_per_dxt_block(texture.m_format);
 
-                  pD = (uint32*)pBlock;
-                  for (uint32 by = 0; by < 2; by++)
-                  {
-                     for (uint32 bx = 0; bx < 2; bx++, pD += 2)
-                     {
-                        uint32 delta; CRND_HUFF_DECODE(m_codec, m_selector_delta_dm[1], delta);
-                        prev_alpha0_selector_index += delta;
-                        limit(prev_alpha0_selector_index, num_alpha_selectors);
+      if (texture.m_num_levels > texture.m_levels)
+         return;
 
-                        if (!((bx && skip_right_col) || (by && skip_bottom_row)))
-                        {
-                           const uint32 tile_index = pTile_indices[bx + by * 2];
-                           const uint16* pAlpha0_selectors = &m_alpha_selectors[prev_alpha0_selector_index * 3];
+      const uint32 first_level = texture.m_first_level;
+      const uint32 end_level = texture.m_num_levels ? (first_level + texture.m_num_levels) : texture.m_levels;
+      if ((first_level >= end_level) || (end_level > texture.m_levels) || (texture.m_faces > cCRNMaxFaces))
+         return;
 
-#if CRND_BIG_ENDIAN_PLATFORM
-                           pD[0] = (alpha0_endpoints[tile_index] << 16) | pAlpha0_selectors[0];
-                           CRND_WRITE_BARRIER
-                           pD[1] = (pAlpha0_selectors[1] << 16) | pAlpha0_selectors[2];
-                           CRND_WRITE_BARRIER
-#else
-                           pD[0] = alpha0_endpoints[tile_index] | (pAlpha0_selectors[0] << 16);
-                           CRND_WRITE_BARRIER
-                           pD[1] = pAlpha0_selectors[1] | (pAlpha0_selectors[2] << 16);
-                           CRND_WRITE_BARRIER
-#endif
-                        }
-                     }
+      uint32 level_sizes[cCRNMaxLevels];
+      uint32 row_pitches[cCRNMaxLevels];
+      for (uint32 level_index = first_level; level_index < end_level; level_index++)
+      {
+         const uint32 width = math::maximum(texture.m_width >> level_index, 1U);
+         const uint32 height = math::maximum(texture.m_height >> level_index, 1U);
 
-                     pD = (uint32*)((uint8*)pD - cBytesPerBlock * 2 + row_pitch_in_bytes);
-                  }
+         row_pitches[level_index] = ((width + 3) >> 2) * texture.m_bytes_per_block;
+         level_sizes[level_index] = row_pitches[level_index] * ((height + 3) >> 2);
 
-                  pBlock += block_delta;
+         texture.m_unpacked_size += level_sizes[level_index] * texture.m_faces;
+      }
 
-               } // x
+      if (!texture.m_pDst)
+      {
+         texture.m_status = 1;
+         return;
+      }
 
-               pRow += row_pitch_in_bytes * 2;
+      if (texture.m_dst_size < texture.m_unpacked_size)
+         return;
 
-            } // y
+      crnd_unpack_context pContext = crnd_unpack_begin(texture.m_pData, texture.m_data_size);
+      if (!pContext)
+         return;
 
-         } // f
+      uint8* pDst = static_cast<uint8*>(texture.m_pDst);
 
-         CRND_HUFF_DECODE_END(m_codec);
+      bool status = true;
+      for (uint32 level_index = first_level; (level_index < end_level) && (status); level_index++)
+      {
+         void* pFaces[cCRNMaxFaces];
+         for (uint32 f = 0; f < texture.m_faces; f++)
+         {
+            pFaces[f] = pDst;
+            pDst += level_sizes[level_index];
+         }
 
-         return true;
+         status = crnd_unpack_level(pContext, pFaces, level_sizes[level_index], row_pitches[level_index], level_index);
       }
-   };
 
-   crnd_unpack_context crnd_unpack_begin(const void* pData, uint32 data_size)
-   {
-      if ((!pData) || (data_size < cCRNHeaderMinSize))
-         return NULL;
+      crnd_unpack_end(pContext);
 
-      crn_unpacker* p = crnd_new<crn_unpacker>();
-      if (!p)
-         return NULL;
+      texture.m_status = status;
+   }
 
-      if (!p->init(pData, data_size))
+   uint32 crnd_unpack_batch(crnd_batch_texture* pTextures, uint32 num_textures, crnd_unpack_dispatch_func pDispatch, void* pUser_data)
+   {
+      if ((!pTextures) || (!num_textures))
+         return 0;
+
+      if (pDispatch)
+         pDispatch(crnd_unpack_batch_job, pTextures, num_textures, pUser_data);
+      else
       {
-         crnd_delete(p);
-         return NULL;
+         for (uint32 i = 0; i < num_textures; i++)
+            crnd_unpack_batch_job(pTextures, i);
       }
 
-      return p;
+      uint32 num_unpacked = 0;
+      for (uint32 i = 0; i < num_textures; i++)
+         num_unpacked += pTextures[i].m_status;
+
+      return num_unpacked;
    }
 
-   bool crnd_get_data(crnd_unpack_context pContext, const void** ppData, uint32* pData_size)
+   crnd_unpack_context crnd_unpack_stream_begin()
    {
-      if (!pContext)
+      return crnd_new<crn_unpacker>();
+   }
+
+   bool crnd_unpack_stream_push(crnd_unpack_context pContext, const void* pData, uint32 data_size)
+   {
+      if ((!pContext) || ((!pData) && (data_size)))
          return false;
 
       crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
 
-      if (!pUnpacker->is_valid())
+      if (!pUnpacker->is_unpacker())
          return false;
 
-      if (ppData)
-         *ppData = pUnpacker->get_data();
+      return pUnpacker->stream_push(pData, data_size);
+   }
 
-      if (pData_size)
-         *pData_size = pUnpacker->get_data_size();
+   bool crnd_unpack_stream_is_ready(crnd_unpack_context pContext)
+   {
+      if (!pContext)
+         return false;
 
-      return true;
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
+
+      return pUnpacker->is_valid();
    }
 
-   bool crnd_unpack_level(
-      crnd_unpack_context pContext,
-      void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
-      uint32 level_index)
+   uint32 crnd_unpack_stream_get_num_complete_levels(crnd_unpack_context pContext)
    {
-      if ((!pContext) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
-         return false;
+      if (!pContext)
+         return 0;
 
-      crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
+      const crn_unpacker* pUnpacker = static_cast<const crn_unpacker*>(pContext);
 
       if (!pUnpacker->is_valid())
-         return false;
+         return 0;
 
-      return pUnpacker->unpack_level(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+      return pUnpacker->get_num_complete_levels();
    }
 
-   bool crnd_unpack_level_segmented(
+   bool crnd_unpack_stream_level(
       crnd_unpack_context pContext,
-      const void* pSrc, uint32 src_size_in_bytes,
       void** pDst, uint32 dst_size_in_bytes, uint32 row_pitch_in_bytes,
-      uint32 level_index)
+      uint32 level_index, uint32* pNum_rows_ready)
    {
-      if ((!pContext) || (!pSrc) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels))
+      if ((!pContext) || (!pDst) || (dst_size_in_bytes < 8U) || (level_index >= cCRNMaxLevels) || (!pNum_rows_ready))
          return false;
 
       crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
 
-      if (!pUnpacker->is_valid())
+      if ((!pUnpacker->is_valid()) || (level_index >= pUnpacker->get_header()->m_levels))
          return false;
 
-      return pUnpacker->unpack_level(pSrc, src_size_in_bytes, pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index);
+      return pUnpacker->stream_unpack_level(pDst, dst_size_in_bytes, row_pitch_in_bytes, level_index, *pNum_rows_ready);
    }
 
    bool crnd_unpack_end(crnd_unpack_context pContext)
@@ -4799,9 +7166,11 @@ namespace crnd
 
       crn_unpacker* pUnpacker = static_cast<crn_unpacker*>(pContext);
 
-      if (!pUnpacker->is_valid())
+      if (!pUnpacker->is_unpacker())
          return false;
 
+      crnd_arena_scope arena_scope(pUnpacker->get_arena());
+
       crnd_delete(pUnpacker);
 
       return true;
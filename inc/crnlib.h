@@ -91,7 +91,8 @@ enum crn_limits
    cCRNMaxFaces               = 6,
    cCRNMaxLevels              = 16,
 
-   cCRNMaxHelperThreads       = 16,
+   // Sanity limit only, helper threads and their per-thread state are allocated at runtime.
+   cCRNMaxHelperThreads       = 1024,
 
    cCRNMinQualityLevel        = 0,
    cCRNMaxQualityLevel        = 255
@@ -194,6 +195,9 @@ enum crn_dxt_compressor_type
 // subphase_index, total_subphases - progress within current phase
 typedef crn_bool (*crn_progress_callback_func)(crn_uint32 phase_index, crn_uint32 total_phases, crn_uint32 subphase_index, crn_uint32 total_subphases, void* pUser_data_ptr);
 
+// Opaque handle to a long-lived pool of compression helper threads, see crn_create_thread_pool().
+typedef void *crn_thread_pool_t;
+
 // CRN/DDS compression parameters struct.
 struct crn_comp_params
 {
@@ -228,8 +232,11 @@ struct crn_comp_params
       m_crn_color_selector_palette_size = 0;
       m_crn_alpha_endpoint_palette_size = 0;
       m_crn_alpha_selector_palette_size = 0;
+      m_crn_slice_chunk_rows = 0;
+      m_crn_memory_limit_mb = 0;
 
       m_num_helper_threads = 0;
+      m_pThread_pool = NULL;
       m_userdata0 = 0;
       m_userdata1 = 0;
       m_pProgress_func = NULL;
@@ -259,7 +266,10 @@ struct crn_comp_params
       CRNLIB_COMP(m_crn_color_selector_palette_size);
       CRNLIB_COMP(m_crn_alpha_endpoint_palette_size);
       CRNLIB_COMP(m_crn_alpha_selector_palette_size);
+      CRNLIB_COMP(m_crn_slice_chunk_rows);
+      CRNLIB_COMP(m_crn_memory_limit_mb);
       CRNLIB_COMP(m_num_helper_threads);
+      CRNLIB_COMP(m_pThread_pool);
       CRNLIB_COMP(m_userdata0);
       CRNLIB_COMP(m_userdata1);
       CRNLIB_COMP(m_pProgress_func);
@@ -289,6 +299,7 @@ struct crn_comp_params
          ((m_crn_alpha_endpoint_palette_size) && ((m_crn_alpha_endpoint_palette_size < cCRNMinPaletteSize) || (m_crn_alpha_endpoint_palette_size > cCRNMaxPaletteSize))) ||
          ((m_crn_alpha_selector_palette_size) && ((m_crn_alpha_selector_palette_size < cCRNMinPaletteSize) || (m_crn_alpha_selector_palette_size > cCRNMaxPaletteSize))) ||
          (m_alpha_component > 3) ||
+         (m_crn_slice_chunk_rows > cCRNMaxLevelResolution / 8) ||
          (m_num_helper_threads > cCRNMaxHelperThreads) ||
          (m_dxt_quality > cCRNDXTQualityUber) ||
          (m_dxt_compressor_type >= cCRNTotalDXTCompressors) )
@@ -345,9 +356,28 @@ struct crn_comp_params
    crn_uint32                 m_crn_alpha_endpoint_palette_size;  // [cCRNMinPaletteSize,cCRNMaxPaletteSize]
    crn_uint32                 m_crn_alpha_selector_palette_size;  // [cCRNMinPaletteSize,cCRNMaxPaletteSize]
 
+   // If non-zero, the CRN file gets a slice table with the decoder's state at the start of every m_crn_slice_chunk_rows rows of
+   // chunks (8 pixel rows each) of every level, so a level's slices can be transcoded in parallel (see crnd_unpack_level_slices()).
+   // The levels themselves are coded exactly as before, so older decoders can still read the file.
+   crn_uint32                 m_crn_slice_chunk_rows;             // [0,cCRNMaxLevelResolution/8]
+
+   // If non-zero, caps the CRN compressor's memory use to about this many megabytes. The cap counts the source images in m_pImages,
+   // the codebook indices of every 8x8 chunk (a few dozen bytes each), the codebooks and room for the packed output; what's left goes
+   // to an evenly spread sample of the chunks the codebooks are built from, and to the batches of chunks each mip level is then
+   // encoded with them. Compression fails if the limit can't hold all of that with a reasonable sample, and smaller samples mean lower
+   // quality. Memory the caller holds besides m_pImages isn't counted. To stay within the limit, the codebooks are reordered one trial
+   // at a time, and mipmaps crnlib generates (see crn_mipmap_params) use the single threaded filter, as the multithreaded one needs
+   // several times the memory of the image.
+   // 0=no limit: the codebooks are built from every chunk.
+   crn_uint32                 m_crn_memory_limit_mb;
+
    // Number of helper threads to create during compression. 0=no threading.
    crn_uint32                 m_num_helper_threads;
 
+   // Optional thread pool created by crn_create_thread_pool(). If not NULL, its threads are used instead of creating
+   // m_num_helper_threads new threads, and m_num_helper_threads is ignored.
+   crn_thread_pool_t          m_pThread_pool;
+
    // CRN userdata0 and userdata1 members, which are written directly to the header of the output file.
    crn_uint32                 m_userdata0;
    crn_uint32                 m_userdata1;
@@ -537,6 +567,14 @@ void *crn_compress(const crn_comp_params &comp_params, crn_uint32 &compressed_si
 // Be sure to set the "m_gamma_filtering" member of crn_mipmap_params to false if the input texture is not sRGB.
 void *crn_compress(const crn_comp_params &comp_params, const crn_mipmap_params &mip_params, crn_uint32 &compressed_size, crn_uint32 *pActual_quality_level = NULL, float *pActual_bitrate = NULL);
 
+// Creates a pool of helper threads which can be reused by any number of crn_compress() calls (see crn_comp_params::m_pThread_pool).
+// This avoids creating and destroying OS threads for every texture and every bitrate search trial.
+// The pool may be shared by crn_compress() calls on several threads. Each call only waits for its own work, though it may run other calls' queued work while it waits.
+// Returns NULL on failure. The pool must be freed by calling crn_free_thread_pool() after all compressions using it have returned.
+crn_thread_pool_t crn_create_thread_pool(crn_uint32 num_helper_threads);
+crn_uint32 crn_get_thread_pool_num_helper_threads(crn_thread_pool_t pPool);
+void crn_free_thread_pool(crn_thread_pool_t pPool);
+
 // Transcodes an entire CRN file to DDS using the crn_decomp.h header file library to do most of the heavy lifting.
 // The output DDS file's format is guaranteed to be one of the DXTn formats in the crn_format enum.
 // This is a fast operation, because the CRN format is explicitly designed to be efficiently transcodable to DXTn.
@@ -0,0 +1,167 @@
+// File: crn_decomp_check.cpp - Transcodes .CRN files with the crn_decomp.h stand-alone header file library and prints a hash
+// of every level, so builds of the transcoder with different options (such as CRND_NO_SIMD) can be checked to produce identical
+// DXTn blocks. Also writes the test images the check compresses.
+// See Copyright Notice and license at the end of inc/crnlib.h
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// CRN transcoder library.
+#include "crn_decomp.h"
+
+static int print_usage()
+{
+   printf("Usage: crn_decomp_check file.crn [file.crn ...]\n");
+   printf("       crn_decomp_check -tga file.tga alpha\n");
+   printf("The first form prints a hash of each level of each file, the second writes a 64x64 test image with the given constant alpha.\n");
+   return EXIT_FAILURE;
+}
+
+// Loads an entire file into an allocated memory block.
+static crnd::uint8* read_file_into_buffer(const char* pFilename, crnd::uint32& size)
+{
+   size = 0;
+
+   FILE* pFile = fopen(pFilename, "rb");
+   if (!pFile)
+      return NULL;
+
+   fseek(pFile, 0, SEEK_END);
+   size = ftell(pFile);
+   fseek(pFile, 0, SEEK_SET);
+
+   crnd::uint8* pSrc_file_data = static_cast<crnd::uint8*>(malloc(size ? size : 1));
+   if ((!pSrc_file_data) || (fread(pSrc_file_data, size, 1, pFile) != 1))
+   {
+      fclose(pFile);
+      free(pSrc_file_data);
+      size = 0;
+      return NULL;
+   }
+
+   fclose(pFile);
+   return pSrc_file_data;
+}
+
+// Writes an uncompressed 32-bit .TGA of smooth color gradients, with every pixel's alpha set to the same value. Constant alpha
+// gives DXT5 and DXT5A .CRN files 1 entry alpha endpoint and selector palettes, coded with single symbol models.
+static bool write_test_tga(const char* pFilename, int alpha)
+{
+   const int cSize = 64;
+
+   FILE* pFile = fopen(pFilename, "wb");
+   if (!pFile)
+      return false;
+
+   const crnd::uint8 header[18] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, cSize, 0, cSize, 0, 32, 8 };
+   bool success = fwrite(header, sizeof(header), 1, pFile) == 1;
+
+   for (int y = 0; (y < cSize) && (success); y++)
+   {
+      for (int x = 0; x < cSize; x++)
+      {
+         // B, G, R, A
+         const crnd::uint8 pixel[4] = { static_cast<crnd::uint8>(x * 4), static_cast<crnd::uint8>(y * 4), static_cast<crnd::uint8>((x + y) * 2), static_cast<crnd::uint8>(alpha) };
+         if (fwrite(pixel, sizeof(pixel), 1, pFile) != 1)
+         {
+            success = false;
+            break;
+         }
+      }
+   }
+
+   return (fclose(pFile) == 0) && (success);
+}
+
+// 64-bit FNV-1a.
+static crnd::uint64 hash_bytes(const void* p, crnd::uint32 size, crnd::uint64 h = 14695981039346656037ULL)
+{
+   const crnd::uint8* pBytes = static_cast<const crnd::uint8*>(p);
+   for (crnd::uint32 i = 0; i < size; i++)
+      h = (h ^ pBytes[i]) * 1099511628211ULL;
+   return h;
+}
+
+static bool check_file(const char* pFilename)
+{
+   crnd::uint32 src_file_size;
+   crnd::uint8* pSrc_file_data = read_file_into_buffer(pFilename, src_file_size);
+   if (!pSrc_file_data)
+   {
+      printf("%s: unable to read file\n", pFilename);
+      return false;
+   }
+
+   crnd::crn_texture_info tex_info;
+   crnd::crnd_unpack_context pContext = NULL;
+   if ((!crnd::crnd_get_texture_info(pSrc_file_data, src_file_size, &tex_info)) || ((pContext = crnd::crnd_unpack_begin(pSrc_file_data, src_file_size)) == NULL))
+   {
+      printf("%s: not a valid .CRN file\n", pFilename);
+      free(pSrc_file_data);
+      return false;
+   }
+
+   bool success = true;
+
+   for (crnd::uint32 level_index = 0; level_index < tex_info.m_levels; level_index++)
+   {
+      const crnd::uint32 width = (tex_info.m_width >> level_index) ? (tex_info.m_width >> level_index) : 1U;
+      const crnd::uint32 height = (tex_info.m_height >> level_index) ? (tex_info.m_height >> level_index) : 1U;
+      const crnd::uint32 blocks_x = (width + 3) >> 2;
+      const crnd::uint32 blocks_y = (height + 3) >> 2;
+      const crnd::uint32 row_pitch = blocks_x * tex_info.m_bytes_per_block;
+      const crnd::uint32 face_size = row_pitch * blocks_y;
+
+      void* pFaces[cCRNMaxFaces];
+      for (crnd::uint32 f = 0; f < tex_info.m_faces; f++)
+         pFaces[f] = malloc(face_size);
+
+      if (!crnd::crnd_unpack_level(pContext, pFaces, face_size, row_pitch, level_index))
+      {
+         printf("%s: level %u: crnd_unpack_level() failed\n", pFilename, level_index);
+         success = false;
+      }
+      else
+      {
+         crnd::uint64 h = hash_bytes(NULL, 0);
+         for (crnd::uint32 f = 0; f < tex_info.m_faces; f++)
+            h = hash_bytes(pFaces[f], face_size, h);
+
+         printf("%s: level %u: %08X%08X\n", pFilename, level_index, static_cast<crnd::uint32>(h >> 32U), static_cast<crnd::uint32>(h));
+      }
+
+      for (crnd::uint32 f = 0; f < tex_info.m_faces; f++)
+         free(pFaces[f]);
+   }
+
+   crnd::crnd_unpack_end(pContext);
+   free(pSrc_file_data);
+
+   return success;
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+      return print_usage();
+
+   if (!strcmp(argv[1], "-tga"))
+   {
+      if (argc != 4)
+         return print_usage();
+
+      if (!write_test_tga(argv[2], atoi(argv[3])))
+      {
+         printf("Unable to write %s\n", argv[2]);
+         return EXIT_FAILURE;
+      }
+
+      return EXIT_SUCCESS;
+   }
+
+   bool success = true;
+   for (int i = 1; i < argc; i++)
+      success = check_file(argv[i]) && success;
+
+   return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}